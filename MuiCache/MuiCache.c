@@ -1,4 +1,21 @@
 // nsFileVSI.cpp : Defines the exported functions for the DLL application.
+// V1.21: Add FindShortcuts, query shortcuts by target folder or AppID through a persistent index
+// V1.20: Add ClearStep, time-budgeted purge that resumes from a cursor
+// V1.19: Add CacheMatchers, reuse matchers built by earlier Clear* calls while the plugin stays loaded
+// V1.18: Add ClearChanged, skip targets whose key is unchanged since the last purge
+// V1.17: Add ClearAsync/ClearWait/ClearPoll, purge on a background thread
+// V1.16: Add TraceFlush, Chrome trace of registry, shell verb, taskband and shortcut calls (MUICACHE_TRACE builds)
+// V1.15: Add ClearStats, per-target purge statistics and dry runs, with an optional JSON report
+// V1.14: Add ClearAll, purge the MuiCache, SHC and firewall targets in parallel
+// V1.13: ClearEx flag 4 also removes firewall rules whose App= field matches
+// V1.12: Clear/ClearMany/ClearEx also purge UFH\SHC entries whose data holds a matching path
+// V1.11: Add ClearEx, case-insensitive and path-anchored matching; vectorized name scan
+// V1.10: Add ClearAllProfiles, purge every profile's hives in parallel
+// V1.9: Add ClearHive, purge an unloaded profile hive (UsrClass.dat) in place
+// V1.8: Add TaskbarPinMany/TaskbarUnpinMany, one taskband object for the list
+// V1.7: TaskbarUnpin glob patterns, parallel unpin; Add TaskbarUnpinEx with recurse
+// V1.6: Add SetLnkAppIdMany
+// V1.5: Add ClearMany, purge many image names in one enumeration
 // V1.4: TaskUnpin support wilchard
 // V1.3: Add TaskPin support
 // V1.2: First release
@@ -8,101 +25,217 @@
 #include <shlwapi.h>
 #include <ShellAPI.h>
 #include "nsis/pluginapi.h" // nsis plugin
+#include "clearjob.h"
+#include "lnkindex.h"
+#include "matchercache.h"
+#include "osver.h"
+#include "pinsession.h"
+#include "profiles.h"
+#include "purge.h"
+#include "report.h"
+#include "targets.h"
+#include "trace.h"
+#include "unpin.h"
 
 #if defined(_DEBUG)
 #define MUICACHE_WAIT_DEBUGGER 1
 #pragma comment(lib, "Shlwapi.lib")
 #endif
 
-#define MAX_KEY_LENGTH 255
-#define MAX_VALUE_NAME 16383
+#define MUICACHE_REG_PATH L"Local Settings\\Software\\Microsoft\\Windows\\Shell\\MuiCache"
+// ClearEx/ClearAll flags beyond the MATCHER_* ones.
+#define MUICACHE_CLEAR_FIREWALL 0x0004
+#define MUICACHE_CLEAR_DRY_RUN  0x0008
+#define MUICACHE_CLEAR_FORCE    0x0010
+
+// Background purges an installer may have going at once.
+#define MUICACHE_MAX_JOBS 8
 
 #define TB_PIN_OK   42
 #define TB_PIN_FAIL 31
 
 extern HRESULT TaskbarSetPinState(LPCTSTR pszPath, BOOL pinning);
-extern BOOL IsWindows10OrGreater();
+extern DWORD TaskbarSetPinStates(const PIN_MODIFICATION* mods, DWORD count, HRESULT* results);
 extern BOOL SetShortcutAppId(LPCTSTR shortcut, LPCTSTR appid);
+extern DWORD SetShortcutAppIds(LPCTSTR* shortcuts, LPCTSTR* appids, DWORD count, HRESULT* results);
 
-static void MuiCache_Clear(const wchar_t* imageName, HKEY hRegRoot, const wchar_t* cacheRegPath) {
-
-    HKEY hKeyMuiCache;
-    //TCHAR    achKey[MAX_KEY_LENGTH];   // buffer for subkey name
-    //DWORD    cbName;                   // size of name string 
-    TCHAR    achClass[MAX_PATH] = TEXT("");  // buffer for class name 
-    DWORD    cchClassName = MAX_PATH;  // size of class string 
-    DWORD    cSubKeys = 0;               // number of subkeys 
-    DWORD    cbMaxSubKey;              // longest subkey size 
-    DWORD    cchMaxClass;              // longest class string 
-    DWORD    cValues;              // number of values for key 
-    DWORD    cchMaxValue;          // longest value name 
-    DWORD    cbMaxValueData;       // longest value data 
-    DWORD    cbSecurityDescriptor; // size of security descriptor 
-    FILETIME ftLastWriteTime;      // last write time 
+// Number of built-in targets MuiCache_Clear runs for |flags|.
+static DWORD MuiCache_TargetCount(DWORD flags)
+{
+    return (flags & MUICACHE_CLEAR_FIREWALL) ? TARGET_BUILTIN_COUNT : TARGET_FIREWALL;
+}
 
-    int i, n;
-    LSTATUS retCode;
+// Purges the built-in targets: MuiCache and UFH\SHC, plus the firewall rules
+// with MUICACHE_CLEAR_FIREWALL; MUICACHE_CLEAR_DRY_RUN only counts matches.
+// With |fingerprints|, unchanged keys are skipped unless MUICACHE_CLEAR_FORCE.
+// With one worker everything runs on the calling thread.
+// |purge| is released by the caller with Targets_Free.
+static LSTATUS MuiCache_Clear(const MATCHER* imageNames, DWORD flags, DWORD workers, FINGERPRINT_STORE* fingerprints,
+    TARGETS_PURGE* purge) {
 
-    static TCHAR  achValue[MAX_VALUE_NAME];
-    DWORD cchValue = MAX_VALUE_NAME;
+    LSTATUS status;
 
 #if defined(_DEBUG)
     MessageBoxW(NULL, L"Waiting for debugger to attach...", L"Waiting for debugger to attach...", MB_OK | MB_ICONEXCLAMATION);
 #endif
 
-    if (RegOpenKeyEx(hRegRoot, cacheRegPath, 0, KEY_READ | KEY_WRITE, &hKeyMuiCache) == 0)
+    MC_TRACE(TRACE_OP_PURGE,
+        status = Targets_Purge(KeyOpener_Win32(), Targets_Builtin(), MuiCache_TargetCount(flags), imageNames,
+            ((flags & MUICACHE_CLEAR_DRY_RUN) ? PURGE_DRY_RUN : 0) | ((flags & MUICACHE_CLEAR_FORCE) ? TARGETS_FORCE : 0),
+            workers, fingerprints, purge));
+    return status == ERROR_SUCCESS ? purge->firstError : status;
+}
+
+// <count> <path1> ... <pathN> -> one HRESULT per path, the first path's on top.
+static void TaskbarPinMany_Impl(int string_size, BOOL pinning)
+{
+    int i, count;
+    TCHAR* paths;
+    PIN_MODIFICATION* mods;
+    HRESULT* results;
+    INT_PTR verbResult;
+
+    count = popint();
+    if (count <= 0)
+        return;
+
+    paths = (TCHAR*)Mem_Alloc((SIZE_T)count * string_size * sizeof(TCHAR));
+    mods = (PIN_MODIFICATION*)Mem_Alloc((SIZE_T)count * sizeof(PIN_MODIFICATION));
+    results = (HRESULT*)Mem_Alloc((SIZE_T)count * sizeof(HRESULT));
+    if (paths && mods && results)
     {
-        retCode = RegQueryInfoKey(
-            hKeyMuiCache,            // key handle 
-            achClass,                // buffer for class name 
-            &cchClassName,           // size of class string 
-            NULL,                    // reserved 
-            &cSubKeys,               // number of subkeys 
-            &cbMaxSubKey,            // longest subkey size 
-            &cchMaxClass,            // longest class string 
-            &cValues,                // number of values for this key 
-            &cchMaxValue,            // longest value name 
-            &cbMaxValueData,         // longest value data 
-            &cbSecurityDescriptor,   // security descriptor 
-            &ftLastWriteTime);       // last write time 
-
-        // Enumerate the subkeys, until RegEnumKeyEx fails.
-
-        // Enumerate the key values. 
-        if (cValues)
+        for (i = 0; i < count; ++i)
         {
-            n = (int)cValues;
-            for (i = 0, retCode = ERROR_SUCCESS; i < n; )
-            {
-                cchValue = MAX_VALUE_NAME;
-                achValue[0] = '\0';
-                retCode = RegEnumValue(hKeyMuiCache, i,
-                    achValue,
-                    &cchValue,
-                    NULL,
-                    NULL,
-                    NULL,
-                    NULL);
-
-                if (retCode == ERROR_SUCCESS && StrStrW(achValue, imageName))
-                {
-                    RegDeleteValue(hKeyMuiCache, achValue);
-                    --n;
-                    continue;
-                }
+            mods[i].path = &paths[i * string_size];
+            mods[i].pinning = pinning;
+            paths[i * string_size] = '\0';
+            popstring(&paths[i * string_size]);
+        }
 
-                ++i;
+        if (OsVersion_SelectPinMethod(OsVersion_Get()) == PIN_METHOD_PINNED_LIST)
+            TaskbarSetPinStates(mods, (DWORD)count, results);
+        else
+        {
+            for (i = 0; i < count; ++i)
+            {
+                MC_TRACE(TRACE_OP_SHELL_VERB,
+                    verbResult = (INT_PTR)ShellExecute(NULL, pinning ? L"taskbarpin" : L"taskbarunpin", mods[i].path, NULL, NULL, 0));
+                results[i] = verbResult > 32 ? S_OK : E_FAIL;
             }
         }
+        for (i = count - 1; i >= 0; --i)
+            pushint(results[i]);
+    }
+    else
+    {
+        for (i = 0; i < count; ++i)
+            popstring(NULL);
+        for (i = 0; i < count; ++i)
+            pushint(E_OUTOFMEMORY);
+    }
 
-        RegCloseKey(hKeyMuiCache);
+    Mem_Free(results);
+    Mem_Free(mods);
+    Mem_Free(paths);
+}
+
+// ClearAsync handles are slot + 1. Exports all run on the installer thread,
+// so the table needs no lock.
+static CLEAR_JOB* g_clearJobs[MUICACHE_MAX_JOBS];
+static BOOL g_pluginCallbackRegistered;
+// Matchers built by earlier calls, kept while the plugin stays loaded.
+static MATCHER_CACHE g_matcherCache;
+
+static CLEAR_JOB** MuiCache_FindJob(int handle)
+{
+    if (handle < 1 || handle > MUICACHE_MAX_JOBS || !g_clearJobs[handle - 1])
+        return NULL;
+    return &g_clearJobs[handle - 1];
+}
+
+static UINT_PTR MuiCache_PluginCallback(enum NSPIM msg)
+{
+    int i;
+    if (msg == NSPIM_UNLOAD)
+    {
+        // Jobs still running finish on their own; their threads keep the
+        // DLL mapped until then.
+        for (i = 0; i < MUICACHE_MAX_JOBS; ++i)
+        {
+            ClearJob_Release(g_clearJobs[i]);
+            g_clearJobs[i] = NULL;
+        }
+        MatcherCache_Free(&g_matcherCache);
     }
+    return 0;
 }
 
-static BOOL StartsWith(LPCTSTR str1, LPCTSTR str2) {
-    int len1 = lstrlen(str1);
-    int len2 = lstrlen(str2);
-    return (len1 >= len2) && StrCmpNW(str1, str2, len2) == 0;
+// Keeps the plugin loaded across calls, as /NOUNLOAD did, so the job table
+// survives from ClearAsync to ClearWait and built matchers get reused.
+static void MuiCache_StayLoaded(extra_parameters* extra)
+{
+    HMODULE module;
+    if (g_pluginCallbackRegistered || !extra)
+        return;
+    if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+        (LPCWSTR)MuiCache_PluginCallback, &module))
+    {
+        g_pluginCallbackRegistered = extra->RegisterPluginCallback(module, MuiCache_PluginCallback) >= 0;
+    }
+}
+
+// Matcher_CreateEx through the matcher cache. Only once CacheMatchers or
+// ClearAsync has kept the plugin loaded does it cache; until then each call
+// builds and frees its own, as nothing would free the entries at unload.
+static MATCHER* MuiCache_AcquireMatcher(const WCHAR** patterns, DWORD count, DWORD flags)
+{
+    return MatcherCache_Acquire(g_pluginCallbackRegistered ? &g_matcherCache : NULL, patterns, count, flags);
+}
+
+static void MuiCache_ReleaseMatcher(MATCHER* matcher)
+{
+    MatcherCache_Release(&g_matcherCache, matcher);
+}
+
+// Pops the <name1> ... <nameN> that follow a <count> and returns the matcher
+// for them with |flags|: from MuiCache_AcquireMatcher when |extra| is given
+// (release it with MuiCache_ReleaseMatcher), else a new one the caller
+// destroys, for a matcher handed to another thread. A negative count is
+// none. The names come off the stack even when memory runs out; NULL is
+// returned then.
+static MATCHER* MuiCache_PopPatterns(extra_parameters* extra, int string_size, int count, DWORD flags)
+{
+    TCHAR* names;
+    const WCHAR** patterns;
+    MATCHER* matcher = NULL;
+    int i;
+
+    if (count < 0)
+        count = 0;
+    names = (TCHAR*)Mem_Alloc(((SIZE_T)count + 1) * string_size * sizeof(TCHAR));
+    patterns = (const WCHAR**)Mem_Alloc(((SIZE_T)count + 1) * sizeof(const WCHAR*));
+    if (names && patterns)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            patterns[i] = &names[i * string_size];
+            names[i * string_size] = '\0';
+            popstring(&names[i * string_size]);
+        }
+        // The matcher keeps its own copy of the patterns.
+        matcher = extra ? MuiCache_AcquireMatcher(patterns, (DWORD)count, flags)
+            : Matcher_CreateEx(patterns, (DWORD)count, flags);
+    }
+    else
+    {
+        // Still take our parameters off the stack.
+        for (i = 0; i < count; ++i)
+            popstring(NULL);
+    }
+
+    Mem_Free(patterns);
+    Mem_Free(names);
+    return matcher;
 }
 
 #if defined(__cplusplus)
@@ -121,14 +254,503 @@ extern "C" {
         // you should empty the stack of your parameters, and ONLY your
         // parameters.
         TCHAR appImageName[256];
+        const WCHAR* pattern;
+        MATCHER* matcher;
+        TARGETS_PURGE purge;
         EXDLL_INIT();
 
         popstring(appImageName);
-        MuiCache_Clear(appImageName, HKEY_CLASSES_ROOT, L"Local Settings\\Software\\Microsoft\\Windows\\Shell\\MuiCache");
-		// MuiCache_Clear(appImageName, HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\UFH\\SHC");
+        pattern = appImageName;
+        matcher = MuiCache_AcquireMatcher(&pattern, 1, 0);
+        if (!matcher)
+            return;
+        MuiCache_Clear(matcher, 0, 1, NULL, &purge);
+        Targets_Free(&purge);
+        MuiCache_ReleaseMatcher(matcher);
 		// HKEY_USERS\S-1-5-21-3324583540-2673638656-2559637184-1002\Software\Microsoft\Windows\CurrentVersion\UFH\SHC
-		
-		// MuiCache_Clear(appImageName, HKEY_LOCAL_MACHINE, L"SYSTEM\\CurrentControlSet\\Services\\SharedAccess\\Parameters\\FirewallPolicy\\FirewallRules");
+		// Firewall rules are machine-wide and need elevation: see ClearEx.
+    }
+
+    // MuiCache::ClearMany <count> <name1> ... <nameN>
+    // Same as calling Clear once per name, but the key is enumerated only once.
+    void __declspec(dllexport) ClearMany(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int count;
+        MATCHER* matcher;
+        TARGETS_PURGE purge;
+        EXDLL_INIT();
+
+        count = popint();
+        if (count <= 0)
+            return;
+
+        matcher = MuiCache_PopPatterns(extra, string_size, count, 0);
+        if (matcher)
+        {
+            MuiCache_Clear(matcher, 0, 1, NULL, &purge);
+            Targets_Free(&purge);
+            MuiCache_ReleaseMatcher(matcher);
+        }
+    }
+
+    // MuiCache::ClearEx <flags> <count> <name1> ... <nameN>
+    // ClearMany with matching options: 1 ignores ASCII case, 2 matches a name
+    // only as the file name a MuiCache entry is about ("app.exe" then leaves
+    // "C:\x\myapp.exe.FriendlyAppName" alone), 4 also deletes the firewall
+    // rules whose App= field matches (needs elevation; the firewall service
+    // picks the change up on restart). Pushes the number of values removed,
+    // then the Win32 status (on top).
+    void __declspec(dllexport) ClearEx(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int count, flags;
+        MATCHER* matcher = NULL;
+        TARGETS_PURGE purge;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        EXDLL_INIT();
+
+        memset(&purge, 0, sizeof(purge));
+        flags = popint();
+        count = popint();
+        matcher = MuiCache_PopPatterns(extra, string_size, count,
+            (DWORD)flags & (MATCHER_IGNORE_CASE | MATCHER_PATH_SUFFIX));
+
+        if (matcher)
+            status = MuiCache_Clear(matcher, (DWORD)flags & MUICACHE_CLEAR_FIREWALL, 1, NULL, &purge);
+
+        pushint(purge.totals.deleted);
+        pushint(status);
+
+        Targets_Free(&purge);
+        MuiCache_ReleaseMatcher(matcher);
+    }
+
+    // MuiCache::ClearAll <flags> <count> <name1> ... <nameN>
+    // ClearEx with every target key on its own thread. Pushes the first
+    // error, failed targets, purged targets, then values deleted (on top).
+    void __declspec(dllexport) ClearAll(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int count, flags;
+        MATCHER* matcher = NULL;
+        TARGETS_PURGE purge;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        EXDLL_INIT();
+
+        memset(&purge, 0, sizeof(purge));
+        flags = popint();
+        count = popint();
+        matcher = MuiCache_PopPatterns(extra, string_size, count,
+            (DWORD)flags & (MATCHER_IGNORE_CASE | MATCHER_PATH_SUFFIX));
+
+        if (matcher)
+            status = MuiCache_Clear(matcher, (DWORD)flags & MUICACHE_CLEAR_FIREWALL, 0, NULL, &purge);
+
+        pushint(status);
+        pushint(purge.failed);
+        pushint(purge.purged);
+        pushint(purge.totals.deleted);
+
+        Targets_Free(&purge);
+        MuiCache_ReleaseMatcher(matcher);
+    }
+
+    // MuiCache::ClearStats <flags> <report> <count> <name1> ... <nameN>
+    // ClearAll that reports what it did. Flags are ClearEx's, plus 8 for a
+    // dry run that only counts the values it would delete. Per target and in
+    // total: values enumerated, bytes read, matches, deletions, failures and
+    // wall time. <report> is a JSON file to write, or "" for none. Pushes
+    // the compact one-line statistics, then the first error (on top).
+    void __declspec(dllexport) ClearStats(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int i, count, flags;
+        TCHAR* reportPath;
+        MATCHER* matcher = NULL;
+        TARGETS_PURGE purge;
+        REPORT report;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        LSTATUS writeStatus;
+        EXDLL_INIT();
+
+        memset(&purge, 0, sizeof(purge));
+        Report_Init(&report);
+        flags = popint();
+        reportPath = (TCHAR*)Mem_Alloc((SIZE_T)string_size * sizeof(TCHAR));
+        if (reportPath)
+            reportPath[0] = '\0';
+        popstring(reportPath);
+        count = popint();
+        matcher = MuiCache_PopPatterns(extra, string_size, count,
+            (DWORD)flags & (MATCHER_IGNORE_CASE | MATCHER_PATH_SUFFIX));
+
+        if (reportPath && matcher)
+        {
+            status = MuiCache_Clear(matcher, (DWORD)flags & (MUICACHE_CLEAR_FIREWALL | MUICACHE_CLEAR_DRY_RUN), 0,
+                NULL, &purge);
+            if (purge.results)
+            {
+                if (reportPath[0])
+                {
+                    Report_FormatJson(&report, Targets_Builtin(), &purge, MuiCache_TargetCount((DWORD)flags),
+                        (flags & MUICACHE_CLEAR_DRY_RUN) != 0);
+                    writeStatus = Report_Write(&report, reportPath);
+                    if (status == ERROR_SUCCESS)
+                        status = writeStatus;
+                    Report_Free(&report);
+                }
+                Report_FormatCompact(&report, Targets_Builtin(), &purge, MuiCache_TargetCount((DWORD)flags));
+            }
+        }
+
+        // The stack holds string_size TCHARs; the ASCII text widens as is.
+        if (reportPath)
+        {
+            for (i = 0; i < string_size - 1 && (DWORD)i < report.cch; ++i)
+                reportPath[i] = (TCHAR)(BYTE)report.chars[i];
+            reportPath[i] = '\0';
+            pushstring(reportPath);
+        }
+        else
+        {
+            pushstring(TEXT(""));
+        }
+        pushint(status);
+
+        Report_Free(&report);
+        Targets_Free(&purge);
+        MuiCache_ReleaseMatcher(matcher);
+        Mem_Free(reportPath);
+    }
+
+    // MuiCache::ClearChanged <fingerprint file> <flags> <count> <name1> ... <nameN>
+    // ClearEx for installers that clear on every update: the fingerprint
+    // file remembers each key's last-write time and value count after the
+    // purge, per set of names, and keys that haven't changed since are not
+    // enumerated again. Flags are ClearEx's, plus 16 to purge regardless.
+    // Pushes the number of values removed, the number of targets skipped,
+    // then the Win32 status (on top).
+    void __declspec(dllexport) ClearChanged(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int count, flags;
+        TCHAR* storePath;
+        MATCHER* matcher = NULL;
+        FINGERPRINT_STORE fingerprints;
+        TARGETS_PURGE purge;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        LSTATUS saveStatus;
+        EXDLL_INIT();
+
+        memset(&purge, 0, sizeof(purge));
+        FingerprintStore_Init(&fingerprints);
+        storePath = (TCHAR*)Mem_Alloc((SIZE_T)string_size * sizeof(TCHAR));
+        if (storePath)
+            storePath[0] = '\0';
+        popstring(storePath);
+        flags = popint();
+        count = popint();
+        matcher = MuiCache_PopPatterns(extra, string_size, count,
+            (DWORD)flags & (MATCHER_IGNORE_CASE | MATCHER_PATH_SUFFIX));
+
+        if (storePath && matcher)
+        {
+            // A damaged or newer-format file only costs one full purge.
+            FingerprintStore_Load(&fingerprints, storePath);
+            status = MuiCache_Clear(matcher, (DWORD)flags & (MUICACHE_CLEAR_FIREWALL | MUICACHE_CLEAR_FORCE), 1,
+                &fingerprints, &purge);
+            if (fingerprints.dirty)
+            {
+                saveStatus = FingerprintStore_Save(&fingerprints, storePath);
+                if (status == ERROR_SUCCESS)
+                    status = saveStatus;
+            }
+        }
+
+        pushint(purge.totals.deleted);
+        pushint(purge.skipped);
+        pushint(status);
+
+        Targets_Free(&purge);
+        FingerprintStore_Free(&fingerprints);
+        MuiCache_ReleaseMatcher(matcher);
+        Mem_Free(storePath);
+    }
+
+    // MuiCache::ClearStep <flags> <milliseconds> <cursor> <count> <name1> ... <nameN>
+    // ClearEx that stops once <milliseconds> are spent, for installers that
+    // spread a large purge over several pages. Pass "" as the cursor first,
+    // then the one pushed by the previous call, with the same names. Pushes
+    // the cursor to resume from ("" when done), the number of values
+    // removed by this call, then the Win32 status (on top): 258
+    // (WAIT_TIMEOUT) while values remain, 0 when the last target is done.
+    void __declspec(dllexport) ClearStep(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int count, flags;
+        DWORD deadline;
+        TCHAR* cursorText;
+        MATCHER* matcher = NULL;
+        TARGETS_CURSOR cursor;
+        TARGETS_PURGE purge;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        EXDLL_INIT();
+
+        memset(&purge, 0, sizeof(purge));
+        flags = popint();
+        deadline = Time_Milliseconds() + (DWORD)popint();
+        cursorText = (TCHAR*)Mem_Alloc(((SIZE_T)string_size + TARGETS_CURSOR_CCH) * sizeof(TCHAR));
+        if (cursorText)
+            cursorText[0] = '\0';
+        popstring(cursorText);
+        count = popint();
+        matcher = MuiCache_PopPatterns(extra, string_size, count,
+            (DWORD)flags & (MATCHER_IGNORE_CASE | MATCHER_PATH_SUFFIX));
+
+        if (cursorText && matcher)
+        {
+            // A damaged cursor starts over, which only costs time.
+            TargetsCursor_Parse(cursorText, &cursor);
+            MC_TRACE(TRACE_OP_PURGE,
+                status = Targets_PurgeUntil(KeyOpener_Win32(), Targets_Builtin(), MuiCache_TargetCount((DWORD)flags),
+                    matcher, (flags & MUICACHE_CLEAR_DRY_RUN) ? PURGE_DRY_RUN : 0, deadline, &cursor, &purge));
+            if (status == ERROR_SUCCESS)
+                status = purge.firstError;
+            if (status == WAIT_TIMEOUT)
+                TargetsCursor_Format(&cursor, cursorText);
+            else
+                cursorText[0] = '\0';
+        }
+
+        pushstring(cursorText ? cursorText : TEXT(""));
+        pushint(purge.totals.deleted);
+        pushint(status);
+
+        Targets_Free(&purge);
+        MuiCache_ReleaseMatcher(matcher);
+        Mem_Free(cursorText);
+    }
+
+    // MuiCache::ClearAsync <flags> <count> <name1> ... <nameN>
+    // Starts ClearAll on a background thread and returns at once, so the
+    // script can go on and join with ClearWait. Flags are ClearEx's. Pushes
+    // a job handle (0 on failure), then the Win32 status (on top).
+    void __declspec(dllexport) ClearAsync(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int i, count, flags, handle = 0;
+        CLEAR_JOB_PARAMS params;
+        CLEAR_JOB* job;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        EXDLL_INIT();
+
+        memset(&params, 0, sizeof(params));
+        flags = popint();
+        count = popint();
+        params.matcher = MuiCache_PopPatterns(NULL, string_size, count,
+            (DWORD)flags & (MATCHER_IGNORE_CASE | MATCHER_PATH_SUFFIX));
+
+        for (i = 0; i < MUICACHE_MAX_JOBS && g_clearJobs[i]; ++i)
+            ;
+        if (i == MUICACHE_MAX_JOBS)
+        {
+            Matcher_Destroy(params.matcher);
+            status = ERROR_BUSY;
+        }
+        else if (params.matcher)
+        {
+            MuiCache_StayLoaded(extra);
+            params.opener = KeyOpener_Win32();
+            params.targets = Targets_Builtin();
+            params.count = MuiCache_TargetCount((DWORD)flags);
+            params.flags = (flags & MUICACHE_CLEAR_DRY_RUN) ? PURGE_DRY_RUN : 0;
+            status = ClearJob_Start(&params, &job);
+            if (status == ERROR_SUCCESS)
+            {
+                g_clearJobs[i] = job;
+                handle = i + 1;
+            }
+        }
+
+        pushint(handle);
+        pushint(status);
+    }
+
+    // MuiCache::ClearWait <handle> <timeout ms, -1 for none>
+    // Waits for a ClearAsync job. Once it is done, pushes the number of
+    // values removed, then the job's Win32 status (on top), and the handle
+    // is closed. Until then pushes 0, then WAIT_TIMEOUT (258) and the handle
+    // stays valid; ERROR_INVALID_HANDLE for an unknown handle.
+    void __declspec(dllexport) ClearWait(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int handle, timeout;
+        CLEAR_JOB** slot;
+        const TARGETS_PURGE* purge;
+        DWORD deleted = 0;
+        LSTATUS status = ERROR_INVALID_HANDLE;
+        EXDLL_INIT();
+
+        handle = popint();
+        timeout = popint();
+        slot = MuiCache_FindJob(handle);
+        if (slot)
+        {
+            status = ClearJob_Wait(*slot, timeout < 0 ? INFINITE : (DWORD)timeout);
+            if (status == ERROR_SUCCESS)
+            {
+                status = ClearJob_Result(*slot, &purge);
+                deleted = purge->totals.deleted;
+                ClearJob_Release(*slot);
+                *slot = NULL;
+            }
+        }
+
+        pushint(deleted);
+        pushint(status);
+    }
+
+    // MuiCache::ClearPoll <handle>
+    // Pushes a ClearAsync job's state without waiting: 0 starting,
+    // 1 running, 2 done (collect it with ClearWait), -1 unknown handle.
+    void __declspec(dllexport) ClearPoll(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        CLEAR_JOB** slot;
+        EXDLL_INIT();
+
+        slot = MuiCache_FindJob(popint());
+        pushint(slot ? (int)ClearJob_State(*slot) : -1);
+    }
+
+    // MuiCache::CacheMatchers
+    // Keeps the plugin loaded for the rest of the install, as /NOUNLOAD
+    // did, so later Clear* calls reuse the matchers built for the same
+    // names and flags instead of building them again; they are freed when
+    // the installer unloads the plugin. ClearAsync does the same. Pushes 1
+    // when matchers are cached, 0 when this NSIS can't keep the plugin.
+    void __declspec(dllexport) CacheMatchers(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        EXDLL_INIT();
+
+        MuiCache_StayLoaded(extra);
+        pushint(g_pluginCallbackRegistered ? 1 : 0);
+    }
+
+    // MuiCache::TraceFlush <file>
+    // Writes the spans traced since the last flush (RegEnumValue, shell
+    // verbs, taskband and IShellLink calls, IPersistFile::Save) and the
+    // per-call latency histograms to <file> in Chrome trace-event format.
+    // Pushes the Win32 status; ERROR_NOT_SUPPORTED unless the plugin was
+    // built with MUICACHE_TRACE.
+    void __declspec(dllexport) TraceFlush(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        TCHAR* path;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        EXDLL_INIT();
+
+        path = (TCHAR*)Mem_Alloc((SIZE_T)string_size * sizeof(TCHAR));
+        if (path)
+            path[0] = '\0';
+        popstring(path);
+#if defined(MUICACHE_TRACE)
+        if (path)
+            status = Trace_Flush(path);
+#else
+        status = ERROR_NOT_SUPPORTED;
+#endif
+        pushint(status);
+        Mem_Free(path);
+    }
+
+    // MuiCache::ClearHive <hive file> <count> <name1> ... <nameN>
+    // ClearMany on an unloaded UsrClass.dat, e.g. another profile's
+    // "<profile>\AppData\Local\Microsoft\Windows\UsrClass.dat". Pushes the
+    // number of values removed, then the Win32 status (on top).
+    void __declspec(dllexport) ClearHive(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int count;
+        TCHAR* hivePath;
+        MATCHER* matcher = NULL;
+        DWORD deleted = 0;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        EXDLL_INIT();
+
+        hivePath = (TCHAR*)Mem_Alloc((SIZE_T)string_size * sizeof(TCHAR));
+        if (hivePath)
+            hivePath[0] = '\0';
+        popstring(hivePath);
+        count = popint();
+        matcher = MuiCache_PopPatterns(extra, string_size, count, 0);
+
+        if (hivePath && matcher)
+            status = Purge_HiveFile(hivePath, MUICACHE_REG_PATH, matcher, 0, &deleted);
+
+        MuiCache_ReleaseMatcher(matcher);
+        Mem_Free(hivePath);
+        pushint(deleted);
+        pushint(status);
+    }
+
+    // MuiCache::ClearAllProfiles <profiles dir> <count> <name1> ... <nameN>
+    // ClearHive on the UsrClass.dat and NTUSER.DAT of every profile folder
+    // under <profiles dir> (e.g. C:\Users), one worker per core. Hives of
+    // logged-on users are in use and counted as busy; clear those with Clear
+    // while the user is logged on. Pushes the first error, failed, busy,
+    // purged hives, then values deleted (on top).
+    void __declspec(dllexport) ClearAllProfiles(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int count;
+        TCHAR* profilesDir;
+        MATCHER* matcher = NULL;
+        PROFILE_DIR_SOURCE source;
+        PROFILE_PURGE purge;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        EXDLL_INIT();
+
+        memset(&purge, 0, sizeof(purge));
+        profilesDir = (TCHAR*)Mem_Alloc((SIZE_T)string_size * sizeof(TCHAR));
+        if (profilesDir)
+            profilesDir[0] = '\0';
+        popstring(profilesDir);
+        count = popint();
+        matcher = MuiCache_PopPatterns(extra, string_size, count, 0);
+
+        if (profilesDir && matcher)
+        {
+            ProfileDirSource_Init(&source, DirLister_Win32(), profilesDir);
+            status = Profiles_Purge(&source.base, matcher, 0, &purge);
+            if (status == ERROR_SUCCESS)
+                status = purge.firstError;
+        }
+
+        pushint(status);
+        pushint(purge.failed);
+        pushint(purge.busy);
+        pushint(purge.purged);
+        pushint(purge.deleted);
+
+        Profiles_Free(&purge);
+        MuiCache_ReleaseMatcher(matcher);
+        Mem_Free(profilesDir);
     }
 
 	void __declspec(dllexport) TaskbarUnpin(HWND hwndParent, int string_size,
@@ -144,10 +766,7 @@ extern "C" {
         TCHAR path[512];
         TCHAR name[128];
         INT_PTR result;
-        HANDLE hFind;
-        BOOL bFindRet;
-        int nPathLen;
-        WIN32_FIND_DATAW fd;
+        UNPIN_RESULT unpin;
 
         EXDLL_INIT();
 
@@ -159,40 +778,47 @@ extern "C" {
         popstring(name);
 
         if(!name[0])
-            result = (INT_PTR)ShellExecute(NULL, L"taskbarunpin", path, NULL, NULL, 0);
+            MC_TRACE(TRACE_OP_SHELL_VERB, result = (INT_PTR)ShellExecute(NULL, L"taskbarunpin", path, NULL, NULL, 0));
         else {
-            nPathLen = lstrlen(path);
-            memset(&fd, 0, sizeof(fd));
-            lstrcpyW(&path[nPathLen], L"*.lnk");
-            hFind = FindFirstFile(path, &fd);
-            if (hFind != INVALID_HANDLE_VALUE)
-            {
-                path[nPathLen] = '\0';
-                do {
-                    if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && !(fd.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) &&
-                        !(fd.dwFileAttributes & FILE_ATTRIBUTE_SYSTEM))
-                    {
-                        if (StartsWith(fd.cFileName, name))
-                        {
-                            lstrcpyW(&path[nPathLen], fd.cFileName);
-
-                            if(result <= 32)
-                                result = (INT_PTR)ShellExecute(NULL, L"taskbarunpin", path, NULL, NULL, 0);
-                            else
-                                ShellExecute(NULL, L"taskbarunpin", path, NULL, NULL, 0);
-                        }
-                    }
-                    
-                    bFindRet = FindNextFile(hFind, &fd);
-                } while (bFindRet);
-
-                FindClose(hFind);
-            }
+            Unpin_Run(DirLister_Win32(), Unpin_Win32Executor(), path, name, 0, UNPIN_DEFAULT_CONCURRENCY, &unpin);
+            result = unpin.result;
         }
 
 		pushint(result);
     }
 
+    // MuiCache::TaskbarUnpinEx <dir> <pattern> <recurse> <concurrency>
+    // Like TaskbarUnpin with a pattern, optionally walking subfolders;
+    // <concurrency> 0 means the default. Pushes succeeded, matched, then
+    // the TaskbarUnpin result, so the result is popped first.
+    void __declspec(dllexport) TaskbarUnpinEx(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        TCHAR path[512];
+        TCHAR pattern[128];
+        int recurse, concurrency;
+        UNPIN_RESULT unpin;
+
+        EXDLL_INIT();
+
+        path[0] = '\0';
+        pattern[0] = '\0';
+        popstring(path);
+        popstring(pattern);
+        recurse = popint();
+        concurrency = popint();
+        if (concurrency <= 0)
+            concurrency = UNPIN_DEFAULT_CONCURRENCY;
+
+        Unpin_Run(DirLister_Win32(), Unpin_Win32Executor(), path, pattern,
+            recurse ? UNPIN_RECURSE : 0, (DWORD)concurrency, &unpin);
+
+        pushint(unpin.succeeded);
+        pushint(unpin.matched);
+        pushint(unpin.result);
+    }
+
 	void __declspec(dllexport) TaskbarPin(HWND hwndParent, int string_size,
 		LPTSTR variables, stack_t** stacktop,
 		extra_parameters* extra, ...)
@@ -208,10 +834,10 @@ extern "C" {
         EXDLL_INIT();
 
         popstring(shortcut);
-		if(IsWindows10OrGreater())
+		if(OsVersion_SelectPinMethod(OsVersion_Get()) == PIN_METHOD_PINNED_LIST)
 			result = TaskbarSetPinState(shortcut, TRUE) == S_OK ? TB_PIN_OK : TB_PIN_FAIL;
 		else
-			result = (INT_PTR)ShellExecute(NULL, L"taskbarpin", shortcut, NULL, NULL, 0);
+			MC_TRACE(TRACE_OP_SHELL_VERB, result = (INT_PTR)ShellExecute(NULL, L"taskbarpin", shortcut, NULL, NULL, 0));
 		pushint(result);
     }
 
@@ -238,6 +864,136 @@ extern "C" {
     }
 
 
+    // MuiCache::SetLnkAppIdMany <count> <shortcut1> <appid1> ... <shortcutN> <appidN>
+    // Pushes one HRESULT per shortcut, the first shortcut's on top.
+    void __declspec(dllexport) SetLnkAppIdMany(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int i, count;
+        TCHAR* strings;
+        LPCTSTR* shortcuts;
+        LPCTSTR* appids;
+        HRESULT* results;
+        EXDLL_INIT();
+
+        count = popint();
+        if (count <= 0)
+            return;
+
+        strings = (TCHAR*)Mem_Alloc((SIZE_T)count * 2 * string_size * sizeof(TCHAR));
+        shortcuts = (LPCTSTR*)Mem_Alloc((SIZE_T)count * sizeof(LPCTSTR));
+        appids = (LPCTSTR*)Mem_Alloc((SIZE_T)count * sizeof(LPCTSTR));
+        results = (HRESULT*)Mem_Alloc((SIZE_T)count * sizeof(HRESULT));
+        if (strings && shortcuts && appids && results)
+        {
+            for (i = 0; i < count; ++i)
+            {
+                shortcuts[i] = &strings[(2 * i) * string_size];
+                appids[i] = &strings[(2 * i + 1) * string_size];
+                strings[(2 * i) * string_size] = '\0';
+                strings[(2 * i + 1) * string_size] = '\0';
+                popstring(&strings[(2 * i) * string_size]);
+                popstring(&strings[(2 * i + 1) * string_size]);
+            }
+
+            SetShortcutAppIds(shortcuts, appids, (DWORD)count, results);
+            for (i = count - 1; i >= 0; --i)
+                pushint(results[i]);
+        }
+        else
+        {
+            for (i = 0; i < 2 * count; ++i)
+                popstring(NULL);
+            for (i = 0; i < count; ++i)
+                pushint(E_OUTOFMEMORY);
+        }
+
+        Mem_Free(results);
+        Mem_Free(appids);
+        Mem_Free(shortcuts);
+        Mem_Free(strings);
+    }
+
+    // MuiCache::FindShortcuts <index file> <dir> <flags> <by> <value>
+    // Lists the shortcuts under <dir> (and its subfolders with flag 1) whose
+    // target lies under <value> (<by> 0) or whose AppUserModelID is <value>
+    // (<by> 1). What each shortcut holds is kept in <index file>, so only
+    // shortcuts added or changed since the last call are read. Pushes the
+    // paths, their count, then the Win32 status (on top).
+    void __declspec(dllexport) FindShortcuts(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        int i, flags, by;
+        TCHAR* strings;
+        TCHAR* indexPath;
+        TCHAR* dir;
+        TCHAR* value;
+        LNK_INDEX index;
+        STR_LIST paths;
+        LSTATUS status = ERROR_NOT_ENOUGH_MEMORY;
+        EXDLL_INIT();
+
+        LnkIndex_Init(&index);
+        StrList_Init(&paths);
+        strings = (TCHAR*)Mem_Alloc((SIZE_T)3 * string_size * sizeof(TCHAR));
+        indexPath = strings;
+        dir = strings ? &strings[string_size] : NULL;
+        value = strings ? &strings[2 * string_size] : NULL;
+        if (strings)
+            indexPath[0] = dir[0] = '\0';
+        popstring(indexPath);
+        popstring(dir);
+        flags = popint();
+        by = popint();
+        if (value)
+            value[0] = '\0';
+        popstring(value);
+
+        if (strings)
+        {
+            // A damaged or newer-format index is rebuilt from the folder.
+            LnkIndex_Load(&index, indexPath);
+            status = LnkIndex_Refresh(&index, DirLister_Win32(), dir, (flags & 1) ? LNK_INDEX_RECURSE : 0, NULL);
+            if (status == ERROR_SUCCESS && index.dirty)
+                status = LnkIndex_Save(&index, indexPath);
+            if (status == ERROR_SUCCESS && !(by ? LnkIndex_FindByAppId(&index, value, &paths)
+                : LnkIndex_FindByTargetDir(&index, value, &paths)))
+                status = ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        for (i = (int)paths.count - 1; i >= 0; --i)
+            pushstring(StrList_Get(&paths, (DWORD)i));
+        pushint(paths.count);
+        pushint(status);
+
+        StrList_Free(&paths);
+        LnkIndex_Free(&index);
+        Mem_Free(strings);
+    }
+
+    // MuiCache::TaskbarPinMany <count> <shortcut1> ... <shortcutN>
+    // Pins every shortcut through one taskband object. Pushes one HRESULT
+    // per shortcut, the first shortcut's on top.
+    void __declspec(dllexport) TaskbarPinMany(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        EXDLL_INIT();
+        TaskbarPinMany_Impl(string_size, TRUE);
+    }
+
+    // MuiCache::TaskbarUnpinMany <count> <shortcut1> ... <shortcutN>
+    // Same as TaskbarPinMany, unpinning.
+    void __declspec(dllexport) TaskbarUnpinMany(HWND hwndParent, int string_size,
+        LPTSTR variables, stack_t** stacktop,
+        extra_parameters* extra, ...)
+    {
+        EXDLL_INIT();
+        TaskbarPinMany_Impl(string_size, FALSE);
+    }
+
     BOOL WINAPI DllMain(HINSTANCE hInst, ULONG ul_reason_for_call, LPVOID lpReserved)
     {
         // Perform actions based on the reason for calling.
@@ -246,6 +1002,9 @@ extern "C" {
         case DLL_PROCESS_ATTACH:
             // Initialize once for each new process.
             // Return FALSE to fail DLL load.
+            // Release builds have no entry point; OsVersion_Get probes on
+            // first use there.
+            OsVersion_Get();
 #if defined(MUICACHE_WAIT_DEBUGGER)
             MessageBox(NULL, L"Waiting for visual studio debugger to attach...", L"Waiting for visual studio debugger to attach...", MB_OK|MB_ICONEXCLAMATION);
 #endif
@@ -260,7 +1019,8 @@ extern "C" {
             break;
 
         case DLL_PROCESS_DETACH:
-            // Perform any necessary cleanup.
+            // Builds with an entry point; others free it at NSPIM_UNLOAD.
+            MatcherCache_Free(&g_matcherCache);
             break;
         }
         return TRUE;  // Successful DLL_PROCESS_ATTACH.
@@ -0,0 +1,51 @@
+// bench.h: a small benchmark runner for the portable cores. Suites time
+// their cases with Bench_Measure (best of --repeat runs, setup excluded) and
+// report one row per case; muicache_bench prints every row as one JSON
+// document, so results can be diffed between releases.
+#ifndef MUICACHE_BENCH_BENCH_H_
+#define MUICACHE_BENCH_BENCH_H_
+
+#include "platform.h"
+#include "gen.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef struct _BENCH_RESULT {
+    std::string suite;
+    std::string name;
+    DWORD items;     // work units per run (names, values, files, ...)
+    double ms;       // best run
+    ULONGLONG check; // a count the run produced (matches, deletions, ...)
+} BENCH_RESULT;
+
+typedef struct _BENCH_CONTEXT {
+    DWORD scale;     // items per case: 1000, 100000 or 1000000
+    ULONGLONG seed;
+    DWORD repeat;
+    const char* dumpPath;   // --dump, a regedit export for suites that replay recorded data
+    std::vector<BENCH_RESULT> results;
+} BENCH_CONTEXT;
+
+// Milliseconds on a monotonic clock.
+double Bench_Now(void);
+
+// Runs |setup| then |run| --repeat times, times only |run| and records the
+// fastest run as case |name| of |suite|. |run| returns the check count,
+// which must be the same every time.
+void Bench_Measure(BENCH_CONTEXT* bench, const char* suite, const char* name, DWORD items,
+    const std::function<void()>& setup, const std::function<ULONGLONG()>& run);
+
+// Suites, in the order they run.
+void Bench_Match(BENCH_CONTEXT* bench);
+void Bench_SimdScan(BENCH_CONTEXT* bench);
+void Bench_MatcherCache(BENCH_CONTEXT* bench);
+void Bench_Purge(BENCH_CONTEXT* bench);
+void Bench_MultiSz(BENCH_CONTEXT* bench);
+void Bench_FirewallRules(BENCH_CONTEXT* bench);
+void Bench_Lnk(BENCH_CONTEXT* bench);
+void Bench_Unpin(BENCH_CONTEXT* bench);
+void Bench_Pin(BENCH_CONTEXT* bench);
+
+#endif // MUICACHE_BENCH_BENCH_H_
@@ -0,0 +1,110 @@
+// Firewall rules: tokenizing generated rule strings, pulling out App=, and
+// the purge that matches only that field. The corpus_50k cases always use
+// 50k rules, a large dev box's FirewallRules key, whatever --scale says;
+// the others follow --scale.
+#include "bench.h"
+#include "fwrule.h"
+#include "purge.h"
+
+#include <stdio.h>
+
+#define BENCH_FWRULE_CORPUS 50000
+
+static void Bench_FirewallCases(BENCH_CONTEXT* bench, const char* prefix, DWORD count, GEN_RNG* rng)
+{
+    static const WCHAR kApp[] = { 'A', 'p', 'p', 0 };
+    std::vector<WSTR> rules, patterns;
+    std::vector<const WCHAR*> pointers;
+    REGKEY* key = NULL;
+    MATCHER* matcher;
+    DWORD app;
+    char name[64];
+
+    rules.reserve(count);
+    for (DWORD i = 0; i < count; ++i)
+        rules.push_back(Gen_FirewallRule(rng, &app));
+    for (DWORD i = 0; i < 16; ++i)
+        patterns.push_back(Gen_ImageName(Gen_Below(rng, GEN_APP_COUNT)));
+    for (const WSTR& p : patterns)
+        pointers.push_back(p.c_str());
+    matcher = Matcher_CreateEx(pointers.data(), (DWORD)pointers.size(), MATCHER_IGNORE_CASE);
+
+    snprintf(name, sizeof(name), "%stokenize", prefix);
+    Bench_Measure(bench, "fwrule", name, count, NULL, [&]() {
+        ULONGLONG fields = 0;
+        FW_RULE_TOKENIZER tok;
+        FW_RULE_FIELD field;
+        for (const WSTR& r : rules)
+        {
+            FwRule_Init(&tok, r.c_str(), (DWORD)r.size());
+            while (FwRule_Next(&tok, &field))
+                ++fields;
+        }
+        return fields;
+    });
+
+    snprintf(name, sizeof(name), "%sfind_app", prefix);
+    Bench_Measure(bench, "fwrule", name, count, NULL, [&]() {
+        ULONGLONG found = 0;
+        const WCHAR* value;
+        DWORD cchValue;
+        for (const WSTR& r : rules)
+            found += FwRule_FindField(r.c_str(), (DWORD)r.size(), kApp, &value, &cchValue);
+        return found;
+    });
+
+    // What matching the whole rule would do; its check counts the rules
+    // that only mention an image in Name= or Desc= as well.
+    snprintf(name, sizeof(name), "%smatch_whole_rule_16", prefix);
+    Bench_Measure(bench, "fwrule", name, count, NULL, [&]() {
+        ULONGLONG hits = 0;
+        for (const WSTR& r : rules)
+            hits += Matcher_Contains(matcher, r.c_str(), (DWORD)r.size());
+        return hits;
+    });
+
+    snprintf(name, sizeof(name), "%smatch_app_16", prefix);
+    Bench_Measure(bench, "fwrule", name, count, NULL, [&]() {
+        ULONGLONG hits = 0;
+        const WCHAR* value;
+        DWORD cchValue;
+        for (const WSTR& r : rules)
+        {
+            if (FwRule_FindField(r.c_str(), (DWORD)r.size(), kApp, &value, &cchValue))
+                hits += Matcher_Contains(matcher, value, cchValue);
+        }
+        return hits;
+    });
+
+    auto fill = [&]() {
+        if (key)
+            key->vtbl->Close(key);
+        RegKey_CreateMemory(&key);
+        for (DWORD i = 0; i < rules.size(); ++i)
+        {
+            char valueName[48];
+            snprintf(valueName, sizeof(valueName), "{%08X-0000-4000-8000-%012u}", i, i);
+            RegKey_MemorySetValue(key, W(valueName).c_str(), REG_SZ, (const BYTE*)rules[i].c_str(),
+                (DWORD)(rules[i].size() + 1) * sizeof(WCHAR));
+        }
+    };
+    snprintf(name, sizeof(name), "%spurge_app_16", prefix);
+    Bench_Measure(bench, "fwrule", name, count, fill, [&]() {
+        DWORD deleted = 0;
+        Purge_ValueNames(key, matcher, PURGE_MATCH_FIREWALL_APP, &deleted);
+        return (ULONGLONG)deleted;
+    });
+
+    key->vtbl->Close(key);
+    Matcher_Destroy(matcher);
+}
+
+void Bench_FirewallRules(BENCH_CONTEXT* bench)
+{
+    GEN_RNG rng;
+
+    Gen_Seed(&rng, bench->seed);
+    Bench_FirewallCases(bench, "", bench->scale, &rng);
+    Gen_Seed(&rng, bench->seed);
+    Bench_FirewallCases(bench, "corpus_50k_", BENCH_FWRULE_CORPUS, &rng);
+}
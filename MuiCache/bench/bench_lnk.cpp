@@ -0,0 +1,48 @@
+// .lnk parsing and AppUserModelID patching over generated shortcuts. Up to
+// 10k distinct files are generated and cycled through to reach --scale.
+#include "bench.h"
+#include "lnkfile.h"
+
+#define BENCH_LNK_DISTINCT 10000
+
+void Bench_Lnk(BENCH_CONTEXT* bench)
+{
+    static const WCHAR kAppId[] = { 'V', 'e', 'n', 'd', 'o', 'r', '.', 'S', 'u', 'i', 't', 'e', '.', 'A', 'p', 'p', 0 };
+    std::vector<std::vector<BYTE> > files;
+    std::vector<BYTE> out;
+    DWORD distinct = bench->scale < BENCH_LNK_DISTINCT ? bench->scale : BENCH_LNK_DISTINCT;
+    GEN_RNG rng;
+
+    Gen_Seed(&rng, bench->seed);
+    for (DWORD i = 0; i < distinct; ++i)
+        files.push_back(Gen_RandomLnk(&rng, Gen_Below(&rng, GEN_APP_COUNT)));
+    out.resize(64 * 1024);
+
+    Bench_Measure(bench, "lnk", "parse_find_appid", bench->scale, NULL, [&]() {
+        ULONGLONG found = 0;
+        LNK_FILE lnk;
+        LNK_TEXT appId;
+        for (DWORD i = 0; i < bench->scale; ++i)
+        {
+            const std::vector<BYTE>& f = files[i % distinct];
+            if (SUCCEEDED(Lnk_Parse(f.data(), (DWORD)f.size(), &lnk)))
+                found += Lnk_FindStringProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, &appId);
+        }
+        return found;
+    });
+
+    Bench_Measure(bench, "lnk", "patch_appid", bench->scale, NULL, [&]() {
+        ULONGLONG bytes = 0;
+        LNK_FILE lnk;
+        DWORD cb;
+        for (DWORD i = 0; i < bench->scale; ++i)
+        {
+            const std::vector<BYTE>& f = files[i % distinct];
+            if (SUCCEEDED(Lnk_Parse(f.data(), (DWORD)f.size(), &lnk)) &&
+                SUCCEEDED(Lnk_WriteWithStringProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, kAppId,
+                    out.data(), (DWORD)out.size(), &cb)))
+                bytes += cb;
+        }
+        return bytes;
+    });
+}
@@ -0,0 +1,170 @@
+// muicache_bench [--scale 1k|100k|1m] [--seed N] [--repeat N] [--suite NAME]...
+//                [--dump FILE] [--out FILE]
+// Runs the benchmark suites over seeded synthetic data and writes the
+// results as JSON to --out (default: stdout). Progress goes to stderr.
+#include "bench.h"
+#include "simdscan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct _BENCH_SUITE {
+    const char* name;
+    void (*run)(BENCH_CONTEXT* bench);
+} BENCH_SUITE;
+
+static const BENCH_SUITE kSuites[] = {
+    { "match", Bench_Match },
+    { "simdscan", Bench_SimdScan },
+    { "matchercache", Bench_MatcherCache },
+    { "purge", Bench_Purge },
+    { "multisz", Bench_MultiSz },
+    { "fwrule", Bench_FirewallRules },
+    { "lnk", Bench_Lnk },
+    { "unpin", Bench_Unpin },
+    { "pin", Bench_Pin },
+};
+
+double Bench_Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+void Bench_Measure(BENCH_CONTEXT* bench, const char* suite, const char* name, DWORD items,
+    const std::function<void()>& setup, const std::function<ULONGLONG()>& run)
+{
+    BENCH_RESULT result;
+    double start, ms;
+
+    result.suite = suite;
+    result.name = name;
+    result.items = items;
+    result.ms = 0;
+    result.check = 0;
+    for (DWORD i = 0; i < bench->repeat; ++i)
+    {
+        if (setup)
+            setup();
+        start = Bench_Now();
+        ULONGLONG check = run();
+        ms = Bench_Now() - start;
+        if (i && check != result.check)
+            fprintf(stderr, "%s/%s: check %llu differs from %llu\n", suite, name,
+                (unsigned long long)check, (unsigned long long)result.check);
+        result.check = check;
+        if (!i || ms < result.ms)
+            result.ms = ms;
+    }
+    fprintf(stderr, "  %-8s %-32s %9u items %10.3f ms\n", suite, name, items, result.ms);
+    bench->results.push_back(result);
+}
+
+static void Bench_WriteJson(FILE* out, const BENCH_CONTEXT* bench)
+{
+    fprintf(out, "{\n  \"benchmark\": \"muicache\",\n  \"format\": 1,\n  \"scale\": %u,\n  \"seed\": %llu,\n"
+        "  \"repeat\": %u,\n  \"simd_level\": %u,\n  \"results\": [", bench->scale,
+        (unsigned long long)bench->seed, bench->repeat,
+        SimdScan_Level());
+    for (size_t i = 0; i < bench->results.size(); ++i)
+    {
+        const BENCH_RESULT& r = bench->results[i];
+        fprintf(out, "%s\n    {\"suite\": \"%s\", \"case\": \"%s\", \"items\": %u, \"ms\": %.4f, "
+            "\"items_per_sec\": %.0f, \"check\": %llu}", i ? "," : "", r.suite.c_str(), r.name.c_str(), r.items,
+            r.ms, r.ms > 0 ? r.items * 1000.0 / r.ms : 0.0, (unsigned long long)r.check);
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+static BOOL Bench_ParseScale(const char* text, DWORD* scale)
+{
+    if (!strcmp(text, "1k"))
+        *scale = 1000;
+    else if (!strcmp(text, "100k"))
+        *scale = 100000;
+    else if (!strcmp(text, "1m") || !strcmp(text, "1M"))
+        *scale = 1000000;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+static void Bench_Usage(void)
+{
+    size_t i;
+    fprintf(stderr, "usage: muicache_bench [--scale 1k|100k|1m] [--seed N] [--repeat N] [--suite NAME]...\n"
+        "                      [--dump FILE] [--out FILE]\nsuites:");
+    for (i = 0; i < sizeof(kSuites) / sizeof(kSuites[0]); ++i)
+        fprintf(stderr, " %s", kSuites[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv)
+{
+    BENCH_CONTEXT bench;
+    std::vector<std::string> only;
+    const char* outPath = NULL;
+    FILE* out = stdout;
+    size_t i, j;
+
+    bench.scale = 100000;
+    bench.seed = 1;
+    bench.repeat = 3;
+    bench.dumpPath = NULL;
+    for (int a = 1; a < argc; ++a)
+    {
+        const char* value = a + 1 < argc ? argv[a + 1] : NULL;
+        if (!strcmp(argv[a], "--scale") && value && Bench_ParseScale(value, &bench.scale))
+            ++a;
+        else if (!strcmp(argv[a], "--seed") && value)
+            bench.seed = strtoull(argv[++a], NULL, 0);
+        else if (!strcmp(argv[a], "--repeat") && value && atoi(value) > 0)
+            bench.repeat = (DWORD)atoi(argv[++a]);
+        else if (!strcmp(argv[a], "--suite") && value)
+            only.push_back(argv[++a]);
+        else if (!strcmp(argv[a], "--dump") && value)
+            bench.dumpPath = argv[++a];
+        else if (!strcmp(argv[a], "--out") && value)
+            outPath = argv[++a];
+        else
+        {
+            Bench_Usage();
+            return 2;
+        }
+    }
+    for (j = 0; j < only.size(); ++j)
+    {
+        for (i = 0; i < sizeof(kSuites) / sizeof(kSuites[0]) && only[j] != kSuites[i].name; ++i)
+            ;
+        if (i == sizeof(kSuites) / sizeof(kSuites[0]))
+        {
+            fprintf(stderr, "unknown suite %s\n", only[j].c_str());
+            Bench_Usage();
+            return 2;
+        }
+    }
+
+    for (i = 0; i < sizeof(kSuites) / sizeof(kSuites[0]); ++i)
+    {
+        BOOL selected = only.empty();
+        for (j = 0; j < only.size(); ++j)
+            selected |= only[j] == kSuites[i].name;
+        if (!selected)
+            continue;
+        fprintf(stderr, "%s\n", kSuites[i].name);
+        kSuites[i].run(&bench);
+    }
+
+    if (outPath && !(out = fopen(outPath, "w")))
+    {
+        perror(outPath);
+        return 1;
+    }
+    Bench_WriteJson(out, &bench);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
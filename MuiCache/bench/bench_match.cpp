@@ -0,0 +1,75 @@
+// Value-name matching: Matcher_Contains over generated MuiCache names with
+// growing pattern sets, against the StrStrW loop it replaced.
+#include "bench.h"
+#include "matcher.h"
+
+#include <stdio.h>
+
+// StrStrW over a counted name, one pattern after another: the old hot loop.
+static BOOL Bench_StrStrAny(const WSTR* patterns, DWORD count, const WCHAR* text, DWORD cch)
+{
+    for (DWORD p = 0; p < count; ++p)
+    {
+        const WCHAR* needle = patterns[p].c_str();
+        DWORD m = (DWORD)patterns[p].size();
+        for (DWORD i = 0; i + m <= cch; ++i)
+        {
+            DWORD j = 0;
+            while (j < m && text[i + j] == needle[j])
+                ++j;
+            if (j == m)
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void Bench_Match(BENCH_CONTEXT* bench)
+{
+    static const DWORD kPatternCounts[] = { 1, 4, 16, 64 };
+    std::vector<WSTR> names;
+    GEN_RNG rng;
+    DWORD app;
+    char name[64];
+
+    Gen_Seed(&rng, bench->seed);
+    names.reserve(bench->scale);
+    for (DWORD i = 0; i < bench->scale; ++i)
+        names.push_back(Gen_MuiCacheName(&rng, &app));
+
+    for (DWORD count : kPatternCounts)
+    {
+        std::vector<WSTR> patterns;
+        std::vector<const WCHAR*> pointers;
+        for (DWORD i = 0; i < count; ++i)
+            patterns.push_back(Gen_ImageName(Gen_Below(&rng, GEN_APP_COUNT)));
+        for (const WSTR& p : patterns)
+            pointers.push_back(p.c_str());
+
+        snprintf(name, sizeof(name), "strstr_%u", count);
+        Bench_Measure(bench, "match", name, bench->scale, NULL, [&]() {
+            ULONGLONG hits = 0;
+            for (const WSTR& n : names)
+                hits += Bench_StrStrAny(patterns.data(), count, n.c_str(), (DWORD)n.size());
+            return hits;
+        });
+
+        static const struct { const char* label; DWORD flags; } kModes[] = {
+            { "matcher", 0 },
+            { "matcher_icase", MATCHER_IGNORE_CASE },
+            { "matcher_suffix_icase", MATCHER_PATH_SUFFIX | MATCHER_IGNORE_CASE },
+        };
+        for (const auto& mode : kModes)
+        {
+            MATCHER* matcher = Matcher_CreateEx(pointers.data(), count, mode.flags);
+            snprintf(name, sizeof(name), "%s_%u", mode.label, count);
+            Bench_Measure(bench, "match", name, bench->scale, NULL, [&]() {
+                ULONGLONG hits = 0;
+                for (const WSTR& n : names)
+                    hits += Matcher_Contains(matcher, n.c_str(), (DWORD)n.size());
+                return hits;
+            });
+            Matcher_Destroy(matcher);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+// What MatcherCache saves per Clear* call: building the matcher for the
+// call (cold) against acquiring the one the previous call left (warm).
+// Calls are --scale / 100, at least 100.
+#include "bench.h"
+#include "matchercache.h"
+
+#include <stdio.h>
+
+void Bench_MatcherCache(BENCH_CONTEXT* bench)
+{
+    static const DWORD kPatternCounts[] = { 1, 4, 16, 64 };
+    static const DWORD kFlags = MATCHER_IGNORE_CASE;
+    DWORD calls = bench->scale / 100 < 100 ? 100 : bench->scale / 100;
+    MATCHER_CACHE cache;
+    GEN_RNG rng;
+    char name[32];
+
+    Gen_Seed(&rng, bench->seed);
+    memset(&cache, 0, sizeof(cache));
+    for (DWORD count : kPatternCounts)
+    {
+        std::vector<WSTR> patterns;
+        std::vector<const WCHAR*> pointers;
+        for (DWORD i = 0; i < count; ++i)
+            patterns.push_back(Gen_AppDir(Gen_Below(&rng, GEN_APP_COUNT)) + W("\\") +
+                Gen_ImageName(Gen_Below(&rng, GEN_APP_COUNT)));
+        for (const WSTR& p : patterns)
+            pointers.push_back(p.c_str());
+
+        snprintf(name, sizeof(name), "cold_%u", count);
+        Bench_Measure(bench, "matchercache", name, calls, NULL, [&]() {
+            ULONGLONG hash = 0;
+            for (DWORD i = 0; i < calls; ++i)
+            {
+                MATCHER* matcher = MatcherCache_Acquire(NULL, pointers.data(), count, kFlags);
+                hash += Matcher_Hash(matcher);
+                MatcherCache_Release(NULL, matcher);
+            }
+            return hash;
+        });
+
+        snprintf(name, sizeof(name), "warm_%u", count);
+        Bench_Measure(bench, "matchercache", name, calls, [&]() {
+            MatcherCache_Release(&cache, MatcherCache_Acquire(&cache, pointers.data(), count, kFlags));
+        }, [&]() {
+            ULONGLONG hash = 0;
+            for (DWORD i = 0; i < calls; ++i)
+            {
+                MATCHER* matcher = MatcherCache_Acquire(&cache, pointers.data(), count, kFlags);
+                hash += Matcher_Hash(matcher);
+                MatcherCache_Release(&cache, matcher);
+            }
+            return hash;
+        });
+    }
+    MatcherCache_Free(&cache);
+}
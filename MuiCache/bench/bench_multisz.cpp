@@ -0,0 +1,92 @@
+// UFH\SHC-style REG_MULTI_SZ data: the zero-copy walk, matching every
+// string against the image set, and the PURGE_MATCH_DATA purge. Runs on
+// --scale generated records, or on the string values of a regedit export
+// given with --dump (e.g. reg export HKCU\...\UFH\SHC shc.reg).
+#include "bench.h"
+#include "multisz.h"
+#include "purge.h"
+#include "regdump.h"
+
+#include <stdio.h>
+
+void Bench_MultiSz(BENCH_CONTEXT* bench)
+{
+    std::vector<REG_DUMP_VALUE> values;
+    std::vector<WSTR> patterns;
+    std::vector<const WCHAR*> pointers;
+    REGKEY* key = NULL;
+    MATCHER* matcher;
+    GEN_RNG rng;
+    DWORD app, error;
+    char name[32];
+
+    Gen_Seed(&rng, bench->seed);
+    if (bench->dumpPath)
+    {
+        std::vector<REG_DUMP_VALUE> dump;
+        if (!RegDump_Load(bench->dumpPath, &dump, &error))
+        {
+            fprintf(stderr, "%s: can't read (line %u), skipping multisz\n", bench->dumpPath, error);
+            return;
+        }
+        for (const REG_DUMP_VALUE& v : dump)
+        {
+            if (v.type == REG_SZ || v.type == REG_EXPAND_SZ || v.type == REG_MULTI_SZ)
+                values.push_back(v);
+        }
+    }
+    else
+    {
+        for (DWORD i = 0; i < bench->scale; ++i)
+        {
+            REG_DUMP_VALUE v;
+            snprintf(name, sizeof(name), "%u", i);
+            v.name = W(name);
+            v.type = REG_MULTI_SZ;
+            v.data = Gen_ShcRecord(&rng, &app);
+            values.push_back(v);
+        }
+    }
+    for (DWORD i = 0; i < 16; ++i)
+        patterns.push_back(Gen_ImageName(Gen_Below(&rng, GEN_APP_COUNT)));
+    for (const WSTR& p : patterns)
+        pointers.push_back(p.c_str());
+    matcher = Matcher_CreateEx(pointers.data(), (DWORD)pointers.size(), MATCHER_IGNORE_CASE);
+
+    Bench_Measure(bench, "multisz", "walk", (DWORD)values.size(), NULL, [&]() {
+        ULONGLONG strings = 0;
+        const WCHAR* str;
+        DWORD cch;
+        MULTI_SZ ms;
+        for (const REG_DUMP_VALUE& v : values)
+        {
+            MultiSz_Init(&ms, v.data.data(), (DWORD)v.data.size());
+            while (MultiSz_Next(&ms, &str, &cch))
+                ++strings;
+        }
+        return strings;
+    });
+
+    Bench_Measure(bench, "multisz", "contains_16", (DWORD)values.size(), NULL, [&]() {
+        ULONGLONG hits = 0;
+        for (const REG_DUMP_VALUE& v : values)
+            hits += MultiSz_Contains(matcher, v.type, v.data.data(), (DWORD)v.data.size());
+        return hits;
+    });
+
+    auto fill = [&]() {
+        if (key)
+            key->vtbl->Close(key);
+        RegKey_CreateMemory(&key);
+        RegDump_Fill(key, values, NULL);
+    };
+    Bench_Measure(bench, "multisz", "purge_data_16", (DWORD)values.size(), fill, [&]() {
+        DWORD deleted = 0;
+        Purge_ValueNames(key, matcher, PURGE_MATCH_DATA, &deleted);
+        return (ULONGLONG)deleted;
+    });
+
+    if (key)
+        key->vtbl->Close(key);
+    Matcher_Destroy(matcher);
+}
@@ -0,0 +1,57 @@
+// The enumerate/match/delete loop over a memory key holding --scale
+// generated MuiCache names, as Clear runs it.
+#include "bench.h"
+#include "purge.h"
+
+#include <algorithm>
+
+void Bench_Purge(BENCH_CONTEXT* bench)
+{
+    std::vector<WSTR> names, patterns;
+    std::vector<const WCHAR*> pointers;
+    REGKEY* key = NULL;
+    MATCHER* matcher;
+    GEN_RNG rng;
+    DWORD app;
+
+    Gen_Seed(&rng, bench->seed);
+    names.reserve(bench->scale);
+    for (DWORD i = 0; i < bench->scale; ++i)
+        names.push_back(Gen_MuiCacheName(&rng, &app));
+    // A key holds each name once; resource names repeat.
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    for (DWORD i = 0; i < 16; ++i)
+        patterns.push_back(Gen_ImageName(Gen_Below(&rng, GEN_APP_COUNT)));
+    for (const WSTR& p : patterns)
+        pointers.push_back(p.c_str());
+    matcher = Matcher_CreateEx(pointers.data(), (DWORD)pointers.size(), MATCHER_IGNORE_CASE);
+
+    auto fill = [&]() {
+        static const BYTE kData[] = { 'A', 0, 'p', 0, 'p', 0, 0, 0 };
+        if (key)
+            key->vtbl->Close(key);
+        RegKey_CreateMemory(&key);
+        for (const WSTR& n : names)
+            RegKey_MemorySetValue(key, n.c_str(), REG_SZ, kData, sizeof(kData));
+    };
+    Bench_Measure(bench, "purge", "snapshot_16", (DWORD)names.size(), fill, [&]() {
+        DWORD deleted = 0;
+        Purge_ValueNames(key, matcher, 0, &deleted);
+        return (ULONGLONG)deleted;
+    });
+    Bench_Measure(bench, "purge", "in_place_16", (DWORD)names.size(), fill, [&]() {
+        DWORD deleted = 0;
+        Purge_ValueNames(key, matcher, PURGE_IN_PLACE, &deleted);
+        return (ULONGLONG)deleted;
+    });
+    Bench_Measure(bench, "purge", "dry_run_16", (DWORD)names.size(), fill, [&]() {
+        PURGE_STATS stats;
+        memset(&stats, 0, sizeof(stats));
+        Purge_ValueNamesEx(key, matcher, PURGE_DRY_RUN, &stats);
+        return (ULONGLONG)stats.matched;
+    });
+
+    key->vtbl->Close(key);
+    Matcher_Destroy(matcher);
+}
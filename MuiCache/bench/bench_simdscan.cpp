@@ -0,0 +1,71 @@
+// SimdScan_Contains at each kernel level the CPU has, forced with
+// SimdScan_Limit, against the StrStrW-style loop: per value name, and over
+// all names joined into one buffer as REG_MULTI_SZ data is scanned.
+#include "bench.h"
+#include "simdscan.h"
+
+#include <stdio.h>
+
+static BOOL Bench_StrStr(const WCHAR* text, DWORD cch, const WCHAR* needle, DWORD cchNeedle, BOOL foldCase)
+{
+    for (DWORD i = 0; i + cchNeedle <= cch; ++i)
+    {
+        DWORD j = 0;
+        while (j < cchNeedle && (foldCase ? SimdScan_FoldChar(text[i + j]) : text[i + j]) == needle[j])
+            ++j;
+        if (j == cchNeedle)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+void Bench_SimdScan(BENCH_CONTEXT* bench)
+{
+    static const char* const kLevels[] = { "scalar", "sse2", "avx2" };
+    typedef BOOL (*SCAN)(const WCHAR*, DWORD, const WCHAR*, DWORD, BOOL);
+    DWORD best = SimdScan_Level();
+    std::vector<WSTR> names;
+    WSTR joined, needle, folded, absent = W("nothere.exe");
+    GEN_RNG rng;
+    DWORD app;
+    char name[64];
+
+    Gen_Seed(&rng, bench->seed);
+    names.reserve(bench->scale);
+    for (DWORD i = 0; i < bench->scale; ++i)
+    {
+        names.push_back(Gen_MuiCacheName(&rng, &app));
+        joined += names.back();
+        joined.push_back(0);
+    }
+    needle = Gen_ImageName(Gen_Below(&rng, GEN_APP_COUNT));
+    folded = needle;
+    for (WCHAR& ch : folded)
+        ch = SimdScan_FoldChar(ch);
+
+    auto measure = [&](const char* label, SCAN scan) {
+        for (BOOL foldCase = FALSE; foldCase <= TRUE; ++foldCase)
+        {
+            snprintf(name, sizeof(name), "%s%s", label, foldCase ? "_icase" : "");
+            const WSTR& p = foldCase ? folded : needle;
+            Bench_Measure(bench, "simdscan", name, bench->scale, NULL, [&]() {
+                ULONGLONG hits = 0;
+                for (const WSTR& n : names)
+                    hits += scan(n.c_str(), (DWORD)n.size(), p.c_str(), (DWORD)p.size(), foldCase);
+                return hits;
+            });
+        }
+        snprintf(name, sizeof(name), "%s_joined", label);
+        Bench_Measure(bench, "simdscan", name, bench->scale, NULL, [&]() {
+            return (ULONGLONG)scan(joined.c_str(), (DWORD)joined.size(), absent.c_str(), (DWORD)absent.size(), FALSE);
+        });
+    };
+
+    measure("strstr", Bench_StrStr);
+    for (DWORD level = 0; level <= best; ++level)
+    {
+        SimdScan_Limit(level);
+        measure(kLevels[level], SimdScan_Contains);
+    }
+    SimdScan_Limit(best);
+}
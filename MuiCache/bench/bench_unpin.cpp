@@ -0,0 +1,129 @@
+// Wildcard shortcut matching and the pin/unpin schedulers, against the
+// fake directory tree, verb executor and taskband of testing/fakes.h.
+#include "bench.h"
+#include "fakes.h"
+#include "glob.h"
+
+#define BENCH_FOLDER_FILES 200
+
+static void Bench_FillStartMenu(FAKE_DIR_LISTER* lister, const WSTR& root, DWORD files, GEN_RNG* rng)
+{
+    DWORD folders = (files + BENCH_FOLDER_FILES - 1) / BENCH_FOLDER_FILES;
+    char name[32];
+
+    for (DWORD f = 0; f < folders; ++f)
+    {
+        snprintf(name, sizeof(name), "Group %u", f);
+        WSTR folder = W(name);
+        FakeDirLister_Add(lister, root, folder, TRUE);
+        WSTR dir = FakeDir_Join(root, folder);
+        for (DWORD i = f * BENCH_FOLDER_FILES; i < files && i < (f + 1) * BENCH_FOLDER_FILES; ++i)
+        {
+            WSTR image = Gen_ImageName(Gen_Below(rng, GEN_APP_COUNT));
+            image.resize(image.size() - 4); // ".exe"
+            snprintf(name, sizeof(name), " %u.%s", i, Gen_Below(rng, 8) ? "lnk" : "url");
+            FakeDirLister_Add(lister, dir, image + W(name), FALSE);
+        }
+    }
+}
+
+void Bench_Unpin(BENCH_CONTEXT* bench)
+{
+    static const char* const kPatterns[] = { "studio*.lnk", "*[0-9]7.LNK", "Player1?? *" };
+    FAKE_DIR_LISTER lister;
+    FAKE_VERB_EXECUTOR executor;
+    WSTR root = W("C:\\ProgramData\\Microsoft\\Windows\\Start Menu\\Programs");
+    std::vector<WSTR> names;
+    STR_LIST paths;
+    GEN_RNG rng;
+    char name[48];
+
+    Gen_Seed(&rng, bench->seed);
+    FakeDirLister_Init(&lister);
+    Bench_FillStartMenu(&lister, root, bench->scale, &rng);
+    for (const auto& dir : lister.dirs)
+    {
+        for (const FAKE_DIR_ENTRY& entry : dir.second)
+            names.push_back(entry.name);
+    }
+
+    for (DWORD p = 0; p < sizeof(kPatterns) / sizeof(kPatterns[0]); ++p)
+    {
+        WSTR pattern = W(kPatterns[p]);
+        snprintf(name, sizeof(name), "glob_%u", p);
+        Bench_Measure(bench, "unpin", name, (DWORD)names.size(), NULL, [&]() {
+            ULONGLONG hits = 0;
+            for (const WSTR& n : names)
+                hits += Glob_Match(pattern.c_str(), n.c_str(), GLOB_IGNORE_CASE);
+            return hits;
+        });
+    }
+
+    StrList_Init(&paths);
+    Bench_Measure(bench, "unpin", "find_shortcuts_recursive", (DWORD)names.size(), NULL, [&]() {
+        StrList_Clear(&paths);
+        Unpin_FindShortcuts(&lister.base, root.c_str(), W("*player*").c_str(), UNPIN_RECURSE, &paths);
+        return (ULONGLONG)paths.count;
+    });
+
+    // Scheduling overhead alone, then with calls that block like
+    // ShellExecute does, where the concurrency limit pays off.
+    FakeVerbExecutor_Init(&executor);
+    std::vector<LONG> results(paths.count);
+    for (DWORD workers = 1; workers <= UNPIN_DEFAULT_CONCURRENCY; workers *= 4)
+    {
+        snprintf(name, sizeof(name), "dispatch_%u", workers);
+        Bench_Measure(bench, "unpin", name, paths.count, NULL, [&]() {
+            Verb_Dispatch(&executor.base, W("taskbarunpin").c_str(), &paths, workers, results.data());
+            return (ULONGLONG)paths.count;
+        });
+    }
+
+    STR_LIST few;
+    StrList_Init(&few);
+    for (DWORD i = 0; i < paths.count && i < 64; ++i)
+        StrList_Add(&few, StrList_Get(&paths, i), Str_Length(StrList_Get(&paths, i)));
+    executor.delayMicroseconds = 1000;
+    for (DWORD workers = 1; workers <= UNPIN_MAX_CONCURRENCY; workers *= 4)
+    {
+        snprintf(name, sizeof(name), "dispatch_blocking_1ms_%u", workers);
+        Bench_Measure(bench, "unpin", name, few.count, NULL, [&]() {
+            Verb_Dispatch(&executor.base, W("taskbarunpin").c_str(), &few, workers, results.data());
+            return (ULONGLONG)few.count;
+        });
+    }
+    StrList_Free(&few);
+    StrList_Free(&paths);
+}
+
+void Bench_Pin(BENCH_CONTEXT* bench)
+{
+    std::vector<WSTR> paths;
+    std::vector<PIN_MODIFICATION> mods;
+    std::vector<HRESULT> results(bench->scale);
+    FAKE_PIN_CONTEXT context;
+    GEN_RNG rng;
+
+    Gen_Seed(&rng, bench->seed);
+    paths.reserve(bench->scale);
+    for (DWORD i = 0; i < bench->scale; ++i)
+        paths.push_back(W("C:\\Users\\user\\Desktop\\") + Gen_ImageName(Gen_Below(&rng, GEN_APP_COUNT)) + W(".lnk"));
+    for (DWORD i = 0; i < bench->scale; ++i)
+    {
+        PIN_MODIFICATION mod = { paths[i].c_str(), (BOOL)(i & 1) };
+        mods.push_back(mod);
+    }
+
+    // One session for the whole list, with Explorer restarting midway.
+    Bench_Measure(bench, "pin", "session_apply", bench->scale, [&]() {
+        FakePinContext_Init(&context);
+        context.disconnectAt = bench->scale / 2;
+    }, [&]() {
+        PIN_SESSION session;
+        DWORD ok;
+        PinSession_Open(&session, &kFakePinSessionOps, &context);
+        ok = PinSession_Apply(&session, mods.data(), bench->scale, results.data());
+        PinSession_Close(&session);
+        return (ULONGLONG)ok;
+    });
+}
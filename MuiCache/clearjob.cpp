@@ -0,0 +1,107 @@
+// Background purge jobs.
+// A job has two references, the owner's and the worker's; whichever side
+// lets go last frees it, so an installer that releases a running job (or
+// exits) never waits for it and never leaves the worker with freed memory.
+// The state is published with interlocked stores after the result is in
+// place, so a reader that sees DONE also sees the result.
+#include "clearjob.h"
+#include "thread.h"
+
+struct _CLEAR_JOB
+{
+    CLEAR_JOB_PARAMS params;
+    volatile LONG state;
+    volatile LONG refs;
+    EVENT done;
+    LSTATUS status;
+    TARGETS_PURGE purge;
+};
+
+static void ClearJob_Free(CLEAR_JOB* job)
+{
+    Targets_Free(&job->purge);
+    Matcher_Destroy(job->params.matcher);
+    if (job->done)
+        Event_Destroy(job->done);
+    Mem_Free(job);
+}
+
+static void ClearJob_Unref(CLEAR_JOB* job)
+{
+    if (Atomic_Add(&job->refs, -1) == 0)
+        ClearJob_Free(job);
+}
+
+static DWORD WINAPI ClearJob_Worker(void* arg)
+{
+    CLEAR_JOB* job = (CLEAR_JOB*)arg;
+    const CLEAR_JOB_PARAMS* params = &job->params;
+    LSTATUS status;
+
+    Atomic_Exchange(&job->state, CLEAR_JOB_RUNNING);
+    if (params->delay)
+        params->delay(params->delayContext);
+
+    status = Targets_Purge(params->opener, params->targets, params->count, params->matcher, params->flags,
+        params->workers, NULL, &job->purge);
+    job->status = status == ERROR_SUCCESS ? job->purge.firstError : status;
+
+    Atomic_Exchange(&job->state, CLEAR_JOB_DONE);
+    Event_Set(job->done);
+    ClearJob_Unref(job);
+    return 0;
+}
+
+extern "C" LSTATUS ClearJob_Start(const CLEAR_JOB_PARAMS* params, CLEAR_JOB** job)
+{
+    CLEAR_JOB* j;
+
+    *job = NULL;
+    j = (CLEAR_JOB*)Mem_Alloc(sizeof(CLEAR_JOB));
+    if (!j)
+    {
+        Matcher_Destroy(params->matcher);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    memset(j, 0, sizeof(CLEAR_JOB));
+    j->params = *params;
+    j->state = CLEAR_JOB_PENDING;
+    j->refs = 2;
+    j->done = Event_Create();
+    if (!j->done)
+    {
+        ClearJob_Free(j);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    if (!Thread_Spawn(ClearJob_Worker, j))
+    {
+        ClearJob_Free(j);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    *job = j;
+    return ERROR_SUCCESS;
+}
+
+extern "C" DWORD ClearJob_State(const CLEAR_JOB* job)
+{
+    return (DWORD)Atomic_Load(&job->state);
+}
+
+extern "C" LSTATUS ClearJob_Wait(CLEAR_JOB* job, DWORD milliseconds)
+{
+    if (ClearJob_State(job) == CLEAR_JOB_DONE)
+        return ERROR_SUCCESS;
+    return Event_Wait(job->done, milliseconds) ? ERROR_SUCCESS : WAIT_TIMEOUT;
+}
+
+extern "C" LSTATUS ClearJob_Result(const CLEAR_JOB* job, const TARGETS_PURGE** purge)
+{
+    *purge = &job->purge;
+    return job->status;
+}
+
+extern "C" void ClearJob_Release(CLEAR_JOB* job)
+{
+    if (job)
+        ClearJob_Unref(job);
+}
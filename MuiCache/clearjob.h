@@ -0,0 +1,59 @@
+// clearjob.h: a Targets_Purge run on a background thread, so the installer
+// thread can go on (copy files, pump its UI) and join later. A job goes
+// PENDING -> RUNNING -> DONE; its owner polls or waits on it, then reads the
+// result and releases it, and may do so before the purge finishes.
+#ifndef MUICACHE_CLEARJOB_H_
+#define MUICACHE_CLEARJOB_H_
+
+#include "platform.h"
+#include "targets.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define CLEAR_JOB_PENDING 0 // started, the worker hasn't picked it up yet
+#define CLEAR_JOB_RUNNING 1
+#define CLEAR_JOB_DONE    2
+
+typedef struct _CLEAR_JOB CLEAR_JOB;
+
+// Called on the worker thread once the job is RUNNING, before the purge.
+// Tests use it to hold a job in that state; NULL in the plugin.
+typedef void (*CLEAR_JOB_DELAY)(void* context);
+
+typedef struct _CLEAR_JOB_PARAMS {
+    KEY_OPENER* opener;
+    const PURGE_TARGET* targets; // must outlive the job
+    DWORD count;
+    MATCHER* matcher;            // owned by the job from ClearJob_Start on
+    DWORD flags;                 // Targets_Purge flags
+    DWORD workers;
+    CLEAR_JOB_DELAY delay;
+    void* delayContext;
+} CLEAR_JOB_PARAMS;
+
+// Starts the purge described by |params| on a thread of its own. The job
+// takes |params->matcher| even on failure.
+LSTATUS ClearJob_Start(const CLEAR_JOB_PARAMS* params, CLEAR_JOB** job);
+
+// CLEAR_JOB_PENDING, CLEAR_JOB_RUNNING or CLEAR_JOB_DONE.
+DWORD ClearJob_State(const CLEAR_JOB* job);
+
+// Waits up to |milliseconds| (or INFINITE) for the job to be DONE: returns
+// ERROR_SUCCESS then, WAIT_TIMEOUT otherwise.
+LSTATUS ClearJob_Wait(CLEAR_JOB* job, DWORD milliseconds);
+
+// The purge outcome of a DONE job: the Targets_Purge status, or the first
+// failed target's. |purge| stays valid until ClearJob_Release.
+LSTATUS ClearJob_Result(const CLEAR_JOB* job, const TARGETS_PURGE** purge);
+
+// Drops the owner's reference. A job still running finishes on its own
+// and is freed by its worker.
+void ClearJob_Release(CLEAR_JOB* job);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_CLEARJOB_H_
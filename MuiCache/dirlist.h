@@ -0,0 +1,36 @@
+// dirlist.h: directory listing behind a vtable, so directory walks (taskbar
+// shortcuts, user profiles) can run against a fake tree off Windows.
+#ifndef MUICACHE_DIRLIST_H_
+#define MUICACHE_DIRLIST_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Return FALSE to stop the listing.
+typedef BOOL (*DIR_LIST_CALLBACK)(void* context, const WCHAR* name, BOOL isDirectory);
+
+typedef struct _DIR_LISTER DIR_LISTER;
+
+typedef struct _DIR_LISTER_VTBL {
+    // Reports each visible entry of |dir| except "." and "..".
+    LSTATUS (*List)(DIR_LISTER* lister, const WCHAR* dir, DIR_LIST_CALLBACK callback, void* context);
+} DIR_LISTER_VTBL;
+
+struct _DIR_LISTER {
+    const DIR_LISTER_VTBL* vtbl;
+};
+
+#if defined(_WIN32)
+// FindFirstFile lister. Hidden and system entries are skipped, and so are
+// directory junctions, so recursive walks can't loop.
+DIR_LISTER* DirLister_Win32(void);
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_DIRLIST_H_
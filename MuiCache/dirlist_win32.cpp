@@ -0,0 +1,48 @@
+// DIR_LISTER over FindFirstFile.
+#include "dirlist.h"
+
+static LSTATUS Win32_List(DIR_LISTER* lister, const WCHAR* dir, DIR_LIST_CALLBACK callback, void* context)
+{
+    DWORD cchDir = Str_Length(dir);
+    WCHAR* query = (WCHAR*)Mem_Alloc((cchDir + 3) * sizeof(WCHAR));
+    WIN32_FIND_DATAW fd;
+    HANDLE hFind;
+
+    if (!query)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memcpy(query, dir, cchDir * sizeof(WCHAR));
+    if (cchDir && dir[cchDir - 1] != '\\' && dir[cchDir - 1] != '/')
+        query[cchDir++] = '\\';
+    query[cchDir++] = '*';
+    query[cchDir] = 0;
+
+    hFind = FindFirstFileW(query, &fd);
+    Mem_Free(query);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return GetLastError();
+    do
+    {
+        if (fd.dwFileAttributes & (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM))
+            continue;
+        if (fd.cFileName[0] == '.' && (!fd.cFileName[1] || (fd.cFileName[1] == '.' && !fd.cFileName[2])))
+            continue;
+        // Don't follow junctions, a recursive walk could loop forever.
+        if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+            continue;
+        if (!callback(context, fd.cFileName, (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0))
+            break;
+    } while (FindNextFileW(hFind, &fd));
+    FindClose(hFind);
+    return ERROR_SUCCESS;
+}
+
+static const DIR_LISTER_VTBL Win32_DirListerVtbl = {
+    Win32_List,
+};
+
+static DIR_LISTER Win32_DirLister = { &Win32_DirListerVtbl };
+
+extern "C" DIR_LISTER* DirLister_Win32(void)
+{
+    return &Win32_DirLister;
+}
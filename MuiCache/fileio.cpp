@@ -0,0 +1,404 @@
+#include "fileio.h"
+
+static volatile LONG g_fileTempCount;
+
+// |path| with ".<process>-<count>.tmp" appended: the temporary file
+// File_WriteAll writes before renaming it over |path|. In the same
+// directory so the rename never crosses volumes, and distinct per process
+// and per call so concurrent writers don't share one. Mem_Free'd by the
+// caller; NULL when out of memory.
+static WCHAR* File_TempPath(const WCHAR* path, DWORD process)
+{
+    static const char kHex[] = "0123456789abcdef";
+    static const WCHAR kExtension[] = { '.', 't', 'm', 'p', 0 };
+    DWORD cch = Str_Length(path), count = (DWORD)Atomic_Increment(&g_fileTempCount), i;
+    WCHAR* temp = (WCHAR*)Mem_Alloc((cch + 1 + 8 + 1 + 8 + 5) * sizeof(WCHAR));
+    WCHAR* p;
+
+    if (!temp)
+        return NULL;
+    memcpy(temp, path, cch * sizeof(WCHAR));
+    p = temp + cch;
+    *p++ = '.';
+    for (i = 0; i < 8; ++i)
+        *p++ = (WCHAR)kHex[(process >> (28 - 4 * i)) & 0xF];
+    *p++ = '-';
+    for (i = 0; i < 8; ++i)
+        *p++ = (WCHAR)kHex[(count >> (28 - 4 * i)) & 0xF];
+    memcpy(p, kExtension, sizeof(kExtension));
+    return temp;
+}
+
+#if defined(_WIN32)
+
+extern "C" LSTATUS File_ReadAll(const WCHAR* path, BYTE** data, DWORD* size)
+{
+    HANDLE hFile;
+    DWORD cbHigh = 0, cbFile, cbRead = 0;
+    BYTE* buffer;
+    LSTATUS status = ERROR_SUCCESS;
+
+    *data = NULL;
+    *size = 0;
+    hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return (LSTATUS)GetLastError();
+
+    cbFile = GetFileSize(hFile, &cbHigh);
+    if (cbHigh || cbFile == INVALID_FILE_SIZE)
+    {
+        CloseHandle(hFile);
+        return cbHigh ? ERROR_NOT_ENOUGH_MEMORY : (LSTATUS)GetLastError();
+    }
+
+    buffer = (BYTE*)Mem_Alloc(cbFile ? cbFile : 1);
+    if (!buffer)
+        status = ERROR_NOT_ENOUGH_MEMORY;
+    else if (!ReadFile(hFile, buffer, cbFile, &cbRead, NULL))
+        status = (LSTATUS)GetLastError();
+    else if (cbRead != cbFile)
+        status = ERROR_HANDLE_EOF;
+    CloseHandle(hFile);
+
+    if (status != ERROR_SUCCESS)
+    {
+        Mem_Free(buffer);
+        return status;
+    }
+    *data = buffer;
+    *size = cbFile;
+    return ERROR_SUCCESS;
+}
+
+// Attributes a rewritten file keeps from the one it replaces.
+#define FILE_KEPT_ATTRIBUTES (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE \
+    | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED)
+
+// The data goes to a temporary file next to |path| first, which then takes
+// its place in one rename: a crash or a full disk leaves either the old
+// file or the new one, never a truncated mix. ReplaceFileW carries the
+// old file's attributes, ACL and creation time over; where it can't (FAT,
+// some network shares), MoveFileExW does the rename and the temporary file
+// was already created with the hidden/system bits of the old one.
+extern "C" LSTATUS File_WriteAll(const WCHAR* path, const BYTE* data, DWORD size)
+{
+    HANDLE hFile;
+    DWORD cbWritten = 0, attributes;
+    WCHAR* temp;
+    LSTATUS status = ERROR_SUCCESS;
+
+    temp = File_TempPath(path, GetCurrentProcessId());
+    if (!temp)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    attributes = GetFileAttributesW(path);
+    hFile = CreateFileW(temp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_KEPT_ATTRIBUTES)
+            ? attributes & FILE_KEPT_ATTRIBUTES : FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        status = (LSTATUS)GetLastError();
+        Mem_Free(temp);
+        return status;
+    }
+    if (!WriteFile(hFile, data, size, &cbWritten, NULL) || !FlushFileBuffers(hFile))
+        status = (LSTATUS)GetLastError();
+    else if (cbWritten != size)
+        status = ERROR_HANDLE_EOF;
+    CloseHandle(hFile);
+
+    if (status == ERROR_SUCCESS
+        && !(attributes != INVALID_FILE_ATTRIBUTES
+            && ReplaceFileW(path, temp, NULL, REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL))
+        && !MoveFileExW(temp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        status = (LSTATUS)GetLastError();
+    if (status != ERROR_SUCCESS)
+        DeleteFileW(temp);
+    Mem_Free(temp);
+    return status;
+}
+
+extern "C" LSTATUS File_GetInfo(const WCHAR* path, DWORD* size, FILETIME* lastWrite)
+{
+    WIN32_FILE_ATTRIBUTE_DATA info;
+
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &info))
+        return (LSTATUS)GetLastError();
+    if (info.nFileSizeHigh)
+        return ERROR_INVALID_DATA;
+    *size = info.nFileSizeLow;
+    *lastWrite = info.ftLastWriteTime;
+    return ERROR_SUCCESS;
+}
+
+extern "C" LSTATUS File_Map(const WCHAR* path, FILE_MAP* map)
+{
+    HANDLE hFile, hMapping;
+    DWORD cbHigh = 0, cbFile;
+    void* view;
+    LSTATUS status;
+
+    memset(map, 0, sizeof(FILE_MAP));
+    // No sharing: nobody, the registry included, may have the hive open.
+    hFile = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return (LSTATUS)GetLastError();
+
+    cbFile = GetFileSize(hFile, &cbHigh);
+    if (cbHigh || !cbFile || cbFile == INVALID_FILE_SIZE)
+    {
+        status = cbFile == INVALID_FILE_SIZE && !cbHigh ? (LSTATUS)GetLastError() : ERROR_INVALID_DATA;
+        CloseHandle(hFile);
+        return status;
+    }
+
+    hMapping = CreateFileMappingW(hFile, NULL, PAGE_READWRITE, 0, 0, NULL);
+    if (!hMapping)
+    {
+        status = (LSTATUS)GetLastError();
+        CloseHandle(hFile);
+        return status;
+    }
+    view = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (!view)
+    {
+        status = (LSTATUS)GetLastError();
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return status;
+    }
+
+    map->data = (BYTE*)view;
+    map->size = cbFile;
+    map->file = hFile;
+    map->mapping = hMapping;
+    return ERROR_SUCCESS;
+}
+
+extern "C" LSTATUS File_Unmap(FILE_MAP* map, BOOL flush)
+{
+    LSTATUS status = ERROR_SUCCESS;
+    if (!map->data)
+        return ERROR_SUCCESS;
+    if (flush && (!FlushViewOfFile(map->data, 0) || !FlushFileBuffers((HANDLE)map->file)))
+        status = (LSTATUS)GetLastError();
+    UnmapViewOfFile(map->data);
+    CloseHandle((HANDLE)map->mapping);
+    CloseHandle((HANDLE)map->file);
+    memset(map, 0, sizeof(FILE_MAP));
+    return status;
+}
+
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// UTF-16 to UTF-8, surrogate pairs included. Returns NULL when out of memory.
+static char* File_Utf8Path(const WCHAR* path)
+{
+    DWORD cch = Str_Length(path);
+    char* out = (char*)Mem_Alloc(cch * 3 + 1);
+    char* p = out;
+    DWORD i, cp;
+    if (!out)
+        return NULL;
+    for (i = 0; i < cch; ++i)
+    {
+        cp = path[i];
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 1 < cch && path[i + 1] >= 0xDC00 && path[i + 1] < 0xE000)
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (path[++i] - 0xDC00);
+        if (cp < 0x80)
+            *p++ = (char)cp;
+        else if (cp < 0x800)
+        {
+            *p++ = (char)(0xC0 | (cp >> 6));
+            *p++ = (char)(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            *p++ = (char)(0xE0 | (cp >> 12));
+            *p++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+            *p++ = (char)(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            *p++ = (char)(0xF0 | (cp >> 18));
+            *p++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+            *p++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+            *p++ = (char)(0x80 | (cp & 0x3F));
+        }
+    }
+    *p = 0;
+    return out;
+}
+
+static LSTATUS File_Errno()
+{
+    return errno == ENOENT ? ERROR_FILE_NOT_FOUND : errno == EACCES ? ERROR_ACCESS_DENIED : ERROR_INVALID_DATA;
+}
+
+extern "C" LSTATUS File_ReadAll(const WCHAR* path, BYTE** data, DWORD* size)
+{
+    char* name = File_Utf8Path(path);
+    FILE* f;
+    long cb;
+    BYTE* buffer;
+
+    *data = NULL;
+    *size = 0;
+    if (!name)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    f = fopen(name, "rb");
+    Mem_Free(name);
+    if (!f)
+        return File_Errno();
+    if (fseek(f, 0, SEEK_END) != 0 || (cb = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0)
+    {
+        fclose(f);
+        return ERROR_INVALID_DATA;
+    }
+    buffer = (BYTE*)Mem_Alloc(cb ? (SIZE_T)cb : 1);
+    if (!buffer)
+    {
+        fclose(f);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    if (fread(buffer, 1, (size_t)cb, f) != (size_t)cb)
+    {
+        fclose(f);
+        Mem_Free(buffer);
+        return ERROR_HANDLE_EOF;
+    }
+    fclose(f);
+    *data = buffer;
+    *size = (DWORD)cb;
+    return ERROR_SUCCESS;
+}
+
+// As on Windows: a temporary file next to |path|, synced, then renamed over
+// it. The new file keeps the old one's permission bits.
+extern "C" LSTATUS File_WriteAll(const WCHAR* path, const BYTE* data, DWORD size)
+{
+    WCHAR* tempPath = File_TempPath(path, (DWORD)getpid());
+    char* name = File_Utf8Path(path);
+    char* temp = tempPath ? File_Utf8Path(tempPath) : NULL;
+    struct stat st;
+    size_t done = 0;
+    ssize_t cb;
+    LSTATUS status = ERROR_SUCCESS;
+    int fd, existing;
+
+    Mem_Free(tempPath);
+    if (!name || !temp)
+    {
+        Mem_Free(name);
+        Mem_Free(temp);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    existing = stat(name, &st) == 0;
+    fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, existing ? (st.st_mode & 07777) : 0666);
+    if (fd < 0)
+    {
+        status = File_Errno();
+        Mem_Free(name);
+        Mem_Free(temp);
+        return status;
+    }
+    while (done < size)
+    {
+        cb = write(fd, data + done, size - done);
+        if (cb <= 0)
+        {
+            status = ERROR_HANDLE_EOF;
+            break;
+        }
+        done += (size_t)cb;
+    }
+    // open applied the umask; the old file's bits win.
+    if (status == ERROR_SUCCESS && existing && fchmod(fd, st.st_mode & 07777) != 0)
+        status = File_Errno();
+    if (status == ERROR_SUCCESS && fsync(fd) != 0)
+        status = ERROR_HANDLE_EOF;
+    if (close(fd) != 0 && status == ERROR_SUCCESS)
+        status = ERROR_HANDLE_EOF;
+    if (status == ERROR_SUCCESS && rename(temp, name) != 0)
+        status = File_Errno();
+    if (status != ERROR_SUCCESS)
+        unlink(temp);
+    Mem_Free(name);
+    Mem_Free(temp);
+    return status;
+}
+
+extern "C" LSTATUS File_GetInfo(const WCHAR* path, DWORD* size, FILETIME* lastWrite)
+{
+    char* name = File_Utf8Path(path);
+    struct stat st;
+    ULONGLONG ticks;
+    int failed;
+
+    if (!name)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    failed = stat(name, &st);
+    Mem_Free(name);
+    if (failed)
+        return File_Errno();
+    if (st.st_size < 0 || (unsigned long long)st.st_size > 0xFFFFFFFFull)
+        return ERROR_INVALID_DATA;
+    // FILETIME counts 100ns ticks from 1601, 11644473600 s before 1970.
+    ticks = ((ULONGLONG)st.st_mtim.tv_sec + 11644473600ull) * 10000000u + (ULONGLONG)st.st_mtim.tv_nsec / 100;
+    *size = (DWORD)st.st_size;
+    lastWrite->dwLowDateTime = (DWORD)ticks;
+    lastWrite->dwHighDateTime = (DWORD)(ticks >> 32);
+    return ERROR_SUCCESS;
+}
+
+extern "C" LSTATUS File_Map(const WCHAR* path, FILE_MAP* map)
+{
+    char* name = File_Utf8Path(path);
+    struct stat st;
+    void* view;
+    int fd;
+
+    memset(map, 0, sizeof(FILE_MAP));
+    if (!name)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    fd = open(name, O_RDWR);
+    Mem_Free(name);
+    if (fd < 0)
+        return File_Errno();
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (unsigned long long)st.st_size > 0xFFFFFFFFull)
+    {
+        close(fd);
+        return ERROR_INVALID_DATA;
+    }
+    view = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        LSTATUS status = File_Errno();
+        close(fd);
+        return status;
+    }
+    map->data = (BYTE*)view;
+    map->size = (DWORD)st.st_size;
+    map->file = (void*)(intptr_t)fd;
+    return ERROR_SUCCESS;
+}
+
+extern "C" LSTATUS File_Unmap(FILE_MAP* map, BOOL flush)
+{
+    LSTATUS status = ERROR_SUCCESS;
+    if (!map->data)
+        return ERROR_SUCCESS;
+    if (flush && msync(map->data, map->size, MS_SYNC) != 0)
+        status = File_Errno();
+    munmap(map->data, map->size);
+    close((int)(intptr_t)map->file);
+    memset(map, 0, sizeof(FILE_MAP));
+    return status;
+}
+
+#endif
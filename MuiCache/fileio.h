@@ -0,0 +1,41 @@
+// fileio.h: whole-file read/write for the portable cores (.lnk, hives, ...).
+// Paths are UTF-16 everywhere; off Windows they are converted to UTF-8.
+#ifndef MUICACHE_FILEIO_H_
+#define MUICACHE_FILEIO_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Reads all of |path| into a Mem_Alloc'ed buffer the caller Mem_Free's.
+LSTATUS File_ReadAll(const WCHAR* path, BYTE** data, DWORD* size);
+// Replaces |path| with |size| bytes of |data|, or creates it. Atomic: the
+// bytes go to a temporary file in the same directory that is then renamed
+// over |path|, so readers and a crash see the old contents or the new ones.
+// A replaced file keeps its attributes (hidden, system) or permission bits.
+LSTATUS File_WriteAll(const WCHAR* path, const BYTE* data, DWORD size);
+
+// Size and last-write time of |path|, without opening it. Files of 4GB or
+// more fail with ERROR_INVALID_DATA.
+LSTATUS File_GetInfo(const WCHAR* path, DWORD* size, FILETIME* lastWrite);
+
+// A file mapped read-write and opened without sharing, for in-place edits.
+typedef struct _FILE_MAP {
+    BYTE* data;
+    DWORD size;
+    void* file;    // HANDLE, or the descriptor off Windows
+    void* mapping; // file mapping HANDLE, unused off Windows
+} FILE_MAP;
+
+// Maps all of |path|. Fails on empty files and files of 4GB or more.
+LSTATUS File_Map(const WCHAR* path, FILE_MAP* map);
+// Writes dirty pages back to disk when |flush| is set, then unmaps.
+LSTATUS File_Unmap(FILE_MAP* map, BOOL flush);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_FILEIO_H_
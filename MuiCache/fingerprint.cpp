@@ -0,0 +1,165 @@
+// Fingerprint store, read and written whole: it holds a handful of entries.
+// The entries are kept in a fixed-size array so Set never reallocates.
+#include "fingerprint.h"
+#include "fileio.h"
+
+static const BYTE kFingerprintMagic[4] = { 'M', 'C', 'F', 'P' };
+
+static __inline DWORD Fp_Rd32(const BYTE* p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static __inline void Fp_Wr32(BYTE* p, DWORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+static DWORD Fp_Checksum(const BYTE* data, DWORD size)
+{
+    DWORD hash = 2166136261u, i;
+    for (i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+extern "C" void FingerprintStore_Init(FINGERPRINT_STORE* store)
+{
+    memset(store, 0, sizeof(FINGERPRINT_STORE));
+}
+
+extern "C" void FingerprintStore_Free(FINGERPRINT_STORE* store)
+{
+    Mem_Free(store->entries);
+    FingerprintStore_Init(store);
+}
+
+static BOOL FingerprintStore_Reserve(FINGERPRINT_STORE* store)
+{
+    if (!store->entries)
+        store->entries = (FINGERPRINT*)Mem_Alloc(FINGERPRINT_MAX_ENTRIES * sizeof(FINGERPRINT));
+    return store->entries != NULL;
+}
+
+static LSTATUS FingerprintStore_Parse(FINGERPRINT_STORE* store, const BYTE* data, DWORD size)
+{
+    DWORD count, i;
+    const BYTE* p;
+
+    if (size < FINGERPRINT_HEADER_SIZE || Fp_Rd32(data) != Fp_Rd32(kFingerprintMagic)
+        || Fp_Rd32(data + 4) != FINGERPRINT_VERSION)
+        return ERROR_INVALID_DATA;
+    count = Fp_Rd32(data + 8);
+    if (count > FINGERPRINT_MAX_ENTRIES || size != FINGERPRINT_HEADER_SIZE + count * FINGERPRINT_ENTRY_SIZE
+        || Fp_Rd32(data + 12) != Fp_Checksum(data + FINGERPRINT_HEADER_SIZE, count * FINGERPRINT_ENTRY_SIZE))
+        return ERROR_INVALID_DATA;
+    if (!FingerprintStore_Reserve(store))
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    for (i = 0, p = data + FINGERPRINT_HEADER_SIZE; i < count; ++i, p += FINGERPRINT_ENTRY_SIZE)
+    {
+        store->entries[i].target = Fp_Rd32(p);
+        store->entries[i].patterns = Fp_Rd32(p + 4);
+        store->entries[i].lastWrite.dwLowDateTime = Fp_Rd32(p + 8);
+        store->entries[i].lastWrite.dwHighDateTime = Fp_Rd32(p + 12);
+        store->entries[i].values = Fp_Rd32(p + 16);
+    }
+    store->count = count;
+    return ERROR_SUCCESS;
+}
+
+extern "C" LSTATUS FingerprintStore_Load(FINGERPRINT_STORE* store, const WCHAR* path)
+{
+    BYTE* data;
+    DWORD size;
+    LSTATUS status;
+
+    FingerprintStore_Free(store);
+    status = File_ReadAll(path, &data, &size);
+    if (status == ERROR_FILE_NOT_FOUND || status == ERROR_PATH_NOT_FOUND)
+        return ERROR_SUCCESS;
+    if (status != ERROR_SUCCESS)
+        return status;
+    status = FingerprintStore_Parse(store, data, size);
+    Mem_Free(data);
+    if (status != ERROR_SUCCESS)
+        store->count = 0;
+    return status;
+}
+
+extern "C" LSTATUS FingerprintStore_Save(const FINGERPRINT_STORE* store, const WCHAR* path)
+{
+    BYTE buffer[FINGERPRINT_HEADER_SIZE + FINGERPRINT_MAX_ENTRIES * FINGERPRINT_ENTRY_SIZE];
+    BYTE* p = buffer + FINGERPRINT_HEADER_SIZE;
+    DWORD i;
+
+    memcpy(buffer, kFingerprintMagic, 4);
+    Fp_Wr32(buffer + 4, FINGERPRINT_VERSION);
+    Fp_Wr32(buffer + 8, store->count);
+    for (i = 0; i < store->count; ++i, p += FINGERPRINT_ENTRY_SIZE)
+    {
+        Fp_Wr32(p, store->entries[i].target);
+        Fp_Wr32(p + 4, store->entries[i].patterns);
+        Fp_Wr32(p + 8, store->entries[i].lastWrite.dwLowDateTime);
+        Fp_Wr32(p + 12, store->entries[i].lastWrite.dwHighDateTime);
+        Fp_Wr32(p + 16, store->entries[i].values);
+        Fp_Wr32(p + 20, 0);
+    }
+    Fp_Wr32(buffer + 12, Fp_Checksum(buffer + FINGERPRINT_HEADER_SIZE, store->count * FINGERPRINT_ENTRY_SIZE));
+    return File_WriteAll(path, buffer, (DWORD)(p - buffer));
+}
+
+static DWORD FingerprintStore_IndexOf(const FINGERPRINT_STORE* store, DWORD target, DWORD patterns)
+{
+    DWORD i;
+    for (i = 0; i < store->count; ++i)
+    {
+        if (store->entries[i].target == target && store->entries[i].patterns == patterns)
+            return i;
+    }
+    return store->count;
+}
+
+extern "C" const FINGERPRINT* FingerprintStore_Find(const FINGERPRINT_STORE* store, DWORD target, DWORD patterns)
+{
+    DWORD i = FingerprintStore_IndexOf(store, target, patterns);
+    return i < store->count ? &store->entries[i] : NULL;
+}
+
+extern "C" void FingerprintStore_Remove(FINGERPRINT_STORE* store, DWORD target, DWORD patterns)
+{
+    DWORD i = FingerprintStore_IndexOf(store, target, patterns);
+    if (i == store->count)
+        return;
+    memmove(&store->entries[i], &store->entries[i + 1], (store->count - i - 1) * sizeof(FINGERPRINT));
+    --store->count;
+    store->dirty = TRUE;
+}
+
+extern "C" BOOL FingerprintStore_Set(FINGERPRINT_STORE* store, const FINGERPRINT* fingerprint)
+{
+    // |fingerprint| may point into the store.
+    FINGERPRINT entry = *fingerprint;
+    const FINGERPRINT* old = FingerprintStore_Find(store, entry.target, entry.patterns);
+
+    // Unchanged: leave the file alone.
+    if (old && old->lastWrite.dwLowDateTime == entry.lastWrite.dwLowDateTime
+        && old->lastWrite.dwHighDateTime == entry.lastWrite.dwHighDateTime && old->values == entry.values)
+        return TRUE;
+
+    // Otherwise it goes to the newest end, dropping the oldest when full.
+    FingerprintStore_Remove(store, entry.target, entry.patterns);
+    if (!FingerprintStore_Reserve(store))
+        return FALSE;
+    if (store->count == FINGERPRINT_MAX_ENTRIES)
+    {
+        memmove(&store->entries[0], &store->entries[1], (store->count - 1) * sizeof(FINGERPRINT));
+        --store->count;
+    }
+    store->entries[store->count++] = entry;
+    store->dirty = TRUE;
+    return TRUE;
+}
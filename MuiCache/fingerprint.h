@@ -0,0 +1,57 @@
+// fingerprint.h: what a purged key looked like right after the last purge
+// (last-write time and value count) for a given target and pattern set, so
+// an unchanged key can be skipped without enumerating it. Fingerprints are
+// kept in a small versioned binary file between installer runs.
+#ifndef MUICACHE_FINGERPRINT_H_
+#define MUICACHE_FINGERPRINT_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// File layout, little-endian:
+//   "MCFP", version, entry count, FNV-1a of the entry bytes,
+//   then per entry: target, patterns, last write (low, high), values, 0.
+#define FINGERPRINT_VERSION 1
+#define FINGERPRINT_HEADER_SIZE 16
+#define FINGERPRINT_ENTRY_SIZE 24
+// Older entries are dropped beyond this many.
+#define FINGERPRINT_MAX_ENTRIES 64
+
+typedef struct _FINGERPRINT {
+    DWORD target;   // identifies the key, see Targets_Purge
+    DWORD patterns; // Matcher_Hash
+    FILETIME lastWrite;
+    DWORD values;
+} FINGERPRINT;
+
+typedef struct _FINGERPRINT_STORE {
+    FINGERPRINT* entries; // oldest first
+    DWORD count;
+    BOOL dirty;           // changed since loaded
+} FINGERPRINT_STORE;
+
+void FingerprintStore_Init(FINGERPRINT_STORE* store);
+void FingerprintStore_Free(FINGERPRINT_STORE* store);
+
+// Replaces |store| with the fingerprints in |path|. A missing file leaves
+// it empty and succeeds; an unknown version or a damaged file leaves it
+// empty and returns ERROR_INVALID_DATA, which callers may ignore: the next
+// save overwrites the file.
+LSTATUS FingerprintStore_Load(FINGERPRINT_STORE* store, const WCHAR* path);
+LSTATUS FingerprintStore_Save(const FINGERPRINT_STORE* store, const WCHAR* path);
+
+// The entry for (|target|, |patterns|), or NULL.
+const FINGERPRINT* FingerprintStore_Find(const FINGERPRINT_STORE* store, DWORD target, DWORD patterns);
+// Adds or replaces the entry for |fingerprint|'s target and patterns.
+BOOL FingerprintStore_Set(FINGERPRINT_STORE* store, const FINGERPRINT* fingerprint);
+// Drops the entry for (|target|, |patterns|), if any.
+void FingerprintStore_Remove(FINGERPRINT_STORE* store, DWORD target, DWORD patterns);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_FINGERPRINT_H_
@@ -0,0 +1,65 @@
+#include "fwrule.h"
+#include "simdscan.h"
+
+extern "C" void FwRule_Init(FW_RULE_TOKENIZER* tok, const WCHAR* rule, DWORD cch)
+{
+    tok->chars = rule;
+    tok->cch = SimdScan_FindChar(rule, cch, 0);
+    tok->pos = 0;
+}
+
+extern "C" BOOL FwRule_Next(FW_RULE_TOKENIZER* tok, FW_RULE_FIELD* field)
+{
+    DWORD start, end, eq;
+    while (tok->pos < tok->cch)
+    {
+        start = tok->pos;
+        end = start + SimdScan_FindChar(tok->chars + start, tok->cch - start, '|');
+        tok->pos = end + 1;
+        if (end == start)
+            continue;
+
+        // Keys are short, a plain loop finds the '='.
+        for (eq = start; eq < end && tok->chars[eq] != '='; ++eq)
+            ;
+        field->key = tok->chars + start;
+        field->cchKey = eq - start;
+        field->value = tok->chars + (eq < end ? eq + 1 : end);
+        field->cchValue = eq < end ? end - eq - 1 : 0;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+extern "C" BOOL FwRule_FindField(const WCHAR* rule, DWORD cch, const WCHAR* key, const WCHAR** value, DWORD* cchValue)
+{
+    FW_RULE_TOKENIZER tok;
+    FW_RULE_FIELD field;
+    DWORD cchKey = Str_Length(key);
+    DWORD i;
+
+    FwRule_Init(&tok, rule, cch);
+    while (FwRule_Next(&tok, &field))
+    {
+        if (field.cchKey != cchKey)
+            continue;
+        for (i = 0; i < cchKey && SimdScan_FoldChar(field.key[i]) == SimdScan_FoldChar(key[i]); ++i)
+            ;
+        if (i == cchKey)
+        {
+            *value = field.value;
+            *cchValue = field.cchValue;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+extern "C" void FwRule_Unquote(const WCHAR** value, DWORD* cchValue)
+{
+    if (*cchValue >= 2 && (*value)[0] == '"' && (*value)[*cchValue - 1] == '"')
+    {
+        ++*value;
+        *cchValue -= 2;
+    }
+}
@@ -0,0 +1,47 @@
+// fwrule.h: tokenizer for Windows Firewall rule strings as stored under
+// SharedAccess\Parameters\FirewallPolicy\FirewallRules, e.g.
+// "v2.30|Action=Allow|Active=TRUE|Dir=In|App=C:\x\app.exe|Name=App|".
+// Fields are split on '|' with the vectorized scan of simdscan.h and then
+// on their first '='; nothing is copied.
+#ifndef MUICACHE_FWRULE_H_
+#define MUICACHE_FWRULE_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _FW_RULE_FIELD {
+    const WCHAR* key;
+    DWORD cchKey;
+    const WCHAR* value; // empty for a field without '=', like the version
+    DWORD cchValue;
+} FW_RULE_FIELD;
+
+typedef struct _FW_RULE_TOKENIZER {
+    const WCHAR* chars;
+    DWORD cch;
+    DWORD pos;
+} FW_RULE_TOKENIZER;
+
+// Starts tokenizing the first |cch| chars of |rule|; a NUL ends the rule
+// early, so registry data can be passed with its terminator.
+void FwRule_Init(FW_RULE_TOKENIZER* tok, const WCHAR* rule, DWORD cch);
+
+// Yields the next non-empty field.
+BOOL FwRule_Next(FW_RULE_TOKENIZER* tok, FW_RULE_FIELD* field);
+
+// Finds the first field named |key| (ASCII case-insensitive) and returns
+// its value. Returns FALSE when the rule has no such field.
+BOOL FwRule_FindField(const WCHAR* rule, DWORD cch, const WCHAR* key, const WCHAR** value, DWORD* cchValue);
+
+// Drops one pair of double quotes around |value|, as rules added with a
+// quoted program path (netsh, some installers) store App=.
+void FwRule_Unquote(const WCHAR** value, DWORD* cchValue);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_FWRULE_H_
@@ -0,0 +1,116 @@
+#include "glob.h"
+
+static __inline WCHAR Glob_Fold(WCHAR ch, DWORD flags)
+{
+    if ((flags & GLOB_IGNORE_CASE) && ch >= 'A' && ch <= 'Z')
+        return (WCHAR)(ch + ('a' - 'A'));
+    return ch;
+}
+
+// |*pp| points just past '['. Returns 1/0 for match/no match and moves |*pp|
+// past the closing ']', or -1 (leaving |*pp| alone) if the class never closes.
+static int Glob_MatchClass(const WCHAR** pp, WCHAR ch, DWORD flags)
+{
+    const WCHAR* p = *pp;
+    BOOL negate = FALSE, found = FALSE;
+
+    if (*p == '!' || *p == '^')
+    {
+        negate = TRUE;
+        ++p;
+    }
+    ch = Glob_Fold(ch, flags);
+    // A ']' right after the opening bracket is a member, not the end.
+    do
+    {
+        WCHAR lo, hi;
+        if (!*p)
+            return -1;
+        lo = hi = Glob_Fold(*p++, flags);
+        if (p[0] == '-' && p[1] && p[1] != ']')
+        {
+            hi = Glob_Fold(p[1], flags);
+            p += 2;
+        }
+        if (lo <= ch && ch <= hi)
+            found = TRUE;
+    } while (*p != ']');
+
+    *pp = p + 1;
+    return found != negate;
+}
+
+extern "C" BOOL Glob_Match(const WCHAR* pattern, const WCHAR* name, DWORD flags)
+{
+    const WCHAR* p = pattern;
+    const WCHAR* n = name;
+    const WCHAR* starP = NULL; // pattern just past the last '*'
+    const WCHAR* starN = NULL; // where that '*' started consuming
+
+    while (*n)
+    {
+        BOOL step = FALSE;
+        if (*p == '*')
+        {
+            while (*p == '*')
+                ++p;
+            starP = p;
+            starN = n;
+            continue;
+        }
+        if (*p == '?')
+        {
+            ++p;
+            step = TRUE;
+        }
+        else if (*p == '[')
+        {
+            const WCHAR* q = p + 1;
+            int r = Glob_MatchClass(&q, *n, flags);
+            if (r >= 0)
+            {
+                if (r)
+                    p = q;
+                step = r != 0;
+            }
+            else if (*n == '[')
+            {
+                ++p;
+                step = TRUE;
+            }
+        }
+        else if (*p && Glob_Fold(*p, flags) == Glob_Fold(*n, flags))
+        {
+            ++p;
+            step = TRUE;
+        }
+
+        if (step)
+        {
+            ++n;
+        }
+        else
+        {
+            // Let the last '*' swallow one more character and retry. Earlier
+            // stars never need revisiting: the last one can absorb anything
+            // they would have.
+            if (!starP)
+                return FALSE;
+            p = starP;
+            n = ++starN;
+        }
+    }
+    while (*p == '*')
+        ++p;
+    return *p == 0;
+}
+
+extern "C" BOOL Glob_HasWildcards(const WCHAR* pattern)
+{
+    for (; *pattern; ++pattern)
+    {
+        if (*pattern == '*' || *pattern == '?' || *pattern == '[')
+            return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,27 @@
+// glob.h: shell-style wildcard matching on UTF-16 names.
+// '*' any run, '?' any one character, "[abc]", "[a-z]" and "[!x]" classes.
+// There is no escape character, since '\\' is a path separator on Windows;
+// an unterminated '[' matches itself.
+#ifndef MUICACHE_GLOB_H_
+#define MUICACHE_GLOB_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define GLOB_IGNORE_CASE 0x1 // ASCII case folding, as file names compare on NTFS
+
+// Whole-string match of |name| against |pattern|. Runs in O(|pattern| * |name|)
+// worst case, without recursion.
+BOOL Glob_Match(const WCHAR* pattern, const WCHAR* name, DWORD flags);
+
+// TRUE if |pattern| contains any of "*?[".
+BOOL Glob_HasWildcards(const WCHAR* pattern);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_GLOB_H_
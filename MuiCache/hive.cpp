@@ -0,0 +1,438 @@
+#include "hive.h"
+
+#define HIVE_REGF_SIGNATURE 0x66676572 // "regf"
+
+// Base block fields.
+#define HIVE_PRIMARY_SEQUENCE   0x04
+#define HIVE_SECONDARY_SEQUENCE 0x08
+#define HIVE_MAJOR_VERSION      0x14
+#define HIVE_MINOR_VERSION      0x18
+#define HIVE_ROOT_CELL          0x24
+#define HIVE_BINS_SIZE          0x28
+#define HIVE_CHECKSUM           0x1FC
+
+// Cell signatures, as little-endian WORDs.
+#define HIVE_NK 0x6B6E
+#define HIVE_VK 0x6B76
+#define HIVE_LF 0x666C
+#define HIVE_LH 0x686C
+#define HIVE_LI 0x696C
+#define HIVE_RI 0x6972
+#define HIVE_DB 0x6264
+
+// nk cell fields.
+#define NK_FLAGS         0x02
+#define NK_LAST_WRITTEN  0x04
+#define NK_SUBKEY_COUNT  0x14
+#define NK_SUBKEY_LIST   0x1C
+#define NK_VALUE_COUNT   0x24
+#define NK_VALUE_LIST    0x28
+#define NK_NAME_LENGTH   0x48
+#define NK_NAME          0x4C
+#define NK_COMPRESSED_NAME 0x0020
+
+// vk cell fields.
+#define VK_NAME_LENGTH   0x02
+#define VK_DATA_SIZE     0x04
+#define VK_DATA_OFFSET   0x08
+#define VK_TYPE          0x0C
+#define VK_FLAGS         0x10
+#define VK_NAME          0x14
+#define VK_COMPRESSED_NAME 0x0001
+#define VK_DATA_INLINE   0x80000000
+
+// Data larger than this lives in db segments (hive format 1.4 and later).
+#define HIVE_BIG_DATA_SEGMENT 16344
+
+static __inline DWORD Hive_Rd16(const BYTE* p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8);
+}
+
+static __inline DWORD Hive_Rd32(const BYTE* p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static __inline void Hive_Wr32(BYTE* p, DWORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+static __inline WCHAR Hive_Fold(WCHAR ch)
+{
+    return (ch >= 'a' && ch <= 'z') ? (WCHAR)(ch - ('a' - 'A')) : ch;
+}
+
+// Returns the payload of the allocated cell at |offset| and its size, or
+// NULL if the offset or the cell header doesn't hold up.
+static BYTE* Hive_Cell(const HIVE* hive, DWORD offset, DWORD* cbCell)
+{
+    BYTE* cell;
+    LONG size;
+    if (offset == HIVE_NIL || (offset & 7) || hive->binsSize < 8 || offset > hive->binsSize - 8)
+        return NULL;
+    cell = hive->data + HIVE_BASE_BLOCK_SIZE + offset;
+    size = (LONG)Hive_Rd32(cell);
+    // Allocated cells have a negative size.
+    if (size >= 0 || (DWORD)0 - (DWORD)size < 8 || (DWORD)0 - (DWORD)size > hive->binsSize - offset)
+        return NULL;
+    *cbCell = ((DWORD)0 - (DWORD)size) - 4;
+    return cell + 4;
+}
+
+static void Hive_FreeCell(HIVE* hive, DWORD offset)
+{
+    DWORD cb;
+    BYTE* cell = Hive_Cell(hive, offset, &cb);
+    if (cell)
+        Hive_Wr32(cell - 4, cb + 4);
+}
+
+static BYTE* Hive_KeyCell(const HIVE* hive, DWORD offset, DWORD* cb)
+{
+    BYTE* nk = Hive_Cell(hive, offset, cb);
+    if (!nk || *cb < NK_NAME || Hive_Rd16(nk) != HIVE_NK || NK_NAME + Hive_Rd16(nk + NK_NAME_LENGTH) > *cb)
+        return NULL;
+    return nk;
+}
+
+// Marks the hive dirty before the first change.
+static void Hive_Touch(HIVE* hive)
+{
+    if (hive->modified)
+        return;
+    hive->modified = TRUE;
+    Hive_Wr32(hive->data + HIVE_PRIMARY_SEQUENCE, Hive_Rd32(hive->data + HIVE_PRIMARY_SEQUENCE) + 1);
+    Hive_Wr32(hive->data + HIVE_CHECKSUM, Hive_Checksum(hive->data));
+}
+
+extern "C" DWORD Hive_Checksum(const BYTE* baseBlock)
+{
+    DWORD sum = 0, i;
+    for (i = 0; i < HIVE_CHECKSUM; i += 4)
+        sum ^= Hive_Rd32(baseBlock + i);
+    // 0 and -1 are reserved.
+    if (sum == 0xFFFFFFFF)
+        return 0xFFFFFFFE;
+    if (sum == 0)
+        return 1;
+    return sum;
+}
+
+extern "C" LSTATUS Hive_Open(BYTE* data, DWORD size, HIVE* hive)
+{
+    DWORD cb;
+    memset(hive, 0, sizeof(HIVE));
+    if (size < HIVE_BASE_BLOCK_SIZE || Hive_Rd32(data) != HIVE_REGF_SIGNATURE || Hive_Rd32(data + HIVE_MAJOR_VERSION) != 1)
+        return ERROR_INVALID_DATA;
+    if (Hive_Checksum(data) != Hive_Rd32(data + HIVE_CHECKSUM))
+        return ERROR_INVALID_DATA;
+    if (Hive_Rd32(data + HIVE_PRIMARY_SEQUENCE) != Hive_Rd32(data + HIVE_SECONDARY_SEQUENCE))
+        return ERROR_INVALID_DATA;
+
+    hive->data = data;
+    hive->size = size;
+    hive->binsSize = Hive_Rd32(data + HIVE_BINS_SIZE);
+    hive->rootCell = Hive_Rd32(data + HIVE_ROOT_CELL);
+    hive->minorVersion = Hive_Rd32(data + HIVE_MINOR_VERSION);
+    if (hive->binsSize > size - HIVE_BASE_BLOCK_SIZE || !Hive_KeyCell(hive, hive->rootCell, &cb))
+    {
+        memset(hive, 0, sizeof(HIVE));
+        return ERROR_INVALID_DATA;
+    }
+    return ERROR_SUCCESS;
+}
+
+static BOOL Hive_KeyNameEquals(const HIVE* hive, DWORD offset, const WCHAR* name, DWORD cch)
+{
+    DWORD cb, cbName, i;
+    const BYTE* nk = Hive_KeyCell(hive, offset, &cb);
+    if (!nk)
+        return FALSE;
+    cbName = Hive_Rd16(nk + NK_NAME_LENGTH);
+    if (Hive_Rd16(nk + NK_FLAGS) & NK_COMPRESSED_NAME)
+    {
+        if (cbName != cch)
+            return FALSE;
+        for (i = 0; i < cch; ++i)
+        {
+            if (Hive_Fold(nk[NK_NAME + i]) != Hive_Fold(name[i]))
+                return FALSE;
+        }
+    }
+    else
+    {
+        if (cbName != cch * 2)
+            return FALSE;
+        for (i = 0; i < cch; ++i)
+        {
+            if (Hive_Fold((WCHAR)Hive_Rd16(nk + NK_NAME + i * 2)) != Hive_Fold(name[i]))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Searches one subkey list; an ri list only ever points at leaf lists.
+static DWORD Hive_FindSubkey(const HIVE* hive, DWORD listCell, const WCHAR* name, DWORD cch, BOOL indexRoot)
+{
+    DWORD cb, count, stride, sig, i;
+    const BYTE* list = Hive_Cell(hive, listCell, &cb);
+    if (!list || cb < 4)
+        return HIVE_NIL;
+    sig = Hive_Rd16(list);
+    count = Hive_Rd16(list + 2);
+    if (sig == HIVE_LF || sig == HIVE_LH)
+        stride = 8; // offset + name hint or hash
+    else if (sig == HIVE_LI || (sig == HIVE_RI && !indexRoot))
+        stride = 4;
+    else
+        return HIVE_NIL;
+    if (4 + count * stride > cb)
+        return HIVE_NIL;
+
+    for (i = 0; i < count; ++i)
+    {
+        DWORD offset = Hive_Rd32(list + 4 + i * stride);
+        if (sig == HIVE_RI)
+        {
+            offset = Hive_FindSubkey(hive, offset, name, cch, TRUE);
+            if (offset != HIVE_NIL)
+                return offset;
+        }
+        else if (Hive_KeyNameEquals(hive, offset, name, cch))
+        {
+            return offset;
+        }
+    }
+    return HIVE_NIL;
+}
+
+extern "C" LSTATUS Hive_FindKey(const HIVE* hive, DWORD keyCell, const WCHAR* path, DWORD* cell)
+{
+    DWORD cb;
+    const BYTE* nk;
+
+    *cell = HIVE_NIL;
+    while (*path)
+    {
+        const WCHAR* end = path;
+        while (*end && *end != '\\')
+            ++end;
+        if (end != path)
+        {
+            nk = Hive_KeyCell(hive, keyCell, &cb);
+            if (!nk)
+                return ERROR_INVALID_DATA;
+            if (!Hive_Rd32(nk + NK_SUBKEY_COUNT))
+                return ERROR_FILE_NOT_FOUND;
+            keyCell = Hive_FindSubkey(hive, Hive_Rd32(nk + NK_SUBKEY_LIST), path, (DWORD)(end - path), FALSE);
+            if (keyCell == HIVE_NIL)
+                return ERROR_FILE_NOT_FOUND;
+        }
+        path = *end ? end + 1 : end;
+    }
+    if (!Hive_KeyCell(hive, keyCell, &cb))
+        return ERROR_INVALID_DATA;
+    *cell = keyCell;
+    return ERROR_SUCCESS;
+}
+
+extern "C" LSTATUS Hive_KeyLastWriteTime(const HIVE* hive, DWORD keyCell, FILETIME* time)
+{
+    DWORD cb;
+    const BYTE* nk = Hive_KeyCell(hive, keyCell, &cb);
+    if (!nk)
+        return ERROR_INVALID_DATA;
+    time->dwLowDateTime = Hive_Rd32(nk + NK_LAST_WRITTEN);
+    time->dwHighDateTime = Hive_Rd32(nk + NK_LAST_WRITTEN + 4);
+    return ERROR_SUCCESS;
+}
+
+// Returns the value list of |keyCell| and its length, or NULL when the key
+// has no values (|count| 0) or is malformed (|count| -1).
+static BYTE* Hive_ValueList(const HIVE* hive, DWORD keyCell, DWORD* count, BYTE** nkOut)
+{
+    DWORD cb, n;
+    BYTE* nk = Hive_KeyCell(hive, keyCell, &cb);
+    BYTE* list;
+    *count = (DWORD)-1;
+    if (!nk)
+        return NULL;
+    if (nkOut)
+        *nkOut = nk;
+    n = Hive_Rd32(nk + NK_VALUE_COUNT);
+    if (!n)
+    {
+        *count = 0;
+        return NULL;
+    }
+    list = Hive_Cell(hive, Hive_Rd32(nk + NK_VALUE_LIST), &cb);
+    if (!list || n > cb / 4)
+        return NULL;
+    *count = n;
+    return list;
+}
+
+extern "C" DWORD Hive_ValueCount(const HIVE* hive, DWORD keyCell)
+{
+    DWORD count;
+    Hive_ValueList(hive, keyCell, &count, NULL);
+    return count == (DWORD)-1 ? 0 : count;
+}
+
+extern "C" LSTATUS Hive_GetValue(const HIVE* hive, DWORD keyCell, DWORD index, HIVE_VALUE* value)
+{
+    DWORD count, cb, cbName, rawSize;
+    const BYTE* list = Hive_ValueList(hive, keyCell, &count, NULL);
+    const BYTE* vk;
+
+    if (count == (DWORD)-1)
+        return ERROR_INVALID_DATA;
+    if (index >= count)
+        return ERROR_NO_MORE_ITEMS;
+    value->cell = Hive_Rd32(list + index * 4);
+    vk = Hive_Cell(hive, value->cell, &cb);
+    if (!vk || cb < VK_NAME || Hive_Rd16(vk) != HIVE_VK)
+        return ERROR_INVALID_DATA;
+    cbName = Hive_Rd16(vk + VK_NAME_LENGTH);
+    if (VK_NAME + cbName > cb)
+        return ERROR_INVALID_DATA;
+
+    value->name = vk + VK_NAME;
+    value->compressedName = (Hive_Rd16(vk + VK_FLAGS) & VK_COMPRESSED_NAME) != 0;
+    value->cchName = value->compressedName ? cbName : cbName / 2;
+    value->type = Hive_Rd32(vk + VK_TYPE);
+    rawSize = Hive_Rd32(vk + VK_DATA_SIZE);
+    value->cbData = rawSize & ~VK_DATA_INLINE;
+    if ((rawSize & VK_DATA_INLINE) && value->cbData > 4)
+        return ERROR_INVALID_DATA;
+    return ERROR_SUCCESS;
+}
+
+extern "C" void Hive_CopyValueName(const HIVE_VALUE* value, WCHAR* name)
+{
+    DWORD i;
+    for (i = 0; i < value->cchName; ++i)
+        name[i] = value->compressedName ? (WCHAR)value->name[i] : (WCHAR)Hive_Rd16(value->name + i * 2);
+    name[value->cchName] = 0;
+}
+
+static __inline BOOL Hive_IsBigData(const HIVE* hive, DWORD cbData)
+{
+    return hive->minorVersion >= 4 && cbData > HIVE_BIG_DATA_SEGMENT;
+}
+
+// Returns the db cell's segment list and segment count, or NULL.
+static BYTE* Hive_BigDataSegments(const HIVE* hive, DWORD dbCell, DWORD cbData, DWORD* count, DWORD* listCell)
+{
+    DWORD cb, n;
+    const BYTE* db = Hive_Cell(hive, dbCell, &cb);
+    BYTE* list;
+    if (!db || cb < 8 || Hive_Rd16(db) != HIVE_DB)
+        return NULL;
+    n = Hive_Rd16(db + 2);
+    *listCell = Hive_Rd32(db + 4);
+    list = Hive_Cell(hive, *listCell, &cb);
+    if (!list || n > cb / 4 || (DWORD)n * HIVE_BIG_DATA_SEGMENT < cbData)
+        return NULL;
+    *count = n;
+    return list;
+}
+
+extern "C" LSTATUS Hive_ReadValueData(const HIVE* hive, const HIVE_VALUE* value, BYTE* data)
+{
+    DWORD cb, i, count, listCell;
+    const BYTE* vk = Hive_Cell(hive, value->cell, &cb);
+    DWORD rawSize = Hive_Rd32(vk + VK_DATA_SIZE);
+    DWORD offset = Hive_Rd32(vk + VK_DATA_OFFSET);
+    const BYTE* src;
+
+    if (!value->cbData)
+        return ERROR_SUCCESS;
+    if (rawSize & VK_DATA_INLINE)
+    {
+        memcpy(data, vk + VK_DATA_OFFSET, value->cbData);
+        return ERROR_SUCCESS;
+    }
+    if (Hive_IsBigData(hive, value->cbData))
+    {
+        DWORD done = 0;
+        const BYTE* list = Hive_BigDataSegments(hive, offset, value->cbData, &count, &listCell);
+        if (!list)
+            return ERROR_INVALID_DATA;
+        for (i = 0; i < count && done < value->cbData; ++i)
+        {
+            DWORD chunk = value->cbData - done;
+            if (chunk > HIVE_BIG_DATA_SEGMENT)
+                chunk = HIVE_BIG_DATA_SEGMENT;
+            src = Hive_Cell(hive, Hive_Rd32(list + i * 4), &cb);
+            if (!src || cb < chunk)
+                return ERROR_INVALID_DATA;
+            memcpy(data + done, src, chunk);
+            done += chunk;
+        }
+        return ERROR_SUCCESS;
+    }
+    src = Hive_Cell(hive, offset, &cb);
+    if (!src || cb < value->cbData)
+        return ERROR_INVALID_DATA;
+    memcpy(data, src, value->cbData);
+    return ERROR_SUCCESS;
+}
+
+extern "C" LSTATUS Hive_DeleteValue(HIVE* hive, DWORD keyCell, DWORD index)
+{
+    HIVE_VALUE value;
+    DWORD count, cb, i, segments, listCell;
+    BYTE* nk = NULL;
+    BYTE* list;
+    const BYTE* vk;
+    LSTATUS status = Hive_GetValue(hive, keyCell, index, &value);
+    if (status != ERROR_SUCCESS)
+        return status;
+    list = Hive_ValueList(hive, keyCell, &count, &nk);
+    vk = Hive_Cell(hive, value.cell, &cb);
+    if (!list || !nk || !vk)
+        return ERROR_INVALID_DATA;
+
+    Hive_Touch(hive);
+
+    // Data first, while the vk still says where it is.
+    if (value.cbData && !(Hive_Rd32(vk + VK_DATA_SIZE) & VK_DATA_INLINE))
+    {
+        DWORD offset = Hive_Rd32(vk + VK_DATA_OFFSET);
+        const BYTE* segmentList;
+        if (Hive_IsBigData(hive, value.cbData) &&
+            (segmentList = Hive_BigDataSegments(hive, offset, value.cbData, &segments, &listCell)) != NULL)
+        {
+            for (i = 0; i < segments; ++i)
+                Hive_FreeCell(hive, Hive_Rd32(segmentList + i * 4));
+            Hive_FreeCell(hive, listCell);
+        }
+        Hive_FreeCell(hive, offset);
+    }
+    Hive_FreeCell(hive, value.cell);
+
+    memmove(list + index * 4, list + (index + 1) * 4, (count - index - 1) * 4);
+    Hive_Wr32(nk + NK_VALUE_COUNT, count - 1);
+    if (count == 1)
+    {
+        Hive_FreeCell(hive, Hive_Rd32(nk + NK_VALUE_LIST));
+        Hive_Wr32(nk + NK_VALUE_LIST, HIVE_NIL);
+    }
+    return ERROR_SUCCESS;
+}
+
+extern "C" void Hive_Commit(HIVE* hive)
+{
+    if (!hive->modified)
+        return;
+    Hive_Wr32(hive->data + HIVE_SECONDARY_SEQUENCE, Hive_Rd32(hive->data + HIVE_PRIMARY_SEQUENCE));
+    Hive_Wr32(hive->data + HIVE_CHECKSUM, Hive_Checksum(hive->data));
+    hive->modified = FALSE;
+}
@@ -0,0 +1,75 @@
+// hive.h: in-place editing of registry hive files (regf), e.g. another
+// profile's UsrClass.dat, without loading them into the registry.
+// The hive is a byte buffer, typically a File_Map view. Keys are found by
+// walking nk cells and their lf/lh/li/ri subkey lists; deleting a value
+// unlinks it from the key's value list and marks its vk and data cells free.
+// The first change bumps the primary sequence number and Hive_Commit
+// matches the secondary to it, with the base block checksum fixed up both
+// times, which is how the kernel brackets its own writes.
+#ifndef MUICACHE_HIVE_H_
+#define MUICACHE_HIVE_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define HIVE_BASE_BLOCK_SIZE 0x1000
+#define HIVE_NIL             0xFFFFFFFF // empty cell offset
+
+typedef struct _HIVE {
+    BYTE* data;
+    DWORD size;
+    DWORD binsSize;     // hive bins, starting at HIVE_BASE_BLOCK_SIZE
+    DWORD rootCell;
+    DWORD minorVersion;
+    BOOL modified;
+} HIVE;
+
+// A value of a key, as found in its vk cell.
+typedef struct _HIVE_VALUE {
+    DWORD cell;
+    const BYTE* name;  // Latin-1 bytes when |compressedName|, else UTF-16LE
+    DWORD cchName;
+    BOOL compressedName;
+    DWORD type;
+    DWORD cbData;
+} HIVE_VALUE;
+
+// Checks the base block (signature, checksum, bins size) and fills |hive|.
+// Returns ERROR_INVALID_DATA for malformed files and for hives whose
+// sequence numbers differ: those have changes pending in their .LOG files
+// that the kernel would replay over anything written here.
+LSTATUS Hive_Open(BYTE* data, DWORD size, HIVE* hive);
+
+// XOR of the first 127 dwords of the base block, as stored at 0x1FC.
+DWORD Hive_Checksum(const BYTE* baseBlock);
+
+// Looks up |path| ('\'-separated, case-insensitive) below |keyCell|.
+LSTATUS Hive_FindKey(const HIVE* hive, DWORD keyCell, const WCHAR* path, DWORD* cell);
+
+// Last write time of a key, from its nk cell.
+LSTATUS Hive_KeyLastWriteTime(const HIVE* hive, DWORD keyCell, FILETIME* time);
+
+DWORD Hive_ValueCount(const HIVE* hive, DWORD keyCell);
+// Reads value |index| of |keyCell|; ERROR_NO_MORE_ITEMS past the end.
+LSTATUS Hive_GetValue(const HIVE* hive, DWORD keyCell, DWORD index, HIVE_VALUE* value);
+// Copies the name of |value| into |name|, which holds |value->cchName| + 1.
+void Hive_CopyValueName(const HIVE_VALUE* value, WCHAR* name);
+// Copies the data of |value| (inline, single cell or big data) into |data|,
+// which holds |value->cbData| bytes.
+LSTATUS Hive_ReadValueData(const HIVE* hive, const HIVE_VALUE* value, BYTE* data);
+
+// Removes value |index| from |keyCell| and frees its cells; later values
+// shift down by one, as with RegDeleteValue.
+LSTATUS Hive_DeleteValue(HIVE* hive, DWORD keyCell, DWORD index);
+
+// Marks the hive consistent again after changes. No-op if nothing changed.
+void Hive_Commit(HIVE* hive);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_HIVE_H_
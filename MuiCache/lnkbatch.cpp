@@ -0,0 +1,34 @@
+#include "lnkbatch.h"
+
+extern "C" HRESULT LnkBatch_Run(const LNK_BATCH_OPS* ops, void* ctx, DWORD count, HRESULT* results, DWORD* succeeded)
+{
+    HRESULT hr;
+    DWORD i, ok = 0;
+
+    if (succeeded)
+        *succeeded = 0;
+    if (!count)
+        return S_OK;
+
+    hr = ops->Initialize(ctx);
+    if (FAILED(hr))
+    {
+        for (i = 0; i < count; ++i)
+            results[i] = hr;
+        return hr;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        results[i] = ops->Update(ctx, i);
+        if (SUCCEEDED(results[i]))
+            ++ok;
+        else
+            ops->Reset(ctx);
+    }
+
+    ops->Uninitialize(ctx);
+    if (succeeded)
+        *succeeded = ok;
+    return ok == count ? S_OK : S_FALSE;
+}
@@ -0,0 +1,33 @@
+// lnkbatch.h: drives a batch of shortcut updates through one COM apartment.
+// The COM calls sit behind LNK_BATCH_OPS so the lifetime rules (one init,
+// one uninit, cached objects dropped after a failure) don't depend on COM.
+#ifndef MUICACHE_LNKBATCH_H_
+#define MUICACHE_LNKBATCH_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _LNK_BATCH_OPS {
+    // Called once before the first item; a failure fails every item.
+    HRESULT (*Initialize)(void* ctx);
+    // Updates item |index|, creating and caching whatever objects it needs.
+    HRESULT (*Update)(void* ctx, DWORD index);
+    // Drops cached objects after a failed Update.
+    void (*Reset)(void* ctx);
+    // Called once after the last item, only if Initialize succeeded.
+    void (*Uninitialize)(void* ctx);
+} LNK_BATCH_OPS;
+
+// Runs items 0..count-1 and stores each item's status in |results|.
+// Returns S_OK if all succeeded, S_FALSE if some failed, or the Initialize
+// error. |succeeded| (optional) receives the number of items that worked.
+HRESULT LnkBatch_Run(const LNK_BATCH_OPS* ops, void* ctx, DWORD count, HRESULT* results, DWORD* succeeded);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_LNKBATCH_H_
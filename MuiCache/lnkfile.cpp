@@ -0,0 +1,479 @@
+// MS-SHLLINK reader/writer. All multi-byte fields are little-endian and may
+// be unaligned, so everything goes through Lnk_Rd16/Lnk_Rd32.
+#include "lnkfile.h"
+#include "fileio.h"
+
+#define LNK_INVALID HRESULT_FROM_WIN32(ERROR_INVALID_DATA)
+
+// MS-PROPSTORE serialized property storage.
+#define LNK_STORAGE_VERSION 0x53505331 // 'SPS1'
+#define LNK_STORAGE_HEADER  24         // StorageSize, Version, FormatID
+#define LNK_VT_BOOL         0x000B
+#define LNK_VT_LPWSTR       0x001F
+#define LNK_VT_CLSID        0x0048
+
+static const BYTE LNK_CLSID_ShellLink[16] = {
+    0x01, 0x14, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46
+};
+
+extern "C" const LNK_FMTID LNK_FMTID_AppUserModel = {
+    { 0x55, 0x28, 0x4C, 0x9F, 0x79, 0x9F, 0x39, 0x4B, 0xA8, 0xD0, 0xE1, 0xD4, 0x2D, 0xE1, 0xD5, 0xF3 }
+};
+
+static __inline DWORD Lnk_Rd16(const BYTE* p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8);
+}
+
+static __inline DWORD Lnk_Rd32(const BYTE* p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static BOOL Lnk_BytesEqual(const BYTE* a, const BYTE* b, DWORD cb)
+{
+    DWORD i;
+    for (i = 0; i < cb; ++i)
+    {
+        if (a[i] != b[i])
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// Measures a NUL-terminated string starting at |offset| that must end
+// before |end|. Returns FALSE if it runs past |end|.
+static BOOL Lnk_TerminatedText(const BYTE* data, DWORD offset, DWORD end, BOOL unicode, LNK_TEXT* text)
+{
+    DWORD step = unicode ? 2 : 1;
+    DWORD p;
+    for (p = offset; p + step <= end; p += step)
+    {
+        if (unicode ? Lnk_Rd16(data + p) == 0 : data[p] == 0)
+        {
+            text->offset = offset;
+            text->cch = (p - offset) / step;
+            text->unicode = unicode;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static HRESULT Lnk_ParseLinkInfo(LNK_FILE* lnk)
+{
+    const BYTE* info = lnk->data + lnk->linkInfoOffset;
+    DWORD end = lnk->linkInfoOffset + lnk->linkInfoSize;
+    DWORD headerSize, offset;
+
+    if (lnk->linkInfoSize < 0x1C)
+        return LNK_INVALID;
+    headerSize = Lnk_Rd32(info + 4);
+    lnk->linkInfoFlags = Lnk_Rd32(info + 8);
+    if (headerSize < 0x1C || headerSize > lnk->linkInfoSize)
+        return LNK_INVALID;
+
+    // Prefer the Unicode variants (LinkInfoHeaderSize >= 0x24) when present.
+    if (lnk->linkInfoFlags & LNK_VOLUME_ID_AND_LOCAL_BASE_PATH)
+    {
+        offset = headerSize >= 0x24 ? Lnk_Rd32(info + 28) : 0;
+        if (offset && !Lnk_TerminatedText(lnk->data, lnk->linkInfoOffset + offset, end, TRUE, &lnk->localBasePath))
+            return LNK_INVALID;
+        offset = Lnk_Rd32(info + 16);
+        if (!lnk->localBasePath.offset && offset &&
+            !Lnk_TerminatedText(lnk->data, lnk->linkInfoOffset + offset, end, FALSE, &lnk->localBasePath))
+            return LNK_INVALID;
+    }
+
+    offset = headerSize >= 0x24 ? Lnk_Rd32(info + 32) : 0;
+    if (offset && !Lnk_TerminatedText(lnk->data, lnk->linkInfoOffset + offset, end, TRUE, &lnk->commonPathSuffix))
+        return LNK_INVALID;
+    offset = Lnk_Rd32(info + 24);
+    if (!lnk->commonPathSuffix.offset && offset &&
+        !Lnk_TerminatedText(lnk->data, lnk->linkInfoOffset + offset, end, FALSE, &lnk->commonPathSuffix))
+        return LNK_INVALID;
+    return S_OK;
+}
+
+extern "C" HRESULT Lnk_Parse(const BYTE* data, DWORD size, LNK_FILE* lnk)
+{
+    DWORD pos, cb, i, blockSize;
+    BOOL unicode;
+
+    memset(lnk, 0, sizeof(LNK_FILE));
+    if (size < LNK_HEADER_SIZE || Lnk_Rd32(data) != LNK_HEADER_SIZE || !Lnk_BytesEqual(data + 4, LNK_CLSID_ShellLink, 16))
+        return LNK_INVALID;
+
+    lnk->data = data;
+    lnk->size = size;
+    lnk->linkFlags = Lnk_Rd32(data + 0x14);
+    lnk->fileAttributes = Lnk_Rd32(data + 0x18);
+    lnk->fileSize = Lnk_Rd32(data + 0x34);
+    lnk->iconIndex = (LONG)Lnk_Rd32(data + 0x38);
+    lnk->showCommand = Lnk_Rd32(data + 0x3C);
+    pos = LNK_HEADER_SIZE;
+
+    if (lnk->linkFlags & LNK_HAS_LINK_TARGET_ID_LIST)
+    {
+        if (pos + 2 > size)
+            return LNK_INVALID;
+        cb = 2 + Lnk_Rd16(data + pos);
+        if (cb > size - pos)
+            return LNK_INVALID;
+        lnk->idListOffset = pos;
+        lnk->idListSize = cb;
+        pos += cb;
+    }
+
+    if (lnk->linkFlags & LNK_HAS_LINK_INFO)
+    {
+        if (pos + 4 > size)
+            return LNK_INVALID;
+        cb = Lnk_Rd32(data + pos);
+        if (cb < 4 || cb > size - pos)
+            return LNK_INVALID;
+        lnk->linkInfoOffset = pos;
+        lnk->linkInfoSize = cb;
+        if (FAILED(Lnk_ParseLinkInfo(lnk)))
+            return LNK_INVALID;
+        pos += cb;
+    }
+
+    unicode = (lnk->linkFlags & LNK_IS_UNICODE) != 0;
+    for (i = 0; i < LNK_STRING_COUNT; ++i)
+    {
+        if (!(lnk->linkFlags & (LNK_HAS_NAME << i)))
+            continue;
+        if (pos + 2 > size)
+            return LNK_INVALID;
+        lnk->strings[i].cch = Lnk_Rd16(data + pos);
+        lnk->strings[i].offset = pos + 2;
+        lnk->strings[i].unicode = unicode;
+        cb = lnk->strings[i].cch * (unicode ? 2 : 1);
+        if (cb > size - pos - 2)
+            return LNK_INVALID;
+        pos += 2 + cb;
+    }
+
+    // ExtraData is a chain of blocks closed by a TerminalBlock (size < 4).
+    // Some writers omit the terminator; accept that at end of file.
+    lnk->extraOffset = pos;
+    while (pos + 4 <= size)
+    {
+        blockSize = Lnk_Rd32(data + pos);
+        if (blockSize < 4)
+        {
+            lnk->terminalOffset = pos;
+            pos += 4;
+            break;
+        }
+        if (blockSize < 8 || blockSize > size - pos)
+            return LNK_INVALID;
+        if (Lnk_Rd32(data + pos + 4) == LNK_PROPERTY_STORE_SIGNATURE)
+        {
+            lnk->propertyStoreOffset = pos;
+            lnk->propertyStoreSize = blockSize;
+        }
+        pos += blockSize;
+    }
+    lnk->extraSize = pos - lnk->extraOffset;
+    return S_OK;
+}
+
+// Walks the serialized storages of the property store block. Returns the
+// offset of the first storage at or after |pos| and its size, or FALSE at
+// the terminating zero-size storage, the block end, or a malformed one.
+static BOOL Lnk_NextStorage(const LNK_FILE* lnk, DWORD pos, DWORD* storageSize)
+{
+    DWORD end = lnk->propertyStoreOffset + lnk->propertyStoreSize;
+    DWORD cb;
+    if (pos + 4 > end)
+        return FALSE;
+    cb = Lnk_Rd32(lnk->data + pos);
+    if (cb < LNK_STORAGE_HEADER || cb > end - pos || Lnk_Rd32(lnk->data + pos + 4) != LNK_STORAGE_VERSION)
+        return FALSE;
+    *storageSize = cb;
+    return TRUE;
+}
+
+// Same for the integer-named values inside one storage.
+static BOOL Lnk_NextValue(const LNK_FILE* lnk, DWORD pos, DWORD storageEnd, DWORD* valueSize)
+{
+    DWORD cb;
+    if (pos + 4 > storageEnd)
+        return FALSE;
+    cb = Lnk_Rd32(lnk->data + pos);
+    if (cb < 9 || cb > storageEnd - pos)
+        return FALSE;
+    *valueSize = cb;
+    return TRUE;
+}
+
+// Finds the serialized value (|fmtid|, |pid|) of type |vt| holding at least
+// |cbMin| bytes of data. |v| receives the value's offset, its data starting
+// at v + 13, and |valueSize| its size.
+static BOOL Lnk_FindValue(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, DWORD vt, DWORD cbMin,
+    DWORD* v, DWORD* valueSize)
+{
+    const BYTE* data = lnk->data;
+    DWORD storage, storageSize;
+
+    if (!lnk->propertyStoreSize)
+        return FALSE;
+    for (storage = lnk->propertyStoreOffset + 8; Lnk_NextStorage(lnk, storage, &storageSize); storage += storageSize)
+    {
+        if (!Lnk_BytesEqual(data + storage + 8, fmtid->bytes, 16))
+            continue;
+        for (*v = storage + LNK_STORAGE_HEADER; Lnk_NextValue(lnk, *v, storage + storageSize, valueSize);
+            *v += *valueSize)
+        {
+            if (Lnk_Rd32(data + *v + 4) != pid)
+                continue;
+            return *valueSize >= 13 + cbMin && Lnk_Rd16(data + *v + 9) == vt;
+        }
+    }
+    return FALSE;
+}
+
+extern "C" BOOL Lnk_FindStringProperty(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, LNK_TEXT* value)
+{
+    const BYTE* data = lnk->data;
+    DWORD v, valueSize, cch;
+
+    if (!Lnk_FindValue(lnk, fmtid, pid, LNK_VT_LPWSTR, 4, &v, &valueSize))
+        return FALSE;
+    cch = Lnk_Rd32(data + v + 13);
+    if (cch > (valueSize - 17) / 2)
+        return FALSE;
+    if (cch && Lnk_Rd16(data + v + 17 + (cch - 1) * 2) == 0)
+        --cch;
+    value->offset = v + 17;
+    value->cch = cch;
+    value->unicode = TRUE;
+    return TRUE;
+}
+
+extern "C" BOOL Lnk_FindBoolProperty(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, BOOL* value)
+{
+    DWORD v, valueSize;
+
+    if (!Lnk_FindValue(lnk, fmtid, pid, LNK_VT_BOOL, 2, &v, &valueSize))
+        return FALSE;
+    // VARIANT_BOOL: 0xFFFF for true.
+    *value = Lnk_Rd16(lnk->data + v + 13) != 0;
+    return TRUE;
+}
+
+extern "C" BOOL Lnk_FindGuidProperty(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, LNK_FMTID* value)
+{
+    DWORD v, valueSize;
+
+    if (!Lnk_FindValue(lnk, fmtid, pid, LNK_VT_CLSID, 16, &v, &valueSize))
+        return FALSE;
+    memcpy(value->bytes, lnk->data + v + 13, 16);
+    return TRUE;
+}
+
+struct LNK_WRITER
+{
+    BYTE* out;
+    DWORD cap;
+    DWORD pos;
+};
+
+static void Lnk_Put(LNK_WRITER* w, const BYTE* src, DWORD cb)
+{
+    if (w->out && cb <= w->cap && w->pos <= w->cap - cb)
+        memcpy(w->out + w->pos, src, cb);
+    w->pos += cb;
+}
+
+static void Lnk_Put16(LNK_WRITER* w, DWORD v)
+{
+    BYTE b[2];
+    b[0] = (BYTE)v;
+    b[1] = (BYTE)(v >> 8);
+    Lnk_Put(w, b, 2);
+}
+
+static void Lnk_Put32(LNK_WRITER* w, DWORD v)
+{
+    BYTE b[4];
+    b[0] = (BYTE)v;
+    b[1] = (BYTE)(v >> 8);
+    b[2] = (BYTE)(v >> 16);
+    b[3] = (BYTE)(v >> 24);
+    Lnk_Put(w, b, 4);
+}
+
+static void Lnk_Patch32(LNK_WRITER* w, DWORD at, DWORD v)
+{
+    if (w->out && at + 4 <= w->cap)
+    {
+        w->out[at] = (BYTE)v;
+        w->out[at + 1] = (BYTE)(v >> 8);
+        w->out[at + 2] = (BYTE)(v >> 16);
+        w->out[at + 3] = (BYTE)(v >> 24);
+    }
+}
+
+// Integer-named VT_LPWSTR value; the string is padded to 4 bytes.
+static void Lnk_PutStringValue(LNK_WRITER* w, DWORD pid, const WCHAR* value)
+{
+    DWORD cch = Str_Length(value) + 1;
+    DWORD pad = (4 - (cch * 2) % 4) % 4;
+    DWORD i;
+
+    Lnk_Put32(w, 17 + cch * 2 + pad);
+    Lnk_Put32(w, pid);
+    Lnk_Put(w, (const BYTE*)"", 1); // Reserved
+    Lnk_Put16(w, LNK_VT_LPWSTR);
+    Lnk_Put16(w, 0);
+    Lnk_Put32(w, cch);
+    for (i = 0; i < cch; ++i)
+        Lnk_Put16(w, value[i]);
+    for (i = 0; i < pad; ++i)
+        Lnk_Put(w, (const BYTE*)"", 1);
+}
+
+// Writes storage |fmtid|, keeping the values of the existing storage at
+// |storage| (if any) except |pid|, then |value| (if any).
+static void Lnk_PutStorage(LNK_WRITER* w, const LNK_FILE* lnk, DWORD storage, DWORD storageSize,
+    const LNK_FMTID* fmtid, DWORD pid, const WCHAR* value)
+{
+    DWORD start = w->pos;
+    DWORD v, valueSize;
+
+    Lnk_Put32(w, 0);
+    Lnk_Put32(w, LNK_STORAGE_VERSION);
+    Lnk_Put(w, fmtid->bytes, 16);
+    if (storageSize)
+    {
+        for (v = storage + LNK_STORAGE_HEADER; Lnk_NextValue(lnk, v, storage + storageSize, &valueSize); v += valueSize)
+        {
+            if (Lnk_Rd32(lnk->data + v + 4) != pid)
+                Lnk_Put(w, lnk->data + v, valueSize);
+        }
+    }
+    if (value)
+        Lnk_PutStringValue(w, pid, value);
+    Lnk_Put32(w, 0);
+    Lnk_Patch32(w, start, w->pos - start);
+}
+
+static void Lnk_PutPropertyStore(LNK_WRITER* w, const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, const WCHAR* value)
+{
+    DWORD start = w->pos;
+    DWORD storage, storageSize, end;
+    BOOL done = FALSE;
+
+    Lnk_Put32(w, 0);
+    Lnk_Put32(w, LNK_PROPERTY_STORE_SIGNATURE);
+    if (lnk->propertyStoreSize)
+    {
+        end = lnk->propertyStoreOffset + lnk->propertyStoreSize;
+        for (storage = lnk->propertyStoreOffset + 8; Lnk_NextStorage(lnk, storage, &storageSize); storage += storageSize)
+        {
+            if (Lnk_BytesEqual(lnk->data + storage + 8, fmtid->bytes, 16))
+            {
+                Lnk_PutStorage(w, lnk, storage, storageSize, fmtid, pid, value);
+                done = TRUE;
+            }
+            else
+                Lnk_Put(w, lnk->data + storage, storageSize);
+        }
+        if (!done && value)
+            Lnk_PutStorage(w, lnk, 0, 0, fmtid, pid, value);
+        // The terminating zero storage size, plus whatever followed it.
+        if (storage < end)
+            Lnk_Put(w, lnk->data + storage, end - storage);
+        else
+            Lnk_Put32(w, 0);
+    }
+    else
+    {
+        Lnk_PutStorage(w, lnk, 0, 0, fmtid, pid, value);
+        Lnk_Put32(w, 0);
+    }
+    Lnk_Patch32(w, start, w->pos - start);
+}
+
+extern "C" HRESULT Lnk_WriteWithStringProperty(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, const WCHAR* value,
+    BYTE* out, DWORD cbOut, DWORD* cbWritten)
+{
+    LNK_WRITER w;
+    DWORD at;
+
+    w.out = out;
+    w.cap = cbOut;
+    w.pos = 0;
+
+    if (lnk->propertyStoreSize)
+    {
+        at = lnk->propertyStoreOffset;
+        Lnk_Put(&w, lnk->data, at);
+        Lnk_PutPropertyStore(&w, lnk, fmtid, pid, value);
+        at += lnk->propertyStoreSize;
+        Lnk_Put(&w, lnk->data + at, lnk->size - at);
+    }
+    else if (value)
+    {
+        // New block goes right before the TerminalBlock.
+        at = lnk->terminalOffset ? lnk->terminalOffset : lnk->extraOffset + lnk->extraSize;
+        Lnk_Put(&w, lnk->data, at);
+        Lnk_PutPropertyStore(&w, lnk, fmtid, pid, value);
+        if (!lnk->terminalOffset)
+            Lnk_Put32(&w, 0);
+        Lnk_Put(&w, lnk->data + at, lnk->size - at);
+    }
+    else
+        Lnk_Put(&w, lnk->data, lnk->size);
+
+    *cbWritten = w.pos;
+    return w.pos <= cbOut ? S_OK : HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+}
+
+extern "C" HRESULT Lnk_SetAppIdInFile(const WCHAR* path, const WCHAR* appId)
+{
+    BYTE* data = NULL;
+    BYTE* out = NULL;
+    DWORD size = 0, cbOut = 0, i;
+    LNK_FILE lnk;
+    LNK_TEXT current;
+    LSTATUS status;
+    HRESULT hr;
+
+    status = File_ReadAll(path, &data, &size);
+    if (status != ERROR_SUCCESS)
+        return HRESULT_FROM_WIN32(status);
+
+    hr = Lnk_Parse(data, size, &lnk);
+    if (SUCCEEDED(hr) && Lnk_FindStringProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, &current) &&
+        current.cch == Str_Length(appId))
+    {
+        for (i = 0; i < current.cch && Lnk_Rd16(data + current.offset + i * 2) == appId[i]; ++i)
+            ;
+        if (i == current.cch)
+            hr = S_FALSE;
+    }
+
+    if (hr == S_OK)
+    {
+        Lnk_WriteWithStringProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, appId, NULL, 0, &cbOut);
+        out = (BYTE*)Mem_Alloc(cbOut);
+        if (!out)
+            hr = E_OUTOFMEMORY;
+        else
+            hr = Lnk_WriteWithStringProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, appId, out, cbOut, &cbOut);
+    }
+    if (hr == S_OK)
+    {
+        status = File_WriteAll(path, out, cbOut);
+        if (status != ERROR_SUCCESS)
+            hr = HRESULT_FROM_WIN32(status);
+    }
+
+    Mem_Free(out);
+    Mem_Free(data);
+    return hr;
+}
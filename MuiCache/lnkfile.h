@@ -0,0 +1,119 @@
+// lnkfile.h: Shell Link (.lnk) binary format reader/writer, per MS-SHLLINK.
+// Works on a byte buffer without COM: parsing records where each structure
+// (header, LinkTargetIDList, LinkInfo, StringData, ExtraData) lives, and
+// writing copies every byte it was not asked to change, so a file that is
+// re-serialized without edits comes out identical.
+#ifndef MUICACHE_LNKFILE_H_
+#define MUICACHE_LNKFILE_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define LNK_HEADER_SIZE 0x4C
+
+// LinkFlags
+#define LNK_HAS_LINK_TARGET_ID_LIST 0x00000001
+#define LNK_HAS_LINK_INFO           0x00000002
+#define LNK_HAS_NAME                0x00000004
+#define LNK_HAS_RELATIVE_PATH       0x00000008
+#define LNK_HAS_WORKING_DIR         0x00000010
+#define LNK_HAS_ARGUMENTS           0x00000020
+#define LNK_HAS_ICON_LOCATION       0x00000040
+#define LNK_IS_UNICODE              0x00000080
+#define LNK_HAS_EXP_STRING          0x00000200 // target also in an EnvironmentVariableDataBlock
+#define LNK_HAS_EXP_ICON            0x00004000 // icon also in an IconEnvironmentDataBlock
+
+// LinkInfoFlags
+#define LNK_VOLUME_ID_AND_LOCAL_BASE_PATH 0x00000001
+
+#define LNK_PROPERTY_STORE_SIGNATURE 0xA0000009
+
+// StringData entries, in file order.
+enum LNK_STRING_ID
+{
+    LNK_NAME_STRING = 0,
+    LNK_RELATIVE_PATH,
+    LNK_WORKING_DIR,
+    LNK_COMMAND_LINE_ARGUMENTS,
+    LNK_ICON_LOCATION,
+    LNK_STRING_COUNT
+};
+
+// A run of characters inside the parsed buffer. |offset| is 0 when absent.
+// Strings are UTF-16LE when |unicode| is set, system code page otherwise.
+typedef struct _LNK_TEXT {
+    DWORD offset;
+    DWORD cch;
+    BOOL unicode;
+} LNK_TEXT;
+
+// Where things are, as byte offsets into the buffer given to Lnk_Parse.
+// A size of 0 means the structure is absent.
+typedef struct _LNK_FILE {
+    const BYTE* data;
+    DWORD size;
+
+    DWORD linkFlags;
+    DWORD fileAttributes;
+    DWORD fileSize;
+    LONG iconIndex;
+    DWORD showCommand;
+
+    DWORD idListOffset; // LinkTargetIDList, IDListSize field included
+    DWORD idListSize;
+    DWORD linkInfoOffset;
+    DWORD linkInfoSize;
+    DWORD linkInfoFlags;
+    LNK_TEXT localBasePath;    // Unicode variant when present
+    LNK_TEXT commonPathSuffix; // Unicode variant when present
+    LNK_TEXT strings[LNK_STRING_COUNT];
+    DWORD extraOffset; // ExtraData up to the end of the TerminalBlock
+    DWORD extraSize;
+    DWORD terminalOffset; // 0 when the file ends without a TerminalBlock
+    DWORD propertyStoreOffset; // PropertyStoreDataBlock, block header included
+    DWORD propertyStoreSize;
+} LNK_FILE;
+
+// 16-byte little-endian GUID as stored in the file.
+typedef struct _LNK_FMTID {
+    BYTE bytes[16];
+} LNK_FMTID;
+
+// {9F4C2855-9F79-4B39-A8D0-E1D42DE1D5F3}, PKEY_AppUserModel_* format id.
+extern const LNK_FMTID LNK_FMTID_AppUserModel;
+#define LNK_PID_AppUserModel_ID 5
+#define LNK_PID_AppUserModel_IsDualMode 11
+#define LNK_PID_AppUserModel_ToastActivatorCLSID 26
+
+// Validates |data| and fills |lnk|. The buffer must outlive |lnk|.
+// Returns HRESULT_FROM_WIN32(ERROR_INVALID_DATA) for malformed input.
+HRESULT Lnk_Parse(const BYTE* data, DWORD size, LNK_FILE* lnk);
+
+// Looks up a VT_LPWSTR property in the PropertyStoreDataBlock. On success
+// |value| points at the UTF-16LE characters (without NUL) in lnk->data.
+BOOL Lnk_FindStringProperty(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, LNK_TEXT* value);
+// Same for a VT_BOOL and a VT_CLSID property.
+BOOL Lnk_FindBoolProperty(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, BOOL* value);
+BOOL Lnk_FindGuidProperty(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, LNK_FMTID* value);
+
+// Serializes |lnk| with the string property (|fmtid|, |pid|) set to |value|,
+// or removed when |value| is NULL. Everything outside the property store
+// block is copied verbatim; inside it, only the affected storage is rebuilt.
+// |cbWritten| receives the size needed; if |cbOut| is too small nothing
+// useful is written and HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER) is
+// returned, so callers can measure with a NULL |out| first.
+HRESULT Lnk_WriteWithStringProperty(const LNK_FILE* lnk, const LNK_FMTID* fmtid, DWORD pid, const WCHAR* value,
+    BYTE* out, DWORD cbOut, DWORD* cbWritten);
+
+// Reads |path|, sets its System.AppUserModel.ID to |appId| and writes it
+// back. Returns S_FALSE without writing when the id is already |appId|.
+HRESULT Lnk_SetAppIdInFile(const WCHAR* path, const WCHAR* appId);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_LNKFILE_H_
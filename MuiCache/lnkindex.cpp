@@ -0,0 +1,475 @@
+// Shortcut index behind lnkindex.h.
+// A refresh builds a new index next to the old one: entries of other folders
+// and unchanged shortcuts are copied over, the rest is parsed, and the old
+// index is dropped at the end, so a failure halfway leaves it untouched.
+// Lookups by path compare a case-insensitive hash first; the index holds a
+// few hundred shortcuts, so a linear scan is enough.
+#include "lnkindex.h"
+#include "fileio.h"
+#include "lnkfile.h"
+#include "unpin.h"
+
+static const BYTE kLnkIndexMagic[4] = { 'M', 'C', 'L', 'I' };
+static const WCHAR kAnyShortcut[] = { '*', 0 };
+
+// size, last write (low, high), icon index, parsed
+#define LNK_INDEX_ENTRY_FIXED_SIZE 20
+
+static __inline DWORD Li_Rd32(const BYTE* p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static __inline void Li_Wr32(BYTE* p, DWORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+static __inline WCHAR Li_Lower(WCHAR ch)
+{
+    return ch >= 'A' && ch <= 'Z' ? (WCHAR)(ch | 0x20) : ch;
+}
+
+static __inline BOOL Li_IsSeparator(WCHAR ch)
+{
+    return ch == '\\' || ch == '/';
+}
+
+static DWORD Li_PathHash(const WCHAR* path)
+{
+    DWORD hash = 2166136261u;
+    WCHAR ch;
+    for (; *path; ++path)
+    {
+        ch = Li_Lower(*path);
+        hash = (hash ^ (ch & 0xFF)) * 16777619u;
+        hash = (hash ^ (ch >> 8)) * 16777619u;
+    }
+    return hash;
+}
+
+static DWORD Li_Checksum(const BYTE* data, DWORD size)
+{
+    DWORD hash = 2166136261u, i;
+    for (i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+static BOOL Li_PathEquals(const WCHAR* a, const WCHAR* b)
+{
+    for (; *a && Li_Lower(*a) == Li_Lower(*b); ++a, ++b)
+        ;
+    return Li_Lower(*a) == Li_Lower(*b);
+}
+
+// TRUE when |path| is |dir| or lies below it.
+static BOOL Li_IsUnder(const WCHAR* path, const WCHAR* dir)
+{
+    DWORD i;
+    for (i = 0; dir[i]; ++i)
+    {
+        if (Li_Lower(path[i]) != Li_Lower(dir[i]))
+            return FALSE;
+    }
+    return !path[i] || Li_IsSeparator(path[i]) || (i && Li_IsSeparator(dir[i - 1]));
+}
+
+extern "C" void LnkIndex_Init(LNK_INDEX* index)
+{
+    memset(index, 0, sizeof(LNK_INDEX));
+    StrList_Init(&index->strings);
+}
+
+extern "C" void LnkIndex_Free(LNK_INDEX* index)
+{
+    Mem_Free(index->entries);
+    StrList_Free(&index->strings);
+    LnkIndex_Init(index);
+}
+
+// Appends |entry| with its LNK_INDEX_FIELD_COUNT |fields| of |cch| chars.
+static BOOL LnkIndex_Append(LNK_INDEX* index, const LNK_INDEX_ENTRY* entry, const WCHAR* const* fields,
+    const DWORD* cch)
+{
+    DWORD field;
+
+    if (index->count == index->capacity)
+    {
+        DWORD capacity = index->capacity ? index->capacity * 2 : 64;
+        LNK_INDEX_ENTRY* entries = (LNK_INDEX_ENTRY*)Mem_Realloc(index->entries, capacity * sizeof(LNK_INDEX_ENTRY));
+        if (!entries)
+            return FALSE;
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+    for (field = 0; field < LNK_INDEX_FIELD_COUNT; ++field)
+    {
+        if (!StrList_Add(&index->strings, fields[field], cch[field]))
+            return FALSE;
+    }
+    index->entries[index->count++] = *entry;
+    return TRUE;
+}
+
+// Copies entry |i| of |from| to the end of |to|.
+static BOOL LnkIndex_Copy(LNK_INDEX* to, const LNK_INDEX* from, DWORD i)
+{
+    const WCHAR* fields[LNK_INDEX_FIELD_COUNT];
+    DWORD cch[LNK_INDEX_FIELD_COUNT], field;
+
+    for (field = 0; field < LNK_INDEX_FIELD_COUNT; ++field)
+    {
+        fields[field] = LnkIndex_Get(from, i, field);
+        cch[field] = Str_Length(fields[field]);
+    }
+    return LnkIndex_Append(to, &from->entries[i], fields, cch);
+}
+
+static DWORD LnkIndex_Find(const LNK_INDEX* index, const WCHAR* path, DWORD hash)
+{
+    DWORD i;
+    for (i = 0; i < index->count; ++i)
+    {
+        if (index->entries[i].pathHash == hash && Li_PathEquals(LnkIndex_Get(index, i, LNK_INDEX_PATH), path))
+            return i;
+    }
+    return index->count;
+}
+
+// Appends |text| of |lnk| to |out|, up to an embedded NUL. Code-page
+// strings are widened byte by byte, which is exact for ASCII.
+static DWORD Li_AppendText(const LNK_FILE* lnk, const LNK_TEXT* text, WCHAR* out)
+{
+    const BYTE* p = lnk->data + text->offset;
+    DWORD i;
+    WCHAR ch;
+
+    if (!text->offset)
+        return 0;
+    for (i = 0; i < text->cch; ++i)
+    {
+        ch = text->unicode ? (WCHAR)(p[i * 2] | (p[i * 2 + 1] << 8)) : (WCHAR)p[i];
+        if (!ch)
+            break;
+        out[i] = ch;
+    }
+    return i;
+}
+
+// Reads the shortcut at |path| into a new entry of |index|. A file that
+// doesn't parse gets an entry too, so it isn't read again until it changes.
+static LSTATUS LnkIndex_Parse(LNK_INDEX* index, const WCHAR* path, DWORD hash, DWORD size,
+    const FILETIME* lastWrite)
+{
+    LNK_INDEX_ENTRY entry;
+    LNK_FILE lnk;
+    LNK_TEXT appId;
+    const WCHAR* fields[LNK_INDEX_FIELD_COUNT];
+    DWORD cch[LNK_INDEX_FIELD_COUNT], field, used = 0, cbFile;
+    WCHAR* chars;
+    BYTE* data;
+    LSTATUS status;
+
+    status = File_ReadAll(path, &data, &cbFile);
+    if (status != ERROR_SUCCESS)
+        return status;
+    // The strings come from disjoint parts of the file: no more chars
+    // than it has bytes.
+    chars = (WCHAR*)Mem_Alloc(((SIZE_T)cbFile + 1) * sizeof(WCHAR));
+    if (!chars)
+    {
+        Mem_Free(data);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    memset(&entry, 0, sizeof(LNK_INDEX_ENTRY));
+    memset(cch, 0, sizeof(cch));
+    entry.pathHash = hash;
+    entry.size = size;
+    entry.lastWrite = *lastWrite;
+    fields[LNK_INDEX_PATH] = path;
+    cch[LNK_INDEX_PATH] = Str_Length(path);
+    for (field = LNK_INDEX_TARGET; field < LNK_INDEX_FIELD_COUNT; ++field)
+        fields[field] = chars;
+
+    if (SUCCEEDED(Lnk_Parse(data, cbFile, &lnk)))
+    {
+        entry.parsed = TRUE;
+        entry.iconIndex = lnk.iconIndex;
+
+        fields[LNK_INDEX_TARGET] = chars + used;
+        cch[LNK_INDEX_TARGET] = Li_AppendText(&lnk, &lnk.localBasePath, chars + used);
+        cch[LNK_INDEX_TARGET] += Li_AppendText(&lnk, &lnk.commonPathSuffix, chars + used + cch[LNK_INDEX_TARGET]);
+        used += cch[LNK_INDEX_TARGET];
+
+        fields[LNK_INDEX_ARGUMENTS] = chars + used;
+        cch[LNK_INDEX_ARGUMENTS] = Li_AppendText(&lnk, &lnk.strings[LNK_COMMAND_LINE_ARGUMENTS], chars + used);
+        used += cch[LNK_INDEX_ARGUMENTS];
+
+        fields[LNK_INDEX_ICON] = chars + used;
+        cch[LNK_INDEX_ICON] = Li_AppendText(&lnk, &lnk.strings[LNK_ICON_LOCATION], chars + used);
+        used += cch[LNK_INDEX_ICON];
+
+        fields[LNK_INDEX_APP_ID] = chars + used;
+        if (Lnk_FindStringProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, &appId))
+            cch[LNK_INDEX_APP_ID] = Li_AppendText(&lnk, &appId, chars + used);
+    }
+
+    status = LnkIndex_Append(index, &entry, fields, cch) ? ERROR_SUCCESS : ERROR_NOT_ENOUGH_MEMORY;
+    Mem_Free(chars);
+    Mem_Free(data);
+    return status;
+}
+
+extern "C" LSTATUS LnkIndex_Refresh(LNK_INDEX* index, DIR_LISTER* lister, const WCHAR* dir, DWORD flags,
+    LNK_INDEX_STATS* stats)
+{
+    LNK_INDEX next;
+    LNK_INDEX_STATS counted;
+    STR_LIST paths;
+    FILETIME lastWrite;
+    DWORD i, old, hash, size, carried = 0, known = 0;
+    const WCHAR* path;
+    LSTATUS status;
+
+    memset(&counted, 0, sizeof(LNK_INDEX_STATS));
+    StrList_Init(&paths);
+    status = Unpin_FindShortcuts(lister, dir, kAnyShortcut, (flags & LNK_INDEX_RECURSE) ? UNPIN_RECURSE : 0, &paths);
+    if (status != ERROR_SUCCESS)
+    {
+        StrList_Free(&paths);
+        return status;
+    }
+
+    LnkIndex_Init(&next);
+    for (i = 0; i < index->count && status == ERROR_SUCCESS; ++i)
+    {
+        if (Li_IsUnder(LnkIndex_Get(index, i, LNK_INDEX_PATH), dir))
+            continue;
+        if (!LnkIndex_Copy(&next, index, i))
+            status = ERROR_NOT_ENOUGH_MEMORY;
+        ++carried;
+    }
+
+    for (i = 0; i < paths.count && status == ERROR_SUCCESS; ++i)
+    {
+        path = StrList_Get(&paths, i);
+        // Deleted since it was listed.
+        if (File_GetInfo(path, &size, &lastWrite) != ERROR_SUCCESS)
+            continue;
+        ++counted.listed;
+        hash = Li_PathHash(path);
+        old = LnkIndex_Find(index, path, hash);
+        if (old < index->count)
+            ++known;
+        if (old < index->count && index->entries[old].size == size
+            && index->entries[old].lastWrite.dwLowDateTime == lastWrite.dwLowDateTime
+            && index->entries[old].lastWrite.dwHighDateTime == lastWrite.dwHighDateTime)
+        {
+            if (!LnkIndex_Copy(&next, index, old))
+                status = ERROR_NOT_ENOUGH_MEMORY;
+            ++counted.reused;
+            continue;
+        }
+        status = LnkIndex_Parse(&next, path, hash, size, &lastWrite);
+        // Gone or locked between the two calls: leave it out this time.
+        if (status != ERROR_SUCCESS && status != ERROR_NOT_ENOUGH_MEMORY)
+        {
+            status = ERROR_SUCCESS;
+            --counted.listed;
+            if (old < index->count)
+                --known;
+            continue;
+        }
+        ++counted.parsed;
+    }
+    StrList_Free(&paths);
+
+    if (status != ERROR_SUCCESS)
+    {
+        LnkIndex_Free(&next);
+        return status;
+    }
+
+    counted.removed = index->count - carried - known;
+    next.dirty = index->dirty || counted.parsed || counted.removed;
+    LnkIndex_Free(index);
+    *index = next;
+    if (stats)
+        *stats = counted;
+    return ERROR_SUCCESS;
+}
+
+static LSTATUS LnkIndex_ParseFile(LNK_INDEX* index, const BYTE* data, DWORD size)
+{
+    LNK_INDEX_ENTRY entry;
+    const WCHAR* fields[LNK_INDEX_FIELD_COUNT];
+    DWORD cch[LNK_INDEX_FIELD_COUNT], count, i, field, pos, j;
+    WCHAR* chars;
+    LSTATUS status = ERROR_SUCCESS;
+
+    if (size < LNK_INDEX_HEADER_SIZE || Li_Rd32(data) != Li_Rd32(kLnkIndexMagic)
+        || Li_Rd32(data + 4) != LNK_INDEX_VERSION
+        || Li_Rd32(data + 12) != Li_Checksum(data + LNK_INDEX_HEADER_SIZE, size - LNK_INDEX_HEADER_SIZE))
+        return ERROR_INVALID_DATA;
+    count = Li_Rd32(data + 8);
+
+    // The chars are stored unaligned; copy them out one entry at a time.
+    chars = (WCHAR*)Mem_Alloc(((SIZE_T)size / 2 + 1) * sizeof(WCHAR));
+    if (!chars)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    for (i = 0, pos = LNK_INDEX_HEADER_SIZE; i < count && status == ERROR_SUCCESS; ++i)
+    {
+        DWORD used = 0;
+        if (size - pos < LNK_INDEX_ENTRY_FIXED_SIZE)
+        {
+            status = ERROR_INVALID_DATA;
+            break;
+        }
+        entry.size = Li_Rd32(data + pos);
+        entry.lastWrite.dwLowDateTime = Li_Rd32(data + pos + 4);
+        entry.lastWrite.dwHighDateTime = Li_Rd32(data + pos + 8);
+        entry.iconIndex = (LONG)Li_Rd32(data + pos + 12);
+        entry.parsed = Li_Rd32(data + pos + 16) != 0;
+        pos += LNK_INDEX_ENTRY_FIXED_SIZE;
+
+        for (field = 0; field < LNK_INDEX_FIELD_COUNT; ++field)
+        {
+            if (size - pos < 4 || (size - pos - 4) / 2 < Li_Rd32(data + pos))
+            {
+                status = ERROR_INVALID_DATA;
+                break;
+            }
+            cch[field] = Li_Rd32(data + pos);
+            pos += 4;
+            fields[field] = chars + used;
+            for (j = 0; j < cch[field]; ++j, pos += 2)
+                chars[used + j] = (WCHAR)(data[pos] | (data[pos + 1] << 8));
+            used += cch[field];
+        }
+        if (status != ERROR_SUCCESS)
+            break;
+        entry.pathHash = 0;
+        if (!LnkIndex_Append(index, &entry, fields, cch))
+            status = ERROR_NOT_ENOUGH_MEMORY;
+        else // the copy is NUL-terminated, |chars| isn't
+            index->entries[i].pathHash = Li_PathHash(LnkIndex_Get(index, i, LNK_INDEX_PATH));
+    }
+    if (status == ERROR_SUCCESS && pos != size)
+        status = ERROR_INVALID_DATA;
+
+    Mem_Free(chars);
+    return status;
+}
+
+extern "C" LSTATUS LnkIndex_Load(LNK_INDEX* index, const WCHAR* path)
+{
+    BYTE* data;
+    DWORD size;
+    LSTATUS status;
+
+    LnkIndex_Free(index);
+    status = File_ReadAll(path, &data, &size);
+    if (status == ERROR_FILE_NOT_FOUND || status == ERROR_PATH_NOT_FOUND)
+        return ERROR_SUCCESS;
+    if (status != ERROR_SUCCESS)
+        return status;
+    status = LnkIndex_ParseFile(index, data, size);
+    Mem_Free(data);
+    if (status != ERROR_SUCCESS)
+        LnkIndex_Free(index);
+    return status;
+}
+
+extern "C" LSTATUS LnkIndex_Save(const LNK_INDEX* index, const WCHAR* path)
+{
+    DWORD size = LNK_INDEX_HEADER_SIZE, i, field, cch, j;
+    const WCHAR* text;
+    BYTE* data;
+    BYTE* p;
+    LSTATUS status;
+
+    for (i = 0; i < index->count; ++i)
+    {
+        size += LNK_INDEX_ENTRY_FIXED_SIZE;
+        for (field = 0; field < LNK_INDEX_FIELD_COUNT; ++field)
+            size += 4 + Str_Length(LnkIndex_Get(index, i, field)) * 2;
+    }
+    data = (BYTE*)Mem_Alloc(size);
+    if (!data)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    memcpy(data, kLnkIndexMagic, 4);
+    Li_Wr32(data + 4, LNK_INDEX_VERSION);
+    Li_Wr32(data + 8, index->count);
+    for (i = 0, p = data + LNK_INDEX_HEADER_SIZE; i < index->count; ++i)
+    {
+        const LNK_INDEX_ENTRY* entry = &index->entries[i];
+        Li_Wr32(p, entry->size);
+        Li_Wr32(p + 4, entry->lastWrite.dwLowDateTime);
+        Li_Wr32(p + 8, entry->lastWrite.dwHighDateTime);
+        Li_Wr32(p + 12, (DWORD)entry->iconIndex);
+        Li_Wr32(p + 16, entry->parsed ? 1 : 0);
+        p += LNK_INDEX_ENTRY_FIXED_SIZE;
+        for (field = 0; field < LNK_INDEX_FIELD_COUNT; ++field)
+        {
+            text = LnkIndex_Get(index, i, field);
+            cch = Str_Length(text);
+            Li_Wr32(p, cch);
+            p += 4;
+            for (j = 0; j < cch; ++j, p += 2)
+            {
+                p[0] = (BYTE)text[j];
+                p[1] = (BYTE)(text[j] >> 8);
+            }
+        }
+    }
+    Li_Wr32(data + 12, Li_Checksum(data + LNK_INDEX_HEADER_SIZE, size - LNK_INDEX_HEADER_SIZE));
+
+    status = File_WriteAll(path, data, size);
+    Mem_Free(data);
+    return status;
+}
+
+extern "C" BOOL LnkIndex_FindByTargetDir(const LNK_INDEX* index, const WCHAR* dir, STR_LIST* paths)
+{
+    const WCHAR* target;
+    DWORD i;
+
+    for (i = 0; i < index->count; ++i)
+    {
+        target = LnkIndex_Get(index, i, LNK_INDEX_TARGET);
+        if (target[0] && Li_IsUnder(target, dir))
+        {
+            if (!StrList_Add(paths, LnkIndex_Get(index, i, LNK_INDEX_PATH),
+                Str_Length(LnkIndex_Get(index, i, LNK_INDEX_PATH))))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+extern "C" BOOL LnkIndex_FindByAppId(const LNK_INDEX* index, const WCHAR* appId, STR_LIST* paths)
+{
+    const WCHAR* value;
+    DWORD i, j;
+
+    for (i = 0; i < index->count; ++i)
+    {
+        value = LnkIndex_Get(index, i, LNK_INDEX_APP_ID);
+        for (j = 0; value[j] && value[j] == appId[j]; ++j)
+            ;
+        if (value[0] && value[j] == appId[j])
+        {
+            if (!StrList_Add(paths, LnkIndex_Get(index, i, LNK_INDEX_PATH),
+                Str_Length(LnkIndex_Get(index, i, LNK_INDEX_PATH))))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
@@ -0,0 +1,94 @@
+// lnkindex.h: what the shortcuts under a folder point at (target, arguments,
+// icon, AppUserModelID), kept in a file between installer runs. A refresh
+// lists the folder and parses only the .lnk files whose size or last-write
+// time changed since, with the COM-free reader of lnkfile.h; questions like
+// "which shortcuts start something under C:\Program Files\App" are then
+// answered from the index.
+#ifndef MUICACHE_LNKINDEX_H_
+#define MUICACHE_LNKINDEX_H_
+
+#include "platform.h"
+#include "dirlist.h"
+#include "strlist.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// File layout, little-endian:
+//   "MCLI", version, entry count, FNV-1a of the entry bytes,
+//   then per entry: size, last write (low, high), icon index, parsed,
+//   and each LNK_INDEX_FIELD as a char count followed by UTF-16 chars.
+#define LNK_INDEX_VERSION 1
+#define LNK_INDEX_HEADER_SIZE 16
+
+// Strings kept per shortcut, in file order.
+enum LNK_INDEX_FIELD
+{
+    LNK_INDEX_PATH = 0,  // of the .lnk file itself
+    LNK_INDEX_TARGET,    // LinkInfo local path, "" when the link has none
+    LNK_INDEX_ARGUMENTS,
+    LNK_INDEX_ICON,
+    LNK_INDEX_APP_ID,    // System.AppUserModel.ID
+    LNK_INDEX_FIELD_COUNT
+};
+
+typedef struct _LNK_INDEX_ENTRY {
+    DWORD pathHash;
+    DWORD size;
+    FILETIME lastWrite;
+    LONG iconIndex;
+    BOOL parsed; // FALSE for a file that isn't a valid shortcut: no strings
+} LNK_INDEX_ENTRY;
+
+typedef struct _LNK_INDEX {
+    LNK_INDEX_ENTRY* entries;
+    DWORD count;
+    DWORD capacity;
+    STR_LIST strings; // LNK_INDEX_FIELD_COUNT per entry, in entry order
+    BOOL dirty;       // changed since loaded
+} LNK_INDEX;
+
+// LnkIndex_Refresh flag: take in subfolders too.
+#define LNK_INDEX_RECURSE 0x1
+
+typedef struct _LNK_INDEX_STATS {
+    DWORD listed;  // shortcuts found
+    DWORD reused;  // unchanged, taken from the index
+    DWORD parsed;  // new or changed, read again
+    DWORD removed; // gone from the folder
+} LNK_INDEX_STATS;
+
+void LnkIndex_Init(LNK_INDEX* index);
+void LnkIndex_Free(LNK_INDEX* index);
+
+// Replaces |index| with the one in |path|. A missing file leaves it empty
+// and succeeds; an unknown version or a damaged file leaves it empty and
+// returns ERROR_INVALID_DATA: the next refresh parses everything again.
+LSTATUS LnkIndex_Load(LNK_INDEX* index, const WCHAR* path);
+LSTATUS LnkIndex_Save(const LNK_INDEX* index, const WCHAR* path);
+
+// Brings the entries under |dir| up to date with the .lnk files |lister|
+// finds there; entries of other folders are kept as they are. A file that
+// vanishes between the listing and its read is left out. |stats| is
+// optional.
+LSTATUS LnkIndex_Refresh(LNK_INDEX* index, DIR_LISTER* lister, const WCHAR* dir, DWORD flags,
+    LNK_INDEX_STATS* stats);
+
+// Field |field| of entry |i|. Invalidated by the next refresh or load.
+static __inline const WCHAR* LnkIndex_Get(const LNK_INDEX* index, DWORD i, DWORD field)
+{
+    return StrList_Get(&index->strings, i * LNK_INDEX_FIELD_COUNT + field);
+}
+
+// Adds to |paths| every shortcut whose target is |dir| or lies below it,
+// comparing ASCII letters case-insensitively as Windows paths do.
+BOOL LnkIndex_FindByTargetDir(const LNK_INDEX* index, const WCHAR* dir, STR_LIST* paths);
+// Adds to |paths| every shortcut whose AppUserModelID is exactly |appId|.
+BOOL LnkIndex_FindByAppId(const LNK_INDEX* index, const WCHAR* appId, STR_LIST* paths);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_LNKINDEX_H_
@@ -0,0 +1,103 @@
+#include "lnkprops.h"
+
+#define LNK_PROP_KNOWN (LNK_PROP_TARGET | LNK_PROP_WORKING_DIR | LNK_PROP_ARGUMENTS | LNK_PROP_DESCRIPTION | \
+    LNK_PROP_ICON | LNK_PROP_APP_ID | LNK_PROP_DUAL_MODE | LNK_PROP_TOAST_ACTIVATOR_CLSID)
+
+static const WCHAR kEmpty[] = { 0 };
+
+static __inline WCHAR LnkProps_Lower(WCHAR ch)
+{
+    return ch >= 'A' && ch <= 'Z' ? (WCHAR)(ch | 0x20) : ch;
+}
+
+// Char |i| of |text|; code-page text only answers for ASCII, anything
+// else reads as 0xFFFF, which no value passed in matches.
+static WCHAR LnkProps_CharAt(const LNK_FILE* lnk, const LNK_TEXT* text, DWORD i)
+{
+    const BYTE* p = lnk->data + text->offset;
+    if (text->unicode)
+        return (WCHAR)(p[i * 2] | (p[i * 2 + 1] << 8));
+    return p[i] < 0x80 ? (WCHAR)p[i] : (WCHAR)0xFFFF;
+}
+
+// TRUE when the |count| texts of |lnk|, joined, spell |value|.
+static BOOL LnkProps_Equals(const LNK_FILE* lnk, const LNK_TEXT* texts, DWORD count, const WCHAR* value,
+    BOOL ignoreCase)
+{
+    DWORD t, i;
+    WCHAR ch;
+
+    if (!value)
+        value = kEmpty;
+    for (t = 0; t < count; ++t)
+    {
+        if (!texts[t].offset)
+            continue;
+        for (i = 0; i < texts[t].cch; ++i, ++value)
+        {
+            ch = LnkProps_CharAt(lnk, &texts[t], i);
+            if (!*value || (ignoreCase ? LnkProps_Lower(ch) != LnkProps_Lower(*value) : ch != *value))
+                return FALSE;
+        }
+    }
+    return !*value;
+}
+
+extern "C" DWORD Lnk_ChangedProperties(const LNK_FILE* lnk, const LNK_PROPERTIES* properties)
+{
+    DWORD options = properties->options;
+    DWORD changed = options & ~LNK_PROP_KNOWN;
+    LNK_TEXT path[2];
+    LNK_TEXT appId;
+    LNK_FMTID clsid;
+    BOOL dualMode;
+    DWORD i;
+
+    if (options & LNK_PROP_TARGET)
+    {
+        // SetPath stores the target in LinkInfo (and the ID list, which
+        // follows from it).
+        path[0] = lnk->localBasePath;
+        path[1] = lnk->commonPathSuffix;
+        if (!lnk->localBasePath.offset || (lnk->linkFlags & LNK_HAS_EXP_STRING) ||
+            !LnkProps_Equals(lnk, path, 2, properties->target, TRUE))
+            changed |= LNK_PROP_TARGET;
+    }
+    if ((options & LNK_PROP_WORKING_DIR) &&
+        !LnkProps_Equals(lnk, &lnk->strings[LNK_WORKING_DIR], 1, properties->workingDir, TRUE))
+        changed |= LNK_PROP_WORKING_DIR;
+    if ((options & LNK_PROP_ARGUMENTS) &&
+        !LnkProps_Equals(lnk, &lnk->strings[LNK_COMMAND_LINE_ARGUMENTS], 1, properties->arguments, FALSE))
+        changed |= LNK_PROP_ARGUMENTS;
+    if ((options & LNK_PROP_DESCRIPTION) &&
+        !LnkProps_Equals(lnk, &lnk->strings[LNK_NAME_STRING], 1, properties->description, FALSE))
+        changed |= LNK_PROP_DESCRIPTION;
+    if ((options & LNK_PROP_ICON) && ((lnk->linkFlags & LNK_HAS_EXP_ICON) || lnk->iconIndex != properties->iconIndex ||
+        !LnkProps_Equals(lnk, &lnk->strings[LNK_ICON_LOCATION], 1, properties->icon, TRUE)))
+        changed |= LNK_PROP_ICON;
+    if (options & LNK_PROP_APP_ID)
+    {
+        // An empty id and no id both leave the shortcut without one.
+        if (!Lnk_FindStringProperty(lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, &appId))
+            appId.offset = 0;
+        if (!LnkProps_Equals(lnk, &appId, 1, properties->appId, FALSE))
+            changed |= LNK_PROP_APP_ID;
+    }
+    if (options & LNK_PROP_DUAL_MODE)
+    {
+        if (!Lnk_FindBoolProperty(lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_IsDualMode, &dualMode))
+            dualMode = FALSE;
+        if (!dualMode != !properties->dualMode)
+            changed |= LNK_PROP_DUAL_MODE;
+    }
+    if (options & LNK_PROP_TOAST_ACTIVATOR_CLSID)
+    {
+        if (!Lnk_FindGuidProperty(lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ToastActivatorCLSID, &clsid))
+            memset(&clsid, 0, sizeof(clsid));
+        for (i = 0; i < 16 && clsid.bytes[i] == properties->toastActivatorClsid.bytes[i]; ++i)
+            ;
+        if (i < 16)
+            changed |= LNK_PROP_TOAST_ACTIVATOR_CLSID;
+    }
+    return changed;
+}
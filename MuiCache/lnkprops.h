@@ -0,0 +1,53 @@
+// lnkprops.h: what a shortcut update would change. The properties to set
+// are compared against a shortcut parsed with lnkfile.h, so a repair install
+// that finds every value already in place can leave the file (and Explorer's
+// caches) alone.
+#ifndef MUICACHE_LNKPROPS_H_
+#define MUICACHE_LNKPROPS_H_
+
+#include "platform.h"
+#include "lnkfile.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// LNK_PROPERTIES options, the bits of ShortcutProperties::options.
+#define LNK_PROP_TARGET      0x0001
+#define LNK_PROP_WORKING_DIR 0x0002
+#define LNK_PROP_ARGUMENTS   0x0004
+#define LNK_PROP_DESCRIPTION 0x0008
+#define LNK_PROP_ICON        0x0010
+#define LNK_PROP_APP_ID      0x0020
+#define LNK_PROP_DUAL_MODE   0x0040
+#define LNK_PROP_TOAST_ACTIVATOR_CLSID 0x0080
+
+// Values to set; only the fields selected by |options| are read. NULL
+// strings stand for "".
+typedef struct _LNK_PROPERTIES {
+    DWORD options;
+    const WCHAR* target;
+    const WCHAR* workingDir;
+    const WCHAR* arguments;
+    const WCHAR* description;
+    const WCHAR* icon;
+    int iconIndex;
+    const WCHAR* appId;
+    BOOL dualMode;
+    LNK_FMTID toastActivatorClsid;
+} LNK_PROPERTIES;
+
+// The bits of |properties->options| whose value |lnk| doesn't already hold,
+// 0 when saving would change nothing. Paths compare ASCII letters
+// case-insensitively, other strings exactly; an empty string, FALSE and
+// the null CLSID match a property that isn't there. A value the file can't
+// answer for (a target or icon kept as an environment string, code-page
+// text outside ASCII, an option this reader doesn't know) counts as
+// changed, so the shortcut gets written.
+DWORD Lnk_ChangedProperties(const LNK_FILE* lnk, const LNK_PROPERTIES* properties);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_LNKPROPS_H_
@@ -0,0 +1,356 @@
+// Pattern matching over UTF-16 value names, in one of three modes:
+//  - up to MATCHER_SCAN_MAX_PATTERNS patterns: one vectorized scan per
+//    pattern, which for the usual one or two image names beats walking an
+//    automaton a char at a time;
+//  - more patterns: an Aho-Corasick automaton, one pass for all of them;
+//  - MATCHER_PATH_SUFFIX: no scan at all, each pattern is compared against
+//    the end of the name once the property suffix is stripped.
+// Patterns are folded once here when ignoring case; the text is folded as
+// it is read.
+//
+// Automaton transitions are kept as per-node sibling lists, which keeps the automaton
+// at O(total pattern length) memory for the full 16-bit alphabet. The root
+// additionally gets a dense table for the ASCII range, since it is visited
+// after every mismatch and value names are overwhelmingly ASCII paths.
+#include "matcher.h"
+
+#include "simdscan.h"
+
+#define MATCHER_NONE ((DWORD)-1)
+#define MATCHER_ROOT 0
+
+#define MATCHER_SCAN_MAX_PATTERNS 4
+
+#define MATCHER_MODE_SCAN      0
+#define MATCHER_MODE_AUTOMATON 1
+#define MATCHER_MODE_SUFFIX    2
+
+struct MATCHER_PATTERN
+{
+    const WCHAR* chars; // folded when ignoring case
+    DWORD cch;
+};
+
+struct MATCHER_EDGE
+{
+    WCHAR ch;
+    DWORD target;
+    DWORD next; // next sibling edge of the same node
+};
+
+struct MATCHER_NODE
+{
+    DWORD edges; // first outgoing edge, MATCHER_NONE if leaf
+    DWORD fail;
+    BOOL output; // a pattern ends here or on the failure chain
+};
+
+struct _MATCHER
+{
+    DWORD flags;
+    DWORD mode;
+    DWORD hash;
+    MATCHER_PATTERN* patterns; // scan and suffix modes; owns the chars too
+    DWORD patternCount;
+    MATCHER_NODE* nodes; // automaton mode
+    DWORD nodeCount;
+    MATCHER_EDGE* edges;
+    DWORD edgeCount;
+    DWORD rootAscii[128]; // 0 (the root itself) when there is no edge
+};
+
+static DWORD Matcher_Goto(const MATCHER* m, DWORD state, WCHAR ch)
+{
+    DWORD e;
+    if (state == MATCHER_ROOT && ch < 128)
+        return m->rootAscii[ch] ? m->rootAscii[ch] : MATCHER_NONE;
+    for (e = m->nodes[state].edges; e != MATCHER_NONE; e = m->edges[e].next)
+    {
+        if (m->edges[e].ch == ch)
+            return m->edges[e].target;
+    }
+    return MATCHER_NONE;
+}
+
+static DWORD Matcher_NewNode(MATCHER* m)
+{
+    DWORD n = m->nodeCount++;
+    m->nodes[n].edges = MATCHER_NONE;
+    m->nodes[n].fail = MATCHER_ROOT;
+    m->nodes[n].output = FALSE;
+    return n;
+}
+
+static void Matcher_Insert(MATCHER* m, const WCHAR* pattern)
+{
+    DWORD state = MATCHER_ROOT;
+    DWORD next, e;
+    WCHAR ch;
+    for (; *pattern; ++pattern)
+    {
+        ch = (m->flags & MATCHER_IGNORE_CASE) ? SimdScan_FoldChar(*pattern) : *pattern;
+        next = Matcher_Goto(m, state, ch);
+        if (next == MATCHER_NONE)
+        {
+            next = Matcher_NewNode(m);
+            e = m->edgeCount++;
+            m->edges[e].ch = ch;
+            m->edges[e].target = next;
+            m->edges[e].next = m->nodes[state].edges;
+            m->nodes[state].edges = e;
+            if (state == MATCHER_ROOT && ch < 128)
+                m->rootAscii[ch] = next;
+        }
+        state = next;
+    }
+    m->nodes[state].output = TRUE;
+}
+
+// Breadth-first pass computing failure links; a node inherits the output
+// flag of its failure target so the search loop never walks the chain.
+static BOOL Matcher_Link(MATCHER* m)
+{
+    DWORD* queue;
+    DWORD head = 0, tail = 0;
+    DWORD u, v, e, f, t;
+
+    queue = (DWORD*)Mem_Alloc(m->nodeCount * sizeof(DWORD));
+    if (!queue)
+        return FALSE;
+
+    for (e = m->nodes[MATCHER_ROOT].edges; e != MATCHER_NONE; e = m->edges[e].next)
+        queue[tail++] = m->edges[e].target;
+
+    while (head < tail)
+    {
+        u = queue[head++];
+        for (e = m->nodes[u].edges; e != MATCHER_NONE; e = m->edges[e].next)
+        {
+            v = m->edges[e].target;
+            f = m->nodes[u].fail;
+            while ((t = Matcher_Goto(m, f, m->edges[e].ch)) == MATCHER_NONE && f != MATCHER_ROOT)
+                f = m->nodes[f].fail;
+            m->nodes[v].fail = t != MATCHER_NONE ? t : MATCHER_ROOT;
+            if (m->nodes[m->nodes[v].fail].output)
+                m->nodes[v].output = TRUE;
+            queue[tail++] = v;
+        }
+    }
+
+    Mem_Free(queue);
+    return TRUE;
+}
+
+// Copies the non-empty patterns, folded if asked, into one block.
+static BOOL Matcher_CopyPatterns(MATCHER* m, const WCHAR** patterns, DWORD count, DWORD total)
+{
+    WCHAR* chars;
+    DWORD i, j, cch;
+
+    // One spare char so that nothing asks for 0 bytes.
+    m->patterns = (MATCHER_PATTERN*)Mem_Alloc(count * sizeof(MATCHER_PATTERN) + (total + 1) * sizeof(WCHAR));
+    if (!m->patterns)
+        return FALSE;
+    chars = (WCHAR*)(m->patterns + count);
+    for (i = 0; i < count; ++i)
+    {
+        cch = Str_Length(patterns[i]);
+        if (!cch)
+            continue;
+        for (j = 0; j < cch; ++j)
+            chars[j] = (m->flags & MATCHER_IGNORE_CASE) ? SimdScan_FoldChar(patterns[i][j]) : patterns[i][j];
+        m->patterns[m->patternCount].chars = chars;
+        m->patterns[m->patternCount].cch = cch;
+        ++m->patternCount;
+        chars += cch;
+    }
+    return TRUE;
+}
+
+// FNV-1a over the pattern's UTF-16 code units, folded like the matcher.
+static DWORD Matcher_HashPattern(const WCHAR* pattern, DWORD flags)
+{
+    DWORD hash = 2166136261u;
+    WCHAR ch;
+    for (; *pattern; ++pattern)
+    {
+        ch = (flags & MATCHER_IGNORE_CASE) ? SimdScan_FoldChar(*pattern) : *pattern;
+        hash = (hash ^ (ch & 0xFF)) * 16777619u;
+        hash = (hash ^ (ch >> 8)) * 16777619u;
+    }
+    return hash;
+}
+
+MATCHER* Matcher_Create(const WCHAR** patterns, DWORD count)
+{
+    return Matcher_CreateEx(patterns, count, 0);
+}
+
+MATCHER* Matcher_CreateEx(const WCHAR** patterns, DWORD count, DWORD flags)
+{
+    MATCHER* m;
+    DWORD i, total = 0, nonEmpty = 0;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (patterns[i][0])
+        {
+            total += Str_Length(patterns[i]);
+            ++nonEmpty;
+        }
+    }
+
+    m = (MATCHER*)Mem_Alloc(sizeof(MATCHER));
+    if (!m)
+        return NULL;
+    memset(m, 0, sizeof(MATCHER));
+    m->flags = flags;
+    // Summing keeps the hash independent of the order patterns came in.
+    m->hash = flags * 16777619u;
+    for (i = 0; i < count; ++i)
+    {
+        if (patterns[i][0])
+            m->hash += Matcher_HashPattern(patterns[i], flags);
+    }
+
+    if ((flags & MATCHER_PATH_SUFFIX) || nonEmpty <= MATCHER_SCAN_MAX_PATTERNS)
+    {
+        m->mode = (flags & MATCHER_PATH_SUFFIX) ? MATCHER_MODE_SUFFIX : MATCHER_MODE_SCAN;
+        if (!Matcher_CopyPatterns(m, patterns, count, total))
+        {
+            Matcher_Destroy(m);
+            return NULL;
+        }
+        return m;
+    }
+
+    // Every pattern char adds at most one node and one edge.
+    m->mode = MATCHER_MODE_AUTOMATON;
+    m->nodes = (MATCHER_NODE*)Mem_Alloc((total + 1) * sizeof(MATCHER_NODE));
+    m->edges = (MATCHER_EDGE*)Mem_Alloc((total + 1) * sizeof(MATCHER_EDGE));
+    if (!m->nodes || !m->edges)
+    {
+        Matcher_Destroy(m);
+        return NULL;
+    }
+
+    Matcher_NewNode(m);
+    for (i = 0; i < count; ++i)
+    {
+        if (patterns[i][0])
+            Matcher_Insert(m, patterns[i]);
+    }
+
+    if (!Matcher_Link(m))
+    {
+        Matcher_Destroy(m);
+        return NULL;
+    }
+    return m;
+}
+
+DWORD Matcher_Hash(const MATCHER* matcher)
+{
+    return matcher->hash;
+}
+
+void Matcher_Destroy(MATCHER* matcher)
+{
+    if (!matcher)
+        return;
+    Mem_Free(matcher->patterns);
+    Mem_Free(matcher->nodes);
+    Mem_Free(matcher->edges);
+    Mem_Free(matcher);
+}
+
+static const WCHAR kFriendlyAppName[] = {
+    '.', 'F', 'r', 'i', 'e', 'n', 'd', 'l', 'y', 'A', 'p', 'p', 'N', 'a', 'm', 'e', 0 };
+static const WCHAR kApplicationCompany[] = {
+    '.', 'A', 'p', 'p', 'l', 'i', 'c', 'a', 't', 'i', 'o', 'n', 'C', 'o', 'm', 'p', 'a', 'n', 'y', 0 };
+
+static BOOL Matcher_EndsWithSuffix(const WCHAR* text, DWORD cch, const WCHAR* suffix, DWORD cchSuffix)
+{
+    DWORD i;
+    if (cch < cchSuffix)
+        return FALSE;
+    text += cch - cchSuffix;
+    for (i = 0; i < cchSuffix; ++i)
+    {
+        if (SimdScan_FoldChar(text[i]) != SimdScan_FoldChar(suffix[i]))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// Does the path in |text| (property suffix already stripped) end with the
+// component(s) in |pattern|?
+static BOOL Matcher_EndsPath(const MATCHER* m, const MATCHER_PATTERN* pattern, const WCHAR* text, DWORD cch)
+{
+    DWORD start, i;
+    if (pattern->cch > cch)
+        return FALSE;
+    start = cch - pattern->cch;
+    if (start && text[start - 1] != '\\' && pattern->chars[0] != '\\')
+        return FALSE;
+    for (i = 0; i < pattern->cch; ++i)
+    {
+        WCHAR ch = (m->flags & MATCHER_IGNORE_CASE) ? SimdScan_FoldChar(text[start + i]) : text[start + i];
+        if (ch != pattern->chars[i])
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL Matcher_ContainsSuffix(const MATCHER* m, const WCHAR* text, DWORD cch)
+{
+    const DWORD cchFriendly = sizeof(kFriendlyAppName) / sizeof(WCHAR) - 1;
+    const DWORD cchCompany = sizeof(kApplicationCompany) / sizeof(WCHAR) - 1;
+    DWORD i;
+
+    if (Matcher_EndsWithSuffix(text, cch, kFriendlyAppName, cchFriendly))
+        cch -= cchFriendly;
+    else if (Matcher_EndsWithSuffix(text, cch, kApplicationCompany, cchCompany))
+        cch -= cchCompany;
+    for (i = 0; i < m->patternCount; ++i)
+    {
+        if (Matcher_EndsPath(m, &m->patterns[i], text, cch))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+BOOL Matcher_Contains(const MATCHER* matcher, const WCHAR* text, DWORD cch)
+{
+    const MATCHER_NODE* nodes = matcher->nodes;
+    BOOL foldCase = (matcher->flags & MATCHER_IGNORE_CASE) != 0;
+    DWORD state = MATCHER_ROOT;
+    DWORD next, i;
+    WCHAR ch;
+
+    if (matcher->mode == MATCHER_MODE_SUFFIX)
+        return Matcher_ContainsSuffix(matcher, text, cch);
+    if (matcher->mode == MATCHER_MODE_SCAN)
+    {
+        for (i = 0; i < matcher->patternCount; ++i)
+        {
+            if (SimdScan_Contains(text, cch, matcher->patterns[i].chars, matcher->patterns[i].cch, foldCase))
+                return TRUE;
+        }
+        return FALSE;
+    }
+
+    if (matcher->nodeCount <= 1)
+        return FALSE;
+
+    for (i = 0; i < cch; ++i)
+    {
+        ch = foldCase ? SimdScan_FoldChar(text[i]) : text[i];
+        while ((next = Matcher_Goto(matcher, state, ch)) == MATCHER_NONE && state != MATCHER_ROOT)
+            state = nodes[state].fail;
+        state = next != MATCHER_NONE ? next : MATCHER_ROOT;
+        if (nodes[state].output)
+            return TRUE;
+    }
+    return FALSE;
+}
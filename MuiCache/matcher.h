@@ -0,0 +1,45 @@
+// matcher.h: multi-pattern matcher over UTF-16 value names. A handful of
+// image names are each searched with the vectorized scanner (simdscan.h);
+// beyond that an Aho-Corasick automaton answers "does the name contain any
+// of them" in one pass, independent of how many image names were given.
+#ifndef MUICACHE_MATCHER_H_
+#define MUICACHE_MATCHER_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _MATCHER MATCHER;
+
+// Matcher_CreateEx flags.
+// Compare ASCII letters case-insensitively; other chars must match exactly.
+#define MATCHER_IGNORE_CASE 0x0001
+// Match a pattern only as the trailing path component of a MuiCache name:
+// "...\app.exe.FriendlyAppName", "...\app.exe.ApplicationCompany", or a
+// name ending in "\app.exe" as written before Windows 8. "app.exe" then no
+// longer matches "myapp.exe" or "app.exe.bak".
+#define MATCHER_PATH_SUFFIX 0x0002
+
+// Builds a matcher for |count| NUL-terminated |patterns|. Matching is
+// case-sensitive, like StrStrW. Empty patterns are ignored rather than
+// matching everything. Returns NULL when out of memory.
+MATCHER* Matcher_Create(const WCHAR** patterns, DWORD count);
+// Same, with MATCHER_* |flags|.
+MATCHER* Matcher_CreateEx(const WCHAR** patterns, DWORD count, DWORD flags);
+void Matcher_Destroy(MATCHER* matcher);
+
+// Returns TRUE if any pattern occurs in the first |cch| chars of |text|
+// (or, with MATCHER_PATH_SUFFIX, ends its path as described above).
+BOOL Matcher_Contains(const MATCHER* matcher, const WCHAR* text, DWORD cch);
+
+// A hash of the pattern set and flags that ignores pattern order, so two
+// matchers built from the same image names agree on it across runs.
+DWORD Matcher_Hash(const MATCHER* matcher);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_MATCHER_H_
@@ -0,0 +1,165 @@
+// Matcher cache behind matchercache.h.
+// Lookups compare a hash first and the full key only on a hash match, so a
+// collision costs a miss, never a wrong matcher. The key keeps the order the
+// patterns came in: Matcher_Hash ignores order, but comparing in order needs
+// no sorting and installers pass their lists the same way each time.
+#include "matchercache.h"
+
+// FNV-1a over pairs of chars, one multiply per pair: every Acquire hashes
+// the whole list, and with a few dozen full paths a byte-at-a-time chain
+// of multiplies costs more than the lookup saves. 32-bit words keep the
+// x86 build free of the CRT's 64-bit multiply helper. Each pattern's length
+// goes in too, so moving chars across a pattern boundary changes the hash.
+static DWORD MatcherCache_Hash(const WCHAR** patterns, DWORD count, DWORD flags)
+{
+    DWORD hash = 2166136261u, i, cch, j;
+
+    for (i = 0; i < count; ++i)
+    {
+        cch = Str_Length(patterns[i]);
+        for (j = 0; j + 2 <= cch; j += 2)
+            hash = (hash ^ (patterns[i][j] | (DWORD)patterns[i][j + 1] << 16)) * 16777619u;
+        hash = (hash ^ (j < cch ? patterns[i][j] : 0) ^ cch << 16) * 16777619u;
+    }
+    return (hash ^ count ^ (flags << 16)) * 16777619u;
+}
+
+static BOOL MatcherCache_KeyEquals(const MATCHER_CACHE_ENTRY* entry, const WCHAR** patterns, DWORD count,
+    DWORD flags)
+{
+    const WCHAR* key = entry->key;
+    const WCHAR* p;
+    DWORD i;
+
+    if (entry->count != count || entry->flags != flags)
+        return FALSE;
+    for (i = 0; i < count; ++i)
+    {
+        for (p = patterns[i]; *p == *key; ++p, ++key)
+        {
+            if (!*p)
+                break;
+        }
+        if (*p != *key)
+            return FALSE;
+        ++key;
+    }
+    return TRUE;
+}
+
+static void MatcherCache_Evict(MATCHER_CACHE_ENTRY* entry)
+{
+    Matcher_Destroy(entry->matcher);
+    Mem_Free(entry->key);
+    memset(entry, 0, sizeof(MATCHER_CACHE_ENTRY));
+}
+
+// A free slot, else the least recently used idle one (emptied), else NULL.
+static MATCHER_CACHE_ENTRY* MatcherCache_Slot(MATCHER_CACHE* cache)
+{
+    MATCHER_CACHE_ENTRY* oldest = NULL;
+    DWORD i;
+
+    for (i = 0; i < MATCHER_CACHE_SIZE; ++i)
+    {
+        MATCHER_CACHE_ENTRY* entry = &cache->entries[i];
+        if (!entry->matcher)
+            return entry;
+        if (!entry->refs && (!oldest || cache->clock - entry->lastUse > cache->clock - oldest->lastUse))
+            oldest = entry;
+    }
+    if (oldest)
+    {
+        MatcherCache_Evict(oldest);
+        ++cache->evictions;
+    }
+    return oldest;
+}
+
+static BOOL MatcherCache_Insert(MATCHER_CACHE* cache, MATCHER* matcher, const WCHAR** patterns, DWORD count,
+    DWORD flags, DWORD hash)
+{
+    MATCHER_CACHE_ENTRY* entry;
+    DWORD cch = 0, i, length;
+
+    for (i = 0; i < count; ++i)
+        cch += Str_Length(patterns[i]) + 1;
+    entry = MatcherCache_Slot(cache);
+    if (!entry)
+        return FALSE;
+    entry->key = (WCHAR*)Mem_Alloc(((SIZE_T)cch + 1) * sizeof(WCHAR));
+    if (!entry->key)
+        return FALSE;
+
+    for (i = 0, cch = 0; i < count; ++i)
+    {
+        length = Str_Length(patterns[i]) + 1;
+        memcpy(entry->key + cch, patterns[i], length * sizeof(WCHAR));
+        cch += length;
+    }
+    entry->matcher = matcher;
+    entry->count = count;
+    entry->flags = flags;
+    entry->hash = hash;
+    entry->refs = 1;
+    entry->lastUse = cache->clock;
+    return TRUE;
+}
+
+extern "C" MATCHER* MatcherCache_Acquire(MATCHER_CACHE* cache, const WCHAR** patterns, DWORD count, DWORD flags)
+{
+    MATCHER* matcher;
+    DWORD hash, i;
+
+    if (!cache)
+        return Matcher_CreateEx(patterns, count, flags);
+
+    hash = MatcherCache_Hash(patterns, count, flags);
+    ++cache->clock;
+    for (i = 0; i < MATCHER_CACHE_SIZE; ++i)
+    {
+        MATCHER_CACHE_ENTRY* entry = &cache->entries[i];
+        if (entry->matcher && entry->hash == hash && MatcherCache_KeyEquals(entry, patterns, count, flags))
+        {
+            ++entry->refs;
+            entry->lastUse = cache->clock;
+            ++cache->hits;
+            return entry->matcher;
+        }
+    }
+
+    ++cache->misses;
+    matcher = Matcher_CreateEx(patterns, count, flags);
+    if (matcher)
+        MatcherCache_Insert(cache, matcher, patterns, count, flags, hash); // else used once, uncached
+    return matcher;
+}
+
+extern "C" void MatcherCache_Release(MATCHER_CACHE* cache, MATCHER* matcher)
+{
+    DWORD i;
+
+    if (!matcher)
+        return;
+    for (i = 0; cache && i < MATCHER_CACHE_SIZE; ++i)
+    {
+        if (cache->entries[i].matcher == matcher)
+        {
+            --cache->entries[i].refs;
+            return;
+        }
+    }
+    Matcher_Destroy(matcher);
+}
+
+extern "C" void MatcherCache_Free(MATCHER_CACHE* cache)
+{
+    DWORD i;
+
+    for (i = 0; i < MATCHER_CACHE_SIZE; ++i)
+    {
+        if (cache->entries[i].matcher)
+            MatcherCache_Evict(&cache->entries[i]);
+    }
+    memset(cache, 0, sizeof(MATCHER_CACHE));
+}
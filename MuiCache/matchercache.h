@@ -0,0 +1,52 @@
+// matchercache.h: built matchers kept for reuse, so an installer that clears
+// the same image names from several sections (or Clear then ClearChanged)
+// builds the automaton once. A small table keyed by the exact pattern list
+// and flags; the least recently used idle entry makes room for a new one.
+#ifndef MUICACHE_MATCHERCACHE_H_
+#define MUICACHE_MATCHERCACHE_H_
+
+#include "platform.h"
+#include "matcher.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define MATCHER_CACHE_SIZE 16
+
+typedef struct _MATCHER_CACHE_ENTRY {
+    MATCHER* matcher; // NULL for a free slot
+    WCHAR* key;       // the patterns, each NUL-terminated, back to back
+    DWORD count;
+    DWORD flags;
+    DWORD hash;       // of key, count and flags
+    DWORD refs;       // Acquire calls not yet released
+    DWORD lastUse;
+} MATCHER_CACHE_ENTRY;
+
+// Zero-initialized is empty. Not thread-safe: the plugin only touches it
+// from the installer thread (background jobs own their matchers).
+typedef struct _MATCHER_CACHE {
+    MATCHER_CACHE_ENTRY entries[MATCHER_CACHE_SIZE];
+    DWORD clock;
+    DWORD hits;
+    DWORD misses;
+    DWORD evictions;
+} MATCHER_CACHE;
+
+// Matcher_CreateEx(|patterns|, |count|, |flags|), or the one built for the
+// same arguments earlier. With every slot in use the matcher is built
+// uncached; a NULL |cache| always builds one. NULL when out of memory.
+MATCHER* MatcherCache_Acquire(MATCHER_CACHE* cache, const WCHAR** patterns, DWORD count, DWORD flags);
+// Gives back a matcher from MatcherCache_Acquire: a cached one stays for the
+// next caller, any other is destroyed. |cache| may be NULL.
+void MatcherCache_Release(MATCHER_CACHE* cache, MATCHER* matcher);
+// Destroys every entry and resets the counters; no matcher may still be
+// acquired.
+void MatcherCache_Free(MATCHER_CACHE* cache);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_MATCHERCACHE_H_
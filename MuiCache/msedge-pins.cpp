@@ -33,6 +33,8 @@ references:
 #include <Windows.h>
 #include <objbase.h>
 #include <shlobj.h>
+#include "pinsession.h"
+#include "trace.h"
 
 const GUID CLSID_TaskbandPin = { 0x90aa3a4e, 0x1cba, 0x4233, {0xb8, 0xbb, 0x53, 0x57, 0x73, 0xd4, 0x84, 0x49} };
 const GUID IID_IPinnedList3 = { 0x0dd79ae2, 0xd156, 0x45d4, {0x9e, 0xeb, 0x3b, 0x54, 0x97, 0x69, 0xe9, 0x40} };
@@ -68,34 +70,101 @@ struct IPinnedList3Vtbl {
     void* MethodSlot16;
     ModifyFuncPtr Modify;
 };
-extern "C" HRESULT TaskbarSetPinState(LPCTSTR pszPath, BOOL pinning)
+struct TaskbandPinContext {
+    BOOL uninitialize;
+    struct IPinnedList3* pinnedList;
+    HRESULT createResult;
+};
+
+static HRESULT TaskbandCreate(TaskbandPinContext* context)
 {
-    HRESULT hr;
-    PIDLIST_ABSOLUTE pidl;
-	struct IPinnedList3* pinnedList;
+    context->pinnedList = NULL;
+    MC_TRACE(TRACE_OP_TASKBAND_CREATE,
+        context->createResult = CoCreateInstance(CLSID_TaskbandPin, NULL, CLSCTX_ALL, IID_IPinnedList3, (LPVOID*)(&context->pinnedList)));
+    return context->createResult;
+}
+
+static void TaskbandRelease(TaskbandPinContext* context)
+{
+    if (context->pinnedList)
+        context->pinnedList->vtbl->Release(context->pinnedList);
+    context->pinnedList = NULL;
+}
 
-    hr = CoInitialize(NULL);
-    if (!SUCCEEDED(hr))
+static HRESULT TaskbandOpen(void* ctx)
+{
+    TaskbandPinContext* context = (TaskbandPinContext*)ctx;
+    HRESULT hr = CoInitialize(NULL);
+    // Already in an MTA: the taskband object works from there too, but the
+    // apartment isn't ours to leave.
+    context->uninitialize = SUCCEEDED(hr);
+    if (FAILED(hr) && hr != RPC_E_CHANGED_MODE)
         return hr;
 
-    do {
-        pidl = NULL;
-        pidl = ILCreateFromPath(pszPath);
-        if (!pidl)
-            break;
+    hr = TaskbandCreate(context);
+    if (FAILED(hr) && context->uninitialize)
+        CoUninitialize();
+    return hr;
+}
+
+static HRESULT TaskbandModify(void* ctx, const WCHAR* path, BOOL pinning)
+{
+    TaskbandPinContext* context = (TaskbandPinContext*)ctx;
+    PIDLIST_ABSOLUTE pidl;
+    HRESULT hr;
+
+    if (!context->pinnedList)
+        return context->createResult;
+    pidl = ILCreateFromPath(path);
+    if (!pidl)
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    MC_TRACE(TRACE_OP_TASKBAND_MODIFY,
+        hr = context->pinnedList->vtbl->Modify(context->pinnedList, pinning ? NULL : pidl, pinning ? pidl : NULL, PLMC_EXPLORER));
+    ILFree(pidl);
+    return hr;
+}
+
+static HRESULT TaskbandReconnect(void* ctx)
+{
+    TaskbandPinContext* context = (TaskbandPinContext*)ctx;
+    TaskbandRelease(context);
+    return TaskbandCreate(context);
+}
+
+static void TaskbandClose(void* ctx)
+{
+    TaskbandPinContext* context = (TaskbandPinContext*)ctx;
+    TaskbandRelease(context);
+    if (context->uninitialize)
+        CoUninitialize();
+}
+
+static const PIN_SESSION_OPS kTaskbandPinOps = {
+    TaskbandOpen,
+    TaskbandModify,
+    TaskbandReconnect,
+    TaskbandClose,
+};
 
-        pinnedList = NULL;
-        hr = CoCreateInstance(CLSID_TaskbandPin, NULL, CLSCTX_ALL, IID_IPinnedList3, (LPVOID*)(&pinnedList));
-        if (!SUCCEEDED(hr))
-            break;
+extern "C" DWORD TaskbarSetPinStates(const PIN_MODIFICATION* mods, DWORD count, HRESULT* results)
+{
+    TaskbandPinContext context;
+    PIN_SESSION session;
+    DWORD ok;
 
-		hr = pinnedList->vtbl->Modify(pinnedList, pinning ? NULL : pidl, pinning ? pidl : NULL, PLMC_EXPLORER);
-        pinnedList->vtbl->Release(pinnedList);
-    } while (0);
+    PinSession_Open(&session, &kTaskbandPinOps, &context);
+    ok = PinSession_Apply(&session, mods, count, results);
+    PinSession_Close(&session);
+    return ok;
+}
 
-    if (pidl)
-        ILFree(pidl);
+extern "C" HRESULT TaskbarSetPinState(LPCTSTR pszPath, BOOL pinning)
+{
+    PIN_MODIFICATION mod;
+    HRESULT hr;
 
-    CoUninitialize();
+    mod.path = pszPath;
+    mod.pinning = pinning;
+    TaskbarSetPinStates(&mod, 1, &hr);
     return hr;
 }
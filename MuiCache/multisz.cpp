@@ -0,0 +1,44 @@
+#include "multisz.h"
+#include "simdscan.h"
+
+extern "C" void MultiSz_Init(MULTI_SZ* ms, const BYTE* data, DWORD cbData)
+{
+    ms->chars = (const WCHAR*)data;
+    ms->cch = cbData / sizeof(WCHAR);
+    ms->pos = 0;
+}
+
+extern "C" BOOL MultiSz_Next(MULTI_SZ* ms, const WCHAR** str, DWORD* cch)
+{
+    DWORD end;
+    while (ms->pos < ms->cch)
+    {
+        end = ms->pos + SimdScan_FindChar(ms->chars + ms->pos, ms->cch - ms->pos, 0);
+        if (end > ms->pos)
+        {
+            *str = ms->chars + ms->pos;
+            *cch = end - ms->pos;
+            ms->pos = end + 1;
+            return TRUE;
+        }
+        ms->pos = end + 1;
+    }
+    return FALSE;
+}
+
+extern "C" BOOL MultiSz_Contains(const MATCHER* matcher, DWORD type, const BYTE* data, DWORD cbData)
+{
+    MULTI_SZ ms;
+    const WCHAR* str;
+    DWORD cch;
+
+    if (type != REG_SZ && type != REG_EXPAND_SZ && type != REG_MULTI_SZ)
+        return FALSE;
+    MultiSz_Init(&ms, data, cbData);
+    while (MultiSz_Next(&ms, &str, &cch))
+    {
+        if (Matcher_Contains(matcher, str, cch))
+            return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,36 @@
+// multisz.h: zero-copy walk over string value data (REG_SZ, REG_EXPAND_SZ,
+// REG_MULTI_SZ). Strings are handed out as pointers into the data buffer,
+// found with the vectorized NUL scan of simdscan.h.
+#ifndef MUICACHE_MULTISZ_H_
+#define MUICACHE_MULTISZ_H_
+
+#include "matcher.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _MULTI_SZ {
+    const WCHAR* chars;
+    DWORD cch;
+    DWORD pos;
+} MULTI_SZ;
+
+// Starts a walk over |cbData| bytes of |data| (2-byte aligned). An odd
+// trailing byte is ignored and the last string may lack its NUL.
+void MultiSz_Init(MULTI_SZ* ms, const BYTE* data, DWORD cbData);
+
+// Yields the next non-empty string. The walk covers the whole buffer: empty
+// strings, which end a REG_MULTI_SZ for the Win32 API, are skipped rather
+// than trusted, since UFH\SHC records keep empty fields in the middle.
+BOOL MultiSz_Next(MULTI_SZ* ms, const WCHAR** str, DWORD* cch);
+
+// Returns TRUE if |type| is a string type and any string in the data
+// matches |matcher|.
+BOOL MultiSz_Contains(const MATCHER* matcher, DWORD type, const BYTE* data, DWORD cbData);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_MULTISZ_H_
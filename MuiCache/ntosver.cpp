@@ -1,4 +1,4 @@
-#include <Windows.h>
+#include "osver.h"
 
 static BOOL GetNtVersionNumbers(LPOSVERSIONINFO lpVersionInformation)
 {
@@ -24,7 +24,18 @@ static BOOL GetNtVersionNumbers(LPOSVERSIONINFO lpVersionInformation)
   return bRet;
 }
 
+extern "C" BOOL OsVersion_Probe(OS_VERSION* version)
+{
+  OSVERSIONINFO info;
+  if (!GetNtVersionNumbers(&info))
+  {
+    memset(version, 0, sizeof(OS_VERSION));
+    return FALSE;
+  }
+  OsVersion_Set(version, info.dwMajorVersion, info.dwMinorVersion, info.dwBuildNumber);
+  return TRUE;
+}
+
 extern "C" BOOL IsWindows10OrGreater() {
-	OSVERSIONINFO info;
-	return GetNtVersionNumbers(&info) && info.dwBuildNumber >= 10240;
+	return OsVersion_Get()->build >= 10240;
 }
@@ -0,0 +1,71 @@
+#include "osver.h"
+
+// Zero-initialized, no constructor: safe in a DLL built without an entry
+// point, where nothing runs at load time.
+static OS_VERSION g_osVersion;
+static volatile LONG g_osVersionState; // OSVER_STATE_*
+
+#define OSVER_STATE_NONE    0
+#define OSVER_STATE_WRITING 1
+#define OSVER_STATE_READY   2
+
+extern "C" void OsVersion_Set(OS_VERSION* version, DWORD major, DWORD minor, DWORD build)
+{
+    version->major = major;
+    version->minor = minor;
+    version->build = build;
+    version->features = 0;
+    if (major > 6 || (major == 6 && minor >= 1))
+        version->features |= OS_FEATURE_PIN_VERB;
+    if (major >= 10 && build >= 10240)
+        version->features |= OS_FEATURE_PINNED_LIST3;
+}
+
+extern "C" const OS_VERSION* OsVersion_Get(void)
+{
+    OS_VERSION probed;
+
+    if (Atomic_Add(&g_osVersionState, 0) == OSVER_STATE_READY)
+        return &g_osVersion;
+
+    // The probe is cheap and gives the same answer everywhere, so racing
+    // threads all probe and the first one publishes. The others only wait
+    // out a 16-byte copy.
+    OsVersion_Probe(&probed);
+    if (Atomic_CompareExchange(&g_osVersionState, OSVER_STATE_WRITING, OSVER_STATE_NONE) == OSVER_STATE_NONE)
+    {
+        g_osVersion = probed;
+        Atomic_CompareExchange(&g_osVersionState, OSVER_STATE_READY, OSVER_STATE_WRITING);
+    }
+    while (Atomic_Add(&g_osVersionState, 0) != OSVER_STATE_READY)
+        ;
+    return &g_osVersion;
+}
+
+extern "C" void OsVersion_Inject(const OS_VERSION* version)
+{
+    if (version)
+    {
+        g_osVersion = *version;
+        Atomic_CompareExchange(&g_osVersionState, OSVER_STATE_READY, OSVER_STATE_NONE);
+    }
+    else
+    {
+        Atomic_CompareExchange(&g_osVersionState, OSVER_STATE_NONE, OSVER_STATE_READY);
+    }
+}
+
+extern "C" PIN_METHOD OsVersion_SelectPinMethod(const OS_VERSION* version)
+{
+    if (version->features & OS_FEATURE_PINNED_LIST3)
+        return PIN_METHOD_PINNED_LIST;
+    return PIN_METHOD_VERB;
+}
+
+#if !defined(_WIN32)
+extern "C" BOOL OsVersion_Probe(OS_VERSION* version)
+{
+    memset(version, 0, sizeof(OS_VERSION));
+    return FALSE;
+}
+#endif
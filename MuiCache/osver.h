@@ -0,0 +1,50 @@
+// osver.h: OS version and pin capabilities, probed once per process and
+// cached. The probe result can be injected so the pin method selection can
+// be exercised on any build.
+#ifndef MUICACHE_OSVER_H_
+#define MUICACHE_OSVER_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define OS_FEATURE_PIN_VERB     0x1 // "taskbarpin"/"taskbarunpin" shell verbs, Windows 7+
+#define OS_FEATURE_PINNED_LIST3 0x2 // IPinnedList3::Modify, Windows 10 RTM (build 10240)+
+
+typedef struct _OS_VERSION {
+    DWORD major;
+    DWORD minor;
+    DWORD build;
+    DWORD features; // OS_FEATURE_*
+} OS_VERSION;
+
+typedef enum _PIN_METHOD {
+    PIN_METHOD_VERB = 0,
+    PIN_METHOD_PINNED_LIST,
+} PIN_METHOD;
+
+// Fills |version| from raw version numbers, deriving the feature flags.
+void OsVersion_Set(OS_VERSION* version, DWORD major, DWORD minor, DWORD build);
+
+// Reads the running OS (RtlGetNtVersionNumbers on Windows). Returns FALSE
+// and zeroes |version| when it cannot tell.
+BOOL OsVersion_Probe(OS_VERSION* version);
+
+// Cached probe result; the first call on any thread probes. Never NULL.
+const OS_VERSION* OsVersion_Get(void);
+
+// Replaces the cached result with |version|, or drops it when NULL so the
+// next OsVersion_Get probes again. Not synchronized with concurrent readers.
+void OsVersion_Inject(const OS_VERSION* version);
+
+// IPinnedList3 where it exists, the shell verb otherwise (and when the
+// version is unknown, as the verb is what older releases did).
+PIN_METHOD OsVersion_SelectPinMethod(const OS_VERSION* version);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_OSVER_H_
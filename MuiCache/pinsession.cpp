@@ -0,0 +1,44 @@
+#include "pinsession.h"
+
+extern "C" HRESULT PinSession_Open(PIN_SESSION* session, const PIN_SESSION_OPS* ops, void* ctx)
+{
+    session->ops = ops;
+    session->ctx = ctx;
+    session->openResult = ops->Open(ctx);
+    return session->openResult;
+}
+
+extern "C" HRESULT PinSession_Modify(PIN_SESSION* session, const WCHAR* path, BOOL pinning)
+{
+    HRESULT hr;
+    if (FAILED(session->openResult))
+        return session->openResult;
+
+    hr = session->ops->Modify(session->ctx, path, pinning);
+    if (hr == PIN_E_DISCONNECTED || hr == PIN_E_SERVER_UNAVAILABLE)
+    {
+        HRESULT reconnected = session->ops->Reconnect(session->ctx);
+        if (SUCCEEDED(reconnected))
+            hr = session->ops->Modify(session->ctx, path, pinning);
+    }
+    return hr;
+}
+
+extern "C" void PinSession_Close(PIN_SESSION* session)
+{
+    if (SUCCEEDED(session->openResult))
+        session->ops->Close(session->ctx);
+    session->openResult = E_FAIL;
+}
+
+extern "C" DWORD PinSession_Apply(PIN_SESSION* session, const PIN_MODIFICATION* mods, DWORD count, HRESULT* results)
+{
+    DWORD i, ok = 0;
+    for (i = 0; i < count; ++i)
+    {
+        results[i] = PinSession_Modify(session, mods[i].path, mods[i].pinning);
+        if (SUCCEEDED(results[i]))
+            ++ok;
+    }
+    return ok;
+}
@@ -0,0 +1,54 @@
+// pinsession.h: pins and unpins a list of shortcuts through one taskband
+// object. The COM calls sit behind PIN_SESSION_OPS, so the session rules
+// (one create, per-path results, one reconnect when Explorer went away)
+// don't depend on COM.
+#ifndef MUICACHE_PINSESSION_H_
+#define MUICACHE_PINSESSION_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Explorer restarted under us: the cached taskband object is dead.
+#define PIN_E_DISCONNECTED        ((HRESULT)0x80010108L) // RPC_E_DISCONNECTED
+#define PIN_E_SERVER_UNAVAILABLE  ((HRESULT)0x800706BAL) // RPC_S_SERVER_UNAVAILABLE
+
+typedef struct _PIN_SESSION_OPS {
+    // Enters the apartment and creates the taskband object.
+    HRESULT (*Open)(void* ctx);
+    // Pins (|pinning|) or unpins |path| through the object.
+    HRESULT (*Modify)(void* ctx, const WCHAR* path, BOOL pinning);
+    // Drops and re-creates the object after a disconnect.
+    HRESULT (*Reconnect)(void* ctx);
+    // Releases the object and leaves the apartment; only after a good Open.
+    void (*Close)(void* ctx);
+} PIN_SESSION_OPS;
+
+typedef struct _PIN_SESSION {
+    const PIN_SESSION_OPS* ops;
+    void* ctx;
+    HRESULT openResult;
+} PIN_SESSION;
+
+typedef struct _PIN_MODIFICATION {
+    const WCHAR* path;
+    BOOL pinning;
+} PIN_MODIFICATION;
+
+HRESULT PinSession_Open(PIN_SESSION* session, const PIN_SESSION_OPS* ops, void* ctx);
+// Retries once on a fresh object if the cached one reports a disconnect.
+HRESULT PinSession_Modify(PIN_SESSION* session, const WCHAR* path, BOOL pinning);
+void PinSession_Close(PIN_SESSION* session);
+
+// Applies |mods| in order and stores each path's status in |results|; every
+// entry gets the Open error if the session failed to open. Returns the
+// number of modifications that succeeded.
+DWORD PinSession_Apply(PIN_SESSION* session, const PIN_MODIFICATION* mods, DWORD count, HRESULT* results);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_PINSESSION_H_
@@ -0,0 +1,182 @@
+// platform.h: Win32 base types and a few kernel32 shims for the portable
+// cores (matcher, purge, ...), so they can also be built outside Windows.
+// The plugin links without the CRT, so only heap, memory and interlocked
+// primitives are wrapped here; no STL, no operator new, no static ctors.
+#ifndef MUICACHE_PLATFORM_H_
+#define MUICACHE_PLATFORM_H_
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <string.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef int BOOL;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint64_t ULONGLONG;
+typedef LONG LSTATUS;
+typedef LONG HRESULT;
+typedef size_t SIZE_T;
+// Registry and shell data is UTF-16 on disk and on the wire, keep it that way.
+typedef uint16_t WCHAR;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define ERROR_SUCCESS           0L
+#define ERROR_FILE_NOT_FOUND    2L
+#define ERROR_PATH_NOT_FOUND    3L
+#define ERROR_ACCESS_DENIED     5L
+#define ERROR_INVALID_HANDLE    6L
+#define ERROR_NOT_ENOUGH_MEMORY 8L
+#define ERROR_INVALID_DATA      13L
+#define ERROR_OUTOFMEMORY       14L
+#define ERROR_SHARING_VIOLATION 32L
+#define ERROR_HANDLE_EOF        38L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_INSUFFICIENT_BUFFER 122L
+#define ERROR_MORE_DATA         234L
+#define WAIT_TIMEOUT            258L
+#define ERROR_NO_MORE_ITEMS     259L
+
+#define S_OK          ((HRESULT)0L)
+#define S_FALSE       ((HRESULT)1L)
+#define E_FAIL        ((HRESULT)0x80004005L)
+#define E_INVALIDARG  ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT)(((x) & 0x0000FFFF) | (7 << 16) | 0x80000000)))
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)    (((HRESULT)(hr)) < 0)
+
+#define REG_NONE      0
+#define REG_SZ        1
+#define REG_EXPAND_SZ 2
+#define REG_BINARY    3
+#define REG_DWORD     4
+#define REG_MULTI_SZ  7
+
+typedef struct _FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
+#define INFINITE 0xFFFFFFFF
+
+#define WINAPI
+#endif
+
+#if defined(_WIN32)
+#define PATH_SEPARATOR '\\'
+#else
+#define PATH_SEPARATOR '/'
+#endif
+
+static __inline void* Mem_Alloc(SIZE_T cb)
+{
+#if defined(_WIN32)
+    return HeapAlloc(GetProcessHeap(), 0, cb);
+#else
+    return malloc(cb);
+#endif
+}
+
+static __inline void* Mem_Realloc(void* p, SIZE_T cb)
+{
+#if defined(_WIN32)
+    return p ? HeapReAlloc(GetProcessHeap(), 0, p, cb) : HeapAlloc(GetProcessHeap(), 0, cb);
+#else
+    return realloc(p, cb);
+#endif
+}
+
+static __inline void Mem_Free(void* p)
+{
+#if defined(_WIN32)
+    if (p)
+        HeapFree(GetProcessHeap(), 0, p);
+#else
+    free(p);
+#endif
+}
+
+// Full-barrier atomics on 32-bit counters; return the new value.
+static __inline LONG Atomic_Add(volatile LONG* p, LONG v)
+{
+#if defined(_WIN32)
+    return InterlockedExchangeAdd(p, v) + v;
+#else
+    return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static __inline LONG Atomic_Increment(volatile LONG* p)
+{
+    return Atomic_Add(p, 1);
+}
+
+// Plain acquire load, cheap enough for hot paths (no locked instruction).
+static __inline LONG Atomic_Load(const volatile LONG* p)
+{
+#if defined(_WIN32)
+    return *p; // volatile reads have acquire semantics under MSVC on x86
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Stores |value| and returns the previous value.
+static __inline LONG Atomic_Exchange(volatile LONG* p, LONG value)
+{
+#if defined(_WIN32)
+    return InterlockedExchange(p, value);
+#else
+    return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Returns the previous value; |exchange| was stored if it equals |comparand|.
+static __inline LONG Atomic_CompareExchange(volatile LONG* p, LONG exchange, LONG comparand)
+{
+#if defined(_WIN32)
+    return InterlockedCompareExchange(p, exchange, comparand);
+#else
+    __atomic_compare_exchange_n(p, &comparand, exchange, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+#endif
+}
+
+// Monotonic millisecond clock for durations; wraps every 49.7 days, so only
+// differences are meaningful.
+static __inline DWORD Time_Milliseconds(void)
+{
+#if defined(_WIN32)
+    return GetTickCount();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (DWORD)((ULONGLONG)ts.tv_sec * 1000 + (ULONGLONG)ts.tv_nsec / 1000000);
+#endif
+}
+
+static __inline DWORD Str_Length(const WCHAR* s)
+{
+    const WCHAR* p = s;
+    while (*p)
+        ++p;
+    return (DWORD)(p - s);
+}
+
+#endif // MUICACHE_PLATFORM_H_
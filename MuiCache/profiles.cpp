@@ -0,0 +1,226 @@
+#include "profiles.h"
+#include "purge.h"
+#include "wspool.h"
+
+// Portable code has no L"" literals (WCHAR is 16-bit off Windows too).
+static const WCHAR kUsrClassMuiCache[] = {
+    'L', 'o', 'c', 'a', 'l', ' ', 'S', 'e', 't', 't', 'i', 'n', 'g', 's', '\\',
+    'S', 'o', 'f', 't', 'w', 'a', 'r', 'e', '\\',
+    'M', 'i', 'c', 'r', 'o', 's', 'o', 'f', 't', '\\',
+    'W', 'i', 'n', 'd', 'o', 'w', 's', '\\',
+    'S', 'h', 'e', 'l', 'l', '\\',
+    'M', 'u', 'i', 'C', 'a', 'c', 'h', 'e', 0 };
+static const WCHAR kNtUserMuiCache[] = {
+    'S', 'o', 'f', 't', 'w', 'a', 'r', 'e', '\\',
+    'M', 'i', 'c', 'r', 'o', 's', 'o', 'f', 't', '\\',
+    'W', 'i', 'n', 'd', 'o', 'w', 's', '\\',
+    'S', 'h', 'e', 'l', 'l', 'N', 'o', 'R', 'o', 'a', 'm', '\\',
+    'M', 'u', 'i', 'C', 'a', 'c', 'h', 'e', 0 };
+
+// Hive files relative to a profile directory, per PROFILE_HIVE.
+static const WCHAR kUsrClassFile[] = {
+    'A', 'p', 'p', 'D', 'a', 't', 'a', PATH_SEPARATOR,
+    'L', 'o', 'c', 'a', 'l', PATH_SEPARATOR,
+    'M', 'i', 'c', 'r', 'o', 's', 'o', 'f', 't', PATH_SEPARATOR,
+    'W', 'i', 'n', 'd', 'o', 'w', 's', PATH_SEPARATOR,
+    'U', 's', 'r', 'C', 'l', 'a', 's', 's', '.', 'd', 'a', 't', 0 };
+static const WCHAR kNtUserFile[] = { 'N', 'T', 'U', 'S', 'E', 'R', '.', 'D', 'A', 'T', 0 };
+
+extern "C" const WCHAR* Profile_MuiCachePath(PROFILE_HIVE kind)
+{
+    return kind == PROFILE_HIVE_NTUSER ? kNtUserMuiCache : kUsrClassMuiCache;
+}
+
+struct PROFILE_DISCOVERY
+{
+    PROFILE_DIR_SOURCE* source;
+    STR_LIST profile; // scratch: the profile directory, then its hive paths
+    HIVE_FOUND_CALLBACK callback;
+    void* context;
+    BOOL stopped;
+    BOOL failed;
+};
+
+static BOOL ProfileDir_OnEntry(void* context, const WCHAR* name, BOOL isDirectory)
+{
+    PROFILE_DISCOVERY* discovery = (PROFILE_DISCOVERY*)context;
+    const WCHAR* files[PROFILE_HIVE_COUNT] = { kUsrClassFile, kNtUserFile };
+    DWORD kind;
+
+    if (!isDirectory)
+        return TRUE;
+    StrList_Clear(&discovery->profile);
+    if (!StrList_AddPath(&discovery->profile, discovery->source->profilesDir, name))
+    {
+        discovery->failed = TRUE;
+        return FALSE;
+    }
+    for (kind = 0; kind < PROFILE_HIVE_COUNT; ++kind)
+    {
+        // Hives that don't exist fail to open later, which is cheaper than
+        // a second round of file system calls here.
+        if (!StrList_AddPath(&discovery->profile, StrList_Get(&discovery->profile, 0), files[kind]))
+        {
+            discovery->failed = TRUE;
+            return FALSE;
+        }
+        if (!discovery->callback(discovery->context, StrList_Get(&discovery->profile, discovery->profile.count - 1), (PROFILE_HIVE)kind))
+        {
+            discovery->stopped = TRUE;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static LSTATUS ProfileDir_Discover(HIVE_SOURCE* source, HIVE_FOUND_CALLBACK callback, void* context)
+{
+    PROFILE_DISCOVERY discovery;
+    LSTATUS status;
+
+    discovery.source = (PROFILE_DIR_SOURCE*)source;
+    discovery.callback = callback;
+    discovery.context = context;
+    discovery.stopped = FALSE;
+    discovery.failed = FALSE;
+    StrList_Init(&discovery.profile);
+    status = discovery.source->lister->vtbl->List(discovery.source->lister, discovery.source->profilesDir, ProfileDir_OnEntry, &discovery);
+    StrList_Free(&discovery.profile);
+    if (discovery.failed)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    return status;
+}
+
+static LSTATUS ProfileDir_Purge(HIVE_SOURCE* source, const WCHAR* hivePath, PROFILE_HIVE kind, const MATCHER* matcher, DWORD* deleted)
+{
+    (void)source;
+    return Purge_HiveFile(hivePath, Profile_MuiCachePath(kind), matcher, 0, deleted);
+}
+
+static const HIVE_SOURCE_VTBL ProfileDir_SourceVtbl = {
+    ProfileDir_Discover,
+    ProfileDir_Purge,
+};
+
+extern "C" void ProfileDirSource_Init(PROFILE_DIR_SOURCE* source, DIR_LISTER* lister, const WCHAR* profilesDir)
+{
+    source->base.vtbl = &ProfileDir_SourceVtbl;
+    source->lister = lister;
+    source->profilesDir = profilesDir;
+}
+
+struct PROFILE_COLLECT
+{
+    PROFILE_PURGE* purge;
+    DWORD slots;
+    BOOL failed;
+};
+
+static BOOL Profiles_OnHive(void* context, const WCHAR* hivePath, PROFILE_HIVE kind)
+{
+    PROFILE_COLLECT* collect = (PROFILE_COLLECT*)context;
+    PROFILE_PURGE* purge = collect->purge;
+    if (purge->hives.count == collect->slots)
+    {
+        DWORD slots = collect->slots ? collect->slots * 2 : 64;
+        PROFILE_HIVE* kinds = (PROFILE_HIVE*)Mem_Realloc(purge->kinds, slots * sizeof(PROFILE_HIVE));
+        if (!kinds)
+        {
+            collect->failed = TRUE;
+            return FALSE;
+        }
+        purge->kinds = kinds;
+        collect->slots = slots;
+    }
+    if (!StrList_Add(&purge->hives, hivePath, Str_Length(hivePath)))
+    {
+        collect->failed = TRUE;
+        return FALSE;
+    }
+    purge->kinds[purge->hives.count - 1] = kind;
+    return TRUE;
+}
+
+struct PROFILE_JOBS
+{
+    HIVE_SOURCE* source;
+    const MATCHER* matcher;
+    PROFILE_PURGE* purge;
+};
+
+static void Profiles_Job(void* context, DWORD index, DWORD worker)
+{
+    PROFILE_JOBS* jobs = (PROFILE_JOBS*)context;
+    PROFILE_PURGE* purge = jobs->purge;
+    // Each job writes only its own result slot; totals are summed after.
+    PROFILE_RESULT* result = &purge->results[index];
+    (void)worker;
+    result->deleted = 0;
+    result->status = jobs->source->vtbl->Purge(jobs->source, StrList_Get(&purge->hives, index), purge->kinds[index], jobs->matcher, &result->deleted);
+}
+
+extern "C" LSTATUS Profiles_Purge(HIVE_SOURCE* source, const MATCHER* matcher, DWORD workers, PROFILE_PURGE* purge)
+{
+    PROFILE_COLLECT collect;
+    PROFILE_JOBS jobs;
+    WORK_POOL_STATS stats;
+    LSTATUS status;
+    DWORD i;
+
+    memset(purge, 0, sizeof(PROFILE_PURGE));
+    StrList_Init(&purge->hives);
+
+    collect.purge = purge;
+    collect.slots = 0;
+    collect.failed = FALSE;
+    status = source->vtbl->Discover(source, Profiles_OnHive, &collect);
+    if (collect.failed)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    if (status != ERROR_SUCCESS)
+        return status;
+    if (!purge->hives.count)
+        return ERROR_SUCCESS;
+
+    purge->results = (PROFILE_RESULT*)Mem_Alloc(purge->hives.count * sizeof(PROFILE_RESULT));
+    if (!purge->results)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    jobs.source = source;
+    jobs.matcher = matcher;
+    jobs.purge = purge;
+    WorkPool_Run(purge->hives.count, workers, Profiles_Job, &jobs, &stats);
+    purge->workers = stats.workers;
+    purge->steals = stats.steals;
+
+    for (i = 0; i < purge->hives.count; ++i)
+    {
+        const PROFILE_RESULT* result = &purge->results[i];
+        switch (result->status)
+        {
+        case ERROR_SUCCESS:
+            ++purge->purged;
+            purge->deleted += result->deleted;
+            break;
+        case ERROR_FILE_NOT_FOUND:
+        case ERROR_PATH_NOT_FOUND:
+            break;
+        case ERROR_SHARING_VIOLATION:
+            ++purge->busy;
+            break;
+        default:
+            if (!purge->failed++)
+                purge->firstError = result->status;
+            break;
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+extern "C" void Profiles_Free(PROFILE_PURGE* purge)
+{
+    StrList_Free(&purge->hives);
+    Mem_Free(purge->kinds);
+    Mem_Free(purge->results);
+    purge->kinds = NULL;
+    purge->results = NULL;
+}
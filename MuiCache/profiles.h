@@ -0,0 +1,81 @@
+// profiles.h: MuiCache purge across every user profile of the machine.
+// Hives are discovered and purged through a HIVE_SOURCE, then processed on
+// the work-stealing pool; one job per hive file.
+#ifndef MUICACHE_PROFILES_H_
+#define MUICACHE_PROFILES_H_
+
+#include "dirlist.h"
+#include "matcher.h"
+#include "strlist.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Which hive a job is, and so where MuiCache lives in it.
+typedef enum _PROFILE_HIVE {
+    PROFILE_HIVE_USRCLASS = 0, // Local Settings\Software\Microsoft\Windows\Shell\MuiCache
+    PROFILE_HIVE_NTUSER,       // Software\Microsoft\Windows\ShellNoRoam\MuiCache (XP)
+    PROFILE_HIVE_COUNT
+} PROFILE_HIVE;
+
+typedef struct _HIVE_SOURCE HIVE_SOURCE;
+
+// Return FALSE to stop the discovery.
+typedef BOOL (*HIVE_FOUND_CALLBACK)(void* context, const WCHAR* hivePath, PROFILE_HIVE kind);
+
+typedef struct _HIVE_SOURCE_VTBL {
+    // Reports every hive file that may hold a MuiCache key.
+    LSTATUS (*Discover)(HIVE_SOURCE* source, HIVE_FOUND_CALLBACK callback, void* context);
+    // Purges one hive; called concurrently from several threads.
+    LSTATUS (*Purge)(HIVE_SOURCE* source, const WCHAR* hivePath, PROFILE_HIVE kind, const MATCHER* matcher, DWORD* deleted);
+} HIVE_SOURCE_VTBL;
+
+struct _HIVE_SOURCE {
+    const HIVE_SOURCE_VTBL* vtbl;
+};
+
+// Hive files of every profile directory under one profiles folder (e.g.
+// C:\Users), found through |lister|, purged with Purge_HiveFile.
+typedef struct _PROFILE_DIR_SOURCE {
+    HIVE_SOURCE base;
+    DIR_LISTER* lister;
+    const WCHAR* profilesDir;
+} PROFILE_DIR_SOURCE;
+
+void ProfileDirSource_Init(PROFILE_DIR_SOURCE* source, DIR_LISTER* lister, const WCHAR* profilesDir);
+
+// MuiCache key path inside a hive of |kind|.
+const WCHAR* Profile_MuiCachePath(PROFILE_HIVE kind);
+
+typedef struct _PROFILE_RESULT {
+    // ERROR_FILE_NOT_FOUND/ERROR_PATH_NOT_FOUND: no such hive or no MuiCache
+    // key in it. ERROR_SHARING_VIOLATION: loaded, i.e. the user is logged on.
+    LSTATUS status;
+    DWORD deleted;
+} PROFILE_RESULT;
+
+typedef struct _PROFILE_PURGE {
+    STR_LIST hives;          // hive paths, in discovery order
+    PROFILE_HIVE* kinds;     // per hive
+    PROFILE_RESULT* results; // per hive
+    DWORD purged;            // hives that had a MuiCache key and were purged
+    DWORD busy;              // hives in use by a logged-on user
+    DWORD failed;            // hives that exist but couldn't be purged otherwise
+    DWORD deleted;           // values removed, all hives
+    LSTATUS firstError;      // status of the first failed hive, in order
+    DWORD workers;
+    DWORD steals;
+} PROFILE_PURGE;
+
+// Discovers the hives of |source| and purges them on up to |workers|
+// threads (0: one per logical processor). Fills |purge|, which the caller
+// releases with Profiles_Free even on failure.
+LSTATUS Profiles_Purge(HIVE_SOURCE* source, const MATCHER* matcher, DWORD workers, PROFILE_PURGE* purge);
+void Profiles_Free(PROFILE_PURGE* purge);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_PROFILES_H_
@@ -0,0 +1,110 @@
+#include "propstage.h"
+
+static HRESULT Recorder_Call(PROPERTY_WRITER* writer)
+{
+    PROPERTY_WRITE_RECORDER* recorder = (PROPERTY_WRITE_RECORDER*)writer;
+    return ++recorder->calls == recorder->failAt ? E_FAIL : S_OK;
+}
+
+static HRESULT Recorder_Set(PROPERTY_WRITER* writer)
+{
+    HRESULT hr = Recorder_Call(writer);
+    if (SUCCEEDED(hr))
+        ++((PROPERTY_WRITE_RECORDER*)writer)->sets;
+    return hr;
+}
+
+static HRESULT Recorder_SetString(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, const WCHAR* value)
+{
+    (void)fmtid, (void)pid, (void)value;
+    return Recorder_Set(writer);
+}
+
+static HRESULT Recorder_SetBool(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, BOOL value)
+{
+    (void)fmtid, (void)pid, (void)value;
+    return Recorder_Set(writer);
+}
+
+static HRESULT Recorder_SetGuid(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, const LNK_FMTID* value)
+{
+    (void)fmtid, (void)pid, (void)value;
+    return Recorder_Set(writer);
+}
+
+static HRESULT Recorder_Commit(PROPERTY_WRITER* writer)
+{
+    PROPERTY_WRITE_RECORDER* recorder = (PROPERTY_WRITE_RECORDER*)writer;
+    HRESULT hr = Recorder_Call(writer);
+    if (SUCCEEDED(hr))
+    {
+        ++recorder->commits;
+        recorder->setsAtCommit = recorder->sets;
+    }
+    return hr;
+}
+
+static const PROPERTY_WRITER_VTBL Recorder_Vtbl = {
+    Recorder_SetString,
+    Recorder_SetBool,
+    Recorder_SetGuid,
+    Recorder_Commit,
+};
+
+extern "C" void PropertyRecorder_Init(PROPERTY_WRITE_RECORDER* recorder)
+{
+    memset(recorder, 0, sizeof(PROPERTY_WRITE_RECORDER));
+    recorder->base.vtbl = &Recorder_Vtbl;
+}
+
+extern "C" void PropertyStage_Init(PROPERTY_STAGE* stage)
+{
+    memset(stage, 0, sizeof(PROPERTY_STAGE));
+}
+
+extern "C" void PropertyStage_SetAppId(PROPERTY_STAGE* stage, const WCHAR* appId)
+{
+    stage->appId = appId;
+    stage->staged |= PROPERTY_STAGE_APP_ID;
+}
+
+extern "C" void PropertyStage_SetDualMode(PROPERTY_STAGE* stage, BOOL dualMode)
+{
+    stage->dualMode = dualMode;
+    stage->staged |= PROPERTY_STAGE_DUAL_MODE;
+}
+
+extern "C" void PropertyStage_SetToastActivatorClsid(PROPERTY_STAGE* stage, const LNK_FMTID* clsid)
+{
+    stage->toastActivatorClsid = *clsid;
+    stage->staged |= PROPERTY_STAGE_TOAST_ACTIVATOR_CLSID;
+}
+
+extern "C" HRESULT PropertyStage_Apply(const PROPERTY_STAGE* stage, PROPERTY_WRITER* writer)
+{
+    const PROPERTY_WRITER_VTBL* vtbl = writer->vtbl;
+    HRESULT hr;
+
+    if (!stage->staged)
+        return S_FALSE;
+    if (stage->staged & PROPERTY_STAGE_APP_ID)
+    {
+        hr = vtbl->SetString(writer, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, stage->appId);
+        if (FAILED(hr))
+            return hr;
+    }
+    if (stage->staged & PROPERTY_STAGE_DUAL_MODE)
+    {
+        hr = vtbl->SetBool(writer, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_IsDualMode, stage->dualMode);
+        if (FAILED(hr))
+            return hr;
+    }
+    if (stage->staged & PROPERTY_STAGE_TOAST_ACTIVATOR_CLSID)
+    {
+        hr = vtbl->SetGuid(writer, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ToastActivatorCLSID,
+            &stage->toastActivatorClsid);
+        if (FAILED(hr))
+            return hr;
+    }
+    return vtbl->Commit(writer);
+}
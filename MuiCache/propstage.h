@@ -0,0 +1,68 @@
+// propstage.h: a shortcut's property-store values, set together and
+// committed once. IPropertyStore::Commit serializes the link's whole
+// property block, so the AppUserModel values chosen for a shortcut are
+// staged here and go through a PROPERTY_WRITER in one pass with a single
+// Commit. The IPropertyStore writer lives in shortcut.cpp.
+#ifndef MUICACHE_PROPSTAGE_H_
+#define MUICACHE_PROPSTAGE_H_
+
+#include "platform.h"
+#include "lnkfile.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _PROPERTY_WRITER PROPERTY_WRITER;
+
+typedef struct _PROPERTY_WRITER_VTBL {
+    HRESULT (*SetString)(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, const WCHAR* value);
+    HRESULT (*SetBool)(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, BOOL value);
+    HRESULT (*SetGuid)(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, const LNK_FMTID* value);
+    HRESULT (*Commit)(PROPERTY_WRITER* writer);
+} PROPERTY_WRITER_VTBL;
+
+struct _PROPERTY_WRITER {
+    const PROPERTY_WRITER_VTBL* vtbl;
+};
+
+// Counts calls instead of making them, for checking what a stage writes.
+// The call numbered |failAt| (from 1; 0 for none) returns E_FAIL.
+typedef struct _PROPERTY_WRITE_RECORDER {
+    PROPERTY_WRITER base;
+    DWORD calls;
+    DWORD sets;
+    DWORD commits;
+    DWORD failAt;
+    DWORD setsAtCommit; // |sets| when Commit was last called
+} PROPERTY_WRITE_RECORDER;
+
+void PropertyRecorder_Init(PROPERTY_WRITE_RECORDER* recorder);
+
+// PROPERTY_STAGE::staged bits.
+#define PROPERTY_STAGE_APP_ID                0x1
+#define PROPERTY_STAGE_DUAL_MODE             0x2
+#define PROPERTY_STAGE_TOAST_ACTIVATOR_CLSID 0x4
+
+typedef struct _PROPERTY_STAGE {
+    DWORD staged;
+    const WCHAR* appId; // not copied
+    BOOL dualMode;
+    LNK_FMTID toastActivatorClsid;
+} PROPERTY_STAGE;
+
+void PropertyStage_Init(PROPERTY_STAGE* stage);
+void PropertyStage_SetAppId(PROPERTY_STAGE* stage, const WCHAR* appId);
+void PropertyStage_SetDualMode(PROPERTY_STAGE* stage, BOOL dualMode);
+void PropertyStage_SetToastActivatorClsid(PROPERTY_STAGE* stage, const LNK_FMTID* clsid);
+
+// Sets every staged value through |writer|, then commits once. A failed set
+// stops there without committing. Returns S_FALSE, with no calls at all,
+// when nothing is staged.
+HRESULT PropertyStage_Apply(const PROPERTY_STAGE* stage, PROPERTY_WRITER* writer);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_PROPSTAGE_H_
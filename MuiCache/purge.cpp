@@ -0,0 +1,410 @@
+// Value purge over a REGKEY, matching names or string data.
+#include "purge.h"
+#include "fileio.h"
+#include "hive.h"
+#include "fwrule.h"
+#include "multisz.h"
+
+#define PURGE_MATCH_ANY_DATA (PURGE_MATCH_DATA | PURGE_MATCH_FIREWALL_APP)
+
+static const WCHAR kFirewallAppField[] = { 'A', 'p', 'p', 0 };
+
+// Enumeration buffers, sized from QueryInfo and grown when a longer name or
+// larger data turns up later. |data| stays NULL unless data is matched.
+struct PURGE_ENUM
+{
+    DWORD flags;
+    WCHAR* name;
+    DWORD cchName; // buffer size, chars
+    BYTE* data;
+    DWORD cbData;  // buffer size, bytes
+    DWORD cchValue; // results of the last read
+    DWORD type;
+    DWORD cbValue;
+};
+
+static LSTATUS PurgeEnum_Init(PURGE_ENUM* e, REGKEY* key, DWORD flags)
+{
+    DWORD cchMaxValue = 0, cbMaxValueData = 0;
+    LSTATUS retCode;
+
+    memset(e, 0, sizeof(PURGE_ENUM));
+    e->flags = flags;
+    retCode = key->vtbl->QueryInfo(key, NULL, &cchMaxValue, (flags & PURGE_MATCH_ANY_DATA) ? &cbMaxValueData : NULL, NULL);
+    if (retCode != ERROR_SUCCESS)
+        return retCode;
+
+    e->cchName = cchMaxValue + 1;
+    e->name = (WCHAR*)Mem_Alloc(e->cchName * sizeof(WCHAR));
+    if (!e->name)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    if (flags & PURGE_MATCH_ANY_DATA)
+    {
+        // Keep the buffer even for a key with no data yet.
+        e->cbData = cbMaxValueData ? cbMaxValueData : sizeof(WCHAR);
+        e->data = (BYTE*)Mem_Alloc(e->cbData);
+        if (!e->data)
+        {
+            Mem_Free(e->name);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+static void PurgeEnum_Free(PURGE_ENUM* e)
+{
+    Mem_Free(e->name);
+    Mem_Free(e->data);
+}
+
+// Reads value |index|. ERROR_MORE_DATA from here means the name is longer
+// than the registry allows, which can't be ours: callers skip it.
+static LSTATUS PurgeEnum_Read(PURGE_ENUM* e, REGKEY* key, DWORD index)
+{
+    LSTATUS retCode;
+    BOOL grew;
+
+    for (;;)
+    {
+        e->cchValue = e->cchName;
+        e->cbValue = e->cbData;
+        if (e->data)
+            retCode = key->vtbl->EnumValue(key, index, e->name, &e->cchValue, &e->type, e->data, &e->cbValue);
+        else
+            retCode = key->vtbl->EnumValue(key, index, e->name, &e->cchValue, NULL, NULL, NULL);
+        if (retCode != ERROR_MORE_DATA)
+            return retCode;
+
+        // The value changed or was added after QueryInfo; grow whichever
+        // buffer was short and read it again.
+        grew = FALSE;
+        if (e->data && e->cbValue > e->cbData)
+        {
+            BYTE* data = (BYTE*)Mem_Realloc(e->data, e->cbValue);
+            if (!data)
+                return ERROR_NOT_ENOUGH_MEMORY;
+            e->data = data;
+            e->cbData = e->cbValue;
+            grew = TRUE;
+        }
+        if (e->cchName < PURGE_MAX_VALUE_NAME + 1 && (e->cchValue >= e->cchName || !grew))
+        {
+            WCHAR* name = (WCHAR*)Mem_Realloc(e->name, (PURGE_MAX_VALUE_NAME + 1) * sizeof(WCHAR));
+            if (!name)
+                return ERROR_NOT_ENOUGH_MEMORY;
+            e->name = name;
+            e->cchName = PURGE_MAX_VALUE_NAME + 1;
+            grew = TRUE;
+        }
+        if (!grew)
+            return ERROR_MORE_DATA;
+    }
+}
+
+// Counts a value that was read, its name and any data.
+static __inline void PurgeEnum_Count(const PURGE_ENUM* e, PURGE_STATS* stats)
+{
+    ++stats->enumerated;
+    stats->bytesRead += e->cchValue * sizeof(WCHAR) + (e->data ? e->cbValue : 0);
+}
+
+static BOOL PurgeEnum_Matches(const PURGE_ENUM* e, const MATCHER* matcher)
+{
+    const WCHAR* app;
+    DWORD cchApp;
+
+    if (e->flags & PURGE_MATCH_FIREWALL_APP)
+    {
+        // Only the App= field: the rule's Name= and Desc= often mention
+        // the product too, and must not make an unrelated rule match.
+        if (e->type != REG_SZ ||
+            !FwRule_FindField((const WCHAR*)e->data, e->cbValue / sizeof(WCHAR), kFirewallAppField, &app, &cchApp))
+            return FALSE;
+        FwRule_Unquote(&app, &cchApp);
+        return Matcher_Contains(matcher, app, cchApp);
+    }
+    if (e->flags & PURGE_MATCH_DATA)
+        return MultiSz_Contains(matcher, e->type, e->data, e->cbValue);
+    return Matcher_Contains(matcher, e->name, e->cchValue);
+}
+
+// FNV-1a of a value name, never 0 so 0 can mean "no name".
+static DWORD Purge_NameHash(const WCHAR* name, DWORD cch)
+{
+    DWORD hash = 2166136261u, i;
+    for (i = 0; i < cch; ++i)
+    {
+        hash = (hash ^ (name[i] & 0xFF)) * 16777619u;
+        hash = (hash ^ (name[i] >> 8)) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+// Where to pick up |cursor| now. Since it was taken, values before it may
+// have been deleted, moving the last examined name down, so that name is
+// looked for from its old index downwards. If it is gone, the walk starts
+// over: the values already examined are read again, but none is missed.
+static DWORD Purge_Resume(PURGE_ENUM* e, REGKEY* key, const PURGE_CURSOR* cursor)
+{
+    DWORD cValues = 0, j;
+    LSTATUS retCode;
+
+    if (!cursor->index || !cursor->lastName)
+        return cursor->index;
+    if (key->vtbl->QueryInfo(key, &cValues, NULL, NULL, NULL) != ERROR_SUCCESS)
+        return 0;
+
+    for (j = cursor->index < cValues ? cursor->index : cValues; j-- > 0;)
+    {
+        retCode = PurgeEnum_Read(e, key, j);
+        if (retCode == ERROR_SUCCESS && Purge_NameHash(e->name, e->cchValue) == cursor->lastName)
+            return j + 1;
+        if (retCode != ERROR_SUCCESS && retCode != ERROR_MORE_DATA && retCode != ERROR_NO_MORE_ITEMS)
+            break;
+    }
+    return 0;
+}
+
+// Interleaved enumerate/delete. Deleting a value shifts the later ones down
+// by one, so after a successful delete the same index is read again.
+// With |cursor|, the walk starts where it says and, once |deadline| has
+// passed, stops before the next value with the cursor updated and returns
+// WAIT_TIMEOUT. At least one value is read per call, so a caller that
+// keeps resuming always gets through the key.
+static LSTATUS Purge_InPlace(REGKEY* key, const MATCHER* matcher, DWORD flags, PURGE_STATS* stats,
+    PURGE_CURSOR* cursor, DWORD deadline)
+{
+    PURGE_ENUM e;
+    DWORD i, lastName = 0;
+    BOOL any = FALSE;
+    LSTATUS retCode;
+
+    retCode = PurgeEnum_Init(&e, key, flags);
+    if (retCode != ERROR_SUCCESS)
+        return retCode;
+
+    i = 0;
+    if (cursor)
+    {
+        i = Purge_Resume(&e, key, cursor);
+        lastName = i ? cursor->lastName : 0;
+    }
+
+    for (;;)
+    {
+        // Everything below |i| has been examined; |lastName| is at i - 1.
+        if (cursor && any && (LONG)(Time_Milliseconds() - deadline) >= 0)
+        {
+            cursor->index = i;
+            cursor->lastName = lastName;
+            retCode = WAIT_TIMEOUT;
+            break;
+        }
+        any = TRUE;
+
+        retCode = PurgeEnum_Read(&e, key, i);
+        if (retCode == ERROR_NO_MORE_ITEMS)
+        {
+            retCode = ERROR_SUCCESS;
+            if (cursor)
+                memset(cursor, 0, sizeof(PURGE_CURSOR));
+            break;
+        }
+        // A name longer than the registry allows can't be ours; anything
+        // else means the key itself went bad.
+        if (retCode != ERROR_SUCCESS && retCode != ERROR_MORE_DATA)
+            break;
+
+        if (retCode == ERROR_SUCCESS)
+        {
+            PurgeEnum_Count(&e, stats);
+            if (PurgeEnum_Matches(&e, matcher))
+            {
+                ++stats->matched;
+                if (!(flags & PURGE_DRY_RUN))
+                {
+                    if (key->vtbl->DeleteValue(key, e.name) == ERROR_SUCCESS)
+                    {
+                        ++stats->deleted;
+                        continue;
+                    }
+                    ++stats->failed;
+                }
+            }
+            if (cursor)
+                lastName = Purge_NameHash(e.name, e.cchValue);
+        }
+        else
+        {
+            lastName = 0; // an overlong name: resuming trusts the index
+        }
+
+        ++i;
+    }
+
+    PurgeEnum_Free(&e);
+    return retCode;
+}
+
+// Matching names, packed back to back with their NULs.
+struct PURGE_ARENA
+{
+    WCHAR* names;
+    DWORD used;
+    DWORD capacity;
+};
+
+static BOOL Arena_Append(PURGE_ARENA* arena, const WCHAR* name, DWORD cch)
+{
+    if (arena->used + cch + 1 > arena->capacity)
+    {
+        DWORD capacity = arena->capacity * 2;
+        WCHAR* names;
+        while (arena->used + cch + 1 > capacity)
+            capacity *= 2;
+        names = (WCHAR*)Mem_Realloc(arena->names, capacity * sizeof(WCHAR));
+        if (!names)
+            return FALSE;
+        arena->names = names;
+        arena->capacity = capacity;
+    }
+    memcpy(arena->names + arena->used, name, cch * sizeof(WCHAR));
+    arena->used += cch;
+    arena->names[arena->used++] = 0;
+    return TRUE;
+}
+
+// Phase one walks the indices 0..n-1 without touching the key and copies
+// matching names into the arena; phase two deletes them by name. No index
+// is read twice, and a value added or removed by someone else meanwhile
+// can't make the walk skip or revisit entries.
+static LSTATUS Purge_Snapshot(REGKEY* key, const MATCHER* matcher, DWORD flags, PURGE_STATS* stats)
+{
+    PURGE_ARENA arena;
+    PURGE_ENUM e;
+    DWORD i, pos;
+    LSTATUS retCode;
+
+    retCode = PurgeEnum_Init(&e, key, flags);
+    if (retCode != ERROR_SUCCESS)
+        return retCode;
+
+    arena.used = 0;
+    arena.capacity = e.cchName * 16;
+    arena.names = (WCHAR*)Mem_Alloc(arena.capacity * sizeof(WCHAR));
+    if (!arena.names)
+    {
+        PurgeEnum_Free(&e);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    for (i = 0;; ++i)
+    {
+        retCode = PurgeEnum_Read(&e, key, i);
+        if (retCode == ERROR_NO_MORE_ITEMS)
+        {
+            retCode = ERROR_SUCCESS;
+            break;
+        }
+        if (retCode == ERROR_MORE_DATA)
+            continue;
+        if (retCode != ERROR_SUCCESS)
+            break;
+
+        PurgeEnum_Count(&e, stats);
+        if (!PurgeEnum_Matches(&e, matcher))
+            continue;
+        ++stats->matched;
+        if (!(flags & PURGE_DRY_RUN) && !Arena_Append(&arena, e.name, e.cchValue))
+        {
+            retCode = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+    }
+
+    // Delete whatever was collected, even if the walk stopped early.
+    for (pos = 0; pos < arena.used; pos += Str_Length(arena.names + pos) + 1)
+    {
+        if (key->vtbl->DeleteValue(key, arena.names + pos) == ERROR_SUCCESS)
+            ++stats->deleted;
+        else
+            ++stats->failed;
+    }
+
+    Mem_Free(arena.names);
+    PurgeEnum_Free(&e);
+    return retCode;
+}
+
+extern "C" LSTATUS Purge_ValueNamesEx(REGKEY* key, const MATCHER* matcher, DWORD flags, PURGE_STATS* stats)
+{
+    // Counted in a local and added once, so the loop only ever touches
+    // the caller's stack frame.
+    PURGE_STATS counted;
+    LSTATUS retCode;
+
+    memset(&counted, 0, sizeof(PURGE_STATS));
+    if (flags & PURGE_IN_PLACE)
+        retCode = Purge_InPlace(key, matcher, flags, &counted, NULL, 0);
+    else
+        retCode = Purge_Snapshot(key, matcher, flags, &counted);
+
+    PurgeStats_Add(stats, &counted);
+    return retCode;
+}
+
+extern "C" LSTATUS Purge_ValueNamesUntil(REGKEY* key, const MATCHER* matcher, DWORD flags, DWORD deadline,
+    PURGE_CURSOR* cursor, PURGE_STATS* stats)
+{
+    PURGE_STATS counted;
+    LSTATUS retCode;
+
+    memset(&counted, 0, sizeof(PURGE_STATS));
+    retCode = Purge_InPlace(key, matcher, flags, &counted, cursor, deadline);
+    PurgeStats_Add(stats, &counted);
+    return retCode;
+}
+
+extern "C" LSTATUS Purge_ValueNames(REGKEY* key, const MATCHER* matcher, DWORD flags, DWORD* deleted)
+{
+    PURGE_STATS stats;
+    LSTATUS retCode;
+
+    memset(&stats, 0, sizeof(PURGE_STATS));
+    retCode = Purge_ValueNamesEx(key, matcher, flags, &stats);
+    if (deleted)
+        *deleted = stats.deleted;
+    return retCode;
+}
+
+extern "C" LSTATUS Purge_HiveFile(const WCHAR* hivePath, const WCHAR* keyPath, const MATCHER* matcher, DWORD flags, DWORD* deleted)
+{
+    FILE_MAP map;
+    HIVE hive;
+    REGKEY* key;
+    BOOL changed;
+    LSTATUS retCode, unmapped;
+
+    if (deleted)
+        *deleted = 0;
+    retCode = File_Map(hivePath, &map);
+    if (retCode != ERROR_SUCCESS)
+        return retCode;
+
+    retCode = Hive_Open(map.data, map.size, &hive);
+    if (retCode == ERROR_SUCCESS)
+        retCode = RegKey_OpenHive(&hive, keyPath, &key);
+    if (retCode == ERROR_SUCCESS)
+    {
+        retCode = Purge_ValueNames(key, matcher, flags, deleted);
+        key->vtbl->Close(key);
+    }
+    // Whatever was deleted is already in the view; seal it even after an
+    // error so the file is left consistent.
+    changed = hive.modified;
+    Hive_Commit(&hive);
+
+    unmapped = File_Unmap(&map, changed);
+    return retCode != ERROR_SUCCESS ? retCode : unmapped;
+}
@@ -0,0 +1,83 @@
+// purge.h: the enumerate-match-delete loop behind Clear/ClearMany, written
+// against REGKEY so it runs the same on the registry and on memory keys.
+#ifndef MUICACHE_PURGE_H_
+#define MUICACHE_PURGE_H_
+
+#include "regkey.h"
+#include "matcher.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Longest value name the registry allows, without the NUL.
+#define PURGE_MAX_VALUE_NAME 16383
+
+// Purge_ValueNames flags.
+// By default the key is enumerated once into a list of matching names and
+// those are deleted afterwards as a batch. PURGE_IN_PLACE deletes while
+// enumerating instead, re-reading the index each delete shifts into.
+#define PURGE_IN_PLACE 0x00000001
+// Match the strings in the value data (REG_SZ, REG_EXPAND_SZ, REG_MULTI_SZ)
+// instead of the value name, for keys like UFH\SHC whose values are named
+// by number and hold the shortcut and exe paths. Other types never match.
+#define PURGE_MATCH_DATA 0x00000002
+// Treat each REG_SZ value as a firewall rule string and match only its App=
+// field (see fwrule.h). Values of other types, and rules without an App=
+// field, never match.
+#define PURGE_MATCH_FIREWALL_APP 0x00000004
+// Enumerate and match, but delete nothing; the stats tell what would go.
+#define PURGE_DRY_RUN 0x00000008
+
+// What one purge did. Plain counters: each purge fills its own copy and
+// callers sum them afterwards, so nothing is shared between threads.
+typedef struct _PURGE_STATS {
+    DWORD enumerated; // values read
+    DWORD bytesRead;  // name and data bytes of those values
+    DWORD matched;
+    DWORD deleted;
+    DWORD failed;     // matched, but the delete failed
+} PURGE_STATS;
+
+static __inline void PurgeStats_Add(PURGE_STATS* total, const PURGE_STATS* stats)
+{
+    total->enumerated += stats->enumerated;
+    total->bytesRead += stats->bytesRead;
+    total->matched += stats->matched;
+    total->deleted += stats->deleted;
+    total->failed += stats->failed;
+}
+
+// Deletes every value of |key| whose name (or data, see PURGE_MATCH_*)
+// contains one of the patterns of |matcher|. |deleted| (optional) receives
+// the number of values removed.
+LSTATUS Purge_ValueNames(REGKEY* key, const MATCHER* matcher, DWORD flags, DWORD* deleted);
+// Same, adding what was done to |stats|.
+LSTATUS Purge_ValueNamesEx(REGKEY* key, const MATCHER* matcher, DWORD flags, PURGE_STATS* stats);
+
+// Same, on key |keyPath| of the hive file |hivePath| (e.g. a UsrClass.dat
+// that is not loaded), edited in place through a file mapping.
+LSTATUS Purge_HiveFile(const WCHAR* hivePath, const WCHAR* keyPath, const MATCHER* matcher, DWORD flags, DWORD* deleted);
+
+// Where a budgeted purge of one key stopped: the index of the next value
+// to read and a hash of the name just before it, examined and kept. Zeroed
+// means the start of the key.
+typedef struct _PURGE_CURSOR {
+    DWORD index;
+    DWORD lastName;
+} PURGE_CURSOR;
+
+// Purge_ValueNamesEx in place from |cursor| on, stopping once the
+// Time_Milliseconds() value |deadline| has passed: returns WAIT_TIMEOUT then,
+// with |cursor| set to resume from, or ERROR_SUCCESS with |cursor| zeroed
+// when the key is done. Values deleted by anyone between two calls don't
+// make it skip a value; a value added meanwhile is only seen if it lands
+// past the cursor, as the registry does when appending.
+LSTATUS Purge_ValueNamesUntil(REGKEY* key, const MATCHER* matcher, DWORD flags, DWORD deadline,
+    PURGE_CURSOR* cursor, PURGE_STATS* stats);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_PURGE_H_
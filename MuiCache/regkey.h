@@ -0,0 +1,64 @@
+// regkey.h: the few registry operations the purge logic needs, behind a
+// vtable so the same loop can run against the live registry (Win32 backend),
+// an offline hive file (hive backend) or an in-memory key (memory backend);
+// all but the first also build off Windows.
+// Status codes and buffer conventions follow RegEnumValue/RegDeleteValue.
+#ifndef MUICACHE_REGKEY_H_
+#define MUICACHE_REGKEY_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _REGKEY REGKEY;
+typedef struct _HIVE HIVE;
+
+typedef struct _REGKEY_VTBL {
+    // Any out pointer may be NULL.
+    LSTATUS (*QueryInfo)(REGKEY* key, DWORD* cValues, DWORD* cchMaxValue, DWORD* cbMaxValueData, FILETIME* ftLastWriteTime);
+    // |cchName| is the buffer size in chars on input and the name length
+    // (without NUL) on output. |type|, |data| and |cbData| may be NULL.
+    LSTATUS (*EnumValue)(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName, DWORD* type, BYTE* data, DWORD* cbData);
+    LSTATUS (*DeleteValue)(REGKEY* key, const WCHAR* name);
+    void (*Close)(REGKEY* key);
+    // Subkeys, for recursive purges. Both are NULL for backends without
+    // subkey access (hive). |cchName| as for EnumValue; the opened key has
+    // the parent's access and is released with Close.
+    LSTATUS (*EnumKey)(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName);
+    LSTATUS (*OpenSubKey)(REGKEY* key, const WCHAR* name, REGKEY** subKey);
+} REGKEY_VTBL;
+
+// Longest key name the registry allows, without the NUL.
+#define REGKEY_MAX_KEY_NAME 255
+
+struct _REGKEY {
+    const REGKEY_VTBL* vtbl;
+};
+
+#if defined(_WIN32)
+// Opens |path| under |root| with |samDesired| access.
+LSTATUS RegKey_OpenWin32(HKEY root, const WCHAR* path, REGSAM samDesired, REGKEY** key);
+#endif
+
+// Creates an empty key held in process memory. Values enumerate in insertion
+// order and deleting a value shifts the later indices down, like the registry.
+// Value and key names compare case-insensitively in the ASCII range.
+// Memory keys are reference counted: a parent holds its subkeys, and every
+// key returned here or by OpenSubKey is one more reference for Close.
+LSTATUS RegKey_CreateMemory(REGKEY** key);
+// Adds or replaces a value of a memory key.
+LSTATUS RegKey_MemorySetValue(REGKEY* key, const WCHAR* name, DWORD type, const BYTE* data, DWORD cbData);
+// Opens subkey |name| of a memory key, creating it if needed.
+LSTATUS RegKey_MemoryCreateSubKey(REGKEY* key, const WCHAR* name, REGKEY** subKey);
+
+// Opens |path| below the root key of an offline hive. The hive must outlive
+// the key; changes land in the hive buffer, see Hive_Commit.
+LSTATUS RegKey_OpenHive(HIVE* hive, const WCHAR* path, REGKEY** key);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_REGKEY_H_
@@ -0,0 +1,153 @@
+// REGKEY backend over a key of an offline hive (see hive.h).
+#include "regkey.h"
+#include "hive.h"
+
+struct HIVE_REGKEY
+{
+    REGKEY base;
+    HIVE* hive;
+    DWORD keyCell;
+    DWORD deleteHint; // index of the last delete, where the next lookup starts
+};
+
+static LSTATUS HiveKey_QueryInfo(REGKEY* key, DWORD* cValues, DWORD* cchMaxValue, DWORD* cbMaxValueData, FILETIME* ftLastWriteTime)
+{
+    HIVE_REGKEY* k = (HIVE_REGKEY*)key;
+    DWORD count = Hive_ValueCount(k->hive, k->keyCell);
+    DWORD cchMax = 0, cbMax = 0, i;
+    HIVE_VALUE value;
+
+    // The nk cell caches these maxima, but only as upper bounds in bytes;
+    // the value cells themselves are the truth.
+    if (cchMaxValue || cbMaxValueData)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            if (Hive_GetValue(k->hive, k->keyCell, i, &value) != ERROR_SUCCESS)
+                return ERROR_INVALID_DATA;
+            if (value.cchName > cchMax)
+                cchMax = value.cchName;
+            if (value.cbData > cbMax)
+                cbMax = value.cbData;
+        }
+    }
+    if (cValues)
+        *cValues = count;
+    if (cchMaxValue)
+        *cchMaxValue = cchMax;
+    if (cbMaxValueData)
+        *cbMaxValueData = cbMax;
+    if (ftLastWriteTime)
+        return Hive_KeyLastWriteTime(k->hive, k->keyCell, ftLastWriteTime);
+    return ERROR_SUCCESS;
+}
+
+static LSTATUS HiveKey_EnumValue(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName, DWORD* type, BYTE* data, DWORD* cbData)
+{
+    HIVE_REGKEY* k = (HIVE_REGKEY*)key;
+    HIVE_VALUE value;
+    LSTATUS status = Hive_GetValue(k->hive, k->keyCell, index, &value);
+    if (status != ERROR_SUCCESS)
+        return status;
+
+    if (*cchName <= value.cchName)
+    {
+        *cchName = value.cchName;
+        return ERROR_MORE_DATA;
+    }
+    Hive_CopyValueName(&value, name);
+    *cchName = value.cchName;
+
+    if (type)
+        *type = value.type;
+    if (cbData)
+    {
+        if (data && *cbData >= value.cbData)
+            status = Hive_ReadValueData(k->hive, &value, data);
+        else if (data)
+            status = ERROR_MORE_DATA;
+        *cbData = value.cbData;
+    }
+    return status;
+}
+
+static BOOL HiveKey_NameEquals(const HIVE_VALUE* value, const WCHAR* name, DWORD cch)
+{
+    DWORD i;
+    if (value->cchName != cch)
+        return FALSE;
+    for (i = 0; i < cch; ++i)
+    {
+        WCHAR a = value->compressedName ? (WCHAR)value->name[i] : (WCHAR)(value->name[i * 2] | (value->name[i * 2 + 1] << 8));
+        WCHAR b = name[i];
+        if (a >= 'a' && a <= 'z')
+            a = (WCHAR)(a - ('a' - 'A'));
+        if (b >= 'a' && b <= 'z')
+            b = (WCHAR)(b - ('a' - 'A'));
+        if (a != b)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static LSTATUS HiveKey_DeleteValue(REGKEY* key, const WCHAR* name)
+{
+    HIVE_REGKEY* k = (HIVE_REGKEY*)key;
+    DWORD count = Hive_ValueCount(k->hive, k->keyCell);
+    DWORD cch = Str_Length(name);
+    DWORD n, i;
+    HIVE_VALUE value;
+
+    // Batch deletes come in enumeration order, so the next victim is usually
+    // at or just after the previous one: start there and wrap around.
+    for (n = 0; n < count; ++n)
+    {
+        i = k->deleteHint + n;
+        if (i >= count)
+            i -= count;
+        if (Hive_GetValue(k->hive, k->keyCell, i, &value) != ERROR_SUCCESS)
+            return ERROR_INVALID_DATA;
+        if (HiveKey_NameEquals(&value, name, cch))
+        {
+            k->deleteHint = i;
+            return Hive_DeleteValue(k->hive, k->keyCell, i);
+        }
+    }
+    return ERROR_FILE_NOT_FOUND;
+}
+
+static void HiveKey_Close(REGKEY* key)
+{
+    Mem_Free(key);
+}
+
+static const REGKEY_VTBL Hive_RegKeyVtbl = {
+    HiveKey_QueryInfo,
+    HiveKey_EnumValue,
+    HiveKey_DeleteValue,
+    HiveKey_Close,
+    NULL, // EnumKey
+    NULL, // OpenSubKey
+};
+
+extern "C" LSTATUS RegKey_OpenHive(HIVE* hive, const WCHAR* path, REGKEY** key)
+{
+    HIVE_REGKEY* k;
+    DWORD cell;
+    LSTATUS status;
+
+    *key = NULL;
+    status = Hive_FindKey(hive, hive->rootCell, path, &cell);
+    if (status != ERROR_SUCCESS)
+        return status;
+
+    k = (HIVE_REGKEY*)Mem_Alloc(sizeof(HIVE_REGKEY));
+    if (!k)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    k->base.vtbl = &Hive_RegKeyVtbl;
+    k->hive = hive;
+    k->keyCell = cell;
+    k->deleteHint = 0;
+    *key = &k->base;
+    return ERROR_SUCCESS;
+}
@@ -0,0 +1,453 @@
+// In-memory REGKEY backend.
+// Values live in an append-only array in insertion order; deleted entries
+// stay behind as dead slots. A Fenwick tree over the live flags turns
+// "index-th live value" into an O(log n) lookup, so RegEnumValue-style
+// enumeration keeps the registry's shift-on-delete semantics without
+// moving anything. Name lookups go through an open-addressing hash table.
+// Subkeys are a plain array searched linearly: they exist to model a few
+// nested keys for recursive purges, not large trees.
+#include "regkey.h"
+
+struct MEM_VALUE
+{
+    WCHAR* name; // owns name and data in one allocation
+    DWORD cchName;
+    DWORD hash;
+    DWORD type;
+    BYTE* data;
+    DWORD cbData;
+    BOOL live;
+};
+
+struct MEM_REGKEY;
+
+struct MEM_SUBKEY
+{
+    WCHAR* name;
+    DWORD cchName;
+    MEM_REGKEY* key; // one reference held by the parent
+};
+
+struct MEM_REGKEY
+{
+    REGKEY base;
+    volatile LONG refs;
+    MEM_SUBKEY* subkeys;
+    DWORD subkeyCount;
+    DWORD subkeyCapacity;
+    MEM_VALUE* values;
+    DWORD count;    // used slots, dead ones included
+    DWORD capacity;
+    DWORD live;
+    DWORD* tree;    // Fenwick tree over live flags, 1-based, |capacity| + 1 entries
+    DWORD* table;   // value index + 1, 0 when empty
+    DWORD tableSize;
+    DWORD cchMaxValue;
+    DWORD cbMaxValueData;
+    DWORD stamp;    // bumped on every change, reported as the last write time
+};
+
+static __inline WCHAR Mem_FoldChar(WCHAR ch)
+{
+    return (ch >= 'a' && ch <= 'z') ? (WCHAR)(ch - ('a' - 'A')) : ch;
+}
+
+static DWORD Mem_HashName(const WCHAR* name, DWORD cch)
+{
+    DWORD h = 2166136261u; // FNV-1a
+    DWORD i;
+    for (i = 0; i < cch; ++i)
+    {
+        h ^= Mem_FoldChar(name[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static BOOL Mem_NameEquals(const MEM_VALUE* v, const WCHAR* name, DWORD cch)
+{
+    DWORD i;
+    if (v->cchName != cch)
+        return FALSE;
+    for (i = 0; i < cch; ++i)
+    {
+        if (Mem_FoldChar(v->name[i]) != Mem_FoldChar(name[i]))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void Mem_TreeAdd(MEM_REGKEY* k, DWORD index, LONG delta)
+{
+    DWORD i;
+    for (i = index + 1; i <= k->capacity; i += i & (0 - i))
+        k->tree[i] += (DWORD)delta;
+}
+
+// Returns the slot of the |n|-th (0-based) live value; caller checks n < live.
+static DWORD Mem_TreeSelect(const MEM_REGKEY* k, DWORD n)
+{
+    DWORD pos = 0, step = 1;
+    while ((step << 1) <= k->capacity)
+        step <<= 1;
+    for (; step; step >>= 1)
+    {
+        if (pos + step <= k->capacity && k->tree[pos + step] <= n)
+        {
+            pos += step;
+            n -= k->tree[pos];
+        }
+    }
+    return pos; // slots before the match, i.e. its 0-based index
+}
+
+// Returns the slot holding live value |name|, or (DWORD)-1.
+static DWORD Mem_Find(const MEM_REGKEY* k, const WCHAR* name, DWORD cch, DWORD hash)
+{
+    DWORD mask = k->tableSize - 1;
+    DWORD i, slot;
+    if (!k->tableSize)
+        return (DWORD)-1;
+    for (i = hash & mask; (slot = k->table[i]) != 0; i = (i + 1) & mask)
+    {
+        const MEM_VALUE* v = &k->values[slot - 1];
+        if (v->live && v->hash == hash && Mem_NameEquals(v, name, cch))
+            return slot - 1;
+    }
+    return (DWORD)-1;
+}
+
+static void Mem_TableInsert(MEM_REGKEY* k, DWORD slot)
+{
+    DWORD mask = k->tableSize - 1;
+    DWORD i;
+    for (i = k->values[slot].hash & mask; k->table[i]; i = (i + 1) & mask)
+        ;
+    k->table[i] = slot + 1;
+}
+
+// Makes room for one more slot: grows the value array and the Fenwick tree,
+// and rehashes the live values when the table gets half full.
+static BOOL Mem_Reserve(MEM_REGKEY* k)
+{
+    DWORD* tree;
+    DWORD i;
+    if (k->count == k->capacity)
+    {
+        DWORD capacity = k->capacity ? k->capacity * 2 : 64;
+        MEM_VALUE* values = (MEM_VALUE*)Mem_Realloc(k->values, capacity * sizeof(MEM_VALUE));
+        if (!values)
+            return FALSE;
+        k->values = values;
+        tree = (DWORD*)Mem_Alloc((capacity + 1) * sizeof(DWORD));
+        if (!tree)
+            return FALSE;
+        memset(tree, 0, (capacity + 1) * sizeof(DWORD));
+        Mem_Free(k->tree);
+        k->tree = tree;
+        k->capacity = capacity;
+        for (i = 0; i < k->count; ++i)
+        {
+            if (k->values[i].live)
+                Mem_TreeAdd(k, i, 1);
+        }
+    }
+    if ((k->count + 1) * 2 > k->tableSize)
+    {
+        DWORD tableSize = k->tableSize ? k->tableSize * 2 : 128;
+        DWORD* table = (DWORD*)Mem_Alloc(tableSize * sizeof(DWORD));
+        if (!table)
+            return FALSE;
+        memset(table, 0, tableSize * sizeof(DWORD));
+        Mem_Free(k->table);
+        k->table = table;
+        k->tableSize = tableSize;
+        for (i = 0; i < k->count; ++i)
+        {
+            if (k->values[i].live)
+                Mem_TableInsert(k, i);
+        }
+    }
+    return TRUE;
+}
+
+static void Mem_Kill(MEM_REGKEY* k, DWORD slot)
+{
+    MEM_VALUE* v = &k->values[slot];
+    v->live = FALSE;
+    Mem_Free(v->name);
+    v->name = NULL;
+    v->data = NULL;
+    Mem_TreeAdd(k, slot, -1);
+    --k->live;
+    ++k->stamp;
+}
+
+static LSTATUS Mem_QueryInfo(REGKEY* key, DWORD* cValues, DWORD* cchMaxValue, DWORD* cbMaxValueData, FILETIME* ftLastWriteTime)
+{
+    MEM_REGKEY* k = (MEM_REGKEY*)key;
+    if (cValues)
+        *cValues = k->live;
+    if (cchMaxValue)
+        *cchMaxValue = k->cchMaxValue;
+    if (cbMaxValueData)
+        *cbMaxValueData = k->cbMaxValueData;
+    if (ftLastWriteTime)
+    {
+        ftLastWriteTime->dwLowDateTime = k->stamp;
+        ftLastWriteTime->dwHighDateTime = 0;
+    }
+    return ERROR_SUCCESS;
+}
+
+static LSTATUS Mem_EnumValue(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName, DWORD* type, BYTE* data, DWORD* cbData)
+{
+    MEM_REGKEY* k = (MEM_REGKEY*)key;
+    const MEM_VALUE* v;
+    LSTATUS status = ERROR_SUCCESS;
+
+    if (index >= k->live)
+        return ERROR_NO_MORE_ITEMS;
+    v = &k->values[Mem_TreeSelect(k, index)];
+
+    if (*cchName <= v->cchName)
+    {
+        *cchName = v->cchName;
+        return ERROR_MORE_DATA;
+    }
+    memcpy(name, v->name, v->cchName * sizeof(WCHAR));
+    name[v->cchName] = 0;
+    *cchName = v->cchName;
+
+    if (type)
+        *type = v->type;
+    if (cbData)
+    {
+        if (data && *cbData >= v->cbData)
+            memcpy(data, v->data, v->cbData);
+        else if (data)
+            status = ERROR_MORE_DATA;
+        *cbData = v->cbData;
+    }
+    return status;
+}
+
+static LSTATUS Mem_DeleteValue(REGKEY* key, const WCHAR* name)
+{
+    MEM_REGKEY* k = (MEM_REGKEY*)key;
+    DWORD cch = Str_Length(name);
+    DWORD slot = Mem_Find(k, name, cch, Mem_HashName(name, cch));
+    if (slot == (DWORD)-1)
+        return ERROR_FILE_NOT_FOUND;
+    Mem_Kill(k, slot);
+    return ERROR_SUCCESS;
+}
+
+static void Mem_Close(REGKEY* key)
+{
+    MEM_REGKEY* k = (MEM_REGKEY*)key;
+    DWORD i;
+    if (Atomic_Add(&k->refs, -1) != 0)
+        return;
+    for (i = 0; i < k->subkeyCount; ++i)
+    {
+        Mem_Free(k->subkeys[i].name);
+        Mem_Close(&k->subkeys[i].key->base);
+    }
+    for (i = 0; i < k->count; ++i)
+        Mem_Free(k->values[i].name);
+    Mem_Free(k->subkeys);
+    Mem_Free(k->values);
+    Mem_Free(k->tree);
+    Mem_Free(k->table);
+    Mem_Free(k);
+}
+
+static LSTATUS Mem_EnumKey(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName)
+{
+    MEM_REGKEY* k = (MEM_REGKEY*)key;
+    const MEM_SUBKEY* sub;
+
+    if (index >= k->subkeyCount)
+        return ERROR_NO_MORE_ITEMS;
+    sub = &k->subkeys[index];
+    if (*cchName <= sub->cchName)
+    {
+        *cchName = sub->cchName;
+        return ERROR_MORE_DATA;
+    }
+    memcpy(name, sub->name, sub->cchName * sizeof(WCHAR));
+    name[sub->cchName] = 0;
+    *cchName = sub->cchName;
+    return ERROR_SUCCESS;
+}
+
+static MEM_REGKEY* Mem_NewKey(void);
+
+// Finds the direct subkey |name|, or adds it when |create| is set.
+// Returns NULL if it doesn't exist or memory ran out.
+static MEM_REGKEY* Mem_Child(MEM_REGKEY* k, const WCHAR* name, DWORD cch, BOOL create)
+{
+    MEM_SUBKEY* sub;
+    DWORD i, j;
+
+    for (i = 0; i < k->subkeyCount; ++i)
+    {
+        sub = &k->subkeys[i];
+        if (sub->cchName != cch)
+            continue;
+        for (j = 0; j < cch && Mem_FoldChar(sub->name[j]) == Mem_FoldChar(name[j]); ++j)
+            ;
+        if (j == cch)
+            return sub->key;
+    }
+    if (!create)
+        return NULL;
+
+    if (k->subkeyCount == k->subkeyCapacity)
+    {
+        DWORD capacity = k->subkeyCapacity ? k->subkeyCapacity * 2 : 4;
+        MEM_SUBKEY* subkeys = (MEM_SUBKEY*)Mem_Realloc(k->subkeys, capacity * sizeof(MEM_SUBKEY));
+        if (!subkeys)
+            return NULL;
+        k->subkeys = subkeys;
+        k->subkeyCapacity = capacity;
+    }
+    sub = &k->subkeys[k->subkeyCount];
+    sub->name = (WCHAR*)Mem_Alloc((cch + 1) * sizeof(WCHAR));
+    sub->key = Mem_NewKey();
+    if (!sub->name || !sub->key)
+    {
+        Mem_Free(sub->name);
+        Mem_Free(sub->key);
+        return NULL;
+    }
+    memcpy(sub->name, name, cch * sizeof(WCHAR));
+    sub->name[cch] = 0;
+    sub->cchName = cch;
+    ++k->subkeyCount;
+    ++k->stamp;
+    return sub->key;
+}
+
+// Walks a '\'-separated |path| below |k|; an empty path is |k| itself.
+// On success the key returned carries a new reference.
+static LSTATUS Mem_OpenPath(MEM_REGKEY* k, const WCHAR* path, BOOL create, REGKEY** subKey)
+{
+    const WCHAR* end;
+    *subKey = NULL;
+    while (*path)
+    {
+        for (end = path; *end && *end != '\\'; ++end)
+            ;
+        if (end != path)
+        {
+            k = Mem_Child(k, path, (DWORD)(end - path), create);
+            if (!k)
+                return create ? ERROR_NOT_ENOUGH_MEMORY : ERROR_FILE_NOT_FOUND;
+        }
+        path = *end ? end + 1 : end;
+    }
+    Atomic_Increment(&k->refs);
+    *subKey = &k->base;
+    return ERROR_SUCCESS;
+}
+
+static LSTATUS Mem_OpenSubKey(REGKEY* key, const WCHAR* name, REGKEY** subKey)
+{
+    return Mem_OpenPath((MEM_REGKEY*)key, name, FALSE, subKey);
+}
+
+static const REGKEY_VTBL Mem_RegKeyVtbl = {
+    Mem_QueryInfo,
+    Mem_EnumValue,
+    Mem_DeleteValue,
+    Mem_Close,
+    Mem_EnumKey,
+    Mem_OpenSubKey,
+};
+
+// A key with one reference, for its creator or its parent.
+static MEM_REGKEY* Mem_NewKey(void)
+{
+    MEM_REGKEY* k = (MEM_REGKEY*)Mem_Alloc(sizeof(MEM_REGKEY));
+    if (!k)
+        return NULL;
+    memset(k, 0, sizeof(MEM_REGKEY));
+    k->base.vtbl = &Mem_RegKeyVtbl;
+    k->refs = 1;
+    return k;
+}
+
+extern "C" LSTATUS RegKey_CreateMemory(REGKEY** key)
+{
+    MEM_REGKEY* k = Mem_NewKey();
+    *key = k ? &k->base : NULL;
+    return k ? ERROR_SUCCESS : ERROR_NOT_ENOUGH_MEMORY;
+}
+
+extern "C" LSTATUS RegKey_MemoryCreateSubKey(REGKEY* key, const WCHAR* name, REGKEY** subKey)
+{
+    *subKey = NULL;
+    if (key->vtbl != &Mem_RegKeyVtbl)
+        return ERROR_INVALID_PARAMETER;
+    return Mem_OpenPath((MEM_REGKEY*)key, name, TRUE, subKey);
+}
+
+extern "C" LSTATUS RegKey_MemorySetValue(REGKEY* key, const WCHAR* name, DWORD type, const BYTE* data, DWORD cbData)
+{
+    MEM_REGKEY* k = (MEM_REGKEY*)key;
+    DWORD cch = Str_Length(name);
+    DWORD hash = Mem_HashName(name, cch);
+    DWORD slot;
+    MEM_VALUE* v;
+    WCHAR* block;
+
+    if (key->vtbl != &Mem_RegKeyVtbl)
+        return ERROR_INVALID_PARAMETER;
+
+    // Replacing an existing value keeps its enumeration position, as
+    // RegSetValueEx does.
+    slot = Mem_Find(k, name, cch, hash);
+    block = (WCHAR*)Mem_Alloc((cch + 1) * sizeof(WCHAR) + cbData);
+    if (!block)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memcpy(block, name, cch * sizeof(WCHAR));
+    block[cch] = 0;
+    if (cbData)
+        memcpy(block + cch + 1, data, cbData);
+
+    if (slot == (DWORD)-1)
+    {
+        if (!Mem_Reserve(k))
+        {
+            Mem_Free(block);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        slot = k->count++;
+        v = &k->values[slot];
+        v->live = TRUE;
+        v->hash = hash;
+        Mem_TreeAdd(k, slot, 1);
+        Mem_TableInsert(k, slot);
+        ++k->live;
+    }
+    else
+    {
+        v = &k->values[slot];
+        Mem_Free(v->name);
+    }
+
+    v->name = block;
+    v->cchName = cch;
+    v->hash = hash;
+    v->type = type;
+    v->data = (BYTE*)(block + cch + 1);
+    v->cbData = cbData;
+    if (cch > k->cchMaxValue)
+        k->cchMaxValue = cch;
+    if (cbData > k->cbMaxValueData)
+        k->cbMaxValueData = cbData;
+    ++k->stamp;
+    return ERROR_SUCCESS;
+}
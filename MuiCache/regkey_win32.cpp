@@ -0,0 +1,81 @@
+// REGKEY backend over an open HKEY.
+#include "regkey.h"
+#include "trace.h"
+
+struct WIN32_REGKEY
+{
+    REGKEY base;
+    HKEY hKey;
+    REGSAM samDesired;
+};
+
+static LSTATUS Win32_QueryInfo(REGKEY* key, DWORD* cValues, DWORD* cchMaxValue, DWORD* cbMaxValueData, FILETIME* ftLastWriteTime)
+{
+    return RegQueryInfoKeyW(((WIN32_REGKEY*)key)->hKey, NULL, NULL, NULL, NULL, NULL, NULL,
+        cValues, cchMaxValue, cbMaxValueData, NULL, ftLastWriteTime);
+}
+
+static LSTATUS Win32_EnumValue(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName, DWORD* type, BYTE* data, DWORD* cbData)
+{
+    LSTATUS status;
+    MC_TRACE(TRACE_OP_REG_ENUM_VALUE,
+        status = RegEnumValueW(((WIN32_REGKEY*)key)->hKey, index, name, cchName, NULL, type, data, cbData));
+    return status;
+}
+
+static LSTATUS Win32_DeleteValue(REGKEY* key, const WCHAR* name)
+{
+    LSTATUS status;
+    MC_TRACE(TRACE_OP_REG_DELETE_VALUE, status = RegDeleteValueW(((WIN32_REGKEY*)key)->hKey, name));
+    return status;
+}
+
+static void Win32_Close(REGKEY* key)
+{
+    RegCloseKey(((WIN32_REGKEY*)key)->hKey);
+    Mem_Free(key);
+}
+
+static LSTATUS Win32_EnumKey(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName)
+{
+    return RegEnumKeyExW(((WIN32_REGKEY*)key)->hKey, index, name, cchName, NULL, NULL, NULL, NULL);
+}
+
+static LSTATUS Win32_OpenSubKey(REGKEY* key, const WCHAR* name, REGKEY** subKey)
+{
+    WIN32_REGKEY* k = (WIN32_REGKEY*)key;
+    return RegKey_OpenWin32(k->hKey, name, k->samDesired, subKey);
+}
+
+static const REGKEY_VTBL Win32_RegKeyVtbl = {
+    Win32_QueryInfo,
+    Win32_EnumValue,
+    Win32_DeleteValue,
+    Win32_Close,
+    Win32_EnumKey,
+    Win32_OpenSubKey,
+};
+
+extern "C" LSTATUS RegKey_OpenWin32(HKEY root, const WCHAR* path, REGSAM samDesired, REGKEY** key)
+{
+    WIN32_REGKEY* k;
+    HKEY hKey;
+    LSTATUS status;
+
+    *key = NULL;
+    status = RegOpenKeyExW(root, path, 0, samDesired, &hKey);
+    if (status != ERROR_SUCCESS)
+        return status;
+
+    k = (WIN32_REGKEY*)Mem_Alloc(sizeof(WIN32_REGKEY));
+    if (!k)
+    {
+        RegCloseKey(hKey);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    k->base.vtbl = &Win32_RegKeyVtbl;
+    k->hKey = hKey;
+    k->samDesired = samDesired;
+    *key = &k->base;
+    return ERROR_SUCCESS;
+}
@@ -0,0 +1,158 @@
+// Text rendering of TARGETS_PURGE statistics.
+// Counters are DWORDs, so the decimal conversion only ever divides 32-bit
+// values: no 64-bit helpers are pulled in on x86 without the CRT.
+#include "report.h"
+#include "fileio.h"
+
+#define REPORT_INITIAL_CAPACITY 256
+
+extern "C" void Report_Init(REPORT* report)
+{
+    memset(report, 0, sizeof(REPORT));
+}
+
+extern "C" void Report_Free(REPORT* report)
+{
+    Mem_Free(report->chars);
+    Report_Init(report);
+}
+
+static BOOL Report_Reserve(REPORT* report, DWORD cch)
+{
+    DWORD capacity;
+    char* chars;
+
+    if (report->failed)
+        return FALSE;
+    if (report->cch + cch + 1 <= report->capacity)
+        return TRUE;
+    capacity = report->capacity ? report->capacity : REPORT_INITIAL_CAPACITY;
+    while (capacity < report->cch + cch + 1)
+        capacity *= 2;
+    chars = (char*)Mem_Realloc(report->chars, capacity);
+    if (!chars)
+    {
+        report->failed = TRUE;
+        return FALSE;
+    }
+    report->chars = chars;
+    report->capacity = capacity;
+    return TRUE;
+}
+
+extern "C" void Report_Append(REPORT* report, const char* s)
+{
+    DWORD cch = 0;
+    while (s[cch])
+        ++cch;
+    if (!Report_Reserve(report, cch))
+        return;
+    memcpy(report->chars + report->cch, s, cch + 1);
+    report->cch += cch;
+}
+
+extern "C" void Report_AppendDword(REPORT* report, DWORD value)
+{
+    char digits[11];
+    DWORD i = sizeof(digits) - 1;
+
+    digits[i] = '\0';
+    do
+    {
+        digits[--i] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    Report_Append(report, digits + i);
+}
+
+static void Report_AppendStatus(REPORT* report, LSTATUS status)
+{
+    if (status < 0)
+    {
+        Report_Append(report, "-");
+        Report_AppendDword(report, (DWORD)0 - (DWORD)status);
+    }
+    else
+    {
+        Report_AppendDword(report, (DWORD)status);
+    }
+}
+
+// Each field is preceded by |pre| and followed by |post|, e.g. " " and "="
+// for the compact form, "\"" and "\":" for JSON.
+static void Report_AppendField(REPORT* report, const char* pre, const char* name, const char* post, DWORD value)
+{
+    Report_Append(report, pre);
+    Report_Append(report, name);
+    Report_Append(report, post);
+    Report_AppendDword(report, value);
+}
+
+static void Report_AppendStats(REPORT* report, const char* pre, const char* post, const PURGE_STATS* stats)
+{
+    Report_AppendField(report, pre, "enumerated", post, stats->enumerated);
+    Report_AppendField(report, pre, "bytes", post, stats->bytesRead);
+    Report_AppendField(report, pre, "matched", post, stats->matched);
+    Report_AppendField(report, pre, "deleted", post, stats->deleted);
+    Report_AppendField(report, pre, "failed", post, stats->failed);
+}
+
+extern "C" void Report_FormatCompact(REPORT* report, const PURGE_TARGET* targets, const TARGETS_PURGE* purge,
+    DWORD count)
+{
+    DWORD i;
+
+    for (i = 0; i < count; ++i)
+    {
+        const TARGET_RESULT* result = &purge->results[i];
+        Report_Append(report, targets[i].name);
+        Report_Append(report, " status=");
+        Report_AppendStatus(report, result->status);
+        Report_AppendStats(report, " ", "=", &result->stats);
+        Report_AppendField(report, " ", "ms", "=", result->milliseconds);
+        Report_Append(report, ";");
+    }
+    Report_Append(report, "total status=");
+    Report_AppendStatus(report, purge->firstError);
+    Report_AppendStats(report, " ", "=", &purge->totals);
+    Report_AppendField(report, " ", "ms", "=", purge->milliseconds);
+}
+
+extern "C" void Report_FormatJson(REPORT* report, const PURGE_TARGET* targets, const TARGETS_PURGE* purge,
+    DWORD count, BOOL dryRun)
+{
+    DWORD i;
+
+    Report_Append(report, dryRun ? "{\"dryRun\":true" : "{\"dryRun\":false");
+    Report_AppendField(report, ",\"", "milliseconds", "\":", purge->milliseconds);
+    Report_AppendField(report, ",\"", "workers", "\":", purge->workers);
+    Report_Append(report, ",\"targets\":[");
+    for (i = 0; i < count; ++i)
+    {
+        const TARGET_RESULT* result = &purge->results[i];
+        Report_Append(report, i ? ",{\"name\":\"" : "{\"name\":\"");
+        Report_Append(report, targets[i].name);
+        Report_Append(report, "\",\"status\":");
+        Report_AppendStatus(report, result->status);
+        Report_AppendStats(report, ",\"", "\":", &result->stats);
+        Report_AppendField(report, ",\"", "keys", "\":", result->keys);
+        Report_Append(report, result->skipped ? ",\"skipped\":true" : ",\"skipped\":false");
+        Report_AppendField(report, ",\"", "milliseconds", "\":", result->milliseconds);
+        Report_Append(report, "}");
+    }
+    Report_Append(report, "],\"totals\":{\"status\":");
+    Report_AppendStatus(report, purge->firstError);
+    Report_AppendStats(report, ",\"", "\":", &purge->totals);
+    Report_AppendField(report, ",\"", "purged", "\":", purge->purged);
+    Report_AppendField(report, ",\"", "skipped", "\":", purge->skipped);
+    Report_AppendField(report, ",\"", "missing", "\":", purge->missing);
+    Report_AppendField(report, ",\"", "failedTargets", "\":", purge->failed);
+    Report_Append(report, "}}\n");
+}
+
+extern "C" LSTATUS Report_Write(const REPORT* report, const WCHAR* path)
+{
+    if (report->failed)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    return File_WriteAll(path, (const BYTE*)report->chars, report->cch);
+}
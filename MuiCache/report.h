@@ -0,0 +1,42 @@
+// report.h: purge statistics as text, a compact one-line form for the NSIS
+// stack and a JSON document for report files. Both are built in a growable
+// ASCII buffer; target names are ASCII labels, so nothing needs escaping.
+#ifndef MUICACHE_REPORT_H_
+#define MUICACHE_REPORT_H_
+
+#include "platform.h"
+#include "targets.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _REPORT {
+    char* chars; // NUL-terminated once anything was appended
+    DWORD cch;
+    DWORD capacity;
+    BOOL failed; // an allocation failed; the text is truncated
+} REPORT;
+
+void Report_Init(REPORT* report);
+void Report_Free(REPORT* report);
+void Report_Append(REPORT* report, const char* s);
+void Report_AppendDword(REPORT* report, DWORD value);
+
+// "<name> status=0 enumerated=12 bytes=480 matched=2 deleted=2 failed=0 ms=1"
+// per target, separated by ';', then "total ..." with the summed counters.
+void Report_FormatCompact(REPORT* report, const PURGE_TARGET* targets, const TARGETS_PURGE* purge, DWORD count);
+
+// {"dryRun":false,"milliseconds":3,"targets":[{"name":"MuiCache",...}],
+//  "totals":{...}}
+void Report_FormatJson(REPORT* report, const PURGE_TARGET* targets, const TARGETS_PURGE* purge, DWORD count,
+    BOOL dryRun);
+
+// Writes the report to |path|. ERROR_NOT_ENOUGH_MEMORY if it was truncated.
+LSTATUS Report_Write(const REPORT* report, const WCHAR* path);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_REPORT_H_
@@ -0,0 +1,89 @@
+#include "shellnotify.h"
+
+#define NOTIFY_TAG_CREATED 'C'
+#define NOTIFY_TAG_UPDATED 'U'
+
+static void Recorder_Notify(SHELL_NOTIFIER* notifier, LONG eventId, const WCHAR* path)
+{
+    SHELL_NOTIFY_RECORDER* recorder = (SHELL_NOTIFY_RECORDER*)notifier;
+    (void)path;
+    ++recorder->total;
+    if (eventId == SHELL_NOTIFY_CREATE)
+        ++recorder->created;
+    else if (eventId == SHELL_NOTIFY_UPDATEITEM)
+        ++recorder->updated;
+    else if (eventId == SHELL_NOTIFY_ASSOCCHANGED)
+        ++recorder->assocChanged;
+}
+
+static const SHELL_NOTIFIER_VTBL Recorder_Vtbl = {
+    Recorder_Notify,
+};
+
+extern "C" void NotifyRecorder_Init(SHELL_NOTIFY_RECORDER* recorder)
+{
+    memset(recorder, 0, sizeof(SHELL_NOTIFY_RECORDER));
+    recorder->base.vtbl = &Recorder_Vtbl;
+}
+
+extern "C" void NotifyBatch_Init(SHELL_NOTIFY_BATCH* batch, SHELL_NOTIFIER* sink, DWORD itemLimit)
+{
+    memset(batch, 0, sizeof(SHELL_NOTIFY_BATCH));
+    batch->sink = sink;
+    batch->itemLimit = itemLimit;
+}
+
+extern "C" void NotifyBatch_Add(SHELL_NOTIFY_BATCH* batch, const WCHAR* path, BOOL created)
+{
+    DWORD cch = Str_Length(path);
+
+    ++batch->count;
+    if (batch->overflow)
+        return;
+    if (batch->count > batch->itemLimit)
+    {
+        // Past the limit only the one ASSOCCHANGED remains; stop keeping paths.
+        batch->overflow = TRUE;
+        return;
+    }
+
+    if (batch->used + cch + 2 > batch->capacity)
+    {
+        DWORD capacity = (batch->used + cch + 2) * 2;
+        WCHAR* entries = (WCHAR*)Mem_Realloc(batch->entries, capacity * sizeof(WCHAR));
+        if (!entries)
+        {
+            batch->overflow = TRUE;
+            return;
+        }
+        batch->entries = entries;
+        batch->capacity = capacity;
+    }
+    batch->entries[batch->used++] = created ? NOTIFY_TAG_CREATED : NOTIFY_TAG_UPDATED;
+    memcpy(batch->entries + batch->used, path, cch * sizeof(WCHAR));
+    batch->used += cch;
+    batch->entries[batch->used++] = 0;
+}
+
+extern "C" void NotifyBatch_Flush(SHELL_NOTIFY_BATCH* batch)
+{
+    DWORD pos;
+    const WCHAR* entry;
+
+    if (batch->overflow)
+        batch->sink->vtbl->Notify(batch->sink, SHELL_NOTIFY_ASSOCCHANGED, NULL);
+    else
+    {
+        for (pos = 0; pos < batch->used; pos += Str_Length(entry + 1) + 2)
+        {
+            entry = batch->entries + pos;
+            batch->sink->vtbl->Notify(batch->sink,
+                entry[0] == NOTIFY_TAG_CREATED ? SHELL_NOTIFY_CREATE : SHELL_NOTIFY_UPDATEITEM, entry + 1);
+        }
+    }
+
+    Mem_Free(batch->entries);
+    batch->entries = NULL;
+    batch->used = batch->capacity = batch->count = 0;
+    batch->overflow = FALSE;
+}
@@ -0,0 +1,64 @@
+// shellnotify.h: deferred SHChangeNotify for bulk shortcut writes.
+// Writers report each created/updated path to a SHELL_NOTIFY_BATCH; Flush
+// then sends per-item events when there are only a few, or a single
+// SHCNE_ASSOCCHANGED otherwise, through a SHELL_NOTIFIER sink.
+#ifndef MUICACHE_SHELLNOTIFY_H_
+#define MUICACHE_SHELLNOTIFY_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// SHCNE_* values, spelled out so the batching builds without shlobj.h.
+#define SHELL_NOTIFY_CREATE       0x00000002L
+#define SHELL_NOTIFY_UPDATEITEM   0x00002000L
+#define SHELL_NOTIFY_ASSOCCHANGED 0x08000000L
+
+// Up to this many paths are announced one by one.
+#define SHELL_NOTIFY_ITEM_LIMIT 8
+
+typedef struct _SHELL_NOTIFIER SHELL_NOTIFIER;
+
+typedef struct _SHELL_NOTIFIER_VTBL {
+    // |path| is NULL for SHELL_NOTIFY_ASSOCCHANGED.
+    void (*Notify)(SHELL_NOTIFIER* notifier, LONG eventId, const WCHAR* path);
+} SHELL_NOTIFIER_VTBL;
+
+struct _SHELL_NOTIFIER {
+    const SHELL_NOTIFIER_VTBL* vtbl;
+};
+
+// Counts events instead of sending them, for checking what a batch emits.
+typedef struct _SHELL_NOTIFY_RECORDER {
+    SHELL_NOTIFIER base;
+    DWORD total;
+    DWORD created;
+    DWORD updated;
+    DWORD assocChanged;
+} SHELL_NOTIFY_RECORDER;
+
+void NotifyRecorder_Init(SHELL_NOTIFY_RECORDER* recorder);
+
+typedef struct _SHELL_NOTIFY_BATCH {
+    SHELL_NOTIFIER* sink;
+    DWORD itemLimit;
+    DWORD count;
+    BOOL overflow; // more than |itemLimit| paths, or out of memory
+    WCHAR* entries; // packed: event tag, path, NUL
+    DWORD used;
+    DWORD capacity;
+} SHELL_NOTIFY_BATCH;
+
+void NotifyBatch_Init(SHELL_NOTIFY_BATCH* batch, SHELL_NOTIFIER* sink, DWORD itemLimit);
+// Records that |path| was written; |created| if it didn't exist before.
+void NotifyBatch_Add(SHELL_NOTIFY_BATCH* batch, const WCHAR* path, BOOL created);
+// Sends the coalesced events and empties the batch.
+void NotifyBatch_Flush(SHELL_NOTIFY_BATCH* batch);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_SHELLNOTIFY_H_
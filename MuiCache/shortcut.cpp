@@ -3,12 +3,20 @@
 // found in the LICENSE file.
 
 #include "shortcut.h"
+#include "lnkfile.h"
+#include "lnkprops.h"
+#include "propstage.h"
+#include "lnkbatch.h"
+#include "fileio.h"
+#include "shellnotify.h"
+#include "trace.h"
 
 #if defined(_DEBUG)
 #pragma comment(lib, "Propsys.lib")
 #endif
 
 extern "C" void* __cdecl memset(void *p, int c, size_t z);
+extern "C" void* __cdecl memcpy(void *d, const void *s, size_t z);
 
 static bool is_file_exists(LPCTSTR filename)
 {
@@ -436,63 +444,71 @@ private:
 
 namespace
 {
-// Sets the value of |property_key| to |property_value| in |property_store|.
-bool SetPropVariantValueForPropertyStore(IPropertyStore* property_store, const PROPERTYKEY& property_key, const ScopedPropVariant& property_value)
-{
-  // DCHECK(property_store);
-  HRESULT result = property_store->SetValue(property_key, property_value.get());
-  if (result == S_OK)
-    result = property_store->Commit();
-  if (SUCCEEDED(result))
-    return true;
-  // #if DCHECK_IS_ON()
-  if (HRESULT_FACILITY(result) == FACILITY_WIN32)
-    ::SetLastError(HRESULT_CODE(result));
-  // See third_party/perl/c/i686-w64-mingw32/include/propkey.h for GUID and
-  // PID definitions.
-  // DPLOG(ERROR) << "Failed to set property with GUID " << WStringFromGUID(property_key.fmtid) << " PID " << property_key.pid;
-  // #endif
-  return false;
-}
+// A PROPERTY_WRITER over a link's IPropertyStore. Values are only set here;
+// PropertyStage_Apply commits them all at once.
+struct PropertyStoreWriter
+{
+  PROPERTY_WRITER base;
+  IPropertyStore* property_store;
+};
 
-bool SetStringValueForPropertyStore(IPropertyStore* property_store, const PROPERTYKEY& property_key, const wchar_t* property_string_value)
+// Sets the value of (|fmtid|, |pid|) to |property_value| without committing.
+HRESULT SetPropVariantValueForPropertyStore(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, const ScopedPropVariant& property_value)
 {
-  ScopedPropVariant property_value;
-  if (FAILED(InitPropVariantFromString(property_string_value, property_value.Receive())))
-  {
-    return false;
-  }
-  return SetPropVariantValueForPropertyStore(property_store, property_key, property_value);
+  PROPERTYKEY property_key;
+  // LNK_FMTID holds the GUID as stored, which is its in-memory layout here.
+  memcpy(&property_key.fmtid, fmtid->bytes, sizeof(property_key.fmtid));
+  property_key.pid = pid;
+  HRESULT result = reinterpret_cast<PropertyStoreWriter*>(writer)->property_store->SetValue(property_key, property_value.get());
+  return result == S_OK || FAILED(result) ? result : E_FAIL;
 }
 
-bool SetAppIdForPropertyStore(IPropertyStore* property_store, const wchar_t* app_id)
+HRESULT SetStringValueForPropertyStore(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, const WCHAR* property_string_value)
 {
-  // App id should be less than 128 chars and contain no space. And recommended
-  // format is CompanyName.ProductName[.SubProduct.ProductNumber].
-  // See
+  // For the app id: less than 128 chars and no space; recommended format is
+  // CompanyName.ProductName[.SubProduct.ProductNumber]. See
   // https://docs.microsoft.com/en-us/windows/win32/shell/appids#how-to-form-an-application-defined-appusermodelid
-  // DCHECK_LT(lstrlen(app_id), 128);
-  // DCHECK_EQ(wcschr(app_id, L' '), nullptr);
-  return SetStringValueForPropertyStore(property_store, PKEY_AppUserModel_ID, app_id);
+  ScopedPropVariant property_value;
+  HRESULT result = InitPropVariantFromString(property_string_value, property_value.Receive());
+  if (FAILED(result))
+    return result;
+  return SetPropVariantValueForPropertyStore(writer, fmtid, pid, property_value);
 }
-bool SetBooleanValueForPropertyStore(IPropertyStore* property_store, const PROPERTYKEY& property_key, bool property_bool_value)
+
+HRESULT SetBooleanValueForPropertyStore(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, BOOL property_bool_value)
 {
   ScopedPropVariant property_value;
-  if (FAILED(InitPropVariantFromBoolean(property_bool_value, property_value.Receive())))
-  {
-    return false;
-  }
-  return SetPropVariantValueForPropertyStore(property_store, property_key, property_value);
+  HRESULT result = InitPropVariantFromBoolean(property_bool_value, property_value.Receive());
+  if (FAILED(result))
+    return result;
+  return SetPropVariantValueForPropertyStore(writer, fmtid, pid, property_value);
 }
-bool SetClsidForPropertyStore(IPropertyStore* property_store, const PROPERTYKEY& property_key, const CLSID& property_clsid_value)
+
+HRESULT SetClsidForPropertyStore(PROPERTY_WRITER* writer, const LNK_FMTID* fmtid, DWORD pid, const LNK_FMTID* property_clsid_value)
 {
+  // Built by hand: InitPropVariantFromCLSID is exported by Propsys.lib,
+  // which only debug builds link. PropVariantClear frees the CLSID.
   ScopedPropVariant property_value;
-  if (FAILED(InitPropVariantFromCLSID(property_clsid_value, property_value.Receive())))
-  {
-    return false;
-  }
-  return SetPropVariantValueForPropertyStore(property_store, property_key, property_value);
+  PROPVARIANT* variant = property_value.Receive();
+  variant->puuid = static_cast<CLSID*>(::CoTaskMemAlloc(sizeof(CLSID)));
+  if (!variant->puuid)
+    return E_OUTOFMEMORY;
+  memcpy(variant->puuid, property_clsid_value->bytes, sizeof(CLSID));
+  variant->vt = VT_CLSID;
+  return SetPropVariantValueForPropertyStore(writer, fmtid, pid, property_value);
 }
+
+HRESULT CommitPropertyStore(PROPERTY_WRITER* writer)
+{
+  return reinterpret_cast<PropertyStoreWriter*>(writer)->property_store->Commit();
+}
+
+const PROPERTY_WRITER_VTBL kPropertyStoreWriterVtbl = {
+  SetStringValueForPropertyStore,
+  SetBooleanValueForPropertyStore,
+  SetClsidForPropertyStore,
+  CommitPropertyStore,
+};
 } // namespace
 
 namespace base
@@ -516,7 +532,10 @@ void InitializeShortcutInterfaces(LPCTSTR shortcut, ComPtr<IShellLink>* i_shell_
 
   
   ComPtr<IShellLink> shell_link;
-  if (FAILED(::CoCreateInstance(CLSID_ShellLink, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(static_cast<IShellLink**>(&shell_link)))))
+  HRESULT hr;
+  MC_TRACE(TRACE_OP_SHELL_LINK_CREATE,
+    hr = ::CoCreateInstance(CLSID_ShellLink, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(static_cast<IShellLink**>(&shell_link))));
+  if (FAILED(hr))
   {
     return;
   }
@@ -529,25 +548,10 @@ void InitializeShortcutInterfaces(LPCTSTR shortcut, ComPtr<IShellLink>* i_shell_
   i_persist_file->Swap(persist_file);
 }
 
-} // namespace
-
-bool UpdateShortcutLink(LPCTSTR shortcut_path, const ShortcutProperties& properties)
+// Applies the properties selected in |properties.options| to the shortcut
+// loaded into |i_shell_link|, without saving it.
+bool ApplyShortcutProperties(const ShortcutProperties& properties, const ComPtr<IShellLink>& i_shell_link)
 {
-  bool shortcut_existed = is_file_exists(shortcut_path);
-
-  // Interfaces to the old shortcut when replacing an existing shortcut.
-  ComPtr<IShellLink> old_i_shell_link;
-  ComPtr<IPersistFile> old_i_persist_file;
-
-  // Interfaces to the shortcut being created/updated.
-  ComPtr<IShellLink> i_shell_link;
-  ComPtr<IPersistFile> i_persist_file;
-  InitializeShortcutInterfaces(shortcut_path, &i_shell_link, &i_persist_file);
-
-  // Return false immediately upon failure to initialize shortcut interfaces.
-  if (!i_persist_file.Get())
-    return false;
-
   if ((properties.options & ShortcutProperties::PROPERTIES_TARGET) && FAILED(i_shell_link->SetPath(properties.target)))
   {
     return false;
@@ -558,18 +562,9 @@ bool UpdateShortcutLink(LPCTSTR shortcut_path, const ShortcutProperties& propert
     return false;
   }
 
-  if (properties.options & ShortcutProperties::PROPERTIES_ARGUMENTS)
+  if ((properties.options & ShortcutProperties::PROPERTIES_ARGUMENTS) && FAILED(i_shell_link->SetArguments(properties.arguments)))
   {
-    if (FAILED(i_shell_link->SetArguments(properties.arguments)))
-      return false;
-  }
-  else if (old_i_persist_file.Get())
-  {
-    wchar_t current_arguments[MAX_PATH] = {0};
-    if (SUCCEEDED(old_i_shell_link->GetArguments(current_arguments, MAX_PATH)))
-    {
-      i_shell_link->SetArguments(current_arguments);
-    }
+    return false;
   }
 
   if ((properties.options & ShortcutProperties::PROPERTIES_DESCRIPTION) && FAILED(i_shell_link->SetDescription(properties.description)))
@@ -583,35 +578,195 @@ bool UpdateShortcutLink(LPCTSTR shortcut_path, const ShortcutProperties& propert
     return false;
   }
 
-  bool has_app_id                = (properties.options & ShortcutProperties::PROPERTIES_APP_ID) != 0;
-  //bool has_dual_mode             = (properties.options & ShortcutProperties::PROPERTIES_DUAL_MODE) != 0;
-  //bool has_toast_activator_clsid = (properties.options & ShortcutProperties::PROPERTIES_TOAST_ACTIVATOR_CLSID) != 0;
-  if (has_app_id/* || has_dual_mode || has_toast_activator_clsid*/)
+  // Property store values are staged and committed once: each Commit
+  // serializes the whole property block.
+  PROPERTY_STAGE stage;
+  PropertyStage_Init(&stage);
+  if (properties.options & ShortcutProperties::PROPERTIES_APP_ID)
+    PropertyStage_SetAppId(&stage, properties.app_id);
+  if (properties.options & ShortcutProperties::PROPERTIES_DUAL_MODE)
+    PropertyStage_SetDualMode(&stage, properties.dual_mode);
+  if (properties.options & ShortcutProperties::PROPERTIES_TOAST_ACTIVATOR_CLSID)
+    PropertyStage_SetToastActivatorClsid(&stage, reinterpret_cast<const LNK_FMTID*>(&properties.toast_activator_clsid));
+  if (stage.staged)
   {
     ComPtr<IPropertyStore> property_store;
     if (FAILED(i_shell_link.As(&property_store)) || !property_store.Get())
       return false;
 
-    if (has_app_id && !SetAppIdForPropertyStore(property_store.Get(), properties.app_id))
+    PropertyStoreWriter writer = { { &kPropertyStoreWriterVtbl }, property_store.Get() };
+    HRESULT result = PropertyStage_Apply(&stage, &writer.base);
+    if (FAILED(result))
     {
+      if (HRESULT_FACILITY(result) == FACILITY_WIN32)
+        ::SetLastError(HRESULT_CODE(result));
       return false;
     }
-    //if (has_dual_mode && !SetBooleanValueForPropertyStore(property_store.Get(), PKEY_AppUserModel_IsDualMode, properties.dual_mode))
-    //{
-    //  return false;
-    //}
-    //if (has_toast_activator_clsid && !SetClsidForPropertyStore(property_store.Get(), PKEY_AppUserModel_ToastActivatorCLSID, properties.toast_activator_clsid))
-    //{
-    //  return false;
-    //}
   }
 
-  // Release the interfaces to the old shortcut to make sure it doesn't prevent
-  // overwriting it if needed.
-  old_i_persist_file.Reset();
-  old_i_shell_link.Reset();
+  return true;
+}
+
+// Whether |shortcut_path| already holds every property selected in
+// |properties.options|, as far as the file itself tells (see lnkprops.h).
+// Files that can't be read or parsed are reported as changed.
+bool IsShortcutUpToDate(LPCTSTR shortcut_path, const ShortcutProperties& properties)
+{
+  BYTE* data;
+  DWORD size;
+  LNK_FILE lnk;
+  LNK_PROPERTIES wanted;
 
-  HRESULT result = i_persist_file->Save(shortcut_path, TRUE);
+  if (File_ReadAll(shortcut_path, &data, &size) != ERROR_SUCCESS)
+    return false;
+  wanted.options = properties.options;
+  wanted.target = properties.target;
+  wanted.workingDir = properties.working_dir;
+  wanted.arguments = properties.arguments;
+  wanted.description = properties.description;
+  wanted.icon = properties.icon;
+  wanted.iconIndex = properties.icon_index;
+  wanted.appId = properties.app_id;
+  wanted.dualMode = properties.dual_mode;
+  memcpy(&wanted.toastActivatorClsid, &properties.toast_activator_clsid, sizeof(wanted.toastActivatorClsid));
+  bool up_to_date = SUCCEEDED(Lnk_Parse(data, size, &lnk)) && Lnk_ChangedProperties(&lnk, &wanted) == 0;
+  Mem_Free(data);
+  return up_to_date;
+}
+
+// Notifies the shell that |shortcut_path| was created or updated.
+void NotifyShortcutSaved(LPCTSTR shortcut_path, bool shortcut_existed)
+{
+  if (shortcut_existed)
+  {
+    // TODO(gab): SHCNE_UPDATEITEM might be sufficient here; further testing
+    // required.
+    SHChangeNotify(SHCNE_ASSOCCHANGED, SHCNF_IDLIST, nullptr, nullptr);
+  }
+  else
+  {
+    SHChangeNotify(SHCNE_CREATE, SHCNF_PATH, shortcut_path, nullptr);
+  }
+}
+
+void ShellNotify(SHELL_NOTIFIER* notifier, LONG event_id, const WCHAR* path)
+{
+  SHChangeNotify(event_id, path ? SHCNF_PATH : SHCNF_IDLIST, path, nullptr);
+}
+
+const SHELL_NOTIFIER_VTBL kShellNotifierVtbl = {
+  ShellNotify,
+};
+
+SHELL_NOTIFIER g_shell_notifier = { &kShellNotifierVtbl };
+
+HRESULT LastErrorOr(HRESULT fallback)
+{
+  DWORD error = ::GetLastError();
+  return error ? HRESULT_FROM_WIN32(error) : fallback;
+}
+
+// State shared by the LNK_BATCH_OPS callbacks of UpdateShortcutLinks. One
+// IShellLink/IPersistFile pair serves the whole batch: IPersistFile::Load
+// replaces all of the link's state, so nothing leaks from one file into the
+// next.
+struct ShortcutBatch
+{
+  const ShortcutUpdate* updates;
+  SHELL_NOTIFY_BATCH* notify_batch;
+  bool uninitialize;
+  ComPtr<IShellLink> i_shell_link;
+  ComPtr<IPersistFile> i_persist_file;
+};
+
+HRESULT BatchInitialize(void* ctx)
+{
+  ShortcutBatch* batch = static_cast<ShortcutBatch*>(ctx);
+  HRESULT hr = ::CoInitialize(NULL);
+  // Already in the MTA: COM is usable, just not ours to uninitialize.
+  batch->uninitialize = SUCCEEDED(hr);
+  return hr == RPC_E_CHANGED_MODE ? S_OK : hr;
+}
+
+HRESULT BatchUpdate(void* ctx, DWORD index)
+{
+  ShortcutBatch* batch = static_cast<ShortcutBatch*>(ctx);
+  const ShortcutUpdate& update = batch->updates[index];
+  bool shortcut_existed = is_file_exists(update.path);
+  HRESULT hr;
+
+  // Nothing to write: no Save, and nothing for the shell to hear about.
+  if (shortcut_existed && IsShortcutUpToDate(update.path, update.properties))
+    return S_FALSE;
+
+  ::SetLastError(ERROR_SUCCESS);
+  if (!batch->i_persist_file.Get())
+  {
+    InitializeShortcutInterfaces(nullptr, &batch->i_shell_link, &batch->i_persist_file);
+    if (!batch->i_persist_file.Get())
+      return LastErrorOr(E_FAIL);
+  }
+
+  hr = batch->i_persist_file->Load(update.path, STGM_READWRITE);
+  if (FAILED(hr))
+    return hr;
+  if (!ApplyShortcutProperties(update.properties, batch->i_shell_link))
+    return LastErrorOr(E_FAIL);
+  MC_TRACE(TRACE_OP_PERSIST_SAVE, hr = batch->i_persist_file->Save(update.path, TRUE));
+  if (FAILED(hr))
+    return hr;
+
+  NotifyBatch_Add(batch->notify_batch, update.path, !shortcut_existed);
+  return S_OK;
+}
+
+void BatchReset(void* ctx)
+{
+  ShortcutBatch* batch = static_cast<ShortcutBatch*>(ctx);
+  batch->i_persist_file.Reset();
+  batch->i_shell_link.Reset();
+}
+
+void BatchUninitialize(void* ctx)
+{
+  ShortcutBatch* batch = static_cast<ShortcutBatch*>(ctx);
+  BatchReset(ctx);
+  if (batch->uninitialize)
+    ::CoUninitialize();
+}
+
+const LNK_BATCH_OPS kShortcutBatchOps = {
+  BatchInitialize,
+  BatchUpdate,
+  BatchReset,
+  BatchUninitialize,
+};
+
+} // namespace
+
+ShortcutUpdateResult UpdateShortcutLink(LPCTSTR shortcut_path, const ShortcutProperties& properties)
+{
+  bool shortcut_existed = is_file_exists(shortcut_path);
+
+  // Saving would rewrite the file with what it already holds and make the
+  // shell refresh its icon caches for nothing.
+  if (shortcut_existed && IsShortcutUpToDate(shortcut_path, properties))
+    return SHORTCUT_UPDATE_UNCHANGED;
+
+  // Interfaces to the shortcut being created/updated.
+  ComPtr<IShellLink> i_shell_link;
+  ComPtr<IPersistFile> i_persist_file;
+  InitializeShortcutInterfaces(shortcut_path, &i_shell_link, &i_persist_file);
+
+  // Return false immediately upon failure to initialize shortcut interfaces.
+  if (!i_persist_file.Get())
+    return SHORTCUT_UPDATE_FAILED;
+
+  if (!ApplyShortcutProperties(properties, i_shell_link))
+    return SHORTCUT_UPDATE_FAILED;
+
+  HRESULT result;
+  MC_TRACE(TRACE_OP_PERSIST_SAVE, result = i_persist_file->Save(shortcut_path, TRUE));
 
   // Release the interfaces in case the SHChangeNotify call below depends on
   // the operations above being fully completed.
@@ -620,21 +775,37 @@ bool UpdateShortcutLink(LPCTSTR shortcut_path, const ShortcutProperties& propert
 
   // If we successfully created/updated the icon, notify the shell that we have
   // done so.
-  const bool succeeded = SUCCEEDED(result);
-  if (succeeded)
+  if (FAILED(result))
+    return SHORTCUT_UPDATE_FAILED;
+  NotifyShortcutSaved(shortcut_path, shortcut_existed);
+  return SHORTCUT_UPDATE_UPDATED;
+}
+
+SHELL_NOTIFIER* GetShellNotifier()
+{
+  return &g_shell_notifier;
+}
+
+DWORD UpdateShortcutLinks(const ShortcutUpdate* updates, DWORD count, HRESULT* results, SHELL_NOTIFY_BATCH* notify_batch)
+{
+  ShortcutBatch batch;
+  SHELL_NOTIFY_BATCH own_notify_batch;
+  DWORD succeeded = 0;
+
+  if (!notify_batch)
   {
-    if (shortcut_existed)
-    {
-      // TODO(gab): SHCNE_UPDATEITEM might be sufficient here; further testing
-      // required.
-      SHChangeNotify(SHCNE_ASSOCCHANGED, SHCNF_IDLIST, nullptr, nullptr);
-    }
-    else
-    {
-      SHChangeNotify(SHCNE_CREATE, SHCNF_PATH, shortcut_path, nullptr);
-    }
+    NotifyBatch_Init(&own_notify_batch, GetShellNotifier(), SHELL_NOTIFY_ITEM_LIMIT);
+    notify_batch = &own_notify_batch;
   }
 
+  batch.updates = updates;
+  batch.notify_batch = notify_batch;
+  batch.uninitialize = false;
+  LnkBatch_Run(&kShortcutBatchOps, &batch, count, results, &succeeded);
+
+  // Sent after the interfaces are released, as in UpdateShortcutLink.
+  if (notify_batch == &own_notify_batch)
+    NotifyBatch_Flush(notify_batch);
   return succeeded;
 }
 
@@ -643,11 +814,68 @@ bool UpdateShortcutLink(LPCTSTR shortcut_path, const ShortcutProperties& propert
 
 
 extern "C" BOOL SetShortcutAppId(LPCTSTR shortcut, LPCTSTR appid) {
+	// Patch the property store block in the file directly; only fall back
+	// to IShellLink for files the parser doesn't understand.
+	HRESULT hr = Lnk_SetAppIdInFile(shortcut, appid);
+	if (SUCCEEDED(hr)) {
+		if (hr == S_OK)
+			SHChangeNotify(SHCNE_ASSOCCHANGED, SHCNF_IDLIST, nullptr, nullptr);
+		return TRUE;
+	}
+
 	::CoInitialize(NULL);
 	base::win::ShortcutProperties props;
 	memset(&props, 0, sizeof(props));
 	props.set_app_id(appid);
-	BOOL ok = base::win::UpdateShortcutLink(shortcut, props);
+	BOOL ok = base::win::UpdateShortcutLink(shortcut, props) != base::win::SHORTCUT_UPDATE_FAILED;
 	::CoUninitialize();
 	return ok;
 }
+
+extern "C" DWORD SetShortcutAppIds(LPCTSTR* shortcuts, LPCTSTR* appids, DWORD count, HRESULT* results) {
+	// Same split as SetShortcutAppId: patch what the parser understands, and
+	// send only the leftovers through one COM batch.
+	base::win::ShortcutUpdate* updates;
+	SHELL_NOTIFY_BATCH notify_batch;
+	HRESULT* batch_results;
+	DWORD* indices;
+	DWORD i, pending = 0, succeeded = 0;
+
+	updates = (base::win::ShortcutUpdate*)Mem_Alloc(count * sizeof(base::win::ShortcutUpdate));
+	batch_results = (HRESULT*)Mem_Alloc(count * sizeof(HRESULT));
+	indices = (DWORD*)Mem_Alloc(count * sizeof(DWORD));
+	if (!updates || !batch_results || !indices) {
+		for (i = 0; i < count; ++i)
+			results[i] = E_OUTOFMEMORY;
+		Mem_Free(indices);
+		Mem_Free(batch_results);
+		Mem_Free(updates);
+		return 0;
+	}
+
+	NotifyBatch_Init(&notify_batch, base::win::GetShellNotifier(), SHELL_NOTIFY_ITEM_LIMIT);
+	for (i = 0; i < count; ++i) {
+		results[i] = Lnk_SetAppIdInFile(shortcuts[i], appids[i]);
+		if (results[i] == S_OK)
+			NotifyBatch_Add(&notify_batch, shortcuts[i], FALSE);
+		if (SUCCEEDED(results[i])) {
+			results[i] = S_OK;
+			++succeeded;
+			continue;
+		}
+		memset(&updates[pending], 0, sizeof(base::win::ShortcutUpdate));
+		updates[pending].path = shortcuts[i];
+		updates[pending].properties.set_app_id(appids[i]);
+		indices[pending++] = i;
+	}
+
+	succeeded += base::win::UpdateShortcutLinks(updates, pending, batch_results, &notify_batch);
+	for (i = 0; i < pending; ++i)
+		results[indices[i]] = SUCCEEDED(batch_results[i]) ? S_OK : batch_results[i];
+	NotifyBatch_Flush(&notify_batch);
+
+	Mem_Free(indices);
+	Mem_Free(batch_results);
+	Mem_Free(updates);
+	return succeeded;
+}
@@ -14,6 +14,8 @@
 #include <shlobj.h>
 #include <propvarutil.h>
 
+#include "shellnotify.h"
+
 namespace base
 {
 namespace win
@@ -32,11 +34,11 @@ struct ShortcutProperties {
     PROPERTIES_DESCRIPTION           = 1U << 3,
     PROPERTIES_ICON                  = 1U << 4,
     PROPERTIES_APP_ID                = 1U << 5,
-    //PROPERTIES_DUAL_MODE             = 1U << 6,
-    //PROPERTIES_TOAST_ACTIVATOR_CLSID = 1U << 7,
+    PROPERTIES_DUAL_MODE             = 1U << 6,
+    PROPERTIES_TOAST_ACTIVATOR_CLSID = 1U << 7,
     // Be sure to update the values below when adding a new property.
-    PROPERTIES_ALL = PROPERTIES_TARGET | PROPERTIES_WORKING_DIR | PROPERTIES_ARGUMENTS | PROPERTIES_DESCRIPTION | PROPERTIES_ICON | PROPERTIES_APP_ID/* |
-                     PROPERTIES_DUAL_MODE | PROPERTIES_TOAST_ACTIVATOR_CLSID*/
+    PROPERTIES_ALL = PROPERTIES_TARGET | PROPERTIES_WORKING_DIR | PROPERTIES_ARGUMENTS | PROPERTIES_DESCRIPTION | PROPERTIES_ICON | PROPERTIES_APP_ID |
+                     PROPERTIES_DUAL_MODE | PROPERTIES_TOAST_ACTIVATOR_CLSID
   };
 
   void set_target(LPCTSTR target_in)
@@ -78,17 +80,17 @@ struct ShortcutProperties {
     options |= PROPERTIES_APP_ID;
   }
 
-  //void set_dual_mode(bool dual_mode_in)
-  //{
-  //  dual_mode = dual_mode_in;
-  //  options |= PROPERTIES_DUAL_MODE;
-  //}
+  void set_dual_mode(bool dual_mode_in)
+  {
+    dual_mode = dual_mode_in;
+    options |= PROPERTIES_DUAL_MODE;
+  }
 
-  //void set_toast_activator_clsid(const CLSID& toast_activator_clsid_in)
-  //{
-  //  toast_activator_clsid = toast_activator_clsid_in;
-  //  options |= PROPERTIES_TOAST_ACTIVATOR_CLSID;
-  //}
+  void set_toast_activator_clsid(const CLSID& toast_activator_clsid_in)
+  {
+    toast_activator_clsid = toast_activator_clsid_in;
+    options |= PROPERTIES_TOAST_ACTIVATOR_CLSID;
+  }
 
   // The target to launch from this shortcut. This is mandatory when creating
   // a shortcut.
@@ -107,23 +109,49 @@ struct ShortcutProperties {
   // The app model id for the shortcut.
   LPCTSTR app_id;
   // Whether this is a dual mode shortcut (Win8+).
-  // bool dual_mode; // = false;
+  bool dual_mode; // = false;
   // The CLSID of the COM object registered with the OS via the shortcut. This
   // is for app activation via user interaction with a toast notification in the
   // Action Center. (Win10 version 1607, build 14393, and beyond).
-  // CLSID toast_activator_clsid;
+  CLSID toast_activator_clsid;
   // Bitfield made of IndividualProperties. Properties set in |options| will be
   // set on the shortcut, others will be ignored.
   uint32_t options; // = 0U;
 };
 
+enum ShortcutUpdateResult {
+  SHORTCUT_UPDATE_FAILED = 0,
+  // The shortcut already held every property asked for; it was neither
+  // saved nor announced to the shell.
+  SHORTCUT_UPDATE_UNCHANGED,
+  SHORTCUT_UPDATE_UPDATED,
+};
+
 // This method creates (or updates) a shortcut link at |shortcut_path| using the
 // information given through |properties|.
 // Ensure you have initialized COM before calling into this function.
-// |operation|: a choice from the ShortcutOperation enum.
-// If |operation| is SHORTCUT_REPLACE_EXISTING or SHORTCUT_UPDATE_EXISTING and
-// |shortcut_path| does not exist, this method is a no-op and returns false.
-bool UpdateShortcutLink(LPCTSTR shortcut_path, const ShortcutProperties& properties);
+// An existing shortcut is read first and left alone when saving would not
+// change it.
+ShortcutUpdateResult UpdateShortcutLink(LPCTSTR shortcut_path, const ShortcutProperties& properties);
+
+struct ShortcutUpdate {
+  LPCTSTR path;
+  ShortcutProperties properties;
+};
+
+// Same as calling UpdateShortcutLink on each of |updates|, but COM is
+// initialized once for the whole batch (callers need not do it) and a
+// single IShellLink instance is reused for every file.
+// Shell notifications are queued on |notify_batch| for the caller to flush;
+// if it is null they are coalesced over this call and sent at the end.
+// |results| receives one status per update: S_OK when saved, S_FALSE when
+// the shortcut was already up to date and left alone, a failure otherwise.
+// Returns the number of shortcuts that succeeded either way.
+DWORD UpdateShortcutLinks(const ShortcutUpdate* updates, DWORD count, HRESULT* results,
+                          SHELL_NOTIFY_BATCH* notify_batch = nullptr);
+
+// The notifier that forwards to SHChangeNotify.
+SHELL_NOTIFIER* GetShellNotifier();
 
 } // namespace win
 } // namespace base
@@ -0,0 +1,311 @@
+// Vectorized needle search over UTF-16 text.
+// Each kernel loads the text at position i and i+1, compares the two loads
+// against the needle's first and second char broadcast to every lane, and
+// ANDs the results: a set lane k means text[i+k..i+k+1] equals the needle's
+// first pair, which rules out nearly every position of a typical path
+// before any per-char work. The case fold is applied to the loaded text
+// (needles arrive folded), so it costs three ALU ops per vector.
+#include "simdscan.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SIMDSCAN_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMDSCAN_AVX2_TARGET
+#else
+#include <cpuid.h>
+#define SIMDSCAN_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// Level + 1 so that the zero-initialized state means "not probed yet";
+// for the cap, 0 means no cap. Nothing runs at load time in this DLL.
+static volatile LONG g_simdLevel;
+static volatile LONG g_simdCap;
+
+static __inline BOOL SimdScan_Verify(const WCHAR* text, const WCHAR* needle, DWORD cchNeedle, BOOL foldCase)
+{
+    DWORD i;
+    if (foldCase)
+    {
+        for (i = 2; i < cchNeedle; ++i)
+        {
+            if (SimdScan_FoldChar(text[i]) != needle[i])
+                return FALSE;
+        }
+    }
+    else
+    {
+        for (i = 2; i < cchNeedle; ++i)
+        {
+            if (text[i] != needle[i])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Plain loop, also the tail of the vector kernels. Starts at |from|.
+static BOOL SimdScan_Scalar(const WCHAR* text, DWORD cch, DWORD from, const WCHAR* needle, DWORD cchNeedle, BOOL foldCase)
+{
+    DWORD i, j;
+    if (cchNeedle > cch)
+        return FALSE;
+    for (i = from; i <= cch - cchNeedle; ++i)
+    {
+        for (j = 0; j < cchNeedle; ++j)
+        {
+            WCHAR ch = foldCase ? SimdScan_FoldChar(text[i + j]) : text[i + j];
+            if (ch != needle[j])
+                break;
+        }
+        if (j == cchNeedle)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#if defined(SIMDSCAN_X86)
+
+static __inline DWORD SimdScan_LowestBit(DWORD mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (DWORD)index;
+#else
+    return (DWORD)__builtin_ctz(mask);
+#endif
+}
+
+// Signed 16-bit compares: code units >= 0x8000 read as negative and so
+// never land in 'A'..'Z'.
+static __inline __m128i SimdScan_Fold128(__m128i v)
+{
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16('A' - 1)),
+        _mm_cmplt_epi16(v, _mm_set1_epi16('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi16(0x20)));
+}
+
+static BOOL SimdScan_Sse2(const WCHAR* text, DWORD cch, const WCHAR* needle, DWORD cchNeedle, BOOL foldCase)
+{
+    const __m128i first = _mm_set1_epi16((short)needle[0]);
+    const __m128i second = _mm_set1_epi16((short)needle[1]);
+    __m128i a, b;
+    DWORD i, mask, k;
+
+    // The second load reads text[i + 8], hence the 9.
+    for (i = 0; i + 9 <= cch; i += 8)
+    {
+        a = _mm_loadu_si128((const __m128i*)(text + i));
+        b = _mm_loadu_si128((const __m128i*)(text + i + 1));
+        if (foldCase)
+        {
+            a = SimdScan_Fold128(a);
+            b = SimdScan_Fold128(b);
+        }
+        // Two mask bits per lane; keep the low one.
+        mask = (DWORD)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(a, first), _mm_cmpeq_epi16(b, second))) & 0x5555;
+        while (mask)
+        {
+            k = i + (SimdScan_LowestBit(mask) >> 1);
+            if (k + cchNeedle > cch)
+                return FALSE; // later candidates only get closer to the end
+            if (SimdScan_Verify(text + k, needle, cchNeedle, foldCase))
+                return TRUE;
+            mask &= mask - 1;
+        }
+    }
+    return SimdScan_Scalar(text, cch, i, needle, cchNeedle, foldCase);
+}
+
+static DWORD SimdScan_FindCharSse2(const WCHAR* text, DWORD cch, WCHAR ch)
+{
+    const __m128i needle = _mm_set1_epi16((short)ch);
+    DWORD i, mask;
+
+    for (i = 0; i + 8 <= cch; i += 8)
+    {
+        mask = (DWORD)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(text + i)), needle));
+        if (mask)
+            return i + (SimdScan_LowestBit(mask) >> 1);
+    }
+    for (; i < cch && text[i] != ch; ++i)
+        ;
+    return i;
+}
+
+static SIMDSCAN_AVX2_TARGET __inline __m256i SimdScan_Fold256(__m256i v)
+{
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi16(v, _mm256_set1_epi16('A' - 1)),
+        _mm256_cmpgt_epi16(_mm256_set1_epi16('Z' + 1), v));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi16(0x20)));
+}
+
+static SIMDSCAN_AVX2_TARGET BOOL SimdScan_Avx2(const WCHAR* text, DWORD cch, const WCHAR* needle, DWORD cchNeedle, BOOL foldCase)
+{
+    const __m256i first = _mm256_set1_epi16((short)needle[0]);
+    const __m256i second = _mm256_set1_epi16((short)needle[1]);
+    __m256i a, b;
+    DWORD i, mask, k;
+
+    for (i = 0; i + 17 <= cch; i += 16)
+    {
+        a = _mm256_loadu_si256((const __m256i*)(text + i));
+        b = _mm256_loadu_si256((const __m256i*)(text + i + 1));
+        if (foldCase)
+        {
+            a = SimdScan_Fold256(a);
+            b = SimdScan_Fold256(b);
+        }
+        mask = (DWORD)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi16(a, first), _mm256_cmpeq_epi16(b, second))) & 0x55555555u;
+        while (mask)
+        {
+            k = i + (SimdScan_LowestBit(mask) >> 1);
+            if (k + cchNeedle > cch)
+                return FALSE;
+            if (SimdScan_Verify(text + k, needle, cchNeedle, foldCase))
+                return TRUE;
+            mask &= mask - 1;
+        }
+    }
+    // Names are mostly shorter than two vectors; let SSE2 take the rest.
+    // The compiler turns this into a tail jump without clearing the upper
+    // YMM halves, and legacy SSE code run with them dirty is several times
+    // slower, so clear them here.
+    _mm256_zeroupper();
+    return SimdScan_Sse2(text + i, cch - i, needle, cchNeedle, foldCase);
+}
+
+static SIMDSCAN_AVX2_TARGET DWORD SimdScan_FindCharAvx2(const WCHAR* text, DWORD cch, WCHAR ch)
+{
+    const __m256i needle = _mm256_set1_epi16((short)ch);
+    DWORD i, mask;
+
+    for (i = 0; i + 16 <= cch; i += 16)
+    {
+        mask = (DWORD)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(text + i)), needle));
+        if (mask)
+            return i + (SimdScan_LowestBit(mask) >> 1);
+    }
+    _mm256_zeroupper();
+    return i + SimdScan_FindCharSse2(text + i, cch - i, ch);
+}
+
+static void SimdScan_Cpuid(int leaf, int sub, int regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, sub);
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count(leaf, sub, a, b, c, d);
+    regs[0] = (int)a;
+    regs[1] = (int)b;
+    regs[2] = (int)c;
+    regs[3] = (int)d;
+#endif
+}
+
+// XCR0, to check the OS saves the YMM state across context switches.
+static ULONGLONG SimdScan_Xcr0(void)
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((ULONGLONG)hi << 32) | lo;
+#endif
+}
+
+static DWORD SimdScan_Probe(void)
+{
+    int regs[4];
+    int maxLeaf;
+
+    SimdScan_Cpuid(0, 0, regs);
+    maxLeaf = regs[0];
+    if (maxLeaf < 1)
+        return SIMD_LEVEL_SCALAR;
+    SimdScan_Cpuid(1, 0, regs);
+    if (!(regs[3] & (1 << 26))) // SSE2
+        return SIMD_LEVEL_SCALAR;
+    // OSXSAVE and AVX, XMM and YMM state enabled, then the AVX2 bit.
+    if ((regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && (SimdScan_Xcr0() & 6) == 6 && maxLeaf >= 7)
+    {
+        SimdScan_Cpuid(7, 0, regs);
+        if (regs[1] & (1 << 5))
+            return SIMD_LEVEL_AVX2;
+    }
+    return SIMD_LEVEL_SSE2;
+}
+
+#else
+
+static DWORD SimdScan_Probe(void)
+{
+    return SIMD_LEVEL_SCALAR;
+}
+
+#endif // SIMDSCAN_X86
+
+extern "C" DWORD SimdScan_Level(void)
+{
+    LONG level = Atomic_Load(&g_simdLevel);
+    LONG cap;
+
+    // Every racing thread probes and stores the same answer.
+    if (!level)
+    {
+        level = (LONG)SimdScan_Probe() + 1;
+        Atomic_CompareExchange(&g_simdLevel, level, 0);
+    }
+    cap = Atomic_Load(&g_simdCap);
+    if (cap && cap < level)
+        level = cap;
+    return (DWORD)(level - 1);
+}
+
+extern "C" void SimdScan_Limit(DWORD level)
+{
+    g_simdCap = (LONG)level + 1;
+}
+
+extern "C" BOOL SimdScan_Contains(const WCHAR* text, DWORD cch, const WCHAR* needle, DWORD cchNeedle, BOOL foldCase)
+{
+    if (!cchNeedle || cchNeedle > cch)
+        return FALSE;
+    // A single char has no pair to filter on.
+    if (cchNeedle == 1)
+        return SimdScan_Scalar(text, cch, 0, needle, cchNeedle, foldCase);
+
+#if defined(SIMDSCAN_X86)
+    switch (SimdScan_Level())
+    {
+    case SIMD_LEVEL_AVX2:
+        return SimdScan_Avx2(text, cch, needle, cchNeedle, foldCase);
+    case SIMD_LEVEL_SSE2:
+        return SimdScan_Sse2(text, cch, needle, cchNeedle, foldCase);
+    }
+#endif
+    return SimdScan_Scalar(text, cch, 0, needle, cchNeedle, foldCase);
+}
+
+extern "C" DWORD SimdScan_FindChar(const WCHAR* text, DWORD cch, WCHAR ch)
+{
+    DWORD i;
+#if defined(SIMDSCAN_X86)
+    switch (SimdScan_Level())
+    {
+    case SIMD_LEVEL_AVX2:
+        return SimdScan_FindCharAvx2(text, cch, ch);
+    case SIMD_LEVEL_SSE2:
+        return SimdScan_FindCharSse2(text, cch, ch);
+    }
+#endif
+    for (i = 0; i < cch && text[i] != ch; ++i)
+        ;
+    return i;
+}
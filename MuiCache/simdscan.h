@@ -0,0 +1,46 @@
+// simdscan.h: single-needle UTF-16 substring search with SSE2/AVX2 kernels.
+// Candidates are found by comparing the needle's first two chars against a
+// whole vector of text positions at once; only positions where both match
+// are verified char by char. The kernel is picked from cpuid on first use.
+#ifndef MUICACHE_SIMDSCAN_H_
+#define MUICACHE_SIMDSCAN_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define SIMD_LEVEL_SCALAR 0
+#define SIMD_LEVEL_SSE2   1
+#define SIMD_LEVEL_AVX2   2
+
+// Lower-cases ASCII 'A'..'Z' and leaves every other code unit alone, the
+// fold applied to text when SimdScan_Contains is asked to ignore case.
+static __inline WCHAR SimdScan_FoldChar(WCHAR ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? (WCHAR)(ch | 0x20) : ch;
+}
+
+// Returns TRUE if |needle| (|cchNeedle| > 0 chars) occurs in the first |cch|
+// chars of |text|. With |foldCase| the text is folded by SimdScan_FoldChar
+// and |needle| must already be folded the same way.
+BOOL SimdScan_Contains(const WCHAR* text, DWORD cch, const WCHAR* needle, DWORD cchNeedle, BOOL foldCase);
+
+// Returns the index of the first |ch| in the first |cch| chars of |text|,
+// or |cch| when there is none.
+DWORD SimdScan_FindChar(const WCHAR* text, DWORD cch, WCHAR ch);
+
+// The kernel level in use: the best the CPU and OS support, capped by
+// SimdScan_Limit.
+DWORD SimdScan_Level(void);
+
+// Caps the kernel level, e.g. SIMD_LEVEL_SCALAR to compare against the
+// plain loop. Not meant to be called while scans are running.
+void SimdScan_Limit(DWORD level);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_SIMDSCAN_H_
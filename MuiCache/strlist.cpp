@@ -0,0 +1,77 @@
+#include "strlist.h"
+
+extern "C" void StrList_Init(STR_LIST* list)
+{
+    memset(list, 0, sizeof(STR_LIST));
+}
+
+extern "C" void StrList_Free(STR_LIST* list)
+{
+    Mem_Free(list->chars);
+    Mem_Free(list->offsets);
+    StrList_Init(list);
+}
+
+// Reserves room for one more entry of |cch| characters plus its NUL.
+static WCHAR* StrList_Reserve(STR_LIST* list, DWORD cch)
+{
+    if (list->count == list->slots)
+    {
+        DWORD slots = list->slots ? list->slots * 2 : 16;
+        DWORD* offsets = (DWORD*)Mem_Realloc(list->offsets, slots * sizeof(DWORD));
+        if (!offsets)
+            return NULL;
+        list->offsets = offsets;
+        list->slots = slots;
+    }
+    if (list->cchCapacity - list->cchUsed < cch + 1)
+    {
+        DWORD capacity = list->cchCapacity ? list->cchCapacity : 1024;
+        WCHAR* chars;
+        while (capacity - list->cchUsed < cch + 1)
+            capacity *= 2;
+        chars = (WCHAR*)Mem_Realloc(list->chars, capacity * sizeof(WCHAR));
+        if (!chars)
+            return NULL;
+        list->chars = chars;
+        list->cchCapacity = capacity;
+    }
+    list->offsets[list->count] = list->cchUsed;
+    return list->chars + list->cchUsed;
+}
+
+extern "C" BOOL StrList_Add(STR_LIST* list, const WCHAR* s, DWORD cch)
+{
+    WCHAR* dst = StrList_Reserve(list, cch);
+    if (!dst)
+        return FALSE;
+    memcpy(dst, s, cch * sizeof(WCHAR));
+    dst[cch] = 0;
+    list->cchUsed += cch + 1;
+    ++list->count;
+    return TRUE;
+}
+
+extern "C" BOOL StrList_AddPath(STR_LIST* list, const WCHAR* dir, const WCHAR* name)
+{
+    DWORD cchDir = Str_Length(dir);
+    DWORD cchName = Str_Length(name);
+    BOOL separator = cchDir && dir[cchDir - 1] != '\\' && dir[cchDir - 1] != '/';
+    DWORD cch = cchDir + (separator ? 1 : 0) + cchName;
+    // |dir| may be an entry of this list, which Reserve can move.
+    BOOL inside = dir >= list->chars && dir < list->chars + list->cchUsed;
+    DWORD dirOffset = inside ? (DWORD)(dir - list->chars) : 0;
+    WCHAR* dst = StrList_Reserve(list, cch);
+    if (!dst)
+        return FALSE;
+    if (inside)
+        dir = list->chars + dirOffset;
+    memcpy(dst, dir, cchDir * sizeof(WCHAR));
+    if (separator)
+        dst[cchDir++] = PATH_SEPARATOR;
+    memcpy(dst + cchDir, name, cchName * sizeof(WCHAR));
+    dst[cch] = 0;
+    list->cchUsed += cch + 1;
+    ++list->count;
+    return TRUE;
+}
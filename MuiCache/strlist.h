@@ -0,0 +1,46 @@
+// strlist.h: growable list of NUL-terminated UTF-16 strings packed in one
+// buffer, for collecting paths without an allocation per entry.
+#ifndef MUICACHE_STRLIST_H_
+#define MUICACHE_STRLIST_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _STR_LIST {
+    WCHAR* chars;
+    DWORD cchUsed;
+    DWORD cchCapacity;
+    DWORD* offsets;
+    DWORD count;
+    DWORD slots;
+} STR_LIST;
+
+void StrList_Init(STR_LIST* list);
+void StrList_Free(STR_LIST* list);
+// Appends the first |cch| characters of |s|.
+BOOL StrList_Add(STR_LIST* list, const WCHAR* s, DWORD cch);
+// Appends |dir| and |name| joined by one PATH_SEPARATOR. |dir| may be an
+// entry of |list|.
+BOOL StrList_AddPath(STR_LIST* list, const WCHAR* dir, const WCHAR* name);
+
+// Empties |list| but keeps its buffers.
+static __inline void StrList_Clear(STR_LIST* list)
+{
+    list->cchUsed = 0;
+    list->count = 0;
+}
+
+// Pointer is invalidated by the next Add.
+static __inline const WCHAR* StrList_Get(const STR_LIST* list, DWORD index)
+{
+    return list->chars + list->offsets[index];
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_STRLIST_H_
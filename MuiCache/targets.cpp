@@ -0,0 +1,399 @@
+#include "targets.h"
+#include "strlist.h"
+#include "wspool.h"
+
+static const WCHAR kMuiCachePath[] = {
+    'L', 'o', 'c', 'a', 'l', ' ', 'S', 'e', 't', 't', 'i', 'n', 'g', 's', '\\',
+    'S', 'o', 'f', 't', 'w', 'a', 'r', 'e', '\\', 'M', 'i', 'c', 'r', 'o', 's', 'o', 'f', 't', '\\',
+    'W', 'i', 'n', 'd', 'o', 'w', 's', '\\', 'S', 'h', 'e', 'l', 'l', '\\', 'M', 'u', 'i', 'C', 'a', 'c', 'h', 'e', 0 };
+static const WCHAR kShcPath[] = {
+    'S', 'o', 'f', 't', 'w', 'a', 'r', 'e', '\\', 'M', 'i', 'c', 'r', 'o', 's', 'o', 'f', 't', '\\',
+    'W', 'i', 'n', 'd', 'o', 'w', 's', '\\', 'C', 'u', 'r', 'r', 'e', 'n', 't', 'V', 'e', 'r', 's', 'i', 'o', 'n', '\\',
+    'U', 'F', 'H', '\\', 'S', 'H', 'C', 0 };
+static const WCHAR kFirewallRulesPath[] = {
+    'S', 'Y', 'S', 'T', 'E', 'M', '\\', 'C', 'u', 'r', 'r', 'e', 'n', 't', 'C', 'o', 'n', 't', 'r', 'o', 'l', 'S', 'e', 't', '\\',
+    'S', 'e', 'r', 'v', 'i', 'c', 'e', 's', '\\', 'S', 'h', 'a', 'r', 'e', 'd', 'A', 'c', 'c', 'e', 's', 's', '\\',
+    'P', 'a', 'r', 'a', 'm', 'e', 't', 'e', 'r', 's', '\\', 'F', 'i', 'r', 'e', 'w', 'a', 'l', 'l', 'P', 'o', 'l', 'i', 'c', 'y', '\\',
+    'F', 'i', 'r', 'e', 'w', 'a', 'l', 'l', 'R', 'u', 'l', 'e', 's', 0 };
+
+// SHC only exists from Windows 10 on; FirewallRules always exists.
+static const PURGE_TARGET kBuiltinTargets[TARGET_BUILTIN_COUNT] = {
+    { "MuiCache", PURGE_ROOT_CLASSES_ROOT, kMuiCachePath, 0, 0 },
+    { "SHC", PURGE_ROOT_CURRENT_USER, kShcPath, PURGE_MATCH_DATA, TARGET_OPTIONAL },
+    { "FirewallRules", PURGE_ROOT_LOCAL_MACHINE, kFirewallRulesPath, PURGE_MATCH_FIREWALL_APP, 0 },
+};
+
+extern "C" const PURGE_TARGET* Targets_Builtin(void)
+{
+    return kBuiltinTargets;
+}
+
+static LSTATUS MemoryOpener_Open(KEY_OPENER* opener, PURGE_ROOT root, const WCHAR* path, REGKEY** key)
+{
+    REGKEY* rootKey = ((MEMORY_KEY_OPENER*)opener)->roots[root];
+    *key = NULL;
+    if (!rootKey)
+        return ERROR_FILE_NOT_FOUND;
+    return rootKey->vtbl->OpenSubKey(rootKey, path, key);
+}
+
+static const KEY_OPENER_VTBL MemoryOpener_Vtbl = {
+    MemoryOpener_Open,
+};
+
+extern "C" void MemoryKeyOpener_Init(MEMORY_KEY_OPENER* opener)
+{
+    memset(opener, 0, sizeof(MEMORY_KEY_OPENER));
+    opener->base.vtbl = &MemoryOpener_Vtbl;
+}
+
+// Purges |key| and, for TARGET_RECURSE, its subkeys depth first. Subkey
+// names are listed before any is opened, so the walk doesn't depend on
+// how the backend orders keys while values change below it.
+static LSTATUS Targets_PurgeKey(REGKEY* key, const PURGE_TARGET* target, const MATCHER* matcher, DWORD flags,
+    DWORD depth, TARGET_RESULT* result)
+{
+    STR_LIST names;
+    WCHAR name[REGKEY_MAX_KEY_NAME + 1];
+    REGKEY* subKey;
+    DWORD cchName, i;
+    LSTATUS status, subStatus;
+
+    status = Purge_ValueNamesEx(key, matcher, target->match | flags, &result->stats);
+    ++result->keys;
+    if (status != ERROR_SUCCESS || !(target->flags & TARGET_RECURSE) || !key->vtbl->EnumKey ||
+        depth >= TARGET_MAX_DEPTH)
+        return status;
+
+    StrList_Init(&names);
+    for (i = 0;; ++i)
+    {
+        cchName = REGKEY_MAX_KEY_NAME + 1;
+        subStatus = key->vtbl->EnumKey(key, i, name, &cchName);
+        if (subStatus == ERROR_NO_MORE_ITEMS)
+            break;
+        if (subStatus == ERROR_SUCCESS && !StrList_Add(&names, name, cchName))
+            subStatus = ERROR_NOT_ENOUGH_MEMORY;
+        if (subStatus != ERROR_SUCCESS)
+        {
+            status = subStatus;
+            break;
+        }
+    }
+
+    // Keep going past a failed subkey; report the first failure.
+    for (i = 0; i < names.count; ++i)
+    {
+        subStatus = key->vtbl->OpenSubKey(key, StrList_Get(&names, i), &subKey);
+        if (subStatus == ERROR_SUCCESS)
+        {
+            subStatus = Targets_PurgeKey(subKey, target, matcher, flags, depth + 1, result);
+            subKey->vtbl->Close(subKey);
+        }
+        // Deleted by someone else since it was listed.
+        if (subStatus == ERROR_FILE_NOT_FOUND)
+            subStatus = ERROR_SUCCESS;
+        if (status == ERROR_SUCCESS)
+            status = subStatus;
+    }
+    StrList_Free(&names);
+    return status;
+}
+
+struct TARGET_JOBS
+{
+    KEY_OPENER* opener;
+    const PURGE_TARGET* targets;
+    const MATCHER* matcher;
+    DWORD flags;
+    const FINGERPRINT_STORE* fingerprints; // read-only while jobs run
+    TARGET_RESULT* results;
+};
+
+// FNV-1a over what tells one target key from another.
+static DWORD Targets_Identity(const PURGE_TARGET* target)
+{
+    DWORD hash = 2166136261u;
+    const WCHAR* p;
+
+    hash = (hash ^ (DWORD)target->root) * 16777619u;
+    hash = (hash ^ target->match) * 16777619u;
+    for (p = target->path; *p; ++p)
+    {
+        hash = (hash ^ (*p & 0xFF)) * 16777619u;
+        hash = (hash ^ (*p >> 8)) * 16777619u;
+    }
+    return hash;
+}
+
+static BOOL Targets_TakeFingerprint(REGKEY* key, FINGERPRINT* fingerprint)
+{
+    return key->vtbl->QueryInfo(key, &fingerprint->values, NULL, NULL, &fingerprint->lastWrite) == ERROR_SUCCESS;
+}
+
+// TRUE when |key| still looks the way it did after the last purge.
+static BOOL Targets_Unchanged(const TARGET_JOBS* jobs, const PURGE_TARGET* target, REGKEY* key,
+    TARGET_RESULT* result)
+{
+    const FINGERPRINT* last;
+    FINGERPRINT now;
+
+    if (!jobs->fingerprints || (jobs->flags & TARGETS_FORCE) || (target->flags & TARGET_RECURSE))
+        return FALSE;
+    last = FingerprintStore_Find(jobs->fingerprints, result->fingerprint.target, result->fingerprint.patterns);
+    return last && Targets_TakeFingerprint(key, &now) && now.values == last->values
+        && now.lastWrite.dwLowDateTime == last->lastWrite.dwLowDateTime
+        && now.lastWrite.dwHighDateTime == last->lastWrite.dwHighDateTime;
+}
+
+static void Targets_Job(void* context, DWORD index, DWORD worker)
+{
+    TARGET_JOBS* jobs = (TARGET_JOBS*)context;
+    const PURGE_TARGET* target = &jobs->targets[index];
+    // Each job writes only its own result slot; totals are summed after.
+    TARGET_RESULT* result = &jobs->results[index];
+    DWORD start = Time_Milliseconds();
+    REGKEY* key;
+
+    (void)worker;
+    memset(result, 0, sizeof(TARGET_RESULT));
+    result->fingerprint.target = Targets_Identity(target);
+    result->fingerprint.patterns = Matcher_Hash(jobs->matcher);
+    result->status = jobs->opener->vtbl->Open(jobs->opener, target->root, target->path, &key);
+    if (result->status == ERROR_SUCCESS)
+    {
+        if (Targets_Unchanged(jobs, target, key, result))
+        {
+            result->skipped = TRUE;
+        }
+        else
+        {
+            result->status = Targets_PurgeKey(key, target, jobs->matcher, jobs->flags & ~TARGETS_FORCE, 0, result);
+            // Taken after the purge: deleting values moves the last-write
+            // time, and the next run should compare against that.
+            if (jobs->fingerprints && result->status == ERROR_SUCCESS && !result->stats.failed
+                && !(jobs->flags & PURGE_DRY_RUN) && !(target->flags & TARGET_RECURSE))
+                result->fingerprinted = Targets_TakeFingerprint(key, &result->fingerprint);
+        }
+        key->vtbl->Close(key);
+    }
+    result->milliseconds = Time_Milliseconds() - start;
+}
+
+// Counts a finished target into |purge|.
+static void Targets_Tally(TARGETS_PURGE* purge, const PURGE_TARGET* target, const TARGET_RESULT* result)
+{
+    if (result->status == ERROR_SUCCESS)
+        ++purge->purged;
+    else if (result->status == ERROR_FILE_NOT_FOUND && (target->flags & TARGET_OPTIONAL))
+        ++purge->missing;
+    else if (!purge->failed++)
+        purge->firstError = result->status;
+}
+
+extern "C" LSTATUS Targets_Purge(KEY_OPENER* opener, const PURGE_TARGET* targets, DWORD count, const MATCHER* matcher,
+    DWORD flags, DWORD workers, FINGERPRINT_STORE* fingerprints, TARGETS_PURGE* purge)
+{
+    TARGET_JOBS jobs;
+    WORK_POOL_STATS stats;
+    DWORD start = Time_Milliseconds();
+    DWORD i;
+
+    memset(purge, 0, sizeof(TARGETS_PURGE));
+    if (!count)
+        return ERROR_SUCCESS;
+    purge->results = (TARGET_RESULT*)Mem_Alloc(count * sizeof(TARGET_RESULT));
+    if (!purge->results)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Registry work waits on locks and I/O more than on the CPU, so by
+    // default every target gets its own thread.
+    if (!workers || workers > count)
+        workers = count;
+    if (workers > WORK_POOL_MAX_WORKERS)
+        workers = WORK_POOL_MAX_WORKERS;
+
+    jobs.opener = opener;
+    jobs.targets = targets;
+    jobs.matcher = matcher;
+    jobs.flags = flags & (PURGE_IN_PLACE | PURGE_DRY_RUN | TARGETS_FORCE);
+    jobs.fingerprints = fingerprints;
+    jobs.results = purge->results;
+    WorkPool_Run(count, workers, Targets_Job, &jobs, &stats);
+    purge->workers = stats.workers;
+    purge->milliseconds = Time_Milliseconds() - start;
+
+    for (i = 0; i < count; ++i)
+    {
+        const TARGET_RESULT* result = &purge->results[i];
+        PurgeStats_Add(&purge->totals, &result->stats);
+        if (result->skipped)
+            ++purge->skipped;
+        // The store is only written here, after the workers are done.
+        if (fingerprints && !result->skipped && !(flags & PURGE_DRY_RUN))
+        {
+            if (result->fingerprinted)
+                FingerprintStore_Set(fingerprints, &result->fingerprint);
+            else
+                FingerprintStore_Remove(fingerprints, result->fingerprint.target, result->fingerprint.patterns);
+        }
+        Targets_Tally(purge, &targets[i], result);
+    }
+    return ERROR_SUCCESS;
+}
+
+// Hex digits of one cursor field.
+#define TARGETS_CURSOR_FIELD_CCH 8
+
+static DWORD TargetsCursor_Check(const TARGETS_CURSOR* cursor)
+{
+    DWORD fields[4], hash = 2166136261u, i;
+
+    fields[0] = cursor->patterns;
+    fields[1] = cursor->target;
+    fields[2] = cursor->values.index;
+    fields[3] = cursor->values.lastName;
+    for (i = 0; i < 4; ++i)
+        hash = (hash ^ fields[i]) * 16777619u;
+    return hash;
+}
+
+extern "C" void TargetsCursor_Format(const TARGETS_CURSOR* cursor, WCHAR* text)
+{
+    static const char kHex[] = "0123456789abcdef";
+    DWORD fields[5], i, j;
+
+    fields[0] = cursor->patterns;
+    fields[1] = cursor->target;
+    fields[2] = cursor->values.index;
+    fields[3] = cursor->values.lastName;
+    fields[4] = TargetsCursor_Check(cursor);
+    for (i = 0; i < 5; ++i)
+    {
+        for (j = 0; j < TARGETS_CURSOR_FIELD_CCH; ++j)
+            *text++ = (WCHAR)kHex[(fields[i] >> (28 - 4 * j)) & 0xF];
+    }
+    *text = 0;
+}
+
+extern "C" BOOL TargetsCursor_Parse(const WCHAR* text, TARGETS_CURSOR* cursor)
+{
+    DWORD fields[5], i, j, digit;
+    WCHAR ch;
+
+    memset(cursor, 0, sizeof(TARGETS_CURSOR));
+    if (!text[0])
+        return TRUE;
+    for (i = 0; i < 5; ++i)
+    {
+        fields[i] = 0;
+        for (j = 0; j < TARGETS_CURSOR_FIELD_CCH; ++j)
+        {
+            ch = *text++;
+            if (ch >= '0' && ch <= '9')
+                digit = ch - '0';
+            else if (ch >= 'a' && ch <= 'f')
+                digit = ch - 'a' + 10;
+            else
+                return FALSE;
+            fields[i] = (fields[i] << 4) | digit;
+        }
+    }
+    if (*text)
+        return FALSE;
+
+    cursor->patterns = fields[0];
+    cursor->target = fields[1];
+    cursor->values.index = fields[2];
+    cursor->values.lastName = fields[3];
+    if (fields[4] != TargetsCursor_Check(cursor))
+    {
+        memset(cursor, 0, sizeof(TARGETS_CURSOR));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+extern "C" LSTATUS Targets_PurgeUntil(KEY_OPENER* opener, const PURGE_TARGET* targets, DWORD count,
+    const MATCHER* matcher, DWORD flags, DWORD deadline, TARGETS_CURSOR* cursor, TARGETS_PURGE* purge)
+{
+    DWORD start = Time_Milliseconds();
+    DWORD patterns = Matcher_Hash(matcher);
+    LSTATUS status = ERROR_SUCCESS;
+    BOOL worked = FALSE;
+    REGKEY* key;
+
+    memset(purge, 0, sizeof(TARGETS_PURGE));
+    if (count)
+    {
+        purge->results = (TARGET_RESULT*)Mem_Alloc(count * sizeof(TARGET_RESULT));
+        if (!purge->results)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        memset(purge->results, 0, count * sizeof(TARGET_RESULT));
+    }
+    purge->workers = 1;
+
+    // A cursor left by another pattern set, or past the table, starts over.
+    if (cursor->patterns != patterns || cursor->target >= count)
+    {
+        memset(cursor, 0, sizeof(TARGETS_CURSOR));
+        cursor->patterns = patterns;
+    }
+    flags &= PURGE_DRY_RUN;
+
+    for (; cursor->target < count; ++cursor->target)
+    {
+        const PURGE_TARGET* target = &targets[cursor->target];
+        TARGET_RESULT* result = &purge->results[cursor->target];
+        DWORD targetStart = Time_Milliseconds();
+
+        // Checked between targets too, once this call got something done.
+        if (worked && (LONG)(Time_Milliseconds() - deadline) >= 0)
+        {
+            status = WAIT_TIMEOUT;
+            break;
+        }
+        worked = TRUE;
+
+        result->status = opener->vtbl->Open(opener, target->root, target->path, &key);
+        if (result->status == ERROR_SUCCESS)
+        {
+            // Subkeys are listed anew on every walk, so a recursive target
+            // is purged whole rather than resumed.
+            if (target->flags & TARGET_RECURSE)
+            {
+                result->status = Targets_PurgeKey(key, target, matcher, flags | PURGE_IN_PLACE, 0, result);
+            }
+            else
+            {
+                result->status = Purge_ValueNamesUntil(key, matcher, target->match | flags, deadline,
+                    &cursor->values, &result->stats);
+                ++result->keys;
+            }
+            key->vtbl->Close(key);
+        }
+        result->milliseconds = Time_Milliseconds() - targetStart;
+
+        if (result->status == WAIT_TIMEOUT)
+        {
+            // Stopped inside this target: it is neither done nor failed.
+            PurgeStats_Add(&purge->totals, &result->stats);
+            status = WAIT_TIMEOUT;
+            break;
+        }
+        memset(&cursor->values, 0, sizeof(PURGE_CURSOR));
+        PurgeStats_Add(&purge->totals, &result->stats);
+        Targets_Tally(purge, target, result);
+    }
+
+    if (status == ERROR_SUCCESS)
+        memset(cursor, 0, sizeof(TARGETS_CURSOR));
+    purge->milliseconds = Time_Milliseconds() - start;
+    return status;
+}
+
+extern "C" void Targets_Free(TARGETS_PURGE* purge)
+{
+    Mem_Free(purge->results);
+    purge->results = NULL;
+}
@@ -0,0 +1,146 @@
+// targets.h: the registry keys Clear can purge, as a table, and a runner
+// that purges several of them at once. Each target names a root and path,
+// how values are matched (name, string data or firewall App= field) and
+// whether subkeys are purged too. Keys are opened through a KEY_OPENER, so
+// the runner works the same on the registry and on memory keys.
+#ifndef MUICACHE_TARGETS_H_
+#define MUICACHE_TARGETS_H_
+
+#include "fingerprint.h"
+#include "purge.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef enum _PURGE_ROOT {
+    PURGE_ROOT_CLASSES_ROOT = 0,
+    PURGE_ROOT_CURRENT_USER,
+    PURGE_ROOT_LOCAL_MACHINE,
+    PURGE_ROOT_COUNT
+} PURGE_ROOT;
+
+// PURGE_TARGET flags.
+#define TARGET_RECURSE  0x0001 // purge every subkey as well
+#define TARGET_OPTIONAL 0x0002 // a missing key is not an error
+
+// Targets_Purge flag beyond the PURGE_* ones: purge even the targets whose
+// fingerprint says they haven't changed.
+#define TARGETS_FORCE 0x0100
+
+// Subkey levels below a target that TARGET_RECURSE descends into.
+#define TARGET_MAX_DEPTH 16
+
+typedef struct _PURGE_TARGET {
+    const char* name; // short ASCII label for reports
+    PURGE_ROOT root;
+    const WCHAR* path;
+    DWORD match; // 0 for value names, or PURGE_MATCH_DATA / PURGE_MATCH_FIREWALL_APP
+    DWORD flags; // TARGET_*
+} PURGE_TARGET;
+
+// Built-in targets, in Targets_Builtin order.
+#define TARGET_MUICACHE  0 // HKCR MuiCache, value names
+#define TARGET_SHC       1 // HKCU UFH\SHC, multi-string data
+#define TARGET_FIREWALL  2 // HKLM FirewallRules, App= field; needs elevation
+#define TARGET_BUILTIN_COUNT 3
+
+const PURGE_TARGET* Targets_Builtin(void);
+
+typedef struct _KEY_OPENER KEY_OPENER;
+
+typedef struct _KEY_OPENER_VTBL {
+    // Opens |path| under |root| for reading and deleting values; called
+    // concurrently from several threads.
+    LSTATUS (*Open)(KEY_OPENER* opener, PURGE_ROOT root, const WCHAR* path, REGKEY** key);
+} KEY_OPENER_VTBL;
+
+struct _KEY_OPENER {
+    const KEY_OPENER_VTBL* vtbl;
+};
+
+#if defined(_WIN32)
+// Opens keys of the live registry.
+KEY_OPENER* KeyOpener_Win32(void);
+#endif
+
+// Memory keys standing in for the roots, e.g. on Linux. Open hands out a
+// new reference to the subkey of roots[root].
+typedef struct _MEMORY_KEY_OPENER {
+    KEY_OPENER base;
+    REGKEY* roots[PURGE_ROOT_COUNT];
+} MEMORY_KEY_OPENER;
+
+void MemoryKeyOpener_Init(MEMORY_KEY_OPENER* opener);
+
+typedef struct _TARGET_RESULT {
+    // ERROR_FILE_NOT_FOUND for a missing key; for TARGET_RECURSE, the first
+    // error met in a subkey if the target key itself went fine.
+    LSTATUS status;
+    PURGE_STATS stats;  // subkeys included
+    DWORD keys;         // keys purged, subkeys included
+    DWORD milliseconds; // wall time, opening the key included
+    BOOL skipped;       // unchanged since its fingerprint was taken
+    BOOL fingerprinted; // |fingerprint| holds the key as purged
+    FINGERPRINT fingerprint;
+} TARGET_RESULT;
+
+typedef struct _TARGETS_PURGE {
+    TARGET_RESULT* results; // per target
+    DWORD purged;           // targets purged without error, skipped ones included
+    DWORD skipped;          // targets left alone as unchanged
+    DWORD missing;          // optional targets whose key doesn't exist
+    DWORD failed;
+    PURGE_STATS totals;     // all targets
+    LSTATUS firstError;     // status of the first failed target, in order
+    DWORD workers;
+    DWORD milliseconds;     // wall time of the whole run
+} TARGETS_PURGE;
+
+// Purges |count| |targets| with |matcher|, up to |workers| targets at a
+// time (0: all of them at once), each on its own thread. |flags| are
+// PURGE_IN_PLACE, PURGE_DRY_RUN and TARGETS_FORCE, applied to every target.
+// Targets must name distinct keys. Fills |purge|, which the caller releases
+// with Targets_Free even on failure.
+// With |fingerprints|, a target whose key has the last-write time and
+// value count recorded after the previous purge with the same pattern set
+// is skipped without enumerating it, and the fingerprint of every key
+// purged cleanly is updated. Dry runs read fingerprints but don't record
+// them. TARGET_RECURSE targets are always purged: a change in a subkey
+// doesn't touch the parent's last-write time.
+LSTATUS Targets_Purge(KEY_OPENER* opener, const PURGE_TARGET* targets, DWORD count, const MATCHER* matcher,
+    DWORD flags, DWORD workers, FINGERPRINT_STORE* fingerprints, TARGETS_PURGE* purge);
+void Targets_Free(TARGETS_PURGE* purge);
+
+// Where Targets_PurgeUntil stopped. Zeroed starts from the first target.
+typedef struct _TARGETS_CURSOR {
+    DWORD patterns;      // Matcher_Hash of the run it belongs to
+    DWORD target;        // index of the target to go on with
+    PURGE_CURSOR values; // within that target's key
+} TARGETS_CURSOR;
+
+// Chars TargetsCursor_Format writes, with the NUL.
+#define TARGETS_CURSOR_CCH 41
+
+// Targets_Purge one target after another on the calling thread, values
+// deleted in place, stopping once the Time_Milliseconds() value |deadline|
+// has passed (see Purge_ValueNamesUntil). Returns WAIT_TIMEOUT with
+// |cursor| set to resume from, or ERROR_SUCCESS with |cursor| zeroed once
+// every target is done. A cursor taken with another pattern set starts
+// over. |flags| may hold PURGE_DRY_RUN. |purge| covers this call only; a
+// target interrupted is neither purged nor failed in it. TARGET_RECURSE
+// targets are purged whole.
+LSTATUS Targets_PurgeUntil(KEY_OPENER* opener, const PURGE_TARGET* targets, DWORD count,
+    const MATCHER* matcher, DWORD flags, DWORD deadline, TARGETS_CURSOR* cursor, TARGETS_PURGE* purge);
+
+// |cursor| as TARGETS_CURSOR_CCH hex chars, for callers that keep it as a
+// string. Parse takes that text back, or "" for a zeroed cursor; anything
+// else leaves it zeroed and returns FALSE.
+void TargetsCursor_Format(const TARGETS_CURSOR* cursor, WCHAR* text);
+BOOL TargetsCursor_Parse(const WCHAR* text, TARGETS_CURSOR* cursor);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_TARGETS_H_
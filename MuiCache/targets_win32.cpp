@@ -0,0 +1,34 @@
+// KEY_OPENER over the live registry.
+#include "targets.h"
+
+static LSTATUS Win32_OpenTarget(KEY_OPENER* opener, PURGE_ROOT root, const WCHAR* path, REGKEY** key)
+{
+    HKEY hRoot;
+    switch (root)
+    {
+    case PURGE_ROOT_CLASSES_ROOT:
+        hRoot = HKEY_CLASSES_ROOT;
+        break;
+    case PURGE_ROOT_CURRENT_USER:
+        hRoot = HKEY_CURRENT_USER;
+        break;
+    case PURGE_ROOT_LOCAL_MACHINE:
+        hRoot = HKEY_LOCAL_MACHINE;
+        break;
+    default:
+        *key = NULL;
+        return ERROR_INVALID_PARAMETER;
+    }
+    return RegKey_OpenWin32(hRoot, path, KEY_READ | KEY_WRITE, key);
+}
+
+static const KEY_OPENER_VTBL Win32_KeyOpenerVtbl = {
+    Win32_OpenTarget,
+};
+
+static KEY_OPENER Win32_KeyOpener = { &Win32_KeyOpenerVtbl };
+
+extern "C" KEY_OPENER* KeyOpener_Win32(void)
+{
+    return &Win32_KeyOpener;
+}
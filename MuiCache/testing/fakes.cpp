@@ -0,0 +1,267 @@
+#include "fakes.h"
+#include "purge.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+WSTR FakeDir_Join(const WSTR& dir, const WSTR& name)
+{
+    WSTR path = dir;
+    if (!path.empty() && path.back() != '\\' && path.back() != '/')
+        path.push_back(PATH_SEPARATOR);
+    return path + name;
+}
+
+static LSTATUS FakeDirLister_List(DIR_LISTER* base, const WCHAR* dir, DIR_LIST_CALLBACK callback, void* context)
+{
+    FAKE_DIR_LISTER* lister = (FAKE_DIR_LISTER*)base;
+    std::map<WSTR, std::vector<FAKE_DIR_ENTRY> >::const_iterator it = lister->dirs.find(WSTR(dir));
+
+    Atomic_Increment(&lister->lists);
+    if (it == lister->dirs.end())
+        return ERROR_PATH_NOT_FOUND;
+    for (const FAKE_DIR_ENTRY& entry : it->second)
+    {
+        if (!callback(context, entry.name.c_str(), entry.isDirectory))
+            break;
+    }
+    return ERROR_SUCCESS;
+}
+
+static const DIR_LISTER_VTBL kFakeDirListerVtbl = {
+    FakeDirLister_List,
+};
+
+void FakeDirLister_Init(FAKE_DIR_LISTER* lister)
+{
+    lister->base.vtbl = &kFakeDirListerVtbl;
+    lister->dirs.clear();
+    lister->lists = 0;
+}
+
+void FakeDirLister_Add(FAKE_DIR_LISTER* lister, const WSTR& dir, const WSTR& name, BOOL isDirectory)
+{
+    FAKE_DIR_ENTRY entry = { name, isDirectory };
+    lister->dirs[dir].push_back(entry);
+    if (isDirectory)
+        lister->dirs[FakeDir_Join(dir, name)];
+}
+
+static LSTATUS PosixDirLister_List(DIR_LISTER* lister, const WCHAR* dir, DIR_LIST_CALLBACK callback, void* context)
+{
+    std::string path = N(dir, Str_Length(dir));
+    struct dirent* entry;
+    struct stat st;
+    DIR* d;
+
+    (void)lister;
+    d = opendir(path.c_str());
+    if (!d)
+        return ERROR_PATH_NOT_FOUND;
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        if (stat((path + "/" + entry->d_name).c_str(), &st) != 0)
+            continue;
+        if (!callback(context, W(entry->d_name).c_str(), S_ISDIR(st.st_mode)))
+            break;
+    }
+    closedir(d);
+    return ERROR_SUCCESS;
+}
+
+static const DIR_LISTER_VTBL kPosixDirListerVtbl = {
+    PosixDirLister_List,
+};
+
+DIR_LISTER g_posixDirLister = { &kPosixDirListerVtbl };
+
+static BOOL FakeVerbExecutor_ThreadAttach(VERB_EXECUTOR* base)
+{
+    Atomic_Increment(&((FAKE_VERB_EXECUTOR*)base)->attaches);
+    return TRUE;
+}
+
+static void FakeVerbExecutor_ThreadDetach(VERB_EXECUTOR* base)
+{
+    Atomic_Increment(&((FAKE_VERB_EXECUTOR*)base)->detaches);
+}
+
+static LONG FakeVerbExecutor_Execute(VERB_EXECUTOR* base, const WCHAR* verb, const WCHAR* path)
+{
+    FAKE_VERB_EXECUTOR* executor = (FAKE_VERB_EXECUTOR*)base;
+    LONG active = Atomic_Increment(&executor->active);
+    LONG peak;
+    DWORD cch = Str_Length(path);
+
+    (void)verb;
+    while ((peak = Atomic_Load(&executor->peak)) < active && Atomic_CompareExchange(&executor->peak, active, peak) != peak)
+        ;
+    if (executor->delayMicroseconds)
+        usleep(executor->delayMicroseconds);
+    Atomic_Add(&executor->active, -1);
+    Atomic_Increment(&executor->calls);
+    return executor->failSuffix && cch && path[cch - 1] == executor->failSuffix ? 2 : 42;
+}
+
+static const VERB_EXECUTOR_VTBL kFakeVerbExecutorVtbl = {
+    FakeVerbExecutor_ThreadAttach,
+    FakeVerbExecutor_ThreadDetach,
+    FakeVerbExecutor_Execute,
+};
+
+void FakeVerbExecutor_Init(FAKE_VERB_EXECUTOR* executor)
+{
+    memset(executor, 0, sizeof(FAKE_VERB_EXECUTOR));
+    executor->base.vtbl = &kFakeVerbExecutorVtbl;
+}
+
+static HRESULT FakePin_Open(void* ctx)
+{
+    FAKE_PIN_CONTEXT* context = (FAKE_PIN_CONTEXT*)ctx;
+    ++context->opens;
+    return context->openResult;
+}
+
+static HRESULT FakePin_Modify(void* ctx, const WCHAR* path, BOOL pinning)
+{
+    FAKE_PIN_CONTEXT* context = (FAKE_PIN_CONTEXT*)ctx;
+    DWORD call = context->modifies++;
+
+    if (call == context->disconnectAt)
+        return PIN_E_DISCONNECTED;
+    if (context->failPrefix && path[0] == context->failPrefix)
+        return E_FAIL;
+    return pinning ? S_OK : S_FALSE;
+}
+
+static HRESULT FakePin_Reconnect(void* ctx)
+{
+    FAKE_PIN_CONTEXT* context = (FAKE_PIN_CONTEXT*)ctx;
+    ++context->reconnects;
+    return context->failReconnect ? E_FAIL : S_OK;
+}
+
+static void FakePin_Close(void* ctx)
+{
+    ++((FAKE_PIN_CONTEXT*)ctx)->closes;
+}
+
+const PIN_SESSION_OPS kFakePinSessionOps = {
+    FakePin_Open,
+    FakePin_Modify,
+    FakePin_Reconnect,
+    FakePin_Close,
+};
+
+void FakePinContext_Init(FAKE_PIN_CONTEXT* context)
+{
+    memset(context, 0, sizeof(FAKE_PIN_CONTEXT));
+    context->disconnectAt = (DWORD)-1;
+}
+
+void Key_Fill(REGKEY* key, const std::vector<WSTR>& names)
+{
+    for (const WSTR& name : names)
+        RegKey_MemorySetValue(key, name.c_str(), REG_SZ, (const BYTE*)name.c_str(), (DWORD)(name.size() + 1) * sizeof(WCHAR));
+}
+
+std::vector<WSTR> Key_ValueNames(REGKEY* key)
+{
+    std::vector<WSTR> names;
+    std::vector<WCHAR> name(PURGE_MAX_VALUE_NAME + 1);
+    DWORD count = 0;
+
+    key->vtbl->QueryInfo(key, &count, NULL, NULL, NULL);
+    for (DWORD i = 0; i < count; ++i)
+    {
+        DWORD cch = (DWORD)name.size();
+        if (key->vtbl->EnumValue(key, i, name.data(), &cch, NULL, NULL, NULL) == ERROR_SUCCESS)
+            names.push_back(WSTR(name.data(), cch));
+    }
+    return names;
+}
+
+WSTR Scratch_Dir(const char* tag)
+{
+    const char* tmp = getenv("TMPDIR");
+    std::string path = std::string(tmp && tmp[0] ? tmp : "/tmp") + "/muicache-" + tag + "-XXXXXX";
+    std::vector<char> buffer(path.begin(), path.end());
+
+    buffer.push_back(0);
+    if (!mkdtemp(buffer.data()))
+        return WSTR();
+    return W(buffer.data());
+}
+
+static void Scratch_RemoveTree(const std::string& path)
+{
+    struct dirent* entry;
+    struct stat st;
+    DIR* d = opendir(path.c_str());
+
+    if (d)
+    {
+        while ((entry = readdir(d)) != NULL)
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+            std::string child = path + "/" + name;
+            if (lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+                Scratch_RemoveTree(child);
+            else
+                unlink(child.c_str());
+        }
+        closedir(d);
+    }
+    rmdir(path.c_str());
+}
+
+void Scratch_Remove(const WSTR& dir)
+{
+    if (!dir.empty())
+        Scratch_RemoveTree(N(dir));
+}
+
+BOOL Scratch_Write(const WSTR& path, const std::vector<BYTE>& data)
+{
+    FILE* f = fopen(N(path).c_str(), "wb");
+    BOOL ok = TRUE;
+
+    if (!f)
+        return FALSE;
+    if (!data.empty())
+        ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+std::vector<BYTE> Scratch_Read(const WSTR& path)
+{
+    std::vector<BYTE> data;
+    BYTE buffer[4096];
+    size_t got;
+    FILE* f = fopen(N(path).c_str(), "rb");
+
+    if (!f)
+        return data;
+    while ((got = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.insert(data.end(), buffer, buffer + got);
+    fclose(f);
+    return data;
+}
+
+BOOL Scratch_Touch(const WSTR& path, DWORD seconds)
+{
+    struct timeval times[2];
+
+    times[0].tv_sec = (time_t)seconds;
+    times[0].tv_usec = 0;
+    times[1] = times[0];
+    return utimes(N(path).c_str(), times) == 0;
+}
@@ -0,0 +1,84 @@
+// fakes.h: stand-ins for the vtables the cores reach the system through
+// (DIR_LISTER, VERB_EXECUTOR, PIN_SESSION_OPS), for the Linux benchmarks and
+// tests. Each one counts what it was asked to do.
+#ifndef MUICACHE_TESTING_FAKES_H_
+#define MUICACHE_TESTING_FAKES_H_
+
+#include "dirlist.h"
+#include "regkey.h"
+#include "pinsession.h"
+#include "unpin.h"
+#include "gen.h"
+
+#include <map>
+
+// A directory tree held in memory. Directories are addressed the way the
+// walkers build paths: the root as given, then joined by PATH_SEPARATOR.
+typedef struct _FAKE_DIR_ENTRY {
+    WSTR name;
+    BOOL isDirectory;
+} FAKE_DIR_ENTRY;
+
+typedef struct _FAKE_DIR_LISTER {
+    DIR_LISTER base;
+    std::map<WSTR, std::vector<FAKE_DIR_ENTRY> > dirs;
+    volatile LONG lists;
+} FAKE_DIR_LISTER;
+
+void FakeDirLister_Init(FAKE_DIR_LISTER* lister);
+// Adds |name| to |dir|; a directory also becomes listable itself.
+void FakeDirLister_Add(FAKE_DIR_LISTER* lister, const WSTR& dir, const WSTR& name, BOOL isDirectory);
+// |dir| joined with |name| as the walkers do it.
+WSTR FakeDir_Join(const WSTR& dir, const WSTR& name);
+
+// Lists a real directory with opendir/readdir, skipping dot files like the
+// Win32 lister skips hidden ones.
+extern DIR_LISTER g_posixDirLister;
+
+// Verb executor that records calls and how many ran at once.
+typedef struct _FAKE_VERB_EXECUTOR {
+    VERB_EXECUTOR base;
+    volatile LONG attaches;
+    volatile LONG detaches;
+    volatile LONG calls;
+    volatile LONG active;
+    volatile LONG peak;
+    DWORD delayMicroseconds; // per call, to make overlap visible
+    // Paths ending in this char fail with 2 (file not found); 0 for none.
+    WCHAR failSuffix;
+} FAKE_VERB_EXECUTOR;
+
+void FakeVerbExecutor_Init(FAKE_VERB_EXECUTOR* executor);
+
+// Context of kFakePinSessionOps.
+typedef struct _FAKE_PIN_CONTEXT {
+    DWORD opens;
+    DWORD modifies;
+    DWORD reconnects;
+    DWORD closes;
+    HRESULT openResult;
+    DWORD disconnectAt;  // Modify call (from 0) that reports a disconnect, or -1
+    BOOL failReconnect;
+    WCHAR failPrefix;    // paths starting with it fail with E_FAIL; 0 for none
+} FAKE_PIN_CONTEXT;
+
+void FakePinContext_Init(FAKE_PIN_CONTEXT* context);
+extern const PIN_SESSION_OPS kFakePinSessionOps;
+
+// Memory keys (regkey_mem.cpp) as the tests set them up and read them back.
+// Key_Fill adds |names| as REG_SZ values holding the name itself.
+void Key_Fill(REGKEY* key, const std::vector<WSTR>& names);
+// Value names of |key| in enumeration order.
+std::vector<WSTR> Key_ValueNames(REGKEY* key);
+
+// Real files for the tests that go through fileio.cpp. Scratch_Dir makes a
+// fresh directory under $TMPDIR (else /tmp) and returns its path;
+// Scratch_Remove deletes it with everything in it.
+WSTR Scratch_Dir(const char* tag);
+void Scratch_Remove(const WSTR& dir);
+BOOL Scratch_Write(const WSTR& path, const std::vector<BYTE>& data);
+std::vector<BYTE> Scratch_Read(const WSTR& path);
+// Sets the last-write time of |path| to |seconds| since 1970.
+BOOL Scratch_Touch(const WSTR& path, DWORD seconds);
+
+#endif // MUICACHE_TESTING_FAKES_H_
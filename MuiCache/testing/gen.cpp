@@ -0,0 +1,612 @@
+// Generators behind gen.h. Vendor, product and word lists are small fixed
+// tables; everything else is derived from the app index or the RNG.
+#include "gen.h"
+#include "hive.h"
+#include "lnkfile.h"
+
+#include <stdio.h>
+
+static const char* const kVendors[] = {
+    "Contoso", "Fabrikam", "Northwind", "Litware", "Adatum", "Tailspin", "Wingtip", "Proseware",
+    "Lucerne", "Fourth Coffee", "Woodgrove", "Alpine Ski House", "Blue Yonder", "Coho Winery",
+};
+static const char* const kProducts[] = {
+    "Studio", "Player", "Sync", "Updater", "Helper", "Agent", "Viewer", "Editor", "Launcher", "Tools",
+    "Desktop", "Client", "Service", "Manager",
+};
+static const char* const kRoots[] = {
+    "C:\\Program Files", "C:\\Program Files (x86)", "C:\\Users\\user\\AppData\\Local\\Programs",
+};
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+WSTR W(const char* s)
+{
+    WSTR w;
+    for (; *s; ++s)
+        w.push_back((WCHAR)(unsigned char)*s);
+    return w;
+}
+
+std::string N(const WCHAR* s, DWORD cch)
+{
+    std::string n;
+    for (DWORD i = 0; i < cch; ++i)
+        n.push_back(s[i] <= 0xFF ? (char)s[i] : '?');
+    return n;
+}
+
+std::string N(const WSTR& s)
+{
+    return N(s.c_str(), (DWORD)s.size());
+}
+
+void Gen_Seed(GEN_RNG* rng, ULONGLONG seed)
+{
+    rng->state = seed;
+}
+
+DWORD Gen_Next(GEN_RNG* rng)
+{
+    ULONGLONG z = (rng->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (DWORD)((z ^ (z >> 31)) >> 32);
+}
+
+DWORD Gen_Below(GEN_RNG* rng, DWORD n)
+{
+    return (DWORD)(((ULONGLONG)Gen_Next(rng) * n) >> 32);
+}
+
+WSTR Gen_ImageName(DWORD app)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%s%u.exe", kProducts[app % COUNT_OF(kProducts)], app);
+    return W(name);
+}
+
+WSTR Gen_AppDir(DWORD app)
+{
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s\\%s\\%s %u", kRoots[app % COUNT_OF(kRoots)],
+        kVendors[(app / 3) % COUNT_OF(kVendors)], kProducts[app % COUNT_OF(kProducts)], app / 7);
+    return W(dir);
+}
+
+static WSTR Gen_ExePath(DWORD app)
+{
+    return Gen_AppDir(app) + W("\\") + Gen_ImageName(app);
+}
+
+WSTR Gen_MuiCacheName(GEN_RNG* rng, DWORD* app)
+{
+    char resource[96];
+    DWORD kind = Gen_Below(rng, 100);
+    WSTR path;
+
+    *app = Gen_Below(rng, GEN_APP_COUNT);
+    if (kind < 95)
+    {
+        // Every update of a self-updating app runs from a new versioned
+        // folder and leaves its own names behind, which is how a key grows
+        // to a million distinct values.
+        snprintf(resource, sizeof(resource), "\\app-%u.%u.%u\\", Gen_Below(rng, 40), Gen_Below(rng, 100),
+            Gen_Below(rng, 10000));
+        path = Gen_AppDir(*app) + W(resource) + Gen_ImageName(*app);
+    }
+    if (kind < 45)
+        return path + W(".FriendlyAppName");
+    if (kind < 85)
+        return path + W(".ApplicationCompany");
+    if (kind < 95)
+        return path;
+    *app = GEN_APP_COUNT;
+    snprintf(resource, sizeof(resource), "@%%SystemRoot%%\\system32\\shell32.dll,-%u", 8000 + Gen_Below(rng, 30000));
+    return W(resource);
+}
+
+WSTR Gen_FirewallRule(GEN_RNG* rng, DWORD* app)
+{
+    static const char* const kProtocols[] = { "6", "17", "1", "58" };
+    static const char* const kProfiles[] = { "Private", "Public", "Domain" };
+    char head[160], tail[64];
+    DWORD other;
+    WSTR rule;
+
+    snprintf(head, sizeof(head), "v2.%u|Action=%s|Active=%s|Dir=%s|Protocol=%s|Profile=%s|",
+        24 + Gen_Below(rng, 8), Gen_Below(rng, 4) ? "Allow" : "Block", Gen_Below(rng, 5) ? "TRUE" : "FALSE",
+        Gen_Below(rng, 2) ? "In" : "Out", kProtocols[Gen_Below(rng, COUNT_OF(kProtocols))],
+        kProfiles[Gen_Below(rng, COUNT_OF(kProfiles))]);
+    rule = W(head);
+    *app = Gen_Below(rng, GEN_APP_COUNT);
+    other = Gen_Below(rng, GEN_APP_COUNT);
+    if (Gen_Below(rng, 10) == 0)
+    {
+        // Port rule of a service: no App= at all.
+        snprintf(tail, sizeof(tail), "LPort=%u|Svc=svc%u|", 1024 + Gen_Below(rng, 40000), *app);
+        rule += W(tail) + W("Name=Service rule|");
+        *app = GEN_APP_COUNT;
+        return rule;
+    }
+    rule += W("App=") + Gen_ExePath(*app) + W("|Name=") + Gen_ImageName(*app) + W("|");
+    // Descriptions naming some other program, which must not count as a hit.
+    if (Gen_Below(rng, 3) == 0)
+        rule += W("Desc=Allows ") + Gen_ImageName(other) + W(" to reach the update server|");
+    snprintf(tail, sizeof(tail), "EmbedCtxt=@{Package%u}|", Gen_Below(rng, 1000));
+    rule += W(tail);
+    return rule;
+}
+
+std::vector<BYTE> Gen_ShcRecord(GEN_RNG* rng, DWORD* app)
+{
+    char number[16];
+    WSTR fields[6];
+    std::vector<BYTE> data;
+
+    *app = Gen_Below(rng, GEN_APP_COUNT);
+    fields[0] = W("C:\\ProgramData\\Microsoft\\Windows\\Start Menu\\Programs\\") + Gen_ImageName(*app) + W(".lnk");
+    fields[1] = Gen_ExePath(*app);
+    snprintf(number, sizeof(number), "%u", Gen_Below(rng, 100));
+    fields[3] = W(number);
+    snprintf(number, sizeof(number), "%u", 1 + Gen_Below(rng, 9));
+    fields[5] = W(number);
+    for (DWORD i = 0; i < COUNT_OF(fields); ++i)
+    {
+        for (WCHAR ch : fields[i])
+        {
+            data.push_back((BYTE)ch);
+            data.push_back((BYTE)(ch >> 8));
+        }
+        data.push_back(0);
+        data.push_back(0);
+    }
+    data.push_back(0);
+    data.push_back(0);
+    return data;
+}
+
+static void Put16(std::vector<BYTE>& b, DWORD v)
+{
+    b.push_back((BYTE)v);
+    b.push_back((BYTE)(v >> 8));
+}
+
+static void Put32(std::vector<BYTE>& b, DWORD v)
+{
+    Put16(b, v);
+    Put16(b, v >> 16);
+}
+
+static void Set32(std::vector<BYTE>& b, size_t at, DWORD v)
+{
+    b[at] = (BYTE)v;
+    b[at + 1] = (BYTE)(v >> 8);
+    b[at + 2] = (BYTE)(v >> 16);
+    b[at + 3] = (BYTE)(v >> 24);
+}
+
+static void PutChars(std::vector<BYTE>& b, const WCHAR* s, BOOL unicode)
+{
+    for (; *s; ++s)
+    {
+        if (unicode)
+            Put16(b, *s);
+        else
+            b.push_back((BYTE)*s);
+    }
+}
+
+void GenLnk_Init(GEN_LNK* spec)
+{
+    memset(spec, 0, sizeof(GEN_LNK));
+    spec->dualMode = -1;
+}
+
+static void Gen_PutLinkInfo(std::vector<BYTE>& f, const GEN_LNK* spec)
+{
+    size_t start = f.size();
+    DWORD headerSize = spec->unicodeTarget ? 0x24 : 0x1C;
+    DWORD volumeOffset = headerSize, volumeSize = 0x11;
+    DWORD baseOffset = volumeOffset + volumeSize;
+    DWORD suffixOffset = baseOffset + Str_Length(spec->target) + 1;
+
+    Put32(f, 0); // LinkInfoSize, patched
+    Put32(f, headerSize);
+    Put32(f, LNK_VOLUME_ID_AND_LOCAL_BASE_PATH);
+    Put32(f, volumeOffset);
+    Put32(f, baseOffset);
+    Put32(f, 0);            // CommonNetworkRelativeLinkOffset
+    Put32(f, suffixOffset); // CommonPathSuffixOffset
+    if (spec->unicodeTarget)
+    {
+        Put32(f, 0); // LocalBasePathOffsetUnicode, patched
+        Put32(f, 0); // CommonPathSuffixOffsetUnicode, patched
+    }
+    // VolumeID: size, DRIVE_FIXED, serial, label offset, empty label.
+    Put32(f, volumeSize);
+    Put32(f, 3);
+    Put32(f, 0x1234ABCD);
+    Put32(f, 0x10);
+    f.push_back(0);
+    PutChars(f, spec->target, FALSE);
+    f.push_back(0);
+    f.push_back(0); // empty CommonPathSuffix
+    if (spec->unicodeTarget)
+    {
+        if ((f.size() - start) & 1)
+            f.push_back(0);
+        Set32(f, start + 28, (DWORD)(f.size() - start));
+        PutChars(f, spec->target, TRUE);
+        Put16(f, 0);
+        Set32(f, start + 32, (DWORD)(f.size() - start));
+        Put16(f, 0);
+    }
+    Set32(f, start, (DWORD)(f.size() - start));
+}
+
+// Serialized property value: size, pid, reserved, type, padding, data.
+static void Gen_PutValue(std::vector<BYTE>& s, DWORD pid, DWORD vt, const std::vector<BYTE>& data)
+{
+    DWORD size = 13 + (DWORD)data.size();
+    DWORD pad = (4 - size % 4) % 4;
+
+    Put32(s, size + pad);
+    Put32(s, pid);
+    s.push_back(0);
+    Put16(s, vt);
+    Put16(s, 0);
+    s.insert(s.end(), data.begin(), data.end());
+    s.insert(s.end(), pad, 0);
+}
+
+static void Gen_PutPropertyStore(std::vector<BYTE>& f, const GEN_LNK* spec)
+{
+    std::vector<BYTE> values, data;
+    size_t start;
+
+    if (spec->appId)
+    {
+        DWORD cch = Str_Length(spec->appId) + 1;
+        Put32(data, cch);
+        PutChars(data, spec->appId, TRUE);
+        Put16(data, 0);
+        Gen_PutValue(values, LNK_PID_AppUserModel_ID, 0x1F, data);
+    }
+    if (spec->dualMode >= 0)
+    {
+        data.clear();
+        Put16(data, spec->dualMode ? 0xFFFF : 0);
+        Gen_PutValue(values, LNK_PID_AppUserModel_IsDualMode, 0x0B, data);
+    }
+    if (spec->toastActivatorClsid)
+    {
+        data.assign(spec->toastActivatorClsid, spec->toastActivatorClsid + 16);
+        Gen_PutValue(values, LNK_PID_AppUserModel_ToastActivatorCLSID, 0x48, data);
+    }
+
+    start = f.size();
+    Put32(f, 0); // BlockSize, patched
+    Put32(f, LNK_PROPERTY_STORE_SIGNATURE);
+    Put32(f, 24 + (DWORD)values.size() + 4); // StorageSize
+    Put32(f, 0x53505331);                     // 'SPS1'
+    f.insert(f.end(), LNK_FMTID_AppUserModel.bytes, LNK_FMTID_AppUserModel.bytes + 16);
+    f.insert(f.end(), values.begin(), values.end());
+    Put32(f, 0); // end of values
+    Put32(f, 0); // end of storages
+    Set32(f, start, (DWORD)(f.size() - start));
+}
+
+std::vector<BYTE> Gen_Lnk(const GEN_LNK* spec)
+{
+    static const BYTE kShellLinkClsid[16] = {
+        0x01, 0x14, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46
+    };
+    const WCHAR* strings[LNK_STRING_COUNT] = {
+        spec->description, spec->relativePath, spec->workingDir, spec->arguments, spec->icon
+    };
+    DWORD flags = spec->extraFlags;
+    std::vector<BYTE> f;
+
+    if (spec->idList)
+        flags |= LNK_HAS_LINK_TARGET_ID_LIST;
+    if (spec->target)
+        flags |= LNK_HAS_LINK_INFO;
+    if (!spec->ansiStrings)
+        flags |= LNK_IS_UNICODE;
+    for (DWORD i = 0; i < LNK_STRING_COUNT; ++i)
+    {
+        if (strings[i])
+            flags |= LNK_HAS_NAME << i;
+    }
+
+    Put32(f, LNK_HEADER_SIZE);
+    f.insert(f.end(), kShellLinkClsid, kShellLinkClsid + 16);
+    Put32(f, flags);
+    Put32(f, 0x20);                   // FILE_ATTRIBUTE_ARCHIVE
+    f.insert(f.end(), 24, 0);         // creation, access, write times
+    Put32(f, 0x1000);                 // FileSize
+    Put32(f, (DWORD)spec->iconIndex);
+    Put32(f, 1);                      // SW_SHOWNORMAL
+    Put16(f, 0);                      // HotKey
+    f.insert(f.end(), 10, 0);         // reserved
+
+    if (spec->idList)
+    {
+        // One item of 6 bytes, then the terminating empty item.
+        Put16(f, 8);
+        Put16(f, 6);
+        Put32(f, 0x12345678);
+        Put16(f, 0);
+    }
+    if (spec->target)
+        Gen_PutLinkInfo(f, spec);
+    for (DWORD i = 0; i < LNK_STRING_COUNT; ++i)
+    {
+        if (!strings[i])
+            continue;
+        Put16(f, Str_Length(strings[i]));
+        PutChars(f, strings[i], !spec->ansiStrings);
+    }
+    if (spec->specialFolderBlock)
+    {
+        Put32(f, 0x10);
+        Put32(f, 0xA0000005); // SpecialFolderDataBlock
+        Put32(f, 0x26);       // CSIDL_PROGRAM_FILES
+        Put32(f, 0x14);
+    }
+    if (spec->appId || spec->dualMode >= 0 || spec->toastActivatorClsid)
+        Gen_PutPropertyStore(f, spec);
+    if (!spec->noTerminal)
+        Put32(f, 0);
+    return f;
+}
+
+std::vector<BYTE> Gen_RandomLnk(GEN_RNG* rng, DWORD app)
+{
+    char appId[96];
+    WSTR target = Gen_ExePath(app), dir = Gen_AppDir(app), arguments, description, id;
+    GEN_LNK spec;
+
+    GenLnk_Init(&spec);
+    spec.target = target.c_str();
+    spec.unicodeTarget = Gen_Below(rng, 2);
+    spec.idList = TRUE;
+    spec.workingDir = dir.c_str();
+    spec.relativePath = NULL;
+    if (Gen_Below(rng, 3) == 0)
+    {
+        arguments = W("--profile=") + Gen_ImageName(Gen_Below(rng, GEN_APP_COUNT));
+        spec.arguments = arguments.c_str();
+    }
+    if (Gen_Below(rng, 2))
+    {
+        description = W("Starts ") + Gen_ImageName(app);
+        spec.description = description.c_str();
+    }
+    if (Gen_Below(rng, 2))
+    {
+        spec.icon = target.c_str();
+        spec.iconIndex = (LONG)Gen_Below(rng, 4);
+    }
+    if (Gen_Below(rng, 2))
+    {
+        snprintf(appId, sizeof(appId), "%s.%s.%u", kVendors[(app / 3) % COUNT_OF(kVendors)],
+            kProducts[app % COUNT_OF(kProducts)], app);
+        for (char* p = appId; *p; ++p)
+        {
+            if (*p == ' ')
+                *p = '_';
+        }
+        id = W(appId);
+        spec.appId = id.c_str();
+    }
+    spec.specialFolderBlock = Gen_Below(rng, 4) == 0;
+    return Gen_Lnk(&spec);
+}
+
+#define GEN_HIVE_NIL         0xFFFFFFFF
+#define GEN_HIVE_SEGMENT     16344
+#define GEN_HIVE_WRITE_TIME  0x01D0000000000000ULL
+
+// Appends an allocated cell holding |payload| to the bins in |b| and
+// returns its offset, relative to the first bin as cell offsets are.
+static DWORD Gen_HiveCell(std::vector<BYTE>& b, const std::vector<BYTE>& payload)
+{
+    DWORD offset = (DWORD)b.size(), size = (DWORD)(payload.size() + 4 + 7) & ~7u;
+
+    Put32(b, (DWORD)-(LONG)size);
+    b.insert(b.end(), payload.begin(), payload.end());
+    b.insert(b.end(), size - 4 - payload.size(), 0);
+    return offset;
+}
+
+static BOOL Gen_IsLatin1(const WSTR& name)
+{
+    for (WCHAR ch : name)
+    {
+        if (ch > 0xFF)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void Gen_PutHiveName(std::vector<BYTE>& b, const WSTR& name)
+{
+    PutChars(b, name.c_str(), !Gen_IsLatin1(name));
+}
+
+static DWORD Gen_HiveNameSize(const WSTR& name)
+{
+    return (DWORD)name.size() * (Gen_IsLatin1(name) ? 1 : 2);
+}
+
+static DWORD Gen_HiveKey(std::vector<BYTE>& b, const char* name, const WSTR& wideName, DWORD flags, DWORD subkeys,
+    DWORD subkeyList, DWORD values, DWORD valueList)
+{
+    WSTR n = name ? W(name) : wideName;
+    std::vector<BYTE> nk;
+
+    Put16(nk, 0x6B6E); // "nk"
+    Put16(nk, flags | (Gen_IsLatin1(n) ? 0x20 : 0)); // KEY_COMP_NAME
+    Put32(nk, (DWORD)GEN_HIVE_WRITE_TIME);
+    Put32(nk, (DWORD)(GEN_HIVE_WRITE_TIME >> 32));
+    Put32(nk, 0);             // access bits
+    Put32(nk, 0);             // parent, unused by the reader
+    Put32(nk, subkeys);
+    Put32(nk, 0);             // volatile subkeys
+    Put32(nk, subkeyList);
+    Put32(nk, GEN_HIVE_NIL);  // volatile subkey list
+    Put32(nk, values);
+    Put32(nk, valueList);
+    Put32(nk, GEN_HIVE_NIL);  // security
+    Put32(nk, GEN_HIVE_NIL);  // class name
+    nk.insert(nk.end(), 20, 0); // largest name and data sizes, work var
+    Put16(nk, Gen_HiveNameSize(n));
+    Put16(nk, 0);             // class name length
+    Gen_PutHiveName(nk, n);
+    return Gen_HiveCell(b, nk);
+}
+
+static DWORD Gen_HiveValue(std::vector<BYTE>& b, const GEN_HIVE_VALUE& value)
+{
+    DWORD size = (DWORD)value.data.size(), raw = size, offset = GEN_HIVE_NIL;
+    std::vector<BYTE> vk;
+
+    if (size <= 4)
+    {
+        // Inline in the offset field; nothing at all for empty data.
+        if (size)
+        {
+            raw = size | 0x80000000;
+            offset = 0;
+            for (DWORD i = 0; i < size; ++i)
+                offset |= (DWORD)value.data[i] << (i * 8);
+        }
+    }
+    else if (size > GEN_HIVE_SEGMENT)
+    {
+        std::vector<BYTE> list, db;
+        DWORD count = 0;
+        for (DWORD at = 0; at < size; at += GEN_HIVE_SEGMENT, ++count)
+        {
+            DWORD cb = size - at < GEN_HIVE_SEGMENT ? size - at : GEN_HIVE_SEGMENT;
+            Put32(list, Gen_HiveCell(b, std::vector<BYTE>(value.data.begin() + at, value.data.begin() + at + cb)));
+        }
+        Put16(db, 0x6264); // "db"
+        Put16(db, count);
+        Put32(db, Gen_HiveCell(b, list));
+        offset = Gen_HiveCell(b, db);
+    }
+    else
+        offset = Gen_HiveCell(b, value.data);
+
+    Put16(vk, 0x6B76); // "vk"
+    Put16(vk, Gen_HiveNameSize(value.name));
+    Put32(vk, raw);
+    Put32(vk, offset);
+    Put32(vk, value.type);
+    Put16(vk, Gen_IsLatin1(value.name) ? 1 : 0); // VALUE_COMP_NAME
+    Put16(vk, 0);
+    Gen_PutHiveName(vk, value.name);
+    return Gen_HiveCell(b, vk);
+}
+
+// An lf (first four characters as hint) or lh (hash) list of |keys|.
+static DWORD Gen_HiveHashList(std::vector<BYTE>& b, BOOL lh, const std::vector<std::pair<DWORD, WSTR> >& keys)
+{
+    std::vector<BYTE> list;
+
+    Put16(list, lh ? 0x686C : 0x666C);
+    Put16(list, (DWORD)keys.size());
+    for (const std::pair<DWORD, WSTR>& key : keys)
+    {
+        DWORD hash = 0;
+        Put32(list, key.first);
+        for (size_t i = 0; i < key.second.size(); ++i)
+        {
+            WCHAR ch = key.second[i];
+            if (lh)
+                hash = hash * 37 + (ch >= 'a' && ch <= 'z' ? ch - 32 : ch);
+            else if (i < 4)
+                hash |= (DWORD)(BYTE)ch << (i * 8);
+        }
+        Put32(list, hash);
+    }
+    return Gen_HiveCell(b, list);
+}
+
+static DWORD Gen_HiveIndexList(std::vector<BYTE>& b, WORD signature, const std::vector<DWORD>& cells)
+{
+    std::vector<BYTE> list;
+
+    Put16(list, signature);
+    Put16(list, (DWORD)cells.size());
+    for (DWORD cell : cells)
+        Put32(list, cell);
+    return Gen_HiveCell(b, list);
+}
+
+std::vector<BYTE> Gen_Hive(const std::vector<GEN_HIVE_VALUE>& values)
+{
+    static const WCHAR kChinese[] = { 0x4E2D, 0x6587, 0 };
+    std::vector<BYTE> b(32, 0), base(HIVE_BASE_BLOCK_SIZE, 0);
+    std::vector<DWORD> cells;
+    DWORD valueList = GEN_HIVE_NIL;
+
+    // Bottom up, each key after its subkeys and values.
+    for (const GEN_HIVE_VALUE& value : values)
+        cells.push_back(Gen_HiveValue(b, value));
+    // A value list is a bare array of offsets, without a signature.
+    if (!cells.empty())
+    {
+        std::vector<BYTE> list;
+        for (DWORD cell : cells)
+            Put32(list, cell);
+        valueList = Gen_HiveCell(b, list);
+    }
+
+    DWORD muiCache = Gen_HiveKey(b, "MuiCache", WSTR(), 0, 0, GEN_HIVE_NIL, (DWORD)values.size(), valueList);
+    DWORD bags = Gen_HiveKey(b, "Bags", WSTR(), 0, 0, GEN_HIVE_NIL, 0, GEN_HIVE_NIL);
+    DWORD shell = Gen_HiveKey(b, "Shell", WSTR(), 0, 2,
+        Gen_HiveHashList(b, TRUE, { { bags, W("Bags") }, { muiCache, W("MuiCache") } }), 0, GEN_HIVE_NIL);
+    DWORD windows = Gen_HiveKey(b, "Windows", WSTR(), 0, 1,
+        Gen_HiveHashList(b, FALSE, { { shell, W("Shell") } }), 0, GEN_HIVE_NIL);
+    DWORD microsoft = Gen_HiveKey(b, "Microsoft", WSTR(), 0, 1, Gen_HiveIndexList(b, 0x696C, { windows }), 0,
+        GEN_HIVE_NIL);
+    DWORD aaa = Gen_HiveKey(b, "AAA", WSTR(), 0, 0, GEN_HIVE_NIL, 0, GEN_HIVE_NIL);
+    // ri over two li lists, the way large subkey lists are split.
+    DWORD ri = Gen_HiveIndexList(b, 0x6972, { Gen_HiveIndexList(b, 0x696C, { aaa }),
+        Gen_HiveIndexList(b, 0x696C, { microsoft }) });
+    DWORD software = Gen_HiveKey(b, "Software", WSTR(), 0, 2, ri, 0, GEN_HIVE_NIL);
+    DWORD localSettings = Gen_HiveKey(b, "Local Settings", WSTR(), 0, 1,
+        Gen_HiveHashList(b, TRUE, { { software, W("Software") } }), 0, GEN_HIVE_NIL);
+    DWORD apps = Gen_HiveKey(b, "\xC4pps", WSTR(), 0, 0, GEN_HIVE_NIL, 0, GEN_HIVE_NIL);
+    DWORD chinese = Gen_HiveKey(b, NULL, kChinese, 0, 0, GEN_HIVE_NIL, 0, GEN_HIVE_NIL);
+    DWORD root = Gen_HiveKey(b, "S-1-5-21-1-2-3-1001_Classes", WSTR(), 0x0C, 3,
+        Gen_HiveHashList(b, FALSE, { { localSettings, W("Local Settings") }, { apps, W("\xC4pps") },
+            { chinese, kChinese } }), 0, GEN_HIVE_NIL);
+
+    // One bin, padded to a 4 KB multiple with a free cell.
+    DWORD pad = (DWORD)(-(LONG)b.size()) & (HIVE_BASE_BLOCK_SIZE - 1);
+    if (pad < 8)
+        pad += HIVE_BASE_BLOCK_SIZE;
+    Put32(b, pad);
+    b.insert(b.end(), pad - 4, 0);
+    Set32(b, 0, 0x6E696268); // "hbin"
+    Set32(b, 4, 0);
+    Set32(b, 8, (DWORD)b.size());
+
+    Set32(base, 0x00, 0x66676572); // "regf"
+    Set32(base, 0x04, 7);
+    Set32(base, 0x08, 7);
+    Set32(base, 0x14, 1);
+    Set32(base, 0x18, 5);
+    Set32(base, 0x20, 1);
+    Set32(base, 0x24, root);
+    Set32(base, 0x28, (DWORD)b.size());
+    Set32(base, 0x2C, 1);
+    Set32(base, 0x1FC, Hive_Checksum(base.data()));
+    base.insert(base.end(), b.begin(), b.end());
+    return base;
+}
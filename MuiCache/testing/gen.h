@@ -0,0 +1,101 @@
+// gen.h: seeded generators of data shaped like what the plugin meets on a
+// real machine (MuiCache value names, firewall rule strings, .lnk files),
+// for the Linux benchmarks and tests. A seed gives the same data on every
+// run and every platform.
+#ifndef MUICACHE_TESTING_GEN_H_
+#define MUICACHE_TESTING_GEN_H_
+
+#include "platform.h"
+
+#include <string>
+#include <vector>
+
+typedef std::basic_string<WCHAR> WSTR;
+
+// UTF-16 copy of an ASCII/Latin-1 string, and back (chars above 0xFF as '?').
+WSTR W(const char* s);
+std::string N(const WCHAR* s, DWORD cch);
+std::string N(const WSTR& s);
+
+// splitmix64; plenty for test data and identical everywhere.
+typedef struct _GEN_RNG {
+    ULONGLONG state;
+} GEN_RNG;
+
+void Gen_Seed(GEN_RNG* rng, ULONGLONG seed);
+DWORD Gen_Next(GEN_RNG* rng);
+// Uniform in [0, n), n > 0.
+DWORD Gen_Below(GEN_RNG* rng, DWORD n);
+
+// Distinct applications the name generators draw from. App |i| lives in
+// "C:\Program Files\<vendor>\<product>\" as Gen_ImageName(i).
+#define GEN_APP_COUNT 4096
+
+// "app<i>.exe" style image name of app |i|, what an installer passes to Clear.
+WSTR Gen_ImageName(DWORD app);
+// Install folder of app |i|, without the trailing '\'.
+WSTR Gen_AppDir(DWORD app);
+
+// A MuiCache value name: mostly "<dir>\app-<version>\<image>.FriendlyAppName"
+// and ".ApplicationCompany", some pre-Windows 8 "<dir>\app-<version>\<image>", some
+// "@%SystemRoot%\system32\shell32.dll,-<id>" resource names. |app| receives
+// the app it belongs to, or GEN_APP_COUNT for resource names.
+WSTR Gen_MuiCacheName(GEN_RNG* rng, DWORD* app);
+
+// A FirewallRules value: "v2.30|Action=..|Active=..|Dir=..|Protocol=..|
+// App=<dir>\<image>|Name=..|Desc=..|" with fields in the usual order, some
+// rules without App= (service or port rules) and some whose Name/Desc
+// mention another app's image name. |app| as for Gen_MuiCacheName.
+WSTR Gen_FirewallRule(GEN_RNG* rng, DWORD* app);
+
+// UFH\SHC record: REG_MULTI_SZ of the shortcut path, the exe path, and a
+// few empty and numeric fields, as Windows 10 writes them.
+std::vector<BYTE> Gen_ShcRecord(GEN_RNG* rng, DWORD* app);
+
+// What Gen_Lnk writes. NULL strings are left out of the file.
+typedef struct _GEN_LNK {
+    const WCHAR* target;      // LinkInfo local base path; NULL: no LinkInfo
+    BOOL unicodeTarget;       // also the Unicode variant (LinkInfo header 0x24)
+    BOOL idList;              // a small LinkTargetIDList before the LinkInfo
+    const WCHAR* description; // StringData, in file order
+    const WCHAR* relativePath;
+    const WCHAR* workingDir;
+    const WCHAR* arguments;
+    const WCHAR* icon;
+    LONG iconIndex;
+    BOOL ansiStrings;         // StringData in the code page (chars <= 0xFF)
+    DWORD extraFlags;         // OR'ed into LinkFlags, e.g. LNK_HAS_EXP_STRING
+    BOOL specialFolderBlock;  // an unrelated ExtraData block before the store
+    // System.AppUserModel properties; the store block is only written when
+    // one of them is set.
+    const WCHAR* appId;
+    int dualMode;             // -1: absent, else VT_BOOL
+    const BYTE* toastActivatorClsid; // 16 bytes, NULL: absent
+    BOOL noTerminal;          // end the file without a TerminalBlock
+} GEN_LNK;
+
+// Fills |spec| with defaults: nothing set, iconIndex 0, dualMode -1.
+void GenLnk_Init(GEN_LNK* spec);
+std::vector<BYTE> Gen_Lnk(const GEN_LNK* spec);
+// A Start menu style shortcut to app |app| with a random mix of arguments,
+// icon, description and AppUserModelID.
+std::vector<BYTE> Gen_RandomLnk(GEN_RNG* rng, DWORD app);
+
+// One value of the Gen_Hive MuiCache key.
+typedef struct _GEN_HIVE_VALUE {
+    WSTR name;
+    DWORD type;
+    std::vector<BYTE> data;
+} GEN_HIVE_VALUE;
+
+// Where Gen_Hive puts |values|, below its root key.
+#define GEN_HIVE_KEY_PATH "Local Settings\\Software\\Microsoft\\Windows\\Shell\\MuiCache"
+
+// A UsrClass.dat style regf file, both sequence numbers 7, its root
+// "S-1-5-21-1-2-3-1001_Classes" holding GEN_HIVE_KEY_PATH with |values|.
+// The path goes through each subkey list kind (lf, lh, li, ri) past
+// sibling keys, one with a UTF-16 name; values over 4 bytes get a data
+// cell, over 16344 a big data (db) one, and names Latin-1 where they can.
+std::vector<BYTE> Gen_Hive(const std::vector<GEN_HIVE_VALUE>& values);
+
+#endif // MUICACHE_TESTING_GEN_H_
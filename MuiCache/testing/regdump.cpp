@@ -0,0 +1,234 @@
+#include "regdump.h"
+
+#include <stdio.h>
+
+static BOOL RegDump_IsSpace(WCHAR ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+static int RegDump_HexDigit(WCHAR ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    return -1;
+}
+
+// Reads a "quoted" string with \\ and \" escapes starting at |pos| (on the
+// opening quote); leaves |pos| after the closing one.
+static BOOL RegDump_Quoted(const WSTR& line, size_t* pos, WSTR* out)
+{
+    size_t i = *pos + 1;
+    out->clear();
+    for (; i < line.size() && line[i] != '"'; ++i)
+    {
+        if (line[i] == '\\' && i + 1 < line.size())
+            ++i;
+        out->push_back(line[i]);
+    }
+    if (i == line.size())
+        return FALSE;
+    *pos = i + 1;
+    return TRUE;
+}
+
+static BOOL RegDump_Hex(const WSTR& text, std::vector<BYTE>* data)
+{
+    int high = -1;
+    for (WCHAR ch : text)
+    {
+        int digit = RegDump_HexDigit(ch);
+        if (digit >= 0)
+        {
+            if (high < 0)
+            {
+                high = digit;
+                continue;
+            }
+            data->push_back((BYTE)(high << 4 | digit));
+            high = -1;
+        }
+        else if (ch != ',' && !RegDump_IsSpace(ch))
+            return FALSE;
+        else if (high >= 0)
+            return FALSE; // a lone digit
+    }
+    return high < 0;
+}
+
+static BOOL RegDump_Value(const WSTR& line, const WSTR& key, std::vector<REG_DUMP_VALUE>* values)
+{
+    REG_DUMP_VALUE value;
+    size_t pos = 0;
+    WSTR text;
+
+    value.key = key;
+    if (line[0] == '@')
+        pos = 1;
+    else if (!RegDump_Quoted(line, &pos, &value.name))
+        return FALSE;
+    if (pos >= line.size() || line[pos] != '=')
+        return FALSE;
+    text = line.substr(pos + 1);
+
+    if (text == W("-"))
+        return TRUE;
+    if (!text.empty() && text[0] == '"')
+    {
+        WSTR s;
+        pos = 0;
+        if (!RegDump_Quoted(text, &pos, &s))
+            return FALSE;
+        value.type = REG_SZ;
+        for (WCHAR ch : s)
+        {
+            value.data.push_back((BYTE)ch);
+            value.data.push_back((BYTE)(ch >> 8));
+        }
+        value.data.push_back(0);
+        value.data.push_back(0);
+    }
+    else if (text.compare(0, 6, W("dword:")) == 0)
+    {
+        DWORD v = 0;
+        if (text.size() != 14)
+            return FALSE;
+        for (size_t i = 6; i < 14; ++i)
+        {
+            int digit = RegDump_HexDigit(text[i]);
+            if (digit < 0)
+                return FALSE;
+            v = v << 4 | (DWORD)digit;
+        }
+        value.type = REG_DWORD;
+        for (int i = 0; i < 4; ++i)
+            value.data.push_back((BYTE)(v >> (8 * i)));
+    }
+    else if (text.compare(0, 4, W("hex:")) == 0)
+    {
+        value.type = REG_BINARY;
+        if (!RegDump_Hex(text.substr(4), &value.data))
+            return FALSE;
+    }
+    else if (text.compare(0, 4, W("hex(")) == 0)
+    {
+        size_t close = text.find(W("):"));
+        value.type = 0;
+        if (close == WSTR::npos || close == 4)
+            return FALSE;
+        for (size_t i = 4; i < close; ++i)
+        {
+            int digit = RegDump_HexDigit(text[i]);
+            if (digit < 0)
+                return FALSE;
+            value.type = value.type << 4 | (DWORD)digit;
+        }
+        if (!RegDump_Hex(text.substr(close + 2), &value.data))
+            return FALSE;
+    }
+    else
+        return FALSE;
+    values->push_back(value);
+    return TRUE;
+}
+
+BOOL RegDump_Parse(const WSTR& text, std::vector<REG_DUMP_VALUE>* values, DWORD* error)
+{
+    WSTR key, line;
+    BOOL skipKey = FALSE;
+    DWORD number = 0, first = 0;
+    size_t pos = 0;
+
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == WSTR::npos)
+            end = text.size();
+        WSTR part = text.substr(pos, end - pos);
+        pos = end + 1;
+        ++number;
+
+        while (!part.empty() && RegDump_IsSpace(part.back()))
+            part.pop_back();
+        size_t start = 0;
+        while (start < part.size() && RegDump_IsSpace(part[start]))
+            ++start;
+        if (line.empty())
+            first = number;
+        line += part.substr(start);
+        // hex data wraps with a trailing '\'.
+        if (!line.empty() && line.back() == '\\' && line.find(W("=hex")) != WSTR::npos)
+        {
+            line.pop_back();
+            continue;
+        }
+
+        if (line.empty() || line[0] == ';')
+        {
+        }
+        else if (line[0] == '[')
+        {
+            if (line.back() != ']')
+            {
+                *error = first;
+                return FALSE;
+            }
+            skipKey = line.size() > 1 && line[1] == '-';
+            key = line.substr(1, line.size() - 2);
+        }
+        else if (first == 1 || line.compare(0, 8, W("REGEDIT4")) == 0 ||
+            line.compare(0, 16, W("Windows Registry")) == 0)
+        {
+            // The header.
+        }
+        else if (!skipKey && !RegDump_Value(line, key, values))
+        {
+            *error = first;
+            return FALSE;
+        }
+        line.clear();
+    }
+    return TRUE;
+}
+
+BOOL RegDump_Load(const char* path, std::vector<REG_DUMP_VALUE>* values, DWORD* error)
+{
+    std::vector<BYTE> bytes;
+    BYTE buffer[65536];
+    size_t got;
+    FILE* f = fopen(path, "rb");
+    WSTR text;
+
+    *error = 0;
+    if (!f)
+        return FALSE;
+    while ((got = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + got);
+    fclose(f);
+
+    if (bytes.size() >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE)
+    {
+        for (size_t i = 2; i + 1 < bytes.size(); i += 2)
+            text.push_back((WCHAR)(bytes[i] | bytes[i + 1] << 8));
+    }
+    else
+    {
+        size_t i = bytes.size() >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF ? 3 : 0;
+        for (; i < bytes.size(); ++i)
+            text.push_back(bytes[i]);
+    }
+    return RegDump_Parse(text, values, error);
+}
+
+void RegDump_Fill(REGKEY* key, const std::vector<REG_DUMP_VALUE>& values, const WCHAR* keyPath)
+{
+    for (const REG_DUMP_VALUE& value : values)
+    {
+        if (!keyPath || value.key == keyPath)
+            RegKey_MemorySetValue(key, value.name.c_str(), value.type, value.data.data(), (DWORD)value.data.size());
+    }
+}
@@ -0,0 +1,29 @@
+// regdump.h: reads regedit exports (.reg, "Windows Registry Editor Version
+// 5.00", UTF-16LE with BOM as regedit writes them, or plain ASCII), so
+// benchmarks and tests can replay values recorded on real machines.
+#ifndef MUICACHE_TESTING_REGDUMP_H_
+#define MUICACHE_TESTING_REGDUMP_H_
+
+#include "gen.h"
+#include "regkey.h"
+
+typedef struct _REG_DUMP_VALUE {
+    WSTR key;    // "HKEY_CURRENT_USER\Software\..."
+    WSTR name;   // empty for the default value "@"
+    DWORD type;
+    std::vector<BYTE> data; // as stored: hex(7) bytes are kept even if odd
+} REG_DUMP_VALUE;
+
+// Parses the export in |text|. Understands "str", dword:, hex: and hex(n):
+// values with '\' line continuations and ';' comments; a "-" value or a
+// [-key] deletion is skipped. Returns FALSE on a line it can't read and
+// sets |error| to its 1-based number.
+BOOL RegDump_Parse(const WSTR& text, std::vector<REG_DUMP_VALUE>* values, DWORD* error);
+// Same, from the file |path|.
+BOOL RegDump_Load(const char* path, std::vector<REG_DUMP_VALUE>* values, DWORD* error);
+
+// Adds the values of |values| under |keyPath| (all of them if NULL) to the
+// memory key |key|.
+void RegDump_Fill(REGKEY* key, const std::vector<REG_DUMP_VALUE>& values, const WCHAR* keyPath);
+
+#endif // MUICACHE_TESTING_REGDUMP_H_
@@ -0,0 +1,38 @@
+// check.h: assertions for the Linux tests. A failed CHECK reports where and
+// what, and the test carries on so one run shows every failure; main
+// returns Check_Result().
+#ifndef MUICACHE_TESTS_CHECK_H_
+#define MUICACHE_TESTS_CHECK_H_
+
+#include <stdio.h>
+
+static int g_checkFailures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++g_checkFailures; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        unsigned long long checkA_ = (unsigned long long)(a), checkB_ = (unsigned long long)(b); \
+        if (checkA_ != checkB_) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %llu != %llu\n", __FILE__, __LINE__, #a, #b, \
+                checkA_, checkB_); \
+            ++g_checkFailures; \
+        } \
+    } while (0)
+
+static inline int Check_Result(void)
+{
+    if (g_checkFailures)
+        fprintf(stderr, "%d check(s) failed\n", g_checkFailures);
+    return g_checkFailures ? 1 : 0;
+}
+
+#endif // MUICACHE_TESTS_CHECK_H_
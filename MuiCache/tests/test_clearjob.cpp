@@ -0,0 +1,326 @@
+// ClearJob over memory keys, held in RUNNING by its delay hook: the state
+// moves PENDING -> RUNNING -> DONE, Wait times out while the purge is held
+// and returns once it's done, the result is the purge's, and an owner that
+// releases a job early, running or not, leaves the worker to finish the
+// purge and drop the last reference itself.
+#include "check.h"
+#include "fakes.h"
+#include "clearjob.h"
+#include "thread.h"
+
+#include <string.h>
+
+typedef struct _JOB_FIXTURE {
+    MEMORY_KEY_OPENER opener;
+    REGKEY* mui;
+    REGKEY* shc;
+} JOB_FIXTURE;
+
+// |count| MuiCache names, every other one for "app.exe"; SHC empty.
+static void Fixture_Init(JOB_FIXTURE* f, DWORD count)
+{
+    const PURGE_TARGET* targets = Targets_Builtin();
+    std::vector<WSTR> names;
+    char name[64];
+
+    MemoryKeyOpener_Init(&f->opener);
+    for (DWORD i = 0; i < PURGE_ROOT_COUNT; ++i)
+        RegKey_CreateMemory(&f->opener.roots[i]);
+    RegKey_MemoryCreateSubKey(f->opener.roots[targets[TARGET_MUICACHE].root], targets[TARGET_MUICACHE].path,
+        &f->mui);
+    RegKey_MemoryCreateSubKey(f->opener.roots[targets[TARGET_SHC].root], targets[TARGET_SHC].path, &f->shc);
+    for (DWORD i = 0; i < count; ++i)
+    {
+        snprintf(name, sizeof(name), i % 2 ? "C:\\Keep\\other%u.exe" : "C:\\P\\app.exe.%u", i);
+        names.push_back(W(name));
+    }
+    Key_Fill(f->mui, names);
+}
+
+static void Fixture_Close(JOB_FIXTURE* f)
+{
+    f->mui->vtbl->Close(f->mui);
+    f->shc->vtbl->Close(f->shc);
+    for (DWORD i = 0; i < PURGE_ROOT_COUNT; ++i)
+        f->opener.roots[i]->vtbl->Close(f->opener.roots[i]);
+}
+
+// Holds the worker in RUNNING until |go| is set.
+typedef struct _JOB_GATE {
+    EVENT entered;
+    EVENT go;
+} JOB_GATE;
+
+static void Gate_Hold(void* context)
+{
+    JOB_GATE* gate = (JOB_GATE*)context;
+    Event_Set(gate->entered);
+    Event_Wait(gate->go, INFINITE);
+}
+
+static void Params_Init(CLEAR_JOB_PARAMS* params, JOB_FIXTURE* f, DWORD flags, DWORD workers, JOB_GATE* gate)
+{
+    WSTR pattern = W("app.exe");
+    const WCHAR* patterns = pattern.c_str();
+
+    memset(params, 0, sizeof(CLEAR_JOB_PARAMS));
+    params->opener = &f->opener.base;
+    params->targets = Targets_Builtin();
+    params->count = 2;
+    params->matcher = Matcher_Create(&patterns, 1);
+    params->flags = flags;
+    params->workers = workers;
+    if (gate)
+    {
+        params->delay = Gate_Hold;
+        params->delayContext = gate;
+    }
+}
+
+// A KEY_OPENER over |inner| that sets |closed| once |expected| keys it
+// handed out are closed again: the worker is past its purge, and the keys
+// can be read without racing it.
+typedef struct _WATCHED_OPENER {
+    KEY_OPENER base;
+    KEY_OPENER* inner;
+    volatile LONG closes;
+    LONG expected;
+    EVENT closed;
+} WATCHED_OPENER;
+
+typedef struct _WATCHED_KEY {
+    REGKEY base;
+    REGKEY* inner;
+    WATCHED_OPENER* opener;
+} WATCHED_KEY;
+
+static LSTATUS Watched_QueryInfo(REGKEY* key, DWORD* cValues, DWORD* cchMaxValue, DWORD* cbMaxValueData,
+    FILETIME* ftLastWriteTime)
+{
+    REGKEY* inner = ((WATCHED_KEY*)key)->inner;
+    return inner->vtbl->QueryInfo(inner, cValues, cchMaxValue, cbMaxValueData, ftLastWriteTime);
+}
+
+static LSTATUS Watched_EnumValue(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName, DWORD* type, BYTE* data,
+    DWORD* cbData)
+{
+    REGKEY* inner = ((WATCHED_KEY*)key)->inner;
+    return inner->vtbl->EnumValue(inner, index, name, cchName, type, data, cbData);
+}
+
+static LSTATUS Watched_DeleteValue(REGKEY* key, const WCHAR* name)
+{
+    REGKEY* inner = ((WATCHED_KEY*)key)->inner;
+    return inner->vtbl->DeleteValue(inner, name);
+}
+
+static void Watched_Close(REGKEY* key)
+{
+    WATCHED_KEY* watched = (WATCHED_KEY*)key;
+    WATCHED_OPENER* opener = watched->opener;
+
+    watched->inner->vtbl->Close(watched->inner);
+    delete watched;
+    if (Atomic_Increment(&opener->closes) == opener->expected)
+        Event_Set(opener->closed);
+}
+
+static LSTATUS Watched_EnumKey(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName)
+{
+    REGKEY* inner = ((WATCHED_KEY*)key)->inner;
+    return inner->vtbl->EnumKey(inner, index, name, cchName);
+}
+
+static LSTATUS Watched_OpenSubKey(REGKEY* key, const WCHAR* name, REGKEY** subKey)
+{
+    REGKEY* inner = ((WATCHED_KEY*)key)->inner;
+    return inner->vtbl->OpenSubKey(inner, name, subKey);
+}
+
+static const REGKEY_VTBL kWatchedKeyVtbl = {
+    Watched_QueryInfo,
+    Watched_EnumValue,
+    Watched_DeleteValue,
+    Watched_Close,
+    Watched_EnumKey,
+    Watched_OpenSubKey,
+};
+
+static LSTATUS WatchedOpener_Open(KEY_OPENER* base, PURGE_ROOT root, const WCHAR* path, REGKEY** key)
+{
+    WATCHED_OPENER* opener = (WATCHED_OPENER*)base;
+    WATCHED_KEY* watched;
+    REGKEY* inner;
+    LSTATUS status = opener->inner->vtbl->Open(opener->inner, root, path, &inner);
+
+    *key = NULL;
+    if (status != ERROR_SUCCESS)
+        return status;
+    watched = new WATCHED_KEY;
+    watched->base.vtbl = &kWatchedKeyVtbl;
+    watched->inner = inner;
+    watched->opener = opener;
+    *key = &watched->base;
+    return ERROR_SUCCESS;
+}
+
+static const KEY_OPENER_VTBL kWatchedOpenerVtbl = {
+    WatchedOpener_Open,
+};
+
+static WATCHED_OPENER* WatchedOpener_Create(KEY_OPENER* inner, LONG expected)
+{
+    WATCHED_OPENER* opener = new WATCHED_OPENER;
+    opener->base.vtbl = &kWatchedOpenerVtbl;
+    opener->inner = inner;
+    opener->closes = 0;
+    opener->expected = expected;
+    opener->closed = Event_Create();
+    return opener;
+}
+
+// Once |closed| is set the worker has closed its last key, and with it
+// dropped its last use of |opener|.
+static void WatchedOpener_Destroy(WATCHED_OPENER* opener)
+{
+    Event_Destroy(opener->closed);
+    delete opener;
+}
+
+static void TestWaitAndResult(DWORD flags, DWORD workers)
+{
+    JOB_FIXTURE f;
+    JOB_GATE gate = { Event_Create(), Event_Create() };
+    CLEAR_JOB_PARAMS params;
+    CLEAR_JOB* job;
+    const TARGETS_PURGE* purge;
+    DWORD state;
+
+    Fixture_Init(&f, 400);
+    Params_Init(&params, &f, flags, workers, &gate);
+    CHECK_EQ(ClearJob_Start(&params, &job), ERROR_SUCCESS);
+    state = ClearJob_State(job);
+    CHECK(state == CLEAR_JOB_PENDING || state == CLEAR_JOB_RUNNING);
+
+    // Held: RUNNING, and no wait gets past it.
+    Event_Wait(gate.entered, INFINITE);
+    CHECK_EQ(ClearJob_State(job), CLEAR_JOB_RUNNING);
+    CHECK_EQ(ClearJob_Wait(job, 0), WAIT_TIMEOUT);
+    CHECK_EQ(ClearJob_Wait(job, 30), WAIT_TIMEOUT);
+    CHECK_EQ(Key_ValueNames(f.mui).size(), 400);
+
+    Event_Set(gate.go);
+    CHECK_EQ(ClearJob_Wait(job, INFINITE), ERROR_SUCCESS);
+    CHECK_EQ(ClearJob_State(job), CLEAR_JOB_DONE);
+    // Done stays done; a zero timeout is enough now.
+    CHECK_EQ(ClearJob_Wait(job, 0), ERROR_SUCCESS);
+    CHECK_EQ(ClearJob_Result(job, &purge), ERROR_SUCCESS);
+    CHECK_EQ(purge->totals.matched, 200);
+    CHECK_EQ(purge->totals.deleted, flags & PURGE_DRY_RUN ? 0 : 200);
+    CHECK_EQ(purge->purged, 2);
+    CHECK_EQ(Key_ValueNames(f.mui).size(), flags & PURGE_DRY_RUN ? 400 : 200);
+    ClearJob_Release(job);
+
+    Event_Destroy(gate.entered);
+    Event_Destroy(gate.go);
+    Fixture_Close(&f);
+}
+
+static LSTATUS Denied_Open(KEY_OPENER* opener, PURGE_ROOT root, const WCHAR* path, REGKEY** key)
+{
+    (void)opener, (void)root, (void)path;
+    *key = NULL;
+    return ERROR_ACCESS_DENIED;
+}
+
+static const KEY_OPENER_VTBL kDeniedVtbl = {
+    Denied_Open,
+};
+
+static void TestFailedTarget(void)
+{
+    KEY_OPENER denied = { &kDeniedVtbl };
+    JOB_FIXTURE f;
+    CLEAR_JOB_PARAMS params;
+    CLEAR_JOB* job;
+    const TARGETS_PURGE* purge;
+
+    Fixture_Init(&f, 10);
+    Params_Init(&params, &f, 0, 1, NULL);
+    params.opener = &denied;
+    CHECK_EQ(ClearJob_Start(&params, &job), ERROR_SUCCESS);
+    CHECK_EQ(ClearJob_Wait(job, INFINITE), ERROR_SUCCESS);
+    CHECK_EQ(ClearJob_Result(job, &purge), ERROR_ACCESS_DENIED);
+    CHECK_EQ(purge->failed, 2);
+    CHECK_EQ(purge->totals.deleted, 0);
+    ClearJob_Release(job);
+    Fixture_Close(&f);
+}
+
+// The owner lets go while the worker is held: the purge still happens,
+// and the worker frees the job with nobody waiting on it.
+static void TestReleaseRunning(void)
+{
+    for (DWORD round = 0; round < 20; ++round)
+    {
+        JOB_FIXTURE f;
+        JOB_GATE gate = { Event_Create(), Event_Create() };
+        WATCHED_OPENER* opener;
+        CLEAR_JOB_PARAMS params;
+        CLEAR_JOB* job;
+
+        Fixture_Init(&f, 300);
+        opener = WatchedOpener_Create(&f.opener.base, 2);
+        Params_Init(&params, &f, 0, round % 2, &gate);
+        params.opener = &opener->base;
+        CHECK_EQ(ClearJob_Start(&params, &job), ERROR_SUCCESS);
+        Event_Wait(gate.entered, INFINITE);
+        ClearJob_Release(job);
+        Event_Set(gate.go);
+        Event_Wait(opener->closed, INFINITE);
+        CHECK_EQ(Key_ValueNames(f.mui).size(), 150);
+
+        WatchedOpener_Destroy(opener);
+        Event_Destroy(gate.entered);
+        Event_Destroy(gate.go);
+        Fixture_Close(&f);
+    }
+}
+
+// Released straight away, most likely before the worker even starts.
+static void TestReleasePending(void)
+{
+    for (DWORD round = 0; round < 20; ++round)
+    {
+        JOB_FIXTURE f;
+        WATCHED_OPENER* opener;
+        CLEAR_JOB_PARAMS params;
+        CLEAR_JOB* job;
+
+        Fixture_Init(&f, 100);
+        opener = WatchedOpener_Create(&f.opener.base, 2);
+        Params_Init(&params, &f, 0, 1, NULL);
+        params.opener = &opener->base;
+        CHECK_EQ(ClearJob_Start(&params, &job), ERROR_SUCCESS);
+        ClearJob_Release(job);
+        Event_Wait(opener->closed, INFINITE);
+        CHECK_EQ(Key_ValueNames(f.mui).size(), 50);
+
+        WatchedOpener_Destroy(opener);
+        Fixture_Close(&f);
+    }
+
+    // Releasing no job is allowed, as after a failed start.
+    ClearJob_Release(NULL);
+}
+
+int main()
+{
+    TestWaitAndResult(0, 1);
+    TestWaitAndResult(0, 0);
+    TestWaitAndResult(PURGE_DRY_RUN, 2);
+    TestFailedTarget();
+    TestReleaseRunning();
+    TestReleasePending();
+    return Check_Result();
+}
@@ -0,0 +1,271 @@
+// Targets_Purge with a FINGERPRINT_STORE: a key whose last-write time and
+// value count are as the previous purge left them is skipped without being
+// enumerated; any change to it, another pattern set or TARGETS_FORCE brings
+// the scan back. The store itself round-trips through its file, refuses a
+// damaged one and keeps only the newest FINGERPRINT_MAX_ENTRIES entries.
+#include "check.h"
+#include "fakes.h"
+#include "fileio.h"
+#include "targets.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct _FP_FIXTURE {
+    MEMORY_KEY_OPENER opener;
+    REGKEY* mui;
+    REGKEY* shc;
+} FP_FIXTURE;
+
+// MuiCache holds |count| "app.exe" names and as many others; SHC is empty.
+static void Fixture_Init(FP_FIXTURE* f, DWORD count)
+{
+    const PURGE_TARGET* targets = Targets_Builtin();
+    std::vector<WSTR> names;
+    char name[64];
+
+    MemoryKeyOpener_Init(&f->opener);
+    for (DWORD i = 0; i < PURGE_ROOT_COUNT; ++i)
+        RegKey_CreateMemory(&f->opener.roots[i]);
+    RegKey_MemoryCreateSubKey(f->opener.roots[targets[TARGET_MUICACHE].root], targets[TARGET_MUICACHE].path,
+        &f->mui);
+    RegKey_MemoryCreateSubKey(f->opener.roots[targets[TARGET_SHC].root], targets[TARGET_SHC].path, &f->shc);
+    for (DWORD i = 0; i < count; ++i)
+    {
+        snprintf(name, sizeof(name), "C:\\P\\app.exe.FriendlyAppName%u", i);
+        names.push_back(W(name));
+        snprintf(name, sizeof(name), "C:\\Keep\\other%u.exe", i);
+        names.push_back(W(name));
+    }
+    Key_Fill(f->mui, names);
+}
+
+static void Fixture_Close(FP_FIXTURE* f)
+{
+    f->mui->vtbl->Close(f->mui);
+    f->shc->vtbl->Close(f->shc);
+    for (DWORD i = 0; i < PURGE_ROOT_COUNT; ++i)
+        f->opener.roots[i]->vtbl->Close(f->opener.roots[i]);
+}
+
+static MATCHER* CreateMatcher(const char* pattern, DWORD flags)
+{
+    WSTR p = W(pattern);
+    const WCHAR* pointer = p.c_str();
+    return Matcher_CreateEx(&pointer, 1, flags);
+}
+
+// Purges MuiCache and SHC, checks |skipped| and returns the totals.
+static PURGE_STATS PurgeBoth(FP_FIXTURE* f, const MATCHER* matcher, DWORD flags, FINGERPRINT_STORE* store,
+    DWORD skipped)
+{
+    TARGETS_PURGE purge;
+
+    CHECK_EQ(Targets_Purge(&f->opener.base, Targets_Builtin(), 2, matcher, flags, 0, store, &purge), ERROR_SUCCESS);
+    CHECK_EQ(purge.skipped, skipped);
+    CHECK_EQ(purge.purged, 2);
+    CHECK_EQ(purge.failed, 0);
+    PURGE_STATS totals = purge.totals;
+    Targets_Free(&purge);
+    return totals;
+}
+
+static void TestSkipAndRescan(const WSTR& dir)
+{
+    WSTR path = FakeDir_Join(dir, W("fingerprints.bin"));
+    MATCHER* matcher = CreateMatcher("app.exe", 0);
+    MATCHER* other = CreateMatcher("APP.exe", MATCHER_IGNORE_CASE);
+    FINGERPRINT_STORE store, loaded;
+    FP_FIXTURE f;
+    PURGE_STATS totals;
+
+    Fixture_Init(&f, 500);
+    FingerprintStore_Init(&store);
+    FingerprintStore_Init(&loaded);
+    CHECK_EQ(FingerprintStore_Load(&store, path.c_str()), ERROR_SUCCESS);
+    CHECK_EQ(store.count, 0);
+
+    // A dry run reads fingerprints but records none.
+    totals = PurgeBoth(&f, matcher, PURGE_DRY_RUN, &store, 0);
+    CHECK_EQ(totals.matched, 500);
+    CHECK_EQ(store.count, 0);
+    CHECK(!store.dirty);
+
+    totals = PurgeBoth(&f, matcher, 0, &store, 0);
+    CHECK_EQ(totals.deleted, 500);
+    CHECK_EQ(store.count, 2);
+    CHECK(store.dirty);
+    CHECK_EQ(FingerprintStore_Save(&store, path.c_str()), ERROR_SUCCESS);
+
+    // Next run, from the file: both keys are as left, so neither is read.
+    CHECK_EQ(FingerprintStore_Load(&loaded, path.c_str()), ERROR_SUCCESS);
+    CHECK_EQ(loaded.count, 2);
+    CHECK(!loaded.dirty);
+    totals = PurgeBoth(&f, matcher, 0, &loaded, 2);
+    CHECK_EQ(totals.enumerated, 0);
+    CHECK_EQ(totals.deleted, 0);
+    CHECK(!loaded.dirty);
+
+    // Another pattern set has no fingerprint yet.
+    totals = PurgeBoth(&f, other, 0, &loaded, 0);
+    CHECK_EQ(totals.enumerated, 500);
+    CHECK_EQ(loaded.count, 4);
+
+    // A new value changes both the last-write time and the count: MuiCache
+    // is scanned again and the new match deleted, SHC stays skipped.
+    Key_Fill(f.mui, std::vector<WSTR>(1, W("C:\\Z\\app.exe.FriendlyAppName")));
+    TARGETS_PURGE purge;
+    CHECK_EQ(Targets_Purge(&f.opener.base, Targets_Builtin(), 2, matcher, 0, 0, &loaded, &purge), ERROR_SUCCESS);
+    CHECK_EQ(purge.skipped, 1);
+    CHECK(!purge.results[TARGET_MUICACHE].skipped);
+    CHECK(purge.results[TARGET_SHC].skipped);
+    CHECK_EQ(purge.totals.enumerated, 501);
+    CHECK_EQ(purge.totals.deleted, 1);
+    Targets_Free(&purge);
+    PurgeBoth(&f, matcher, 0, &loaded, 2);
+
+    // Rewriting a kept value leaves the count alone; the last-write time
+    // alone is enough to rescan.
+    Key_Fill(f.mui, std::vector<WSTR>(1, W("C:\\Keep\\other0.exe")));
+    totals = PurgeBoth(&f, matcher, 0, &loaded, 1);
+    CHECK_EQ(totals.enumerated, 500);
+    CHECK_EQ(totals.deleted, 0);
+    PurgeBoth(&f, matcher, 0, &loaded, 2);
+
+    // TARGETS_FORCE scans whatever the fingerprints say.
+    totals = PurgeBoth(&f, matcher, TARGETS_FORCE, &loaded, 0);
+    CHECK_EQ(totals.enumerated, 500);
+
+    // Without a store nothing is skipped.
+    totals = PurgeBoth(&f, matcher, 0, NULL, 0);
+    CHECK_EQ(totals.enumerated, 500);
+
+    FingerprintStore_Free(&store);
+    FingerprintStore_Free(&loaded);
+    Matcher_Destroy(matcher);
+    Matcher_Destroy(other);
+    Fixture_Close(&f);
+}
+
+static void TestPatternHash(void)
+{
+    WSTR x = W("x.exe"), y = W("y.exe");
+    const WCHAR* forward[] = { x.c_str(), y.c_str() };
+    const WCHAR* backward[] = { y.c_str(), x.c_str() };
+    MATCHER* a = Matcher_Create(forward, 2);
+    MATCHER* b = Matcher_Create(backward, 2);
+    MATCHER* single = Matcher_Create(forward, 1);
+    MATCHER* ignoreCase = Matcher_CreateEx(forward, 2, MATCHER_IGNORE_CASE);
+
+    // The order of the patterns doesn't matter; the set and flags do.
+    CHECK_EQ(Matcher_Hash(a), Matcher_Hash(b));
+    CHECK(Matcher_Hash(a) != Matcher_Hash(single));
+    CHECK(Matcher_Hash(a) != Matcher_Hash(ignoreCase));
+    Matcher_Destroy(a);
+    Matcher_Destroy(b);
+    Matcher_Destroy(single);
+    Matcher_Destroy(ignoreCase);
+}
+
+static void TestDamagedFile(const WSTR& dir)
+{
+    WSTR path = FakeDir_Join(dir, W("damaged.bin"));
+    FINGERPRINT_STORE store;
+    FINGERPRINT fingerprint;
+    std::vector<BYTE> good, bad;
+
+    FingerprintStore_Init(&store);
+    memset(&fingerprint, 0, sizeof(fingerprint));
+    for (DWORD i = 0; i < 3; ++i)
+    {
+        fingerprint.target = i;
+        fingerprint.values = 10 * i;
+        FingerprintStore_Set(&store, &fingerprint);
+    }
+    CHECK_EQ(FingerprintStore_Save(&store, path.c_str()), ERROR_SUCCESS);
+    good = Scratch_Read(path);
+    CHECK_EQ(good.size(), FINGERPRINT_HEADER_SIZE + 3 * FINGERPRINT_ENTRY_SIZE);
+
+    // A flipped entry bit, another version and a cut file all load empty.
+    bad = good;
+    bad[FINGERPRINT_HEADER_SIZE + 4] ^= 1;
+    CHECK(Scratch_Write(path, bad));
+    CHECK_EQ(FingerprintStore_Load(&store, path.c_str()), ERROR_INVALID_DATA);
+    CHECK_EQ(store.count, 0);
+
+    bad = good;
+    bad[4] = FINGERPRINT_VERSION + 1;
+    CHECK(Scratch_Write(path, bad));
+    CHECK_EQ(FingerprintStore_Load(&store, path.c_str()), ERROR_INVALID_DATA);
+
+    for (size_t cut : { (size_t)5, (size_t)FINGERPRINT_HEADER_SIZE, good.size() - 1 })
+    {
+        CHECK(Scratch_Write(path, std::vector<BYTE>(good.begin(), good.begin() + cut)));
+        CHECK_EQ(FingerprintStore_Load(&store, path.c_str()), ERROR_INVALID_DATA);
+        CHECK_EQ(store.count, 0);
+    }
+
+    CHECK(Scratch_Write(path, good));
+    CHECK_EQ(FingerprintStore_Load(&store, path.c_str()), ERROR_SUCCESS);
+    CHECK_EQ(store.count, 3);
+    CHECK(FingerprintStore_Find(&store, 2, 0) && FingerprintStore_Find(&store, 2, 0)->values == 20);
+    FingerprintStore_Free(&store);
+}
+
+static void TestEviction(const WSTR& dir)
+{
+    WSTR path = FakeDir_Join(dir, W("evicted.bin"));
+    FINGERPRINT_STORE store, loaded;
+    FINGERPRINT fingerprint;
+
+    FingerprintStore_Init(&store);
+    FingerprintStore_Init(&loaded);
+    memset(&fingerprint, 0, sizeof(fingerprint));
+    for (DWORD i = 0; i < 100; ++i)
+    {
+        fingerprint.target = i;
+        fingerprint.values = i;
+        FingerprintStore_Set(&store, &fingerprint);
+    }
+    // The oldest are dropped.
+    CHECK_EQ(store.count, FINGERPRINT_MAX_ENTRIES);
+    CHECK_EQ(store.entries[0].target, 100 - FINGERPRINT_MAX_ENTRIES);
+    CHECK(!FingerprintStore_Find(&store, 0, 0));
+    CHECK(FingerprintStore_Find(&store, 99, 0));
+
+    // Replacing an entry keeps the count and makes it the newest.
+    fingerprint.target = 50;
+    fingerprint.values = 7;
+    FingerprintStore_Set(&store, &fingerprint);
+    CHECK_EQ(store.count, FINGERPRINT_MAX_ENTRIES);
+    CHECK_EQ(store.entries[store.count - 1].target, 50);
+    CHECK_EQ(store.entries[store.count - 1].values, 7);
+
+    FingerprintStore_Remove(&store, 50, 0);
+    CHECK_EQ(store.count, FINGERPRINT_MAX_ENTRIES - 1);
+    CHECK(!FingerprintStore_Find(&store, 50, 0));
+
+    CHECK_EQ(FingerprintStore_Save(&store, path.c_str()), ERROR_SUCCESS);
+    CHECK_EQ(FingerprintStore_Load(&loaded, path.c_str()), ERROR_SUCCESS);
+    CHECK_EQ(loaded.count, FINGERPRINT_MAX_ENTRIES - 1);
+    CHECK(!memcmp(loaded.entries, store.entries, store.count * sizeof(FINGERPRINT)));
+    FingerprintStore_Free(&store);
+    FingerprintStore_Free(&loaded);
+}
+
+int main()
+{
+    WSTR dir = Scratch_Dir("fingerprint");
+
+    if (dir.empty())
+    {
+        fprintf(stderr, "no scratch directory\n");
+        return 1;
+    }
+    TestSkipAndRescan(dir);
+    TestPatternHash();
+    TestDamagedFile(dir);
+    TestEviction(dir);
+    Scratch_Remove(dir);
+    return Check_Result();
+}
@@ -0,0 +1,217 @@
+// The firewall rule tokenizer against a plain split at every SIMD level,
+// App= lookup on awkward rules, and PURGE_MATCH_FIREWALL_APP on a key of
+// rules whose Name= and Desc= mention the app without being its rule.
+#include "check.h"
+#include "fakes.h"
+#include "fwrule.h"
+#include "purge.h"
+#include "simdscan.h"
+
+#include <string>
+#include <utility>
+
+typedef std::vector<std::pair<WSTR, WSTR> > FIELDS;
+
+static FIELDS Reference(const WSTR& rule)
+{
+    FIELDS fields;
+    size_t end = rule.find((WCHAR)0), pos = 0;
+    WSTR text = rule.substr(0, end);
+
+    while (pos <= text.size())
+    {
+        size_t bar = text.find('|', pos);
+        if (bar == WSTR::npos)
+            bar = text.size();
+        if (bar > pos)
+        {
+            WSTR field = text.substr(pos, bar - pos);
+            size_t eq = field.find('=');
+            fields.push_back(eq == WSTR::npos ? std::make_pair(field, WSTR())
+                : std::make_pair(field.substr(0, eq), field.substr(eq + 1)));
+        }
+        pos = bar + 1;
+    }
+    return fields;
+}
+
+static FIELDS Tokenize(const WSTR& rule)
+{
+    FW_RULE_TOKENIZER tok;
+    FW_RULE_FIELD field;
+    FIELDS fields;
+
+    FwRule_Init(&tok, rule.c_str(), (DWORD)rule.size());
+    while (FwRule_Next(&tok, &field))
+        fields.push_back(std::make_pair(WSTR(field.key, field.cchKey), WSTR(field.value, field.cchValue)));
+    return fields;
+}
+
+static void TestTokenizer(DWORD level)
+{
+    static const WCHAR kAlphabet[] = { '|', '=', 0x263A, 'a', 'b', 'A', '|', 0 };
+    DWORD bad = 0;
+    GEN_RNG rng;
+
+    Gen_Seed(&rng, 14);
+    for (DWORD iteration = 0; iteration < 50000; ++iteration)
+    {
+        WSTR rule;
+        DWORD cch = Gen_Below(&rng, 70);
+        for (DWORD i = 0; i < cch; ++i)
+            rule.push_back(kAlphabet[Gen_Below(&rng, iteration & 1 ? 8 : 7)]);
+        if (Tokenize(rule) != Reference(rule))
+            ++bad;
+    }
+    for (DWORD i = 0; i < 2000; ++i)
+    {
+        DWORD app;
+        WSTR rule = Gen_FirewallRule(&rng, &app);
+        if (Tokenize(rule) != Reference(rule))
+            ++bad;
+    }
+    if (bad)
+    {
+        fprintf(stderr, "level %u: %u tokenizer mismatches\n", level, bad);
+        ++g_checkFailures;
+    }
+}
+
+static void TestFindApp(void)
+{
+    static const struct {
+        const char* rule;
+        const char* app; // NULL when there is no App= field
+    } kCases[] = {
+        { "v2.30|Action=Allow|Dir=In|App=C:\\x\\app.exe|Name=App|", "C:\\x\\app.exe" },
+        { "v2.30|Action=Allow|app=C:\\x\\app.exe|", "C:\\x\\app.exe" },
+        { "v2.30|APP=C:\\x\\app.exe|", "C:\\x\\app.exe" },
+        { "v2.30|Name=x|App=C:\\x\\app.exe", "C:\\x\\app.exe" },
+        { "App=C:\\x\\app.exe", "C:\\x\\app.exe" },
+        { "v2.30|App=\"C:\\Program Files\\x\\app.exe\"|", "\"C:\\Program Files\\x\\app.exe\"" },
+        { "v2.30|App=a=b|", "a=b" },
+        { "v2.30|App=first|App=second|", "first" },
+        { "v2.30||||App=C:\\x\\app.exe||", "C:\\x\\app.exe" },
+        { "v2.30|App=|Name=x|", "" },
+        { "v2.30|App|Name=x|", "" },
+        { "v2.30|Apps=C:\\x\\app.exe|Application=x|XApp=y|", NULL },
+        { "v2.30|Name=App=C:\\x\\app.exe|", NULL },
+        { "v2.30|Desc=uses App=C:\\x\\app.exe|", NULL },
+        { "", NULL },
+        { "|||", NULL },
+        { "=|=|", NULL },
+    };
+    WSTR key = W("App");
+    const WCHAR* value;
+    DWORD cchValue;
+
+    for (const auto& c : kCases)
+    {
+        WSTR rule = W(c.rule);
+        BOOL found = FwRule_FindField(rule.c_str(), (DWORD)rule.size(), key.c_str(), &value, &cchValue);
+        if (found != (c.app != NULL) || (found && N(value, cchValue) != c.app))
+        {
+            fprintf(stderr, "App= of \"%s\": %s\n", c.rule, found ? N(value, cchValue).c_str() : "(none)");
+            ++g_checkFailures;
+        }
+    }
+
+    // A NUL ends the rule, as registry data carries its terminator.
+    WSTR rule = W("v2.30|Name=x|");
+    rule.push_back(0);
+    rule += W("App=C:\\x\\app.exe|");
+    CHECK(!FwRule_FindField(rule.c_str(), (DWORD)rule.size(), key.c_str(), &value, &cchValue));
+    // So does |cch|.
+    rule = W("v2.30|App=C:\\x\\app.exe|");
+    CHECK(!FwRule_FindField(rule.c_str(), 8, key.c_str(), &value, &cchValue));
+    CHECK(FwRule_FindField(rule.c_str(), 12, key.c_str(), &value, &cchValue) && N(value, cchValue) == "C:");
+
+    static const struct {
+        const char* value;
+        const char* unquoted;
+    } kQuotes[] = {
+        { "\"C:\\x\\app.exe\"", "C:\\x\\app.exe" },
+        { "C:\\x\\app.exe", "C:\\x\\app.exe" },
+        { "\"C:\\x\\app.exe", "\"C:\\x\\app.exe" },
+        { "\"\"", "" },
+        { "\"", "\"" },
+        { "", "" },
+    };
+    for (const auto& q : kQuotes)
+    {
+        WSTR text = W(q.value);
+        value = text.c_str();
+        cchValue = (DWORD)text.size();
+        FwRule_Unquote(&value, &cchValue);
+        if (N(value, cchValue) != q.unquoted)
+        {
+            fprintf(stderr, "unquoting %s\n", q.value);
+            ++g_checkFailures;
+        }
+    }
+}
+
+static void TestPurge(void)
+{
+    static const struct {
+        const char* name;
+        DWORD type;
+        const char* rule;
+        BOOL removed;
+    } kRules[] = {
+        { "{plain}", REG_SZ, "v2.30|Action=Allow|Active=TRUE|Dir=In|App=C:\\Program Files\\Vendor\\App.exe|Name=App|", TRUE },
+        { "{quoted}", REG_SZ, "v2.30|Action=Allow|App=\"C:\\Program Files\\Vendor\\app.exe\"|Name=App|", TRUE },
+        { "{lower key}", REG_SZ, "v2.30|Action=Block|app=C:\\Vendor\\APP.EXE|", TRUE },
+        { "{last field}", REG_SZ, "v2.30|Action=Allow|Name=App|App=C:\\Vendor\\app.exe", TRUE },
+        { "{other app}", REG_SZ, "v2.30|Action=Allow|App=C:\\x\\myapp.exe|Name=app.exe|Desc=Allows app.exe|", FALSE },
+        { "{service}", REG_SZ, "v2.30|Action=Allow|App=%SystemRoot%\\system32\\svchost.exe|Svc=app.exe|", FALSE },
+        { "{port rule}", REG_SZ, "v2.30|Action=Allow|LPort=80|Name=app.exe web|", FALSE },
+        { "{no app value}", REG_SZ, "v2.30|App|Name=app.exe|", FALSE },
+        { "{name only}", REG_SZ, "v2.30|Name=App=C:\\Vendor\\app.exe|", FALSE },
+        { "{expand sz}", REG_EXPAND_SZ, "v2.30|App=C:\\Vendor\\app.exe|", FALSE },
+        { "{garbage}", REG_SZ, "|||==|", FALSE },
+        { "{empty}", REG_SZ, "", FALSE },
+    };
+    WSTR pattern = W("app.exe");
+    const WCHAR* patterns[] = { pattern.c_str() };
+    MATCHER* matcher = Matcher_CreateEx(patterns, 1, MATCHER_PATH_SUFFIX | MATCHER_IGNORE_CASE);
+    std::vector<WSTR> expected;
+
+    for (const auto& r : kRules)
+    {
+        if (!r.removed)
+            expected.push_back(W(r.name));
+    }
+    for (DWORD flags = 0; flags <= PURGE_IN_PLACE; ++flags)
+    {
+        REGKEY* key;
+        DWORD deleted = 0;
+
+        RegKey_CreateMemory(&key);
+        for (const auto& r : kRules)
+        {
+            WSTR data = W(r.rule);
+            RegKey_MemorySetValue(key, W(r.name).c_str(), r.type, (const BYTE*)data.c_str(),
+                (DWORD)(data.size() + 1) * sizeof(WCHAR));
+        }
+        CHECK_EQ(Purge_ValueNames(key, matcher, PURGE_MATCH_FIREWALL_APP | flags, &deleted), ERROR_SUCCESS);
+        CHECK_EQ(deleted, kRules[0].removed + kRules[1].removed + kRules[2].removed + kRules[3].removed);
+        CHECK(Key_ValueNames(key) == expected);
+        key->vtbl->Close(key);
+    }
+    Matcher_Destroy(matcher);
+}
+
+int main()
+{
+    DWORD best = SimdScan_Level();
+
+    for (DWORD level = 0; level <= best; ++level)
+    {
+        SimdScan_Limit(level);
+        TestTokenizer(level);
+    }
+    TestFindApp();
+    TestPurge();
+    return Check_Result();
+}
@@ -0,0 +1,328 @@
+// Purge_HiveFile, the ClearHive path, over Gen_Hive fixtures written to a
+// scratch folder. A purge leaves a hive the kernel would load as is: both
+// sequence numbers bumped once to the same value, the base block checksum
+// right, every bin still tiling into cells, the survivors and their data
+// untouched. Hives with pending .LOG changes or a bad checksum, and keys
+// that aren't there, leave the file byte for byte as it was.
+#include "check.h"
+#include "fakes.h"
+#include "hive.h"
+#include "purge.h"
+#include "regkey.h"
+
+#include <string>
+
+static DWORD Rd32(const std::vector<BYTE>& b, DWORD at)
+{
+    return b[at] | b[at + 1] << 8 | b[at + 2] << 16 | (DWORD)b[at + 3] << 24;
+}
+
+static void Wr32(std::vector<BYTE>& b, DWORD at, DWORD v)
+{
+    b[at] = (BYTE)v;
+    b[at + 1] = (BYTE)(v >> 8);
+    b[at + 2] = (BYTE)(v >> 16);
+    b[at + 3] = (BYTE)(v >> 24);
+}
+
+static std::vector<BYTE> Utf16(const WSTR& s)
+{
+    std::vector<BYTE> data;
+    for (WCHAR ch : s)
+    {
+        data.push_back((BYTE)ch);
+        data.push_back((BYTE)(ch >> 8));
+    }
+    data.push_back(0);
+    data.push_back(0);
+    return data;
+}
+
+static std::vector<BYTE> Blob(DWORD size, BYTE seed)
+{
+    std::vector<BYTE> data(size);
+    for (DWORD i = 0; i < size; ++i)
+        data[i] = (BYTE)(i * 7 + seed);
+    return data;
+}
+
+// 300 FriendlyAppName values, a third of them for app.exe; a UTF-16 name;
+// inline, empty and big data, one big value for app.exe and one not.
+static std::vector<GEN_HIVE_VALUE> Fixture_Values(void)
+{
+    std::vector<GEN_HIVE_VALUE> values;
+    char text[96];
+
+    for (DWORD i = 0; i < 300; ++i)
+    {
+        GEN_HIVE_VALUE value;
+        snprintf(text, sizeof(text), "C:\\Program Files\\X%u\\%s.FriendlyAppName", i, i % 3 ? "keep.exe" : "app.exe");
+        value.name = W(text);
+        value.type = REG_SZ;
+        snprintf(text, sizeof(text), "Name %u", i);
+        value.data = Utf16(W(text));
+        values.push_back(value);
+    }
+
+    GEN_HIVE_VALUE wide = { W("C:\\"), REG_SZ, Utf16(W("Co")) };
+    wide.name.push_back(0x6D4B);
+    wide.name.push_back(0x8BD5);
+    wide.name += W("\\app.exe.ApplicationCompany");
+    values.push_back(wide);
+
+    GEN_HIVE_VALUE langId = { W("LangID"), REG_DWORD, { 0x09, 0x04, 0x00, 0x00 } };
+    GEN_HIVE_VALUE bigMatch = { W("C:\\big\\app.exe.Blob"), REG_BINARY, Blob(40960, 1) };
+    GEN_HIVE_VALUE bigKeep = { W("C:\\big\\keep.exe.Blob"), REG_BINARY, Blob(43520, 2) };
+    GEN_HIVE_VALUE empty = { W("Empty"), REG_SZ, std::vector<BYTE>() };
+    values.push_back(langId);
+    values.push_back(bigMatch);
+    values.push_back(bigKeep);
+    values.push_back(empty);
+    return values;
+}
+
+static MATCHER* CreateMatcher(std::initializer_list<const char*> patterns)
+{
+    std::vector<WSTR> strings;
+    std::vector<const WCHAR*> pointers;
+
+    for (const char* pattern : patterns)
+        strings.push_back(W(pattern));
+    for (const WSTR& s : strings)
+        pointers.push_back(s.c_str());
+    return Matcher_Create(pointers.data(), (DWORD)pointers.size());
+}
+
+// Walks every bin of |file| cell by cell. FALSE if a bin or cell doesn't
+// add up; |freeBytes| receives the size of the free cells.
+static BOOL Bins_Tile(const std::vector<BYTE>& file, DWORD* freeBytes)
+{
+    DWORD binsSize = Rd32(file, 0x28), at = 0;
+
+    *freeBytes = 0;
+    if (HIVE_BASE_BLOCK_SIZE + binsSize != file.size())
+        return FALSE;
+    while (at < binsSize)
+    {
+        DWORD bin = HIVE_BASE_BLOCK_SIZE + at, size = Rd32(file, bin + 8), cell;
+        if (Rd32(file, bin) != 0x6E696268 || Rd32(file, bin + 4) != at || !size || size % HIVE_BASE_BLOCK_SIZE
+            || at + size > binsSize)
+            return FALSE;
+        for (cell = 32; cell < size;)
+        {
+            LONG cellSize = (LONG)Rd32(file, bin + cell);
+            DWORD length = cellSize < 0 ? (DWORD)-cellSize : (DWORD)cellSize;
+            if (length < 8 || length % 8 || cell + length > size)
+                return FALSE;
+            if (cellSize > 0)
+                *freeBytes += length;
+            cell += length;
+        }
+        at += size;
+    }
+    return TRUE;
+}
+
+// The value names and data of the fixture key in |file|, in order.
+static std::vector<GEN_HIVE_VALUE> Read_Values(std::vector<BYTE> file, const char* keyPath)
+{
+    std::vector<GEN_HIVE_VALUE> values;
+    HIVE hive;
+    REGKEY* key;
+    DWORD count = 0, cchMax = 0, cbMax = 0;
+
+    if (Hive_Open(file.data(), (DWORD)file.size(), &hive) != ERROR_SUCCESS)
+        return values;
+    if (RegKey_OpenHive(&hive, W(keyPath).c_str(), &key) != ERROR_SUCCESS)
+        return values;
+    key->vtbl->QueryInfo(key, &count, &cchMax, &cbMax, NULL);
+    for (DWORD i = 0; i < count; ++i)
+    {
+        std::vector<WCHAR> name(cchMax + 1);
+        GEN_HIVE_VALUE value;
+        DWORD cch = cchMax + 1, cb = cbMax;
+
+        value.data.resize(cbMax);
+        CHECK_EQ(key->vtbl->EnumValue(key, i, name.data(), &cch, &value.type, value.data.data(), &cb), ERROR_SUCCESS);
+        value.name = WSTR(name.data(), cch);
+        value.data.resize(cb);
+        values.push_back(value);
+    }
+    key->vtbl->Close(key);
+    return values;
+}
+
+static BOOL SameValue(const GEN_HIVE_VALUE& a, const GEN_HIVE_VALUE& b)
+{
+    return a.name == b.name && a.type == b.type && a.data == b.data;
+}
+
+static void TestClearHive(const WSTR& dir, DWORD flags)
+{
+    WSTR path = FakeDir_Join(dir, W("UsrClass.dat"));
+    std::vector<GEN_HIVE_VALUE> values = Fixture_Values(), expected;
+    std::vector<BYTE> before = Gen_Hive(values), after;
+    MATCHER* matcher = CreateMatcher({ "app.exe" });
+    DWORD deleted = 0, freeBefore, freeAfter;
+
+    for (const GEN_HIVE_VALUE& value : values)
+    {
+        if (N(value.name).find("app.exe") == std::string::npos)
+            expected.push_back(value);
+    }
+    CHECK(Bins_Tile(before, &freeBefore));
+    CHECK(Scratch_Write(path, before));
+    CHECK_EQ(Purge_HiveFile(path.c_str(), W(GEN_HIVE_KEY_PATH).c_str(), matcher, flags, &deleted), ERROR_SUCCESS);
+    CHECK_EQ(deleted, values.size() - expected.size());
+    CHECK_EQ(deleted, 100 + 2);
+
+    after = Scratch_Read(path);
+    CHECK_EQ(after.size(), before.size());
+    // Bumped once, and the secondary caught up: nothing pending for a log.
+    CHECK_EQ(Rd32(after, 0x04), 8);
+    CHECK_EQ(Rd32(after, 0x08), 8);
+    CHECK_EQ(Rd32(after, 0x1FC), Hive_Checksum(after.data()));
+    // The rest of the base block is as it was.
+    for (DWORD at = 0; at < HIVE_BASE_BLOCK_SIZE; at += 4)
+    {
+        if (at != 0x04 && at != 0x08 && at != 0x1FC)
+            CHECK_EQ(Rd32(after, at), Rd32(before, at));
+    }
+    // The freed vk, data, db and segment cells are free cells now.
+    CHECK(Bins_Tile(after, &freeAfter));
+    CHECK(freeAfter > freeBefore + 40960);
+
+    // The survivors read back whole, in order, with their data; the path
+    // is found whatever its case.
+    std::vector<GEN_HIVE_VALUE> left = Read_Values(after,
+        "local settings\\SOFTWARE\\microsoft\\Windows\\shell\\MUICACHE");
+    CHECK_EQ(left.size(), expected.size());
+    for (DWORD i = 0; i < left.size() && i < expected.size(); ++i)
+        CHECK(SameValue(left[i], expected[i]));
+
+    // Nothing left to delete: the file isn't written at all.
+    CHECK_EQ(Purge_HiveFile(path.c_str(), W(GEN_HIVE_KEY_PATH).c_str(), matcher, flags, &deleted), ERROR_SUCCESS);
+    CHECK_EQ(deleted, 0);
+    CHECK(Scratch_Read(path) == after);
+
+    // A second change bumps the sequence again, to 9.
+    Matcher_Destroy(matcher);
+    matcher = CreateMatcher({ "keep.exe.Blob" });
+    CHECK_EQ(Purge_HiveFile(path.c_str(), W(GEN_HIVE_KEY_PATH).c_str(), matcher, flags, &deleted), ERROR_SUCCESS);
+    CHECK_EQ(deleted, 1);
+    after = Scratch_Read(path);
+    CHECK_EQ(Rd32(after, 0x04), 9);
+    CHECK_EQ(Rd32(after, 0x08), 9);
+    CHECK_EQ(Rd32(after, 0x1FC), Hive_Checksum(after.data()));
+    CHECK(Bins_Tile(after, &freeAfter));
+    Matcher_Destroy(matcher);
+}
+
+static void TestEmptied(const WSTR& dir)
+{
+    WSTR path = FakeDir_Join(dir, W("emptied.dat"));
+    std::vector<GEN_HIVE_VALUE> values = Fixture_Values();
+    MATCHER* matcher = CreateMatcher({ "\\", "LangID", "Empty" });
+    std::vector<BYTE> after;
+    DWORD deleted = 0, freeBytes;
+    HIVE hive;
+    DWORD cell;
+
+    CHECK(Scratch_Write(path, Gen_Hive(values)));
+    CHECK_EQ(Purge_HiveFile(path.c_str(), W(GEN_HIVE_KEY_PATH).c_str(), matcher, PURGE_IN_PLACE, &deleted),
+        ERROR_SUCCESS);
+    CHECK_EQ(deleted, values.size());
+    after = Scratch_Read(path);
+    CHECK(Bins_Tile(after, &freeBytes));
+    CHECK_EQ(Hive_Open(after.data(), (DWORD)after.size(), &hive), ERROR_SUCCESS);
+    CHECK_EQ(Hive_FindKey(&hive, hive.rootCell, W(GEN_HIVE_KEY_PATH).c_str(), &cell), ERROR_SUCCESS);
+    CHECK_EQ(Hive_ValueCount(&hive, cell), 0);
+    CHECK(Read_Values(after, GEN_HIVE_KEY_PATH).empty());
+    Matcher_Destroy(matcher);
+}
+
+static void TestLookups(void)
+{
+    std::vector<BYTE> file = Gen_Hive(Fixture_Values());
+    WSTR chinese;
+    HIVE hive;
+    DWORD cell;
+    FILETIME time;
+
+    CHECK_EQ(Hive_Open(file.data(), (DWORD)file.size(), &hive), ERROR_SUCCESS);
+    CHECK_EQ(Hive_FindKey(&hive, hive.rootCell, W(GEN_HIVE_KEY_PATH).c_str(), &cell), ERROR_SUCCESS);
+    CHECK_EQ(Hive_KeyLastWriteTime(&hive, cell, &time), ERROR_SUCCESS);
+    CHECK_EQ(time.dwHighDateTime, 0x01D00000);
+    CHECK_EQ(time.dwLowDateTime, 0);
+    // Through the ri's first li list, and the siblings next to the path.
+    CHECK_EQ(Hive_FindKey(&hive, hive.rootCell, W("Local Settings\\Software\\aaa").c_str(), &cell), ERROR_SUCCESS);
+    CHECK_EQ(Hive_FindKey(&hive, hive.rootCell, W("Local Settings\\Software\\Microsoft\\Windows\\Shell\\Bags")
+        .c_str(), &cell), ERROR_SUCCESS);
+    CHECK_EQ(Hive_FindKey(&hive, hive.rootCell, W("\xC4pps").c_str(), &cell), ERROR_SUCCESS);
+    chinese.push_back(0x4E2D);
+    chinese.push_back(0x6587);
+    CHECK_EQ(Hive_FindKey(&hive, hive.rootCell, chinese.c_str(), &cell), ERROR_SUCCESS);
+    chinese[1] = 0x6588;
+    CHECK(Hive_FindKey(&hive, hive.rootCell, chinese.c_str(), &cell) != ERROR_SUCCESS);
+    CHECK(Hive_FindKey(&hive, hive.rootCell, W("Local Settings\\Software\\Microsoft\\Windows\\Shell\\MuiCach")
+        .c_str(), &cell) != ERROR_SUCCESS);
+}
+
+static void TestLeftAlone(const WSTR& dir)
+{
+    WSTR path = FakeDir_Join(dir, W("pending.dat"));
+    std::vector<BYTE> good = Gen_Hive(Fixture_Values()), bad;
+    MATCHER* matcher = CreateMatcher({ "app.exe" });
+    DWORD deleted = 99;
+
+    // Changes pending in a .LOG: the sequence numbers differ.
+    bad = good;
+    Wr32(bad, 0x04, 9);
+    Wr32(bad, 0x08, 8);
+    Wr32(bad, 0x1FC, Hive_Checksum(bad.data()));
+    CHECK(Scratch_Write(path, bad));
+    CHECK_EQ(Purge_HiveFile(path.c_str(), W(GEN_HIVE_KEY_PATH).c_str(), matcher, 0, &deleted), ERROR_INVALID_DATA);
+    CHECK_EQ(deleted, 0);
+    CHECK(Scratch_Read(path) == bad);
+
+    // A base block that doesn't check out.
+    bad = good;
+    bad[0x30] ^= 1;
+    CHECK(Scratch_Write(path, bad));
+    CHECK_EQ(Purge_HiveFile(path.c_str(), W(GEN_HIVE_KEY_PATH).c_str(), matcher, 0, &deleted), ERROR_INVALID_DATA);
+    CHECK(Scratch_Read(path) == bad);
+
+    // Bins that run past the end of the file.
+    bad = good;
+    bad.resize(bad.size() - HIVE_BASE_BLOCK_SIZE);
+    CHECK(Scratch_Write(path, bad));
+    CHECK_EQ(Purge_HiveFile(path.c_str(), W(GEN_HIVE_KEY_PATH).c_str(), matcher, 0, &deleted), ERROR_INVALID_DATA);
+    CHECK(Scratch_Read(path) == bad);
+
+    // A key that isn't in the hive, and a hive that isn't there.
+    CHECK(Scratch_Write(path, good));
+    CHECK_EQ(Purge_HiveFile(path.c_str(), W("Local Settings\\Nope").c_str(), matcher, 0, &deleted),
+        ERROR_FILE_NOT_FOUND);
+    CHECK(Scratch_Read(path) == good);
+    CHECK(Purge_HiveFile(FakeDir_Join(dir, W("none.dat")).c_str(), W(GEN_HIVE_KEY_PATH).c_str(), matcher, 0,
+        &deleted) != ERROR_SUCCESS);
+    Matcher_Destroy(matcher);
+}
+
+int main()
+{
+    WSTR dir = Scratch_Dir("hive");
+
+    if (dir.empty())
+    {
+        fprintf(stderr, "no scratch directory\n");
+        return 1;
+    }
+    TestClearHive(dir, 0);
+    TestClearHive(dir, PURGE_IN_PLACE);
+    TestEmptied(dir);
+    TestLookups();
+    TestLeftAlone(dir);
+    Scratch_Remove(dir);
+    return Check_Result();
+}
@@ -0,0 +1,169 @@
+// LnkBatch_Run's lifetime rules over scripted LNK_BATCH_OPS: one Initialize
+// and one Uninitialize per batch however many items there are, a Reset after
+// each failed item and only then, and every item failing with the
+// Initialize error when the apartment can't be entered.
+#include "check.h"
+#include "lnkbatch.h"
+
+#include <string>
+#include <vector>
+
+// RPC_E_CHANGED_MODE: the thread is already in the other apartment type.
+static const HRESULT kChangedMode = (HRESULT)0x80010106L;
+
+typedef struct _SCRIPTED_BATCH {
+    HRESULT initialize;            // what Initialize returns
+    std::vector<HRESULT> updates;  // what Update returns for each item
+    std::string calls;             // I, U<index>, R, X in call order
+    DWORD initializes;
+    DWORD uninitializes;
+    DWORD resets;
+    BOOL cached;                   // an Update left objects to drop
+} SCRIPTED_BATCH;
+
+static HRESULT Scripted_Initialize(void* ctx)
+{
+    SCRIPTED_BATCH* batch = (SCRIPTED_BATCH*)ctx;
+    batch->calls += "I";
+    ++batch->initializes;
+    return batch->initialize;
+}
+
+static HRESULT Scripted_Update(void* ctx, DWORD index)
+{
+    SCRIPTED_BATCH* batch = (SCRIPTED_BATCH*)ctx;
+    batch->calls += "U" + std::to_string(index);
+    CHECK(index < batch->updates.size());
+    // The item before failed: its objects must have been dropped by now.
+    CHECK(!batch->cached);
+    if (index >= batch->updates.size())
+        return E_FAIL;
+    batch->cached = FAILED(batch->updates[index]);
+    return batch->updates[index];
+}
+
+static void Scripted_Reset(void* ctx)
+{
+    SCRIPTED_BATCH* batch = (SCRIPTED_BATCH*)ctx;
+    batch->calls += "R";
+    ++batch->resets;
+    batch->cached = FALSE;
+}
+
+static void Scripted_Uninitialize(void* ctx)
+{
+    SCRIPTED_BATCH* batch = (SCRIPTED_BATCH*)ctx;
+    batch->calls += "X";
+    ++batch->uninitializes;
+}
+
+static const LNK_BATCH_OPS kScriptedOps = {
+    Scripted_Initialize,
+    Scripted_Update,
+    Scripted_Reset,
+    Scripted_Uninitialize,
+};
+
+static void Scripted_Init(SCRIPTED_BATCH* batch, HRESULT initialize, DWORD count, DWORD failEvery)
+{
+    batch->initialize = initialize;
+    batch->updates.assign(count, S_OK);
+    for (DWORD i = 0; failEvery && i < count; ++i)
+    {
+        if (i % failEvery == failEvery - 1)
+            batch->updates[i] = i % 2 ? HRESULT_FROM_WIN32(ERROR_ACCESS_DENIED) : E_FAIL;
+    }
+    batch->calls.clear();
+    batch->initializes = batch->uninitializes = batch->resets = 0;
+    batch->cached = FALSE;
+}
+
+static void TestAllSucceed(void)
+{
+    SCRIPTED_BATCH batch;
+    std::vector<HRESULT> results(50, E_INVALIDARG);
+    DWORD succeeded = 0;
+
+    Scripted_Init(&batch, S_OK, 50, 0);
+    CHECK_EQ(LnkBatch_Run(&kScriptedOps, &batch, 50, results.data(), &succeeded), S_OK);
+    CHECK_EQ(batch.initializes, 1);
+    CHECK_EQ(batch.uninitializes, 1);
+    CHECK_EQ(batch.resets, 0);
+    CHECK_EQ(succeeded, 50);
+    for (DWORD i = 0; i < 50; ++i)
+        CHECK_EQ(results[i], S_OK);
+    CHECK(batch.calls.compare(0, 3, "IU0") == 0);
+    CHECK(batch.calls.compare(batch.calls.size() - 4, 4, "U49X") == 0);
+}
+
+static void TestSomeFail(DWORD failEvery)
+{
+    SCRIPTED_BATCH batch;
+    std::vector<HRESULT> results(40, E_INVALIDARG);
+    std::string expected = "I";
+    DWORD succeeded = 0, failed = 0;
+
+    Scripted_Init(&batch, S_OK, 40, failEvery);
+    for (DWORD i = 0; i < 40; ++i)
+    {
+        expected += "U" + std::to_string(i);
+        if (FAILED(batch.updates[i]))
+        {
+            expected += "R";
+            ++failed;
+        }
+    }
+    expected += "X";
+
+    CHECK_EQ(LnkBatch_Run(&kScriptedOps, &batch, 40, results.data(), &succeeded), S_FALSE);
+    CHECK(batch.calls == expected);
+    CHECK_EQ(batch.initializes, 1);
+    CHECK_EQ(batch.uninitializes, 1);
+    CHECK_EQ(batch.resets, failed);
+    CHECK_EQ(succeeded, 40 - failed);
+    for (DWORD i = 0; i < 40; ++i)
+        CHECK_EQ(results[i], batch.updates[i]);
+}
+
+static void TestInitializeFails(void)
+{
+    SCRIPTED_BATCH batch;
+    std::vector<HRESULT> results(7, S_OK);
+    DWORD succeeded = 99;
+
+    Scripted_Init(&batch, kChangedMode, 7, 0);
+    CHECK_EQ(LnkBatch_Run(&kScriptedOps, &batch, 7, results.data(), &succeeded), kChangedMode);
+    // Nothing to undo: no Update, no Reset, no Uninitialize.
+    CHECK(batch.calls == "I");
+    CHECK_EQ(succeeded, 0);
+    for (DWORD i = 0; i < 7; ++i)
+        CHECK_EQ(results[i], kChangedMode);
+}
+
+static void TestEmpty(void)
+{
+    SCRIPTED_BATCH batch;
+    DWORD succeeded = 99;
+
+    Scripted_Init(&batch, S_OK, 0, 0);
+    CHECK_EQ(LnkBatch_Run(&kScriptedOps, &batch, 0, NULL, &succeeded), S_OK);
+    CHECK(batch.calls.empty());
+    CHECK_EQ(succeeded, 0);
+
+    // |succeeded| is optional.
+    Scripted_Init(&batch, S_OK, 3, 2);
+    std::vector<HRESULT> results(3);
+    CHECK_EQ(LnkBatch_Run(&kScriptedOps, &batch, 3, results.data(), NULL), S_FALSE);
+    CHECK(batch.calls == "IU0U1RU2X");
+}
+
+int main()
+{
+    TestAllSucceed();
+    TestSomeFail(1);
+    TestSomeFail(3);
+    TestSomeFail(40);
+    TestInitializeFails();
+    TestEmpty();
+    return Check_Result();
+}
@@ -0,0 +1,238 @@
+// Lnk_Parse and Lnk_SetAppIdInFile over Gen_Lnk fixtures written to a
+// scratch folder, and the File_WriteAll they save through: short and cut
+// files are refused untouched, a store-less shortcut gains one, an AppID
+// of another length is replaced without disturbing its neighbours, and a
+// rewrite leaves no temporary file and keeps the file's permission bits.
+#include "check.h"
+#include "fakes.h"
+#include "fileio.h"
+#include "lnkfile.h"
+
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const BYTE kToastClsid[16] = {
+    0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF
+};
+
+static std::string Text(const LNK_FILE* lnk, const LNK_TEXT* text)
+{
+    std::string s;
+    for (DWORD i = 0; text->offset && i < text->cch; ++i)
+    {
+        s += text->unicode ? (char)(lnk->data[text->offset + i * 2] | (lnk->data[text->offset + i * 2 + 1] << 8))
+            : (char)lnk->data[text->offset + i];
+    }
+    return s;
+}
+
+static std::string AppIdOf(const std::vector<BYTE>& data)
+{
+    LNK_FILE lnk;
+    LNK_TEXT appId;
+
+    if (FAILED(Lnk_Parse(data.data(), (DWORD)data.size(), &lnk)))
+        return "<invalid>";
+    if (!Lnk_FindStringProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ID, &appId))
+        return "<none>";
+    return Text(&lnk, &appId);
+}
+
+// Everything but the store parses the same in |a| and |b|.
+static void CheckSameOutsideStore(const std::vector<BYTE>& a, const std::vector<BYTE>& b)
+{
+    LNK_FILE la, lb;
+
+    CHECK_EQ(Lnk_Parse(a.data(), (DWORD)a.size(), &la), S_OK);
+    CHECK_EQ(Lnk_Parse(b.data(), (DWORD)b.size(), &lb), S_OK);
+    CHECK_EQ(la.linkFlags, lb.linkFlags);
+    CHECK_EQ(la.iconIndex, lb.iconIndex);
+    CHECK(!memcmp(a.data(), b.data(), la.extraOffset ? la.extraOffset : LNK_HEADER_SIZE));
+    CHECK(Text(&la, &la.localBasePath) == Text(&lb, &lb.localBasePath));
+    for (DWORD i = 0; i < LNK_STRING_COUNT; ++i)
+        CHECK(Text(&la, &la.strings[i]) == Text(&lb, &lb.strings[i]));
+}
+
+static std::vector<BYTE> Fixture(const char* appId, BOOL neighbours, BOOL specialFolder)
+{
+    WSTR target = W("C:\\Program Files\\Vendor\\App\\app.exe"), args = W("--start"), id = appId ? W(appId) : WSTR();
+    GEN_LNK spec;
+
+    GenLnk_Init(&spec);
+    spec.target = target.c_str();
+    spec.unicodeTarget = TRUE;
+    spec.idList = TRUE;
+    spec.arguments = args.c_str();
+    spec.specialFolderBlock = specialFolder;
+    spec.appId = appId ? id.c_str() : NULL;
+    if (neighbours)
+    {
+        spec.dualMode = 1;
+        spec.toastActivatorClsid = kToastClsid;
+    }
+    return Gen_Lnk(&spec);
+}
+
+static void TestShortFiles(const WSTR& dir)
+{
+    WSTR path = FakeDir_Join(dir, W("short.lnk"));
+    std::vector<BYTE> good = Fixture("Vendor.App", FALSE, FALSE);
+    LNK_FILE lnk;
+
+    // Every cut of a valid file either fails to parse or parses within the
+    // bytes it has; the patcher leaves a refused file as it was.
+    for (size_t size = 0; size < good.size(); ++size)
+    {
+        std::vector<BYTE> cut(good.begin(), good.begin() + size);
+        HRESULT hr = Lnk_Parse(cut.data(), (DWORD)cut.size(), &lnk);
+        CHECK(hr == S_OK || hr == HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+        if (hr == S_OK)
+            CHECK(lnk.extraOffset + lnk.extraSize <= size);
+        if (size > LNK_HEADER_SIZE + 8 && size % 7)
+            continue;
+        CHECK(Scratch_Write(path, cut));
+        if (FAILED(Lnk_SetAppIdInFile(path.c_str(), W("Vendor.Other").c_str())))
+            CHECK(Scratch_Read(path) == cut);
+        else
+            CHECK(AppIdOf(Scratch_Read(path)) == "Vendor.Other");
+    }
+    // The header alone is too short for any LinkFlags it claims.
+    CHECK(Lnk_Parse(good.data(), LNK_HEADER_SIZE - 1, &lnk) == HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+    CHECK(Lnk_Parse(good.data(), 0, &lnk) == HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+
+    // A file that isn't there at all.
+    CHECK(FAILED(Lnk_SetAppIdInFile(FakeDir_Join(dir, W("none.lnk")).c_str(), W("Vendor.App").c_str())));
+}
+
+static void TestNoPropertyStore(const WSTR& dir)
+{
+    for (DWORD layout = 0; layout < 2; ++layout)
+    {
+        WSTR path = FakeDir_Join(dir, W("nostore.lnk"));
+        std::vector<BYTE> before = Fixture(NULL, FALSE, layout == 1), after;
+        LNK_FILE lnk;
+
+        CHECK_EQ(Lnk_Parse(before.data(), (DWORD)before.size(), &lnk), S_OK);
+        CHECK_EQ(lnk.propertyStoreSize, 0);
+        CHECK(Scratch_Write(path, before));
+        CHECK_EQ(Lnk_SetAppIdInFile(path.c_str(), W("Vendor.Suite.App").c_str()), S_OK);
+        after = Scratch_Read(path);
+        CHECK(AppIdOf(after) == "Vendor.Suite.App");
+        CheckSameOutsideStore(before, after);
+        CHECK_EQ(Lnk_Parse(after.data(), (DWORD)after.size(), &lnk), S_OK);
+        CHECK(lnk.propertyStoreSize > 0);
+        CHECK(lnk.terminalOffset > 0);
+
+        // Setting it again changes nothing, not even the file.
+        CHECK_EQ(Lnk_SetAppIdInFile(path.c_str(), W("Vendor.Suite.App").c_str()), S_FALSE);
+        CHECK(Scratch_Read(path) == after);
+    }
+}
+
+static void TestReplaceOtherLength(const WSTR& dir)
+{
+    static const char* const kIds[] = { "A", "Vendor.App", "Vendor.Suite.Application.With.A.Longer.Id", "B.C" };
+    WSTR path = FakeDir_Join(dir, W("replace.lnk"));
+    std::vector<BYTE> before = Fixture(kIds[0], TRUE, TRUE), after;
+
+    CHECK(Scratch_Write(path, before));
+    for (DWORD i = 1; i < sizeof(kIds) / sizeof(kIds[0]); ++i)
+    {
+        LNK_FILE lnk;
+        BOOL dualMode = FALSE;
+        LNK_FMTID clsid;
+
+        CHECK_EQ(Lnk_SetAppIdInFile(path.c_str(), W(kIds[i]).c_str()), S_OK);
+        after = Scratch_Read(path);
+        CHECK(AppIdOf(after) == kIds[i]);
+        CheckSameOutsideStore(before, after);
+        // UTF-16 with a NUL, padded to 4 bytes: the file grows or shrinks
+        // with the id. The fixture's own store isn't padded, so only from
+        // the second rewrite on is the difference exact.
+        if (i == 1)
+            CHECK(after.size() > before.size());
+        else
+            CHECK_EQ(after.size() - before.size(), (((strlen(kIds[i]) + 1) * 2 + 3) & ~3u)
+                - (((strlen(kIds[i - 1]) + 1) * 2 + 3) & ~3u));
+        CHECK_EQ(Lnk_Parse(after.data(), (DWORD)after.size(), &lnk), S_OK);
+        CHECK(Lnk_FindBoolProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_IsDualMode, &dualMode));
+        CHECK(dualMode);
+        CHECK(Lnk_FindGuidProperty(&lnk, &LNK_FMTID_AppUserModel, LNK_PID_AppUserModel_ToastActivatorCLSID, &clsid));
+        CHECK(!memcmp(clsid.bytes, kToastClsid, 16));
+        before = after;
+    }
+}
+
+static std::vector<std::string> DirNames(const WSTR& dir)
+{
+    std::vector<std::string> names;
+    struct dirent* entry;
+    DIR* d = opendir(N(dir).c_str());
+
+    while (d && (entry = readdir(d)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+            names.push_back(entry->d_name);
+    }
+    if (d)
+        closedir(d);
+    return names;
+}
+
+static void TestWriteAll(const WSTR& parent)
+{
+    WSTR dir = FakeDir_Join(parent, W("write"));
+    WSTR path = FakeDir_Join(dir, W("file.bin"));
+    BYTE* data;
+    DWORD size;
+    struct stat st;
+    std::vector<BYTE> big(100000, 0xAB), small(3, 0xCD);
+
+    mkdir(N(dir).c_str(), 0700);
+    CHECK_EQ(File_WriteAll(path.c_str(), big.data(), (DWORD)big.size()), ERROR_SUCCESS);
+    CHECK(Scratch_Read(path) == big);
+
+    // Replaced by something shorter: nothing of the old contents is left,
+    // and its permission bits are.
+    CHECK(chmod(N(path).c_str(), 0640) == 0);
+    CHECK_EQ(File_WriteAll(path.c_str(), small.data(), (DWORD)small.size()), ERROR_SUCCESS);
+    CHECK(Scratch_Read(path) == small);
+    CHECK(stat(N(path).c_str(), &st) == 0 && (st.st_mode & 07777) == 0640);
+    CHECK_EQ(File_WriteAll(path.c_str(), NULL, 0), ERROR_SUCCESS);
+    CHECK(Scratch_Read(path).empty());
+    CHECK_EQ(File_ReadAll(path.c_str(), &data, &size), ERROR_SUCCESS);
+    CHECK_EQ(size, 0);
+    Mem_Free(data);
+
+    // No temporary file is left behind, on success or failure.
+    CHECK(DirNames(dir) == std::vector<std::string>(1, "file.bin"));
+    CHECK(File_WriteAll(FakeDir_Join(dir, W("missing/file.bin")).c_str(), small.data(), 3) != ERROR_SUCCESS);
+    CHECK(DirNames(dir) == std::vector<std::string>(1, "file.bin"));
+
+    // Non-ASCII names go through UTF-8.
+    WSTR wide = FakeDir_Join(dir, W("caf\xe9.lnk"));
+    wide.push_back(0x4E2D);
+    CHECK_EQ(File_WriteAll(wide.c_str(), small.data(), 3), ERROR_SUCCESS);
+    CHECK_EQ(File_ReadAll(wide.c_str(), &data, &size), ERROR_SUCCESS);
+    CHECK_EQ(size, 3);
+    Mem_Free(data);
+    CHECK_EQ(DirNames(dir).size(), 2);
+}
+
+int main()
+{
+    WSTR dir = Scratch_Dir("lnkfile");
+
+    if (dir.empty())
+    {
+        fprintf(stderr, "no scratch directory\n");
+        return 1;
+    }
+    TestShortFiles(dir);
+    TestNoPropertyStore(dir);
+    TestReplaceOtherLength(dir);
+    TestWriteAll(dir);
+    Scratch_Remove(dir);
+    return Check_Result();
+}
@@ -0,0 +1,325 @@
+// LnkIndex over .lnk fixtures written to a scratch folder and listed by a
+// FAKE_DIR_LISTER: what a build reads, that a saved index loads back the
+// same, which files a refresh parses again, and that a damaged index file
+// is refused rather than half loaded.
+#include "check.h"
+#include "fakes.h"
+#include "lnkindex.h"
+#include "lnkfile.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Last-write times given to the fixtures, so a change never depends on the
+// clock ticking between two writes.
+#define FIXTURE_TIME 1600000000
+
+typedef struct _LNK_FIXTURE {
+    WSTR dir;
+    WSTR sub;
+    FAKE_DIR_LISTER lister;
+} LNK_FIXTURE;
+
+static std::vector<BYTE> Fixture_Lnk(const char* target, const char* arguments, const char* appId)
+{
+    WSTR t = W(target), a = W(arguments), i = W("C:\\Icons\\app.ico"), id = appId ? W(appId) : WSTR();
+    GEN_LNK spec;
+
+    GenLnk_Init(&spec);
+    spec.target = t.c_str();
+    spec.unicodeTarget = TRUE;
+    spec.idList = TRUE;
+    spec.arguments = a.c_str();
+    spec.icon = i.c_str();
+    spec.iconIndex = 3;
+    spec.appId = appId ? id.c_str() : NULL;
+    return Gen_Lnk(&spec);
+}
+
+static void Fixture_Put(LNK_FIXTURE* f, const WSTR& dir, const char* name, const std::vector<BYTE>& data,
+    DWORD time)
+{
+    WSTR path = FakeDir_Join(dir, W(name));
+    CHECK(Scratch_Write(path, data));
+    CHECK(Scratch_Touch(path, time));
+    FakeDirLister_Add(&f->lister, dir, W(name), FALSE);
+}
+
+// 20 shortcuts, odd ones to C:\Apps\Foo and even ones to C:\Apps\Foobar,
+// every fifth with an AppUserModelID; one in a subfolder; a file named
+// .lnk that isn't one; a text file; and one listed but not on disk.
+static BOOL Fixture_Init(LNK_FIXTURE* f)
+{
+    char name[32];
+
+    f->dir = Scratch_Dir("lnkindex");
+    if (f->dir.empty())
+        return FALSE;
+    f->sub = FakeDir_Join(f->dir, W("sub"));
+    mkdir(N(f->sub).c_str(), 0700);
+    FakeDirLister_Init(&f->lister);
+
+    for (DWORD i = 0; i < 20; ++i)
+    {
+        snprintf(name, sizeof(name), "a%u.lnk", i);
+        Fixture_Put(f, f->dir, name, Fixture_Lnk(i % 2 ? "C:\\Apps\\Foo\\foo.exe" : "C:\\Apps\\Foobar\\x.exe",
+            "--x", i % 5 ? NULL : "Vendor.Foo"), FIXTURE_TIME + i);
+    }
+    FakeDirLister_Add(&f->lister, f->dir, W("sub"), TRUE);
+    Fixture_Put(f, f->sub, "s.LNK", Fixture_Lnk("C:\\Apps\\foo\\deep\\s.exe", "", "Vendor.Foo"), FIXTURE_TIME);
+    Fixture_Put(f, f->dir, "junk.lnk", std::vector<BYTE>(100, 'x'), FIXTURE_TIME);
+    Fixture_Put(f, f->dir, "readme.txt", std::vector<BYTE>(1, 'x'), FIXTURE_TIME);
+    FakeDirLister_Add(&f->lister, f->dir, W("ghost.lnk"), FALSE);
+    return TRUE;
+}
+
+static DWORD Find(const LNK_INDEX* index, const char* value, BOOL byAppId)
+{
+    WSTR w = W(value);
+    STR_LIST paths;
+    DWORD count;
+
+    StrList_Init(&paths);
+    CHECK(byAppId ? LnkIndex_FindByAppId(index, w.c_str(), &paths) : LnkIndex_FindByTargetDir(index, w.c_str(), &paths));
+    count = paths.count;
+    StrList_Free(&paths);
+    return count;
+}
+
+static DWORD Entry(const LNK_INDEX* index, const WSTR& path)
+{
+    for (DWORD i = 0; i < index->count; ++i)
+    {
+        if (WSTR(LnkIndex_Get(index, i, LNK_INDEX_PATH)) == path)
+            return i;
+    }
+    return (DWORD)-1;
+}
+
+static BOOL SameIndex(const LNK_INDEX* a, const LNK_INDEX* b)
+{
+    if (a->count != b->count)
+        return FALSE;
+    for (DWORD i = 0; i < a->count; ++i)
+    {
+        if (a->entries[i].size != b->entries[i].size || a->entries[i].iconIndex != b->entries[i].iconIndex
+            || a->entries[i].parsed != b->entries[i].parsed
+            || memcmp(&a->entries[i].lastWrite, &b->entries[i].lastWrite, sizeof(FILETIME)))
+            return FALSE;
+        for (DWORD field = 0; field < LNK_INDEX_FIELD_COUNT; ++field)
+        {
+            if (WSTR(LnkIndex_Get(a, i, field)) != WSTR(LnkIndex_Get(b, i, field)))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void TestBuildAndFind(LNK_FIXTURE* f)
+{
+    LNK_INDEX index;
+    LNK_INDEX_STATS stats;
+    DWORD i;
+
+    LnkIndex_Init(&index);
+    CHECK_EQ(LnkIndex_Load(&index, FakeDir_Join(f->dir, W("missing.bin")).c_str()), ERROR_SUCCESS);
+    CHECK_EQ(index.count, 0);
+
+    CHECK_EQ(LnkIndex_Refresh(&index, &f->lister.base, f->dir.c_str(), LNK_INDEX_RECURSE, &stats), ERROR_SUCCESS);
+    CHECK_EQ(stats.listed, 22);
+    CHECK_EQ(stats.parsed, 22);
+    CHECK_EQ(stats.reused, 0);
+    CHECK_EQ(stats.removed, 0);
+    CHECK_EQ(index.count, 22);
+    CHECK(index.dirty);
+
+    i = Entry(&index, FakeDir_Join(f->dir, W("a5.lnk")));
+    CHECK(i < index.count);
+    if (i < index.count)
+    {
+        CHECK(index.entries[i].parsed);
+        CHECK_EQ(index.entries[i].iconIndex, 3);
+        CHECK(N(LnkIndex_Get(&index, i, LNK_INDEX_TARGET)) == "C:\\Apps\\Foo\\foo.exe");
+        CHECK(N(LnkIndex_Get(&index, i, LNK_INDEX_ARGUMENTS)) == "--x");
+        CHECK(N(LnkIndex_Get(&index, i, LNK_INDEX_ICON)) == "C:\\Icons\\app.ico");
+        CHECK(N(LnkIndex_Get(&index, i, LNK_INDEX_APP_ID)) == "Vendor.Foo");
+    }
+    i = Entry(&index, FakeDir_Join(f->dir, W("junk.lnk")));
+    CHECK(i < index.count);
+    if (i < index.count)
+    {
+        CHECK(!index.entries[i].parsed);
+        CHECK_EQ(index.entries[i].size, 100);
+        for (DWORD field = LNK_INDEX_TARGET; field < LNK_INDEX_FIELD_COUNT; ++field)
+            CHECK(!LnkIndex_Get(&index, i, field)[0]);
+    }
+    CHECK(Entry(&index, FakeDir_Join(f->dir, W("ghost.lnk"))) == (DWORD)-1);
+    CHECK(Entry(&index, FakeDir_Join(f->dir, W("readme.txt"))) == (DWORD)-1);
+
+    // Path prefixes stop at a separator and ignore ASCII case; AppIDs are exact.
+    CHECK_EQ(Find(&index, "C:\\Apps\\Foo", FALSE), 11);
+    CHECK_EQ(Find(&index, "c:\\apps\\foo\\", FALSE), 11);
+    CHECK_EQ(Find(&index, "C:\\Apps", FALSE), 21);
+    CHECK_EQ(Find(&index, "C:\\Apps\\Fo", FALSE), 0);
+    CHECK_EQ(Find(&index, "Vendor.Foo", TRUE), 5);
+    CHECK_EQ(Find(&index, "vendor.foo", TRUE), 0);
+    CHECK_EQ(Find(&index, "Vendor.Fo", TRUE), 0);
+
+    LnkIndex_Free(&index);
+}
+
+static void TestSaveLoadStale(LNK_FIXTURE* f)
+{
+    WSTR file = FakeDir_Join(f->dir, W("index.bin"));
+    LNK_INDEX built, loaded;
+    LNK_INDEX_STATS stats;
+    DWORD lists;
+
+    LnkIndex_Init(&built);
+    LnkIndex_Init(&loaded);
+    CHECK_EQ(LnkIndex_Refresh(&built, &f->lister.base, f->dir.c_str(), LNK_INDEX_RECURSE, NULL), ERROR_SUCCESS);
+    CHECK_EQ(LnkIndex_Save(&built, file.c_str()), ERROR_SUCCESS);
+    CHECK_EQ(LnkIndex_Load(&loaded, file.c_str()), ERROR_SUCCESS);
+    CHECK(SameIndex(&built, &loaded));
+    CHECK(!loaded.dirty);
+    CHECK_EQ(Find(&loaded, "C:\\Apps\\Foo", FALSE), 11);
+
+    // Nothing changed: nothing read again, and nothing to save.
+    lists = f->lister.lists;
+    CHECK_EQ(LnkIndex_Refresh(&loaded, &f->lister.base, f->dir.c_str(), LNK_INDEX_RECURSE, &stats), ERROR_SUCCESS);
+    CHECK_EQ(f->lister.lists - lists, 2);
+    CHECK_EQ(stats.reused, 22);
+    CHECK_EQ(stats.parsed, 0);
+    CHECK_EQ(stats.removed, 0);
+    CHECK(!loaded.dirty);
+
+    // a3 gets a new AppID (size and time change), a6 a new time only, a7
+    // new bytes of the same size under its old time (not noticed, as on
+    // Windows), a8 is deleted from disk but still listed, a9 is gone from
+    // both.
+    std::vector<BYTE> data = Fixture_Lnk("C:\\Apps\\Foo\\foo.exe", "--x", "Vendor.Changed");
+    WSTR a3 = FakeDir_Join(f->dir, W("a3.lnk"));
+    CHECK(Scratch_Write(a3, data));
+    CHECK(Scratch_Touch(a3, FIXTURE_TIME + 3));
+    CHECK(Scratch_Touch(FakeDir_Join(f->dir, W("a6.lnk")), FIXTURE_TIME + 1000));
+    data = Fixture_Lnk("C:\\Apps\\Foo\\bar.exe", "--y", NULL);
+    WSTR a7 = FakeDir_Join(f->dir, W("a7.lnk"));
+    CHECK(Scratch_Write(a7, data));
+    CHECK(Scratch_Touch(a7, FIXTURE_TIME + 7));
+    CHECK(unlink(N(FakeDir_Join(f->dir, W("a8.lnk"))).c_str()) == 0);
+    CHECK(unlink(N(FakeDir_Join(f->dir, W("a9.lnk"))).c_str()) == 0);
+    std::vector<FAKE_DIR_ENTRY>& entries = f->lister.dirs[f->dir];
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].name == W("a9.lnk"))
+            entries.erase(entries.begin() + i--);
+    }
+
+    CHECK_EQ(LnkIndex_Refresh(&loaded, &f->lister.base, f->dir.c_str(), LNK_INDEX_RECURSE, &stats), ERROR_SUCCESS);
+    CHECK_EQ(stats.listed, 20);
+    CHECK_EQ(stats.parsed, 2);
+    CHECK_EQ(stats.reused, 18);
+    CHECK_EQ(stats.removed, 2);
+    CHECK_EQ(loaded.count, 20);
+    CHECK(loaded.dirty);
+    CHECK_EQ(Find(&loaded, "Vendor.Changed", TRUE), 1);
+    CHECK_EQ(Find(&loaded, "Vendor.Foo", TRUE), 5);
+    CHECK(N(LnkIndex_Get(&loaded, Entry(&loaded, a7), LNK_INDEX_ARGUMENTS)) == "--x");
+
+    // Another folder's entries are left alone by a refresh of this one, and
+    // a refresh without LNK_INDEX_RECURSE drops the subfolder's.
+    FAKE_DIR_LISTER other;
+    WSTR otherDir = Scratch_Dir("lnkindex-other");
+    FakeDirLister_Init(&other);
+    Fixture_Put(f, otherDir, "o.lnk", Fixture_Lnk("D:\\Other\\o.exe", "", NULL), FIXTURE_TIME);
+    other.dirs[otherDir] = f->lister.dirs[otherDir];
+    f->lister.dirs.erase(otherDir);
+    CHECK_EQ(LnkIndex_Refresh(&loaded, &other.base, otherDir.c_str(), 0, &stats), ERROR_SUCCESS);
+    CHECK_EQ(stats.parsed, 1);
+    CHECK_EQ(loaded.count, 21);
+    CHECK_EQ(LnkIndex_Refresh(&loaded, &f->lister.base, f->dir.c_str(), 0, &stats), ERROR_SUCCESS);
+    CHECK_EQ(stats.removed, 1);
+    CHECK_EQ(loaded.count, 20);
+    CHECK_EQ(Find(&loaded, "D:\\Other", FALSE), 1);
+    CHECK(Entry(&loaded, FakeDir_Join(f->sub, W("s.LNK"))) == (DWORD)-1);
+    Scratch_Remove(otherDir);
+
+    LnkIndex_Free(&built);
+    LnkIndex_Free(&loaded);
+}
+
+// A load that fails leaves the index empty, never part of the file.
+static void CheckRefused(const WSTR& file, const std::vector<BYTE>& data)
+{
+    LNK_INDEX index;
+
+    LnkIndex_Init(&index);
+    CHECK(Scratch_Write(file, data));
+    CHECK_EQ(LnkIndex_Load(&index, file.c_str()), ERROR_INVALID_DATA);
+    CHECK_EQ(index.count, 0);
+    LnkIndex_Free(&index);
+}
+
+static void TestDamagedFile(LNK_FIXTURE* f)
+{
+    WSTR file = FakeDir_Join(f->dir, W("index.bin")), damaged = FakeDir_Join(f->dir, W("damaged.bin"));
+    LNK_INDEX index;
+    std::vector<BYTE> good, data;
+
+    LnkIndex_Init(&index);
+    CHECK_EQ(LnkIndex_Refresh(&index, &f->lister.base, f->dir.c_str(), LNK_INDEX_RECURSE, NULL), ERROR_SUCCESS);
+    CHECK_EQ(LnkIndex_Save(&index, file.c_str()), ERROR_SUCCESS);
+    LnkIndex_Free(&index);
+    good = Scratch_Read(file);
+    CHECK(good.size() > LNK_INDEX_HEADER_SIZE);
+
+    // Cut anywhere, from empty to one byte short.
+    for (size_t size = 0; size < good.size(); size += size < 64 ? 1 : 13)
+        CheckRefused(damaged, std::vector<BYTE>(good.begin(), good.begin() + size));
+    data = good;
+    data.push_back(0);
+    CheckRefused(damaged, data);
+
+    // Any byte changed in the entries fails the checksum.
+    for (size_t at = LNK_INDEX_HEADER_SIZE; at < good.size(); at += 29)
+    {
+        data = good;
+        data[at] ^= 0x55;
+        CheckRefused(damaged, data);
+    }
+    // Magic, version, count and checksum.
+    for (size_t at = 0; at < LNK_INDEX_HEADER_SIZE; at += 4)
+    {
+        data = good;
+        data[at] ^= 1;
+        CheckRefused(damaged, data);
+    }
+    // A count far past what the file holds.
+    data = good;
+    data[11] = 0x7F;
+    CheckRefused(damaged, data);
+
+    // The good file still loads.
+    LnkIndex_Init(&index);
+    CHECK(Scratch_Write(damaged, good));
+    CHECK_EQ(LnkIndex_Load(&index, damaged.c_str()), ERROR_SUCCESS);
+    CHECK_EQ(index.count, 22);
+    LnkIndex_Free(&index);
+}
+
+int main()
+{
+    LNK_FIXTURE f;
+
+    if (!Fixture_Init(&f))
+    {
+        fprintf(stderr, "no scratch directory\n");
+        return 1;
+    }
+    TestBuildAndFind(&f);
+    TestDamagedFile(&f);
+    TestSaveLoadStale(&f);
+    Scratch_Remove(f.dir);
+    return Check_Result();
+}
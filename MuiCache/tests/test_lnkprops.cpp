@@ -0,0 +1,261 @@
+// Lnk_ChangedProperties over Gen_Lnk shortcuts: values already in place
+// report nothing; paths match ASCII letters in any case and other strings
+// only exactly; absent values match empty ones; a target or icon kept as
+// an environment string, code-page text outside ASCII and options this
+// reader doesn't know always count as changed.
+#include "check.h"
+#include "fakes.h"
+#include "lnkprops.h"
+
+#include <string.h>
+
+static const BYTE kToastClsid[16] = {
+    0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF
+};
+
+#define ALL_PROPS (LNK_PROP_TARGET | LNK_PROP_WORKING_DIR | LNK_PROP_ARGUMENTS | LNK_PROP_DESCRIPTION | \
+    LNK_PROP_ICON | LNK_PROP_APP_ID | LNK_PROP_DUAL_MODE | LNK_PROP_TOAST_ACTIVATOR_CLSID)
+
+// Strings a shortcut holds or a caller passes, as Latin-1.
+typedef struct _PROP_TEXT {
+    WSTR target, workingDir, arguments, description, icon, appId;
+} PROP_TEXT;
+
+static void PropText_Init(PROP_TEXT* text)
+{
+    text->target = W("C:\\Program Files\\Vendor\\App\\app.exe");
+    text->workingDir = W("C:\\Program Files\\Vendor\\App");
+    text->arguments = W("--start \"My Docs\"");
+    text->description = W("Vendor App");
+    text->icon = W("C:\\Program Files\\Vendor\\App\\app.ico");
+    text->appId = W("Vendor.Suite.App");
+}
+
+static std::vector<BYTE> Fixture(const PROP_TEXT* text, BOOL unicodeTarget, BOOL ansiStrings, DWORD extraFlags)
+{
+    GEN_LNK spec;
+
+    GenLnk_Init(&spec);
+    spec.target = text->target.c_str();
+    spec.unicodeTarget = unicodeTarget;
+    spec.idList = TRUE;
+    spec.workingDir = text->workingDir.c_str();
+    spec.arguments = text->arguments.c_str();
+    spec.description = text->description.c_str();
+    spec.icon = text->icon.c_str();
+    spec.iconIndex = 3;
+    spec.ansiStrings = ansiStrings;
+    spec.extraFlags = extraFlags;
+    spec.appId = text->appId.c_str();
+    spec.dualMode = 1;
+    spec.toastActivatorClsid = kToastClsid;
+    return Gen_Lnk(&spec);
+}
+
+static void Properties_Init(LNK_PROPERTIES* properties, const PROP_TEXT* text, DWORD options)
+{
+    memset(properties, 0, sizeof(LNK_PROPERTIES));
+    properties->options = options;
+    properties->target = text->target.c_str();
+    properties->workingDir = text->workingDir.c_str();
+    properties->arguments = text->arguments.c_str();
+    properties->description = text->description.c_str();
+    properties->icon = text->icon.c_str();
+    properties->iconIndex = 3;
+    properties->appId = text->appId.c_str();
+    properties->dualMode = TRUE;
+    memcpy(properties->toastActivatorClsid.bytes, kToastClsid, 16);
+}
+
+// Lnk_ChangedProperties of |file| against |text| for |options|.
+static DWORD Changed(const std::vector<BYTE>& file, const PROP_TEXT* text, DWORD options)
+{
+    LNK_PROPERTIES properties;
+    LNK_FILE lnk;
+
+    if (FAILED(Lnk_Parse(file.data(), (DWORD)file.size(), &lnk)))
+        return 0xFFFFFFFF;
+    Properties_Init(&properties, text, options);
+    return Lnk_ChangedProperties(&lnk, &properties);
+}
+
+static void TestExactMatch(void)
+{
+    PROP_TEXT text;
+    PropText_Init(&text);
+
+    // Every layout of the same values: nothing to save, whichever options.
+    for (DWORD layout = 0; layout < 4; ++layout)
+    {
+        std::vector<BYTE> file = Fixture(&text, layout & 1, (layout & 2) != 0, 0);
+        CHECK_EQ(Changed(file, &text, ALL_PROPS), 0);
+        for (DWORD option = 1; option & ALL_PROPS; option <<= 1)
+            CHECK_EQ(Changed(file, &text, option), 0);
+        CHECK_EQ(Changed(file, &text, 0), 0);
+    }
+
+    // One value off at a time reports that one only.
+    std::vector<BYTE> file = Fixture(&text, TRUE, FALSE, 0);
+    LNK_PROPERTIES properties;
+    LNK_FILE lnk;
+    WSTR other = W("C:\\Program Files\\Vendor\\App\\app.ex");
+    CHECK_EQ(Lnk_Parse(file.data(), (DWORD)file.size(), &lnk), S_OK);
+
+    Properties_Init(&properties, &text, ALL_PROPS);
+    properties.target = other.c_str();
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), LNK_PROP_TARGET);
+    Properties_Init(&properties, &text, ALL_PROPS);
+    properties.workingDir = other.c_str();
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), LNK_PROP_WORKING_DIR);
+    Properties_Init(&properties, &text, ALL_PROPS);
+    properties.iconIndex = 4;
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), LNK_PROP_ICON);
+    Properties_Init(&properties, &text, ALL_PROPS);
+    properties.dualMode = FALSE;
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), LNK_PROP_DUAL_MODE);
+    Properties_Init(&properties, &text, ALL_PROPS);
+    properties.toastActivatorClsid.bytes[15] ^= 1;
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), LNK_PROP_TOAST_ACTIVATOR_CLSID);
+
+    // A value that is a prefix of the one held, or the other way round.
+    PROP_TEXT longer = text;
+    longer.appId += W(".2");
+    CHECK_EQ(Changed(file, &longer, ALL_PROPS), LNK_PROP_APP_ID);
+    PROP_TEXT shorter = text;
+    shorter.arguments.pop_back();
+    CHECK_EQ(Changed(file, &shorter, ALL_PROPS), LNK_PROP_ARGUMENTS);
+}
+
+static void TestCase(void)
+{
+    PROP_TEXT text, upper;
+    PropText_Init(&text);
+    std::vector<BYTE> file = Fixture(&text, TRUE, FALSE, 0);
+
+    // Paths ignore the case of ASCII letters...
+    upper = text;
+    upper.target = W("c:\\PROGRAM FILES\\vendor\\App\\APP.EXE");
+    upper.workingDir = W("C:\\program files\\VENDOR\\app");
+    upper.icon = W("C:\\Program Files\\Vendor\\App\\App.Ico");
+    CHECK_EQ(Changed(file, &upper, ALL_PROPS), 0);
+
+    // ...code-page ones too, when the target is only there in the code page.
+    CHECK_EQ(Changed(Fixture(&text, FALSE, TRUE, 0), &upper, ALL_PROPS), 0);
+
+    // ...but not of other letters.
+    PROP_TEXT accented = text;
+    accented.target = W("C:\\Program Files\\Vendor\\Caf\xE9\\app.exe");
+    upper = accented;
+    upper.target = W("C:\\Program Files\\Vendor\\Caf\xC9\\app.exe");
+    CHECK_EQ(Changed(Fixture(&accented, TRUE, FALSE, 0), &accented, ALL_PROPS), 0);
+    CHECK_EQ(Changed(Fixture(&accented, TRUE, FALSE, 0), &upper, ALL_PROPS), LNK_PROP_TARGET);
+
+    // Arguments, description and AppUserModelID are compared exactly.
+    upper = text;
+    upper.arguments = W("--START \"My Docs\"");
+    upper.description = W("vendor app");
+    upper.appId = W("vendor.suite.app");
+    CHECK_EQ(Changed(file, &upper, ALL_PROPS), LNK_PROP_ARGUMENTS | LNK_PROP_DESCRIPTION | LNK_PROP_APP_ID);
+}
+
+static void TestAbsent(void)
+{
+    WSTR target = W("C:\\A\\b.exe");
+    PROP_TEXT empty;
+    LNK_PROPERTIES properties;
+    LNK_FILE lnk;
+    GEN_LNK spec;
+
+    // A bare shortcut: empty strings, no AppID, FALSE and the null CLSID
+    // are all already in place.
+    GenLnk_Init(&spec);
+    spec.target = target.c_str();
+    std::vector<BYTE> file = Gen_Lnk(&spec);
+    CHECK_EQ(Lnk_Parse(file.data(), (DWORD)file.size(), &lnk), S_OK);
+
+    memset(&properties, 0, sizeof(properties));
+    properties.options = ALL_PROPS & ~LNK_PROP_TARGET;
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), 0);
+    PropText_Init(&empty);
+    empty.workingDir = empty.arguments = empty.description = empty.icon = empty.appId = WSTR();
+    empty.target = target;
+    Properties_Init(&properties, &empty, ALL_PROPS);
+    properties.iconIndex = 0;
+    properties.dualMode = FALSE;
+    memset(&properties.toastActivatorClsid, 0, sizeof(properties.toastActivatorClsid));
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), 0);
+
+    // Any actual value is a change.
+    properties.appId = target.c_str();
+    properties.dualMode = TRUE;
+    properties.description = target.c_str();
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), LNK_PROP_APP_ID | LNK_PROP_DUAL_MODE | LNK_PROP_DESCRIPTION);
+
+    // No LinkInfo: the target can't be confirmed, even as "".
+    GenLnk_Init(&spec);
+    spec.idList = TRUE;
+    file = Gen_Lnk(&spec);
+    CHECK_EQ(Lnk_Parse(file.data(), (DWORD)file.size(), &lnk), S_OK);
+    memset(&properties, 0, sizeof(properties));
+    properties.options = LNK_PROP_TARGET;
+    CHECK_EQ(Lnk_ChangedProperties(&lnk, &properties), LNK_PROP_TARGET);
+}
+
+static void TestEnvironmentStrings(void)
+{
+    PROP_TEXT text;
+    PropText_Init(&text);
+
+    // %ProgramFiles% style targets and icons are kept in their own blocks,
+    // which this reader doesn't expand: those always get written.
+    std::vector<BYTE> file = Fixture(&text, TRUE, FALSE, LNK_HAS_EXP_STRING);
+    CHECK_EQ(Changed(file, &text, ALL_PROPS), LNK_PROP_TARGET);
+    file = Fixture(&text, TRUE, FALSE, LNK_HAS_EXP_ICON);
+    CHECK_EQ(Changed(file, &text, ALL_PROPS), LNK_PROP_ICON);
+    file = Fixture(&text, TRUE, FALSE, LNK_HAS_EXP_STRING | LNK_HAS_EXP_ICON);
+    CHECK_EQ(Changed(file, &text, ALL_PROPS & ~(LNK_PROP_TARGET | LNK_PROP_ICON)), 0);
+}
+
+static void TestCodePage(void)
+{
+    PROP_TEXT text;
+    PropText_Init(&text);
+    text.target = W("C:\\Program Files\\Vendor\\Caf\xE9\\app.exe");
+    text.workingDir = W("C:\\Program Files\\Vendor\\Caf\xE9");
+    text.arguments = W("--name \"Caf\xE9\"");
+    text.description = W("Caf\xE9 App");
+    text.icon = W("C:\\Program Files\\Vendor\\Caf\xE9\\app.ico");
+
+    // In Unicode the same non-ASCII values match.
+    CHECK_EQ(Changed(Fixture(&text, TRUE, FALSE, 0), &text, ALL_PROPS), 0);
+
+    // In the code page they can't be told from another code page's text.
+    CHECK_EQ(Changed(Fixture(&text, FALSE, FALSE, 0), &text, ALL_PROPS), LNK_PROP_TARGET);
+    CHECK_EQ(Changed(Fixture(&text, TRUE, TRUE, 0), &text, ALL_PROPS),
+        LNK_PROP_WORKING_DIR | LNK_PROP_ARGUMENTS | LNK_PROP_DESCRIPTION | LNK_PROP_ICON);
+
+    // Code-page strings that are plain ASCII still match.
+    PropText_Init(&text);
+    CHECK_EQ(Changed(Fixture(&text, FALSE, TRUE, 0), &text, ALL_PROPS), 0);
+}
+
+static void TestUnknownOptions(void)
+{
+    PROP_TEXT text;
+    PropText_Init(&text);
+    std::vector<BYTE> file = Fixture(&text, TRUE, FALSE, 0);
+
+    CHECK_EQ(Changed(file, &text, 0x0100), 0x0100);
+    CHECK_EQ(Changed(file, &text, ALL_PROPS | 0x80000000), 0x80000000);
+}
+
+int main()
+{
+    TestExactMatch();
+    TestCase();
+    TestAbsent();
+    TestEnvironmentStrings();
+    TestCodePage();
+    TestUnknownOptions();
+    return Check_Result();
+}
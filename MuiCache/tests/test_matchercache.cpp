@@ -0,0 +1,220 @@
+// MatcherCache hits, misses and LRU eviction, and the order independence
+// of Matcher_Hash that fingerprints rely on.
+#include "check.h"
+#include "fakes.h"
+#include "matchercache.h"
+
+#include <algorithm>
+#include <string.h>
+
+static std::vector<WSTR> Names(const char* format, DWORD count)
+{
+    std::vector<WSTR> names;
+    char name[64];
+    for (DWORD i = 0; i < count; ++i)
+    {
+        snprintf(name, sizeof(name), format, i);
+        names.push_back(W(name));
+    }
+    return names;
+}
+
+static std::vector<const WCHAR*> Pointers(const std::vector<WSTR>& names)
+{
+    std::vector<const WCHAR*> pointers;
+    for (const WSTR& n : names)
+        pointers.push_back(n.c_str());
+    return pointers;
+}
+
+// One pattern list per call, released at once.
+static MATCHER* AcquireOne(MATCHER_CACHE* cache, const WSTR& pattern, DWORD flags)
+{
+    const WCHAR* patterns[] = { pattern.c_str() };
+    MATCHER* matcher = MatcherCache_Acquire(cache, patterns, 1, flags);
+    MatcherCache_Release(cache, matcher);
+    return matcher;
+}
+
+static void TestHitsAndMisses(void)
+{
+    MATCHER_CACHE cache;
+    std::vector<WSTR> a = Names("app%u.exe", 3), copy = a, reordered = a, other = Names("app%u.ex", 3);
+    std::vector<const WCHAR*> pa = Pointers(a), pcopy = Pointers(copy), pother = Pointers(other);
+    MATCHER* first;
+    MATCHER* m;
+
+    memset(&cache, 0, sizeof(cache));
+    first = MatcherCache_Acquire(&cache, pa.data(), 3, MATCHER_IGNORE_CASE);
+    CHECK(first != NULL);
+    CHECK_EQ(cache.misses, 1);
+
+    // Same text from other buffers: the cached matcher, still acquired once.
+    m = MatcherCache_Acquire(&cache, pcopy.data(), 3, MATCHER_IGNORE_CASE);
+    CHECK(m == first);
+    CHECK_EQ(cache.hits, 1);
+    MatcherCache_Release(&cache, m);
+    MatcherCache_Release(&cache, first);
+
+    // Anything else in the key misses.
+    CHECK(AcquireOne(&cache, a[0], MATCHER_IGNORE_CASE) != first);        // count
+    m = MatcherCache_Acquire(&cache, pa.data(), 3, 0);                      // flags
+    CHECK(m != first);
+    MatcherCache_Release(&cache, m);
+    m = MatcherCache_Acquire(&cache, pother.data(), 3, MATCHER_IGNORE_CASE); // text
+    CHECK(m != first);
+    CHECK(Matcher_Contains(m, W("C:\\app1.exq").c_str(), 11));
+    MatcherCache_Release(&cache, m);
+    // Reordering misses too: the key is kept in order, so the same set
+    // passed another way gets a matcher of its own (with the same hash).
+    std::swap(reordered[0], reordered[2]);
+    std::vector<const WCHAR*> preordered = Pointers(reordered);
+    m = MatcherCache_Acquire(&cache, preordered.data(), 3, MATCHER_IGNORE_CASE);
+    CHECK(m != first);
+    CHECK_EQ(Matcher_Hash(m), Matcher_Hash(first));
+    MatcherCache_Release(&cache, m);
+    CHECK_EQ(cache.hits, 1);
+    CHECK_EQ(cache.misses, 5);
+    CHECK_EQ(cache.evictions, 0);
+
+    // And everything is still there to hit.
+    CHECK(AcquireOne(&cache, a[0], MATCHER_IGNORE_CASE) != NULL);
+    m = MatcherCache_Acquire(&cache, pa.data(), 3, MATCHER_IGNORE_CASE);
+    CHECK(m == first);
+    MatcherCache_Release(&cache, m);
+    CHECK_EQ(cache.hits, 3);
+
+    MatcherCache_Free(&cache);
+    CHECK_EQ(cache.hits + cache.misses + cache.evictions, 0);
+    for (const MATCHER_CACHE_ENTRY& entry : cache.entries)
+        CHECK(entry.matcher == NULL);
+}
+
+static void TestEviction(void)
+{
+    MATCHER_CACHE cache;
+    std::vector<WSTR> p = Names("p%u.exe", MATCHER_CACHE_SIZE + 2);
+    MATCHER* m0;
+
+    memset(&cache, 0, sizeof(cache));
+    for (DWORD i = 0; i < MATCHER_CACHE_SIZE; ++i)
+        AcquireOne(&cache, p[i], 0);
+    CHECK_EQ(cache.misses, MATCHER_CACHE_SIZE);
+    CHECK_EQ(cache.evictions, 0);
+
+    // Touch p0 so p1 becomes the least recently used, then overflow.
+    m0 = AcquireOne(&cache, p[0], 0);
+    AcquireOne(&cache, p[MATCHER_CACHE_SIZE], 0);
+    CHECK_EQ(cache.evictions, 1);
+    CHECK(AcquireOne(&cache, p[0], 0) == m0);
+    CHECK_EQ(cache.hits, 2);
+    AcquireOne(&cache, p[1], 0);
+    CHECK_EQ(cache.hits, 2);
+    CHECK_EQ(cache.misses, MATCHER_CACHE_SIZE + 2);
+    CHECK_EQ(cache.evictions, 2); // p2 made room for p1
+    AcquireOne(&cache, p[3], 0);
+    CHECK_EQ(cache.hits, 3);
+
+    MatcherCache_Free(&cache);
+}
+
+// Acquired entries are never evicted; with all of them held a new list
+// is built uncached and destroyed on release.
+static void TestAllHeld(void)
+{
+    MATCHER_CACHE cache;
+    std::vector<WSTR> p = Names("held%u.exe", MATCHER_CACHE_SIZE + 1);
+    std::vector<MATCHER*> held;
+    const WCHAR* extra[] = { p[MATCHER_CACHE_SIZE].c_str() };
+    MATCHER* m;
+
+    memset(&cache, 0, sizeof(cache));
+    for (DWORD i = 0; i < MATCHER_CACHE_SIZE; ++i)
+    {
+        const WCHAR* patterns[] = { p[i].c_str() };
+        held.push_back(MatcherCache_Acquire(&cache, patterns, 1, 0));
+    }
+    m = MatcherCache_Acquire(&cache, extra, 1, 0);
+    CHECK(m != NULL);
+    CHECK_EQ(cache.evictions, 0);
+    CHECK(Matcher_Contains(m, extra[0], Str_Length(extra[0])));
+    MatcherCache_Release(&cache, m);
+    for (const MATCHER_CACHE_ENTRY& entry : cache.entries)
+        CHECK(entry.matcher != m && entry.refs == 1);
+
+    // Released, the uncached list misses again and now takes a slot.
+    for (MATCHER* h : held)
+        MatcherCache_Release(&cache, h);
+    AcquireOne(&cache, p[MATCHER_CACHE_SIZE], 0);
+    CHECK_EQ(cache.misses, MATCHER_CACHE_SIZE + 2);
+    CHECK_EQ(cache.evictions, 1);
+    MatcherCache_Free(&cache);
+
+    // A NULL cache just builds.
+    m = MatcherCache_Acquire(NULL, extra, 1, 0);
+    CHECK(m != NULL);
+    MatcherCache_Release(NULL, m);
+}
+
+// Matcher_Hash sums one FNV-1a per pattern, so any order of the same
+// patterns agrees, and fingerprints taken by ClearChanged survive an
+// installer that builds its list in another order.
+static void TestHash(void)
+{
+    std::vector<WSTR> names = Names("C:\\Program Files\\app%u.exe", 5);
+    std::vector<DWORD> order;
+    DWORD reference, permutations = 0, bad = 0;
+    MATCHER* m;
+
+    for (DWORD i = 0; i < names.size(); ++i)
+        order.push_back(i);
+    {
+        std::vector<const WCHAR*> p = Pointers(names);
+        m = Matcher_CreateEx(p.data(), (DWORD)p.size(), MATCHER_IGNORE_CASE);
+        reference = Matcher_Hash(m);
+        Matcher_Destroy(m);
+    }
+    do
+    {
+        std::vector<const WCHAR*> p;
+        for (DWORD i : order)
+            p.push_back(names[i].c_str());
+        m = Matcher_CreateEx(p.data(), (DWORD)p.size(), MATCHER_IGNORE_CASE);
+        bad += Matcher_Hash(m) != reference;
+        Matcher_Destroy(m);
+        ++permutations;
+    } while (std::next_permutation(order.begin(), order.end()));
+    CHECK_EQ(permutations, 120);
+    CHECK_EQ(bad, 0);
+
+    // Scan mode (up to four patterns) and the automaton hash the same way.
+    WSTR a = W("app.exe"), b = W("B.EXE"), upper = W("APP.exe"), empty;
+    const WCHAR* ab[] = { a.c_str(), b.c_str() };
+    const WCHAR* ba[] = { b.c_str(), a.c_str() };
+    const WCHAR* upperB[] = { upper.c_str(), b.c_str() };
+    const WCHAR* withEmpty[] = { empty.c_str(), a.c_str(), empty.c_str(), b.c_str() };
+    const WCHAR* justA[] = { a.c_str() };
+    auto hash = [](const WCHAR** patterns, DWORD count, DWORD flags) {
+        MATCHER* matcher = Matcher_CreateEx(patterns, count, flags);
+        DWORD h = Matcher_Hash(matcher);
+        Matcher_Destroy(matcher);
+        return h;
+    };
+    CHECK_EQ(hash(ab, 2, 0), hash(ba, 2, 0));
+    CHECK_EQ(hash(ab, 2, 0), hash(withEmpty, 4, 0));
+    CHECK(hash(ab, 2, 0) != hash(justA, 1, 0));
+    CHECK(hash(ab, 2, 0) != hash(ab, 2, MATCHER_IGNORE_CASE));
+    CHECK(hash(ab, 2, MATCHER_IGNORE_CASE) != hash(ab, 2, MATCHER_IGNORE_CASE | MATCHER_PATH_SUFFIX));
+    // Case only counts when matching does.
+    CHECK_EQ(hash(ab, 2, MATCHER_IGNORE_CASE), hash(upperB, 2, MATCHER_IGNORE_CASE));
+    CHECK(hash(ab, 2, 0) != hash(upperB, 2, 0));
+}
+
+int main()
+{
+    TestHitsAndMisses();
+    TestEviction();
+    TestAllHeld();
+    TestHash();
+    return Check_Result();
+}
@@ -0,0 +1,226 @@
+// MultiSz walks and PURGE_MATCH_DATA over the UFH\SHC-shaped values of
+// data/shc.reg: empty strings in the middle, no double NUL, odd cbData,
+// non-string types. The data directory is the first argument.
+#include "check.h"
+#include "fakes.h"
+#include "multisz.h"
+#include "purge.h"
+#include "regdump.h"
+#include "simdscan.h"
+
+#include <string>
+
+static const char* const kMatching[] = { "0", "2", "3", "4", "8", "10", "12" };
+
+// The split the walk must produce: whole chars only, on NUL, no empties.
+static std::vector<WSTR> Reference(const std::vector<BYTE>& data)
+{
+    std::vector<WSTR> strings;
+    WSTR current;
+    for (size_t i = 0; i + 1 < data.size(); i += 2)
+    {
+        WCHAR ch = (WCHAR)(data[i] | data[i + 1] << 8);
+        if (ch)
+            current.push_back(ch);
+        else if (!current.empty())
+        {
+            strings.push_back(current);
+            current.clear();
+        }
+    }
+    if (!current.empty())
+        strings.push_back(current);
+    return strings;
+}
+
+static std::vector<WSTR> Walk(const std::vector<BYTE>& data)
+{
+    std::vector<WSTR> strings;
+    std::vector<WCHAR> aligned(data.size() / 2 + 1);
+    const WCHAR* str;
+    DWORD cch;
+    MULTI_SZ ms;
+
+    // Registry data arrives WCHAR-aligned; the vector's may not be.
+    if (!data.empty())
+        memcpy(aligned.data(), data.data(), data.size());
+    MultiSz_Init(&ms, (const BYTE*)aligned.data(), (DWORD)data.size());
+    while (MultiSz_Next(&ms, &str, &cch))
+        strings.push_back(WSTR(str, cch));
+    return strings;
+}
+
+static BOOL IsMatching(const WSTR& name)
+{
+    for (const char* m : kMatching)
+    {
+        if (name == W(m))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void TestDump(const std::vector<REG_DUMP_VALUE>& values, MATCHER* matcher)
+{
+    CHECK_EQ(values.size(), 15);
+    for (const REG_DUMP_VALUE& v : values)
+    {
+        std::vector<WCHAR> aligned(v.data.size() / 2 + 1);
+        if (!v.data.empty())
+            memcpy(aligned.data(), v.data.data(), v.data.size());
+        if (Walk(v.data) != Reference(v.data))
+        {
+            fprintf(stderr, "walk of value %s\n", N(v.name).c_str());
+            ++g_checkFailures;
+        }
+        if (MultiSz_Contains(matcher, v.type, (const BYTE*)aligned.data(), (DWORD)v.data.size()) != IsMatching(v.name))
+        {
+            fprintf(stderr, "match of value %s\n", N(v.name).c_str());
+            ++g_checkFailures;
+        }
+    }
+
+    // Spot checks on the odd shapes, beyond agreeing with Reference.
+    for (const REG_DUMP_VALUE& v : values)
+    {
+        std::vector<WSTR> strings = Walk(v.data);
+        if (v.name == W("2"))
+        {
+            CHECK_EQ(strings.size(), 1);
+        }
+        else if (v.name == W("3"))
+        {
+            CHECK(strings.size() == 2 && N(strings[1]) == "C:\\Program Files\\Vendor\\App\\app.exe");
+        }
+        else if (v.name == W("4"))
+        {
+            CHECK_EQ(v.data.size() % 2, 1);
+            CHECK_EQ(strings.size(), 2);
+        }
+        else if (v.name == W("5"))
+        {
+            CHECK_EQ(v.data.size() % 2, 1);
+            CHECK(strings.size() == 2 && N(strings[1]) == "C:\\Program Files\\Vendor\\App\\app.ex");
+        }
+        else if (v.name == W("6") || v.name == W("7"))
+        {
+            CHECK(strings.empty());
+        }
+    }
+}
+
+// Wraps a key and reports maximum sizes far too small, like a key written
+// to between QueryInfo and the enumeration: the purge must grow its
+// buffers instead of skipping or truncating values.
+typedef struct _SHRINKING_KEY {
+    REGKEY base;
+    REGKEY* inner;
+} SHRINKING_KEY;
+
+static LSTATUS Shrinking_QueryInfo(REGKEY* key, DWORD* cValues, DWORD* cchMaxValue, DWORD* cbMaxValueData, FILETIME* ft)
+{
+    REGKEY* inner = ((SHRINKING_KEY*)key)->inner;
+    LSTATUS status = inner->vtbl->QueryInfo(inner, cValues, cchMaxValue, cbMaxValueData, ft);
+    if (cchMaxValue)
+        *cchMaxValue = 1;
+    if (cbMaxValueData)
+        *cbMaxValueData = 3;
+    return status;
+}
+
+static LSTATUS Shrinking_EnumValue(REGKEY* key, DWORD index, WCHAR* name, DWORD* cchName, DWORD* type, BYTE* data, DWORD* cbData)
+{
+    REGKEY* inner = ((SHRINKING_KEY*)key)->inner;
+    return inner->vtbl->EnumValue(inner, index, name, cchName, type, data, cbData);
+}
+
+static LSTATUS Shrinking_DeleteValue(REGKEY* key, const WCHAR* name)
+{
+    REGKEY* inner = ((SHRINKING_KEY*)key)->inner;
+    return inner->vtbl->DeleteValue(inner, name);
+}
+
+static void Shrinking_Close(REGKEY* key)
+{
+    (void)key;
+}
+
+static const REGKEY_VTBL kShrinkingKeyVtbl = {
+    Shrinking_QueryInfo, Shrinking_EnumValue, Shrinking_DeleteValue, Shrinking_Close, NULL, NULL,
+};
+
+static void TestPurge(const std::vector<REG_DUMP_VALUE>& values, MATCHER* matcher)
+{
+    std::vector<WSTR> expected;
+    for (const REG_DUMP_VALUE& v : values)
+    {
+        if (!IsMatching(v.name))
+            expected.push_back(v.name);
+    }
+
+    for (DWORD mode = 0; mode < 4; ++mode)
+    {
+        SHRINKING_KEY shrinking;
+        REGKEY* key;
+        DWORD deleted = 0;
+
+        RegKey_CreateMemory(&key);
+        RegDump_Fill(key, values, NULL);
+        shrinking.base.vtbl = &kShrinkingKeyVtbl;
+        shrinking.inner = key;
+        CHECK_EQ(Purge_ValueNames(mode & 2 ? &shrinking.base : key, matcher,
+            PURGE_MATCH_DATA | (mode & 1 ? PURGE_IN_PLACE : 0), &deleted), ERROR_SUCCESS);
+        CHECK_EQ(deleted, sizeof(kMatching) / sizeof(kMatching[0]));
+        CHECK(Key_ValueNames(key) == expected);
+        key->vtbl->Close(key);
+    }
+}
+
+static void TestRandom(void)
+{
+    DWORD bad = 0;
+    GEN_RNG rng;
+
+    Gen_Seed(&rng, 13);
+    for (DWORD iteration = 0; iteration < 50000; ++iteration)
+    {
+        std::vector<BYTE> data;
+        DWORD cch = Gen_Below(&rng, 90);
+        for (DWORD i = 0; i < cch; ++i)
+        {
+            WCHAR ch = Gen_Below(&rng, 5) == 0 ? 0 : (WCHAR)('a' + Gen_Below(&rng, 3));
+            data.push_back((BYTE)ch);
+            data.push_back(0);
+        }
+        if (Gen_Below(&rng, 2))
+            data.push_back('z');
+        if (Walk(data) != Reference(data))
+            ++bad;
+    }
+    CHECK_EQ(bad, 0);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<REG_DUMP_VALUE> values;
+    std::string path = std::string(argc > 1 ? argv[1] : "tests/data") + "/shc.reg";
+    WSTR pattern = W("App.exe");
+    const WCHAR* patterns[] = { pattern.c_str() };
+    MATCHER* matcher = Matcher_CreateEx(patterns, 1, MATCHER_IGNORE_CASE);
+    DWORD best = SimdScan_Level(), error;
+
+    if (!RegDump_Load(path.c_str(), &values, &error))
+    {
+        fprintf(stderr, "%s: can't read (line %u)\n", path.c_str(), error);
+        return 1;
+    }
+    for (DWORD level = 0; level <= best; ++level)
+    {
+        SimdScan_Limit(level);
+        TestDump(values, matcher);
+        TestRandom();
+    }
+    TestPurge(values, matcher);
+    Matcher_Destroy(matcher);
+    return Check_Result();
+}
@@ -0,0 +1,128 @@
+// OsVersion_Set feature flags and OsVersion_SelectPinMethod on injected
+// versions: the shell verb before Windows 10 RTM, IPinnedList3 from build
+// 10240 on, Windows 11 (build 22000+) included; and the cached result that
+// OsVersion_Get hands out after OsVersion_Inject, and again after the
+// injection is dropped and the probe (unknown on Linux) runs instead.
+#include "check.h"
+#include "osver.h"
+#include "thread.h"
+
+#include <string.h>
+
+static PIN_METHOD MethodFor(DWORD major, DWORD minor, DWORD build)
+{
+    OS_VERSION version;
+    OsVersion_Set(&version, major, minor, build);
+    return OsVersion_SelectPinMethod(&version);
+}
+
+static DWORD FeaturesFor(DWORD major, DWORD minor, DWORD build)
+{
+    OS_VERSION version;
+    OsVersion_Set(&version, major, minor, build);
+    return version.features;
+}
+
+static void TestBeforeWindows10(void)
+{
+    // Vista has neither; 7, 8 and 8.1 pin through the verb.
+    CHECK_EQ(FeaturesFor(6, 0, 6002), 0);
+    CHECK_EQ(MethodFor(6, 0, 6002), PIN_METHOD_VERB);
+    CHECK_EQ(FeaturesFor(6, 1, 7601), OS_FEATURE_PIN_VERB);
+    CHECK_EQ(MethodFor(6, 1, 7601), PIN_METHOD_VERB);
+    CHECK_EQ(MethodFor(6, 2, 9200), PIN_METHOD_VERB);
+    CHECK_EQ(FeaturesFor(6, 3, 9600), OS_FEATURE_PIN_VERB);
+    CHECK_EQ(MethodFor(6, 3, 9600), PIN_METHOD_VERB);
+
+    // A high build number alone is not Windows 10.
+    CHECK_EQ(MethodFor(6, 3, 10240), PIN_METHOD_VERB);
+    CHECK_EQ(MethodFor(6, 3, 22000), PIN_METHOD_VERB);
+
+    // Unknown: the verb, as older releases did.
+    OS_VERSION unknown;
+    memset(&unknown, 0, sizeof(unknown));
+    CHECK_EQ(MethodFor(0, 0, 0), PIN_METHOD_VERB);
+    CHECK_EQ(OsVersion_SelectPinMethod(&unknown), PIN_METHOD_VERB);
+}
+
+static void TestWindows10(void)
+{
+    // Technical previews reported 10.0 before RTM.
+    CHECK_EQ(FeaturesFor(10, 0, 9926), OS_FEATURE_PIN_VERB);
+    CHECK_EQ(MethodFor(10, 0, 10239), PIN_METHOD_VERB);
+    CHECK_EQ(FeaturesFor(10, 0, 10240), OS_FEATURE_PIN_VERB | OS_FEATURE_PINNED_LIST3);
+    CHECK_EQ(MethodFor(10, 0, 10240), PIN_METHOD_PINNED_LIST);
+    CHECK_EQ(MethodFor(10, 0, 19045), PIN_METHOD_PINNED_LIST);
+}
+
+static void TestWindows11(void)
+{
+    // Windows 11 still reports 10.0; the taskband keeps IPinnedList3 on
+    // both sides of its first build.
+    CHECK_EQ(MethodFor(10, 0, 21999), PIN_METHOD_PINNED_LIST);
+    CHECK_EQ(FeaturesFor(10, 0, 22000), OS_FEATURE_PIN_VERB | OS_FEATURE_PINNED_LIST3);
+    CHECK_EQ(MethodFor(10, 0, 22000), PIN_METHOD_PINNED_LIST);
+    CHECK_EQ(MethodFor(10, 0, 26100), PIN_METHOD_PINNED_LIST);
+}
+
+static DWORD WINAPI GetOnThread(void* arg)
+{
+    *(const OS_VERSION**)arg = OsVersion_Get();
+    return 0;
+}
+
+static void TestCache(void)
+{
+    OS_VERSION win7, win11;
+    const OS_VERSION* cached;
+
+    OsVersion_Set(&win7, 6, 1, 7601);
+    OsVersion_Set(&win11, 10, 0, 22631);
+
+    // Injected, the result is served as is, every call the same copy.
+    OsVersion_Inject(&win11);
+    cached = OsVersion_Get();
+    CHECK(!memcmp(cached, &win11, sizeof(OS_VERSION)));
+    CHECK_EQ(OsVersion_SelectPinMethod(cached), PIN_METHOD_PINNED_LIST);
+    CHECK(OsVersion_Get() == cached);
+
+    // Other threads read the same cache.
+    const OS_VERSION* seen[4];
+    THREAD threads[4];
+    for (DWORD i = 0; i < 4; ++i)
+        threads[i] = Thread_Start(GetOnThread, &seen[i]);
+    for (DWORD i = 0; i < 4; ++i)
+    {
+        Thread_Join(threads[i]);
+        CHECK(seen[i] == cached);
+    }
+    CHECK_EQ(cached->build, 22631);
+
+    // Injecting again over a cached result replaces it.
+    OsVersion_Inject(&win7);
+    CHECK(OsVersion_Get() == cached);
+    CHECK(!memcmp(OsVersion_Get(), &win7, sizeof(OS_VERSION)));
+    CHECK_EQ(OsVersion_SelectPinMethod(OsVersion_Get()), PIN_METHOD_VERB);
+
+    // Dropped, the next call probes; there is no probe off Windows, so the
+    // version is unknown and pins go through the verb.
+    OsVersion_Inject(NULL);
+    CHECK_EQ(OsVersion_Get()->major, 0);
+    CHECK_EQ(OsVersion_Get()->features, 0);
+    CHECK_EQ(OsVersion_SelectPinMethod(OsVersion_Get()), PIN_METHOD_VERB);
+
+    // A later injection takes over from the probed result.
+    OsVersion_Inject(&win11);
+    CHECK_EQ(OsVersion_Get()->build, 22631);
+    CHECK_EQ(OsVersion_SelectPinMethod(OsVersion_Get()), PIN_METHOD_PINNED_LIST);
+    OsVersion_Inject(NULL);
+}
+
+int main()
+{
+    TestBeforeWindows10();
+    TestWindows10();
+    TestWindows11();
+    TestCache();
+    return Check_Result();
+}
@@ -0,0 +1,151 @@
+// PinSession over kFakePinSessionOps: a whole list of pins and unpins goes
+// through one taskband object, opened and closed once; each path gets its
+// own status; a disconnect reconnects once and retries that path only; a
+// failed Open fails every path without touching the object.
+#include "check.h"
+#include "fakes.h"
+#include "pinsession.h"
+
+#include <string>
+
+typedef struct _MOD_LIST {
+    std::vector<WSTR> paths;
+    std::vector<PIN_MODIFICATION> mods;
+} MOD_LIST;
+
+// |count| shortcuts, the odd ones unpinned; every fifth starts with
+// |failFirst| instead of 'C', for the fake's failPrefix.
+static void ModList_Init(MOD_LIST* list, DWORD count, char failFirst)
+{
+    list->paths.clear();
+    list->mods.clear();
+    for (DWORD i = 0; i < count; ++i)
+    {
+        char first = failFirst && i % 5 == 4 ? failFirst : 'C';
+        list->paths.push_back(W((std::string(1, first) + ":\\Pins\\app" + std::to_string(i) + ".lnk").c_str()));
+    }
+    for (DWORD i = 0; i < count; ++i)
+    {
+        PIN_MODIFICATION mod = { list->paths[i].c_str(), i % 2 == 0 };
+        list->mods.push_back(mod);
+    }
+}
+
+static void TestOneObject(void)
+{
+    FAKE_PIN_CONTEXT context;
+    PIN_SESSION session;
+    MOD_LIST list;
+    std::vector<HRESULT> results(30);
+
+    FakePinContext_Init(&context);
+    context.failPrefix = 'X';
+    ModList_Init(&list, 30, 'X');
+    CHECK_EQ(PinSession_Open(&session, &kFakePinSessionOps, &context), S_OK);
+    CHECK_EQ(PinSession_Apply(&session, list.mods.data(), 30, results.data()), 24);
+    PinSession_Close(&session);
+
+    CHECK_EQ(context.opens, 1);
+    CHECK_EQ(context.modifies, 30);
+    CHECK_EQ(context.reconnects, 0);
+    CHECK_EQ(context.closes, 1);
+    for (DWORD i = 0; i < 30; ++i)
+        CHECK_EQ(results[i], i % 5 == 4 ? E_FAIL : i % 2 == 0 ? S_OK : S_FALSE);
+
+    // Closing twice releases once.
+    PinSession_Close(&session);
+    CHECK_EQ(context.closes, 1);
+}
+
+static void TestDisconnect(void)
+{
+    FAKE_PIN_CONTEXT context;
+    PIN_SESSION session;
+    MOD_LIST list;
+    std::vector<HRESULT> results(10);
+
+    // Explorer restarts at the fourth path: one reconnect, that path is
+    // retried on the new object, and the rest carry on there.
+    FakePinContext_Init(&context);
+    context.disconnectAt = 3;
+    ModList_Init(&list, 10, 0);
+    PinSession_Open(&session, &kFakePinSessionOps, &context);
+    CHECK_EQ(PinSession_Apply(&session, list.mods.data(), 10, results.data()), 10);
+    PinSession_Close(&session);
+    CHECK_EQ(context.opens, 1);
+    CHECK_EQ(context.reconnects, 1);
+    CHECK_EQ(context.modifies, 11);
+    CHECK_EQ(context.closes, 1);
+    CHECK_EQ(results[3], S_FALSE);
+
+    // The reconnect fails: only that path carries the disconnect.
+    FakePinContext_Init(&context);
+    context.disconnectAt = 3;
+    context.failReconnect = TRUE;
+    PinSession_Open(&session, &kFakePinSessionOps, &context);
+    CHECK_EQ(PinSession_Apply(&session, list.mods.data(), 10, results.data()), 9);
+    PinSession_Close(&session);
+    CHECK_EQ(context.reconnects, 1);
+    CHECK_EQ(context.modifies, 10);
+    CHECK_EQ(results[3], PIN_E_DISCONNECTED);
+    CHECK_EQ(results[4], S_OK);
+}
+
+static void TestOpenFails(void)
+{
+    FAKE_PIN_CONTEXT context;
+    PIN_SESSION session;
+    MOD_LIST list;
+    std::vector<HRESULT> results(6);
+
+    FakePinContext_Init(&context);
+    context.openResult = E_OUTOFMEMORY;
+    ModList_Init(&list, 6, 0);
+    CHECK_EQ(PinSession_Open(&session, &kFakePinSessionOps, &context), E_OUTOFMEMORY);
+    CHECK_EQ(PinSession_Apply(&session, list.mods.data(), 6, results.data()), 0);
+    PinSession_Close(&session);
+    CHECK_EQ(context.opens, 1);
+    CHECK_EQ(context.modifies, 0);
+    CHECK_EQ(context.reconnects, 0);
+    CHECK_EQ(context.closes, 0);
+    for (DWORD i = 0; i < 6; ++i)
+        CHECK_EQ(results[i], E_OUTOFMEMORY);
+}
+
+static void TestSessions(void)
+{
+    FAKE_PIN_CONTEXT context;
+    MOD_LIST list;
+    std::vector<HRESULT> results(4);
+
+    // One object per session, however many sessions run.
+    FakePinContext_Init(&context);
+    ModList_Init(&list, 4, 0);
+    for (DWORD i = 0; i < 5; ++i)
+    {
+        PIN_SESSION session;
+        PinSession_Open(&session, &kFakePinSessionOps, &context);
+        PinSession_Apply(&session, list.mods.data(), 4, results.data());
+        PinSession_Close(&session);
+    }
+    CHECK_EQ(context.opens, 5);
+    CHECK_EQ(context.closes, 5);
+    CHECK_EQ(context.modifies, 20);
+
+    // An empty list still opens and closes the one object.
+    PIN_SESSION session;
+    PinSession_Open(&session, &kFakePinSessionOps, &context);
+    CHECK_EQ(PinSession_Apply(&session, NULL, 0, NULL), 0);
+    PinSession_Close(&session);
+    CHECK_EQ(context.opens, 6);
+    CHECK_EQ(context.modifies, 20);
+}
+
+int main()
+{
+    TestOneObject();
+    TestDisconnect();
+    TestOpenFails();
+    TestSessions();
+    return Check_Result();
+}
@@ -0,0 +1,289 @@
+// Profiles_Purge over memory keys: a HIVE_SOURCE whose "hives" are memory
+// root keys, purged at Profile_MuiCachePath like Purge_HiveFile would,
+// some missing, in use or failing. Per-hive results, totals and survivors
+// must not depend on the worker count. Also ProfileDirSource's discovery
+// of hive paths through a FAKE_DIR_LISTER.
+#include "check.h"
+#include "fakes.h"
+#include "profiles.h"
+#include "purge.h"
+
+#include <string.h>
+
+typedef struct _MEMORY_HIVE {
+    WSTR path;
+    PROFILE_HIVE kind;
+    REGKEY* root;   // NULL: no such file
+    LSTATUS status; // returned instead of purging, when not ERROR_SUCCESS
+} MEMORY_HIVE;
+
+typedef struct _MEMORY_HIVE_SOURCE {
+    HIVE_SOURCE base;
+    std::vector<MEMORY_HIVE> hives;
+    volatile LONG purges;
+} MEMORY_HIVE_SOURCE;
+
+static LSTATUS MemoryHives_Discover(HIVE_SOURCE* base, HIVE_FOUND_CALLBACK callback, void* context)
+{
+    MEMORY_HIVE_SOURCE* source = (MEMORY_HIVE_SOURCE*)base;
+
+    for (const MEMORY_HIVE& hive : source->hives)
+    {
+        if (!callback(context, hive.path.c_str(), hive.kind))
+            break;
+    }
+    return ERROR_SUCCESS;
+}
+
+static LSTATUS MemoryHives_Purge(HIVE_SOURCE* base, const WCHAR* hivePath, PROFILE_HIVE kind, const MATCHER* matcher,
+    DWORD* deleted)
+{
+    MEMORY_HIVE_SOURCE* source = (MEMORY_HIVE_SOURCE*)base;
+    REGKEY* key;
+    LSTATUS status;
+
+    Atomic_Increment(&source->purges);
+    for (const MEMORY_HIVE& hive : source->hives)
+    {
+        if (hive.path != hivePath)
+            continue;
+        CHECK_EQ(hive.kind, kind);
+        if (hive.status != ERROR_SUCCESS)
+            return hive.status;
+        if (!hive.root)
+            return ERROR_FILE_NOT_FOUND;
+        status = hive.root->vtbl->OpenSubKey(hive.root, Profile_MuiCachePath(kind), &key);
+        if (status != ERROR_SUCCESS)
+            return status;
+        status = Purge_ValueNames(key, matcher, PURGE_IN_PLACE, deleted);
+        key->vtbl->Close(key);
+        return status;
+    }
+    return ERROR_PATH_NOT_FOUND;
+}
+
+static const HIVE_SOURCE_VTBL kMemoryHivesVtbl = {
+    MemoryHives_Discover,
+    MemoryHives_Purge,
+};
+
+// A UsrClass.dat or NTUSER.DAT of user |profile| holding
+// |count| names, a third of them for "app.exe".
+static void MemoryHives_Add(MEMORY_HIVE_SOURCE* source, DWORD profile, PROFILE_HIVE kind, DWORD count,
+    LSTATUS status, BOOL withKey)
+{
+    MEMORY_HIVE hive;
+    std::vector<WSTR> names;
+    REGKEY* key;
+    char text[80];
+
+    snprintf(text, sizeof(text), "C:\\Users\\user%u\\%s", profile, kind == PROFILE_HIVE_NTUSER ? "NTUSER.DAT"
+        : "UsrClass.dat");
+    hive.path = W(text);
+    hive.kind = kind;
+    hive.status = status;
+    RegKey_CreateMemory(&hive.root);
+    if (withKey)
+    {
+        for (DWORD i = 0; i < count; ++i)
+        {
+            snprintf(text, sizeof(text), i % 3 ? "C:\\Tools\\t%u.exe" : "C:\\Apps\\app.exe.%u", i);
+            names.push_back(W(text));
+        }
+        RegKey_MemoryCreateSubKey(hive.root, Profile_MuiCachePath(kind), &key);
+        Key_Fill(key, names);
+        key->vtbl->Close(key);
+    }
+    source->hives.push_back(hive);
+}
+
+static void MemoryHives_Free(MEMORY_HIVE_SOURCE* source)
+{
+    for (MEMORY_HIVE& hive : source->hives)
+        hive.root->vtbl->Close(hive.root);
+    source->hives.clear();
+}
+
+static DWORD Survivors(const MEMORY_HIVE& hive)
+{
+    REGKEY* key;
+    DWORD count;
+
+    if (hive.root->vtbl->OpenSubKey(hive.root, Profile_MuiCachePath(hive.kind), &key) != ERROR_SUCCESS)
+        return (DWORD)-1;
+    count = (DWORD)Key_ValueNames(key).size();
+    key->vtbl->Close(key);
+    return count;
+}
+
+static MATCHER* CreateMatcher(const char* pattern)
+{
+    WSTR p = W(pattern);
+    const WCHAR* pointer = p.c_str();
+    return Matcher_Create(&pointer, 1);
+}
+
+// 12 profiles of both hives: most purgeable, one without a MuiCache key,
+// one NTUSER.DAT missing, two in use, two failing otherwise.
+static void TestPurge(DWORD workers)
+{
+    MEMORY_HIVE_SOURCE source;
+    MATCHER* matcher = CreateMatcher("app.exe");
+    PROFILE_PURGE purge;
+    DWORD expectDeleted = 0;
+
+    source.base.vtbl = &kMemoryHivesVtbl;
+    source.purges = 0;
+    for (DWORD profile = 0; profile < 12; ++profile)
+    {
+        for (DWORD kind = 0; kind < PROFILE_HIVE_COUNT; ++kind)
+        {
+            DWORD count = 30 + profile * 3 + kind;
+            LSTATUS status = ERROR_SUCCESS;
+            BOOL withKey = TRUE;
+
+            if (profile == 3 && kind == PROFILE_HIVE_USRCLASS)
+                withKey = FALSE;
+            if (profile == 4 && kind == PROFILE_HIVE_NTUSER)
+                status = ERROR_FILE_NOT_FOUND;
+            if (profile == 5 || (profile == 9 && kind == PROFILE_HIVE_USRCLASS))
+                status = ERROR_SHARING_VIOLATION;
+            if (profile == 7 && kind == PROFILE_HIVE_NTUSER)
+                status = ERROR_ACCESS_DENIED;
+            if (profile == 10 && kind == PROFILE_HIVE_USRCLASS)
+                status = ERROR_INVALID_DATA;
+            if (withKey && status == ERROR_SUCCESS)
+                expectDeleted += (count + 2) / 3;
+            MemoryHives_Add(&source, profile, (PROFILE_HIVE)kind, count, status, withKey);
+        }
+    }
+
+    CHECK_EQ(Profiles_Purge(&source.base, matcher, workers, &purge), ERROR_SUCCESS);
+    CHECK_EQ(purge.hives.count, 24);
+    CHECK_EQ(source.purges, 24);
+    CHECK_EQ(purge.purged, 24 - 1 - 1 - 3 - 2);
+    CHECK_EQ(purge.busy, 3);
+    CHECK_EQ(purge.failed, 2);
+    // First in discovery order, whichever worker finished first.
+    CHECK_EQ(purge.firstError, ERROR_ACCESS_DENIED);
+    CHECK_EQ(purge.deleted, expectDeleted);
+    CHECK(purge.workers >= 1);
+    if (workers)
+        CHECK(purge.workers <= workers);
+
+    for (DWORD i = 0; i < purge.hives.count; ++i)
+    {
+        const MEMORY_HIVE& hive = source.hives[i];
+        const PROFILE_RESULT& result = purge.results[i];
+        DWORD count = 30 + (i / 2) * 3 + (i % 2);
+
+        CHECK(WSTR(StrList_Get(&purge.hives, i)) == hive.path);
+        CHECK_EQ(purge.kinds[i], hive.kind);
+        if (hive.status != ERROR_SUCCESS)
+        {
+            CHECK_EQ(result.status, hive.status);
+            CHECK_EQ(Survivors(hive), count);
+        }
+        else if (Survivors(hive) == (DWORD)-1)
+        {
+            CHECK_EQ(result.status, ERROR_FILE_NOT_FOUND);
+        }
+        else
+        {
+            CHECK_EQ(result.status, ERROR_SUCCESS);
+            CHECK_EQ(result.deleted, (count + 2) / 3);
+            CHECK_EQ(Survivors(hive), count - (count + 2) / 3);
+        }
+    }
+
+    Profiles_Free(&purge);
+    MemoryHives_Free(&source);
+    Matcher_Destroy(matcher);
+}
+
+static void TestNoHives(void)
+{
+    MEMORY_HIVE_SOURCE source;
+    MATCHER* matcher = CreateMatcher("app.exe");
+    PROFILE_PURGE purge;
+
+    source.base.vtbl = &kMemoryHivesVtbl;
+    source.purges = 0;
+    CHECK_EQ(Profiles_Purge(&source.base, matcher, 0, &purge), ERROR_SUCCESS);
+    CHECK_EQ(purge.hives.count, 0);
+    CHECK_EQ(purge.purged + purge.busy + purge.failed + purge.deleted, 0);
+    CHECK_EQ(source.purges, 0);
+    Profiles_Free(&purge);
+    Matcher_Destroy(matcher);
+}
+
+typedef struct _FOUND_HIVES {
+    std::vector<WSTR> paths;
+    std::vector<PROFILE_HIVE> kinds;
+    DWORD stopAfter;
+} FOUND_HIVES;
+
+static BOOL OnHive(void* context, const WCHAR* hivePath, PROFILE_HIVE kind)
+{
+    FOUND_HIVES* found = (FOUND_HIVES*)context;
+    found->paths.push_back(hivePath);
+    found->kinds.push_back(kind);
+    return found->paths.size() < found->stopAfter;
+}
+
+// Every subfolder of the profiles folder is a profile with both hives;
+// files next to them are not.
+static void TestProfileDirDiscovery(void)
+{
+    WSTR users = W("C:\\Users"), nowhere = W("D:\\Nowhere");
+    FAKE_DIR_LISTER lister;
+    PROFILE_DIR_SOURCE source;
+    FOUND_HIVES found;
+
+    FakeDirLister_Init(&lister);
+    FakeDirLister_Add(&lister, users, W("alice"), TRUE);
+    FakeDirLister_Add(&lister, users, W("desktop.ini"), FALSE);
+    FakeDirLister_Add(&lister, users, W("bob"), TRUE);
+    ProfileDirSource_Init(&source, &lister.base, users.c_str());
+
+    found.stopAfter = (DWORD)-1;
+    CHECK_EQ(source.base.vtbl->Discover(&source.base, OnHive, &found), ERROR_SUCCESS);
+    CHECK_EQ(found.paths.size(), 4);
+    if (found.paths.size() == 4)
+    {
+        WSTR alice = FakeDir_Join(users, W("alice")), bob = FakeDir_Join(users, W("bob"));
+        WSTR usrClass = W("AppData/Local/Microsoft/Windows/UsrClass.dat");
+        for (WCHAR& ch : usrClass)
+            ch = ch == '/' ? (WCHAR)PATH_SEPARATOR : ch;
+        CHECK(found.paths[0] == FakeDir_Join(alice, usrClass));
+        CHECK(found.paths[1] == FakeDir_Join(alice, W("NTUSER.DAT")));
+        CHECK(found.paths[2] == FakeDir_Join(bob, usrClass));
+        CHECK(found.paths[3] == FakeDir_Join(bob, W("NTUSER.DAT")));
+        CHECK(found.kinds[0] == PROFILE_HIVE_USRCLASS && found.kinds[1] == PROFILE_HIVE_NTUSER);
+        CHECK(found.kinds[2] == PROFILE_HIVE_USRCLASS && found.kinds[3] == PROFILE_HIVE_NTUSER);
+    }
+
+    // A callback returning FALSE ends the discovery there.
+    found.paths.clear();
+    found.kinds.clear();
+    found.stopAfter = 3;
+    source.base.vtbl->Discover(&source.base, OnHive, &found);
+    CHECK_EQ(found.paths.size(), 3);
+
+    // No profiles folder at all.
+    ProfileDirSource_Init(&source, &lister.base, nowhere.c_str());
+    found.paths.clear();
+    found.stopAfter = (DWORD)-1;
+    CHECK(source.base.vtbl->Discover(&source.base, OnHive, &found) != ERROR_SUCCESS);
+    CHECK(found.paths.empty());
+}
+
+int main()
+{
+    TestPurge(1);
+    TestPurge(4);
+    TestPurge(0);
+    TestNoHives();
+    TestProfileDirDiscovery();
+    return Check_Result();
+}
@@ -0,0 +1,129 @@
+// PropertyStage_Apply through the PROPERTY_WRITE_RECORDER: however many
+// values are staged they are set and then committed once; a set that fails
+// stops the stage before Commit; nothing staged means no calls at all.
+#include "check.h"
+#include "fakes.h"
+#include "propstage.h"
+
+#include <string.h>
+
+static const LNK_FMTID kClsid = { {
+    0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF
+} };
+
+// Stages the values named by the PROPERTY_STAGE_* bits in |staged|.
+static void Stage(PROPERTY_STAGE* stage, DWORD staged, const WCHAR* appId)
+{
+    PropertyStage_Init(stage);
+    if (staged & PROPERTY_STAGE_APP_ID)
+        PropertyStage_SetAppId(stage, appId);
+    if (staged & PROPERTY_STAGE_DUAL_MODE)
+        PropertyStage_SetDualMode(stage, TRUE);
+    if (staged & PROPERTY_STAGE_TOAST_ACTIVATOR_CLSID)
+        PropertyStage_SetToastActivatorClsid(stage, &kClsid);
+}
+
+static DWORD BitCount(DWORD bits)
+{
+    DWORD count = 0;
+    for (; bits; bits &= bits - 1)
+        ++count;
+    return count;
+}
+
+static void TestOneCommit(void)
+{
+    WSTR appId = W("Vendor.Suite.App");
+
+    for (DWORD staged = 1; staged < 8; ++staged)
+    {
+        PROPERTY_WRITE_RECORDER recorder;
+        PROPERTY_STAGE stage;
+        DWORD sets = BitCount(staged);
+
+        Stage(&stage, staged, appId.c_str());
+        CHECK_EQ(stage.staged, staged);
+        PropertyRecorder_Init(&recorder);
+        CHECK_EQ(PropertyStage_Apply(&stage, &recorder.base), S_OK);
+        CHECK_EQ(recorder.sets, sets);
+        CHECK_EQ(recorder.commits, 1);
+        // Commit came last, after every set.
+        CHECK_EQ(recorder.setsAtCommit, sets);
+        CHECK_EQ(recorder.calls, sets + 1);
+    }
+}
+
+static void TestFailedSet(void)
+{
+    WSTR appId = W("Vendor.App");
+    PROPERTY_STAGE stage;
+
+    Stage(&stage, PROPERTY_STAGE_APP_ID | PROPERTY_STAGE_DUAL_MODE | PROPERTY_STAGE_TOAST_ACTIVATOR_CLSID,
+        appId.c_str());
+    // Calls 1 to 3 are the sets, 4 the Commit.
+    for (DWORD failAt = 1; failAt <= 4; ++failAt)
+    {
+        PROPERTY_WRITE_RECORDER recorder;
+
+        PropertyRecorder_Init(&recorder);
+        recorder.failAt = failAt;
+        CHECK_EQ(PropertyStage_Apply(&stage, &recorder.base), E_FAIL);
+        CHECK_EQ(recorder.calls, failAt);
+        CHECK_EQ(recorder.sets, failAt - 1);
+        CHECK_EQ(recorder.commits, 0);
+    }
+
+    // A failure past the last call changes nothing.
+    PROPERTY_WRITE_RECORDER recorder;
+    PropertyRecorder_Init(&recorder);
+    recorder.failAt = 5;
+    CHECK_EQ(PropertyStage_Apply(&stage, &recorder.base), S_OK);
+    CHECK_EQ(recorder.commits, 1);
+}
+
+static void TestNothingStaged(void)
+{
+    PROPERTY_WRITE_RECORDER recorder;
+    PROPERTY_STAGE stage;
+
+    PropertyStage_Init(&stage);
+    PropertyRecorder_Init(&recorder);
+    recorder.failAt = 1;
+    CHECK_EQ(PropertyStage_Apply(&stage, &recorder.base), S_FALSE);
+    CHECK_EQ(recorder.calls, 0);
+    CHECK_EQ(recorder.commits, 0);
+}
+
+static void TestStagedValues(void)
+{
+    WSTR first = W("First.App"), second = W("Second.App");
+    PROPERTY_STAGE stage;
+
+    // Staging again replaces the value, not adds a set.
+    PropertyStage_Init(&stage);
+    PropertyStage_SetAppId(&stage, first.c_str());
+    PropertyStage_SetAppId(&stage, second.c_str());
+    PropertyStage_SetDualMode(&stage, TRUE);
+    PropertyStage_SetDualMode(&stage, FALSE);
+    CHECK(stage.appId == second.c_str());
+    CHECK(!stage.dualMode);
+    CHECK_EQ(stage.staged, PROPERTY_STAGE_APP_ID | PROPERTY_STAGE_DUAL_MODE);
+
+    PropertyStage_SetToastActivatorClsid(&stage, &kClsid);
+    CHECK(!memcmp(stage.toastActivatorClsid.bytes, kClsid.bytes, 16));
+
+    PROPERTY_WRITE_RECORDER recorder;
+    PropertyRecorder_Init(&recorder);
+    CHECK_EQ(PropertyStage_Apply(&stage, &recorder.base), S_OK);
+    CHECK_EQ(recorder.sets, 3);
+    CHECK_EQ(recorder.commits, 1);
+}
+
+int main()
+{
+    TestOneCommit();
+    TestFailedSet();
+    TestNothingStaged();
+    TestStagedValues();
+    return Check_Result();
+}
@@ -0,0 +1,171 @@
+// Purge_ValueNames on memory keys: the snapshot and in-place loops must
+// leave the same values behind, in their original order.
+#include "check.h"
+#include "fakes.h"
+#include "purge.h"
+
+#include <algorithm>
+#include <string.h>
+
+static WCHAR Fold(WCHAR ch)
+{
+    return ch >= 'A' && ch <= 'Z' ? (WCHAR)(ch + 'a' - 'A') : ch;
+}
+
+static WSTR Fold(const WSTR& s)
+{
+    WSTR folded(s);
+    for (WCHAR& ch : folded)
+        ch = Fold(ch);
+    return folded;
+}
+
+// What the matcher is meant to compute, the slow way.
+static BOOL ContainsAny(const WSTR& text, const std::vector<WSTR>& patterns, BOOL ignoreCase)
+{
+    for (const WSTR& p : patterns)
+    {
+        for (size_t start = 0; start + p.size() <= text.size(); ++start)
+        {
+            size_t i = 0;
+            while (i < p.size() && (ignoreCase ? Fold(text[start + i]) == Fold(p[i]) : text[start + i] == p[i]))
+                ++i;
+            if (i == p.size())
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static MATCHER* CreateMatcher(const std::vector<WSTR>& patterns, DWORD flags)
+{
+    std::vector<const WCHAR*> pointers;
+    for (const WSTR& p : patterns)
+        pointers.push_back(p.c_str());
+    return Matcher_CreateEx(pointers.data(), (DWORD)pointers.size(), flags);
+}
+
+// Purges a fresh key holding |names| with |flags| and checks the survivors
+// against the reference, returning them.
+static std::vector<WSTR> PurgeAndCheck(const std::vector<WSTR>& names, const std::vector<WSTR>& patterns,
+    DWORD matcherFlags, DWORD flags)
+{
+    std::vector<WSTR> expected, survivors;
+    MATCHER* matcher = CreateMatcher(patterns, matcherFlags);
+    REGKEY* key;
+    DWORD deleted = 0;
+
+    for (const WSTR& n : names)
+    {
+        if (!ContainsAny(n, patterns, matcherFlags & MATCHER_IGNORE_CASE))
+            expected.push_back(n);
+    }
+
+    RegKey_CreateMemory(&key);
+    Key_Fill(key, names);
+    CHECK_EQ(Purge_ValueNames(key, matcher, flags, &deleted), ERROR_SUCCESS);
+    survivors = Key_ValueNames(key);
+    CHECK_EQ(deleted, names.size() - expected.size());
+    CHECK(survivors == expected);
+
+    key->vtbl->Close(key);
+    Matcher_Destroy(matcher);
+    return survivors;
+}
+
+static void TestGeneratedKey(void)
+{
+    std::vector<WSTR> names, patterns;
+    GEN_RNG rng;
+    DWORD app;
+
+    Gen_Seed(&rng, 2);
+    for (DWORD i = 0; i < 20000; ++i)
+    {
+        WSTR name = Gen_MuiCacheName(&rng, &app);
+        if (i % 3 == 0)
+        {
+            // Some names in upper case, for the case-insensitive runs.
+            for (WCHAR& ch : name)
+                ch = ch >= 'a' && ch <= 'z' ? (WCHAR)(ch - 'a' + 'A') : ch;
+        }
+        names.push_back(name);
+    }
+    // Value names are unique ignoring case.
+    std::sort(names.begin(), names.end(), [](const WSTR& a, const WSTR& b) {
+        return Fold(a) < Fold(b);
+    });
+    names.erase(std::unique(names.begin(), names.end(), [](const WSTR& a, const WSTR& b) {
+        return Fold(a) == Fold(b);
+    }), names.end());
+    for (DWORD i = (DWORD)names.size(); i > 1; --i)
+        std::swap(names[i - 1], names[Gen_Below(&rng, i)]);
+    for (DWORD i = 0; i < 48; ++i)
+        patterns.push_back(Gen_ImageName(Gen_Below(&rng, GEN_APP_COUNT)));
+
+    for (DWORD matcherFlags = 0; matcherFlags <= MATCHER_IGNORE_CASE; ++matcherFlags)
+    {
+        std::vector<WSTR> snapshot = PurgeAndCheck(names, patterns, matcherFlags, 0);
+        std::vector<WSTR> inPlace = PurgeAndCheck(names, patterns, matcherFlags, PURGE_IN_PLACE);
+        CHECK(snapshot == inPlace);
+        CHECK(snapshot.size() < names.size());
+    }
+}
+
+// Runs of matching values, at the start and end of the key and back to
+// back, are where deleting while enumerating shifts indexes.
+static void TestRuns(void)
+{
+    static const char* const kLayouts[] = {
+        "xxxx", "x...", "...x", "xx..xx..xx", ".x.x.x.x.", "....", "x", ".", "",
+    };
+    std::vector<WSTR> patterns(1, W("Remove"));
+
+    for (const char* layout : kLayouts)
+    {
+        std::vector<WSTR> names;
+        char name[32];
+        for (DWORD i = 0; layout[i]; ++i)
+        {
+            snprintf(name, sizeof(name), layout[i] == 'x' ? "C:\\Remove\\%u.exe" : "C:\\Keep\\%u.exe", i);
+            names.push_back(W(name));
+        }
+        for (DWORD flags = 0; flags <= PURGE_IN_PLACE; ++flags)
+            PurgeAndCheck(names, patterns, 0, flags);
+    }
+}
+
+static void TestDryRun(void)
+{
+    std::vector<WSTR> names, patterns(1, W("b.exe"));
+    MATCHER* matcher = CreateMatcher(patterns, 0);
+    PURGE_STATS stats;
+    REGKEY* key;
+
+    names.push_back(W("C:\\a.exe"));
+    names.push_back(W("C:\\b.exe.FriendlyAppName"));
+    names.push_back(W("C:\\b.exe.ApplicationCompany"));
+    RegKey_CreateMemory(&key);
+    Key_Fill(key, names);
+
+    for (DWORD flags = 0; flags <= PURGE_IN_PLACE; ++flags)
+    {
+        memset(&stats, 0, sizeof(stats));
+        CHECK_EQ(Purge_ValueNamesEx(key, matcher, flags | PURGE_DRY_RUN, &stats), ERROR_SUCCESS);
+        CHECK_EQ(stats.enumerated, 3);
+        CHECK_EQ(stats.matched, 2);
+        CHECK_EQ(stats.deleted, 0);
+        CHECK(Key_ValueNames(key) == names);
+    }
+
+    key->vtbl->Close(key);
+    Matcher_Destroy(matcher);
+}
+
+int main()
+{
+    TestGeneratedKey();
+    TestRuns();
+    TestDryRun();
+    return Check_Result();
+}
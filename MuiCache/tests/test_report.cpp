@@ -0,0 +1,218 @@
+// Targets_Purge statistics over memory keys and the report text made from
+// them: per-target and total counters for a name target, a data target and
+// a missing one; a dry run counts the same matches but leaves every value
+// in place; and the exact compact and JSON forms, wall times zeroed.
+#include "check.h"
+#include "fakes.h"
+#include "report.h"
+#include "targets.h"
+
+#include <string.h>
+
+typedef struct _REPORT_FIXTURE {
+    MEMORY_KEY_OPENER opener;
+    REGKEY* mui;
+    REGKEY* shc;
+} REPORT_FIXTURE;
+
+// MuiCache: three "app.exe" names and three others, 14 chars each. SHC:
+// one record whose data names app.exe and one that doesn't. No firewall
+// rules key, so that target fails with ERROR_FILE_NOT_FOUND.
+static void Fixture_Init(REPORT_FIXTURE* f)
+{
+    const PURGE_TARGET* targets = Targets_Builtin();
+    std::vector<WSTR> names;
+    char name[32];
+
+    MemoryKeyOpener_Init(&f->opener);
+    for (DWORD i = 0; i < PURGE_ROOT_COUNT; ++i)
+        RegKey_CreateMemory(&f->opener.roots[i]);
+    RegKey_MemoryCreateSubKey(f->opener.roots[targets[TARGET_MUICACHE].root], targets[TARGET_MUICACHE].path,
+        &f->mui);
+    RegKey_MemoryCreateSubKey(f->opener.roots[targets[TARGET_SHC].root], targets[TARGET_SHC].path, &f->shc);
+    for (DWORD i = 0; i < 3; ++i)
+    {
+        snprintf(name, sizeof(name), "C:\\P\\app.exe.%u", i);
+        names.push_back(W(name));
+        snprintf(name, sizeof(name), "C:\\K\\oth.exe.%u", i);
+        names.push_back(W(name));
+    }
+    Key_Fill(f->mui, names);
+
+    // 12-char paths, each record 28 bytes of data under a 2-char name.
+    const char* records[2][2] = { { "r0", "C:\\P\\app.exe" }, { "r1", "C:\\K\\oth.exe" } };
+    for (DWORD i = 0; i < 2; ++i)
+    {
+        WSTR recordName = W(records[i][0]), data = W(records[i][1]);
+        data.push_back(0);
+        data.push_back(0);
+        RegKey_MemorySetValue(f->shc, recordName.c_str(), REG_MULTI_SZ, (const BYTE*)data.c_str(),
+            (DWORD)(data.size() * sizeof(WCHAR)));
+    }
+}
+
+static void Fixture_Close(REPORT_FIXTURE* f)
+{
+    f->mui->vtbl->Close(f->mui);
+    f->shc->vtbl->Close(f->shc);
+    for (DWORD i = 0; i < PURGE_ROOT_COUNT; ++i)
+        f->opener.roots[i]->vtbl->Close(f->opener.roots[i]);
+}
+
+static void CheckStats(const PURGE_STATS* stats, DWORD enumerated, DWORD bytes, DWORD matched, DWORD deleted)
+{
+    CHECK_EQ(stats->enumerated, enumerated);
+    CHECK_EQ(stats->bytesRead, bytes);
+    CHECK_EQ(stats->matched, matched);
+    CHECK_EQ(stats->deleted, deleted);
+    CHECK_EQ(stats->failed, 0);
+}
+
+// Wall times vary from run to run; the text is compared without them.
+static void ZeroTimes(TARGETS_PURGE* purge, DWORD count)
+{
+    for (DWORD i = 0; i < count; ++i)
+        purge->results[i].milliseconds = 0;
+    purge->milliseconds = 0;
+}
+
+static std::string Compact(const TARGETS_PURGE* purge)
+{
+    REPORT report;
+    std::string text;
+
+    Report_Init(&report);
+    Report_FormatCompact(&report, Targets_Builtin(), purge, TARGET_BUILTIN_COUNT);
+    CHECK(!report.failed);
+    text.assign(report.chars, report.cch);
+    Report_Free(&report);
+    return text;
+}
+
+static std::string Json(const TARGETS_PURGE* purge, BOOL dryRun)
+{
+    REPORT report;
+    std::string text;
+
+    Report_Init(&report);
+    Report_FormatJson(&report, Targets_Builtin(), purge, TARGET_BUILTIN_COUNT, dryRun);
+    CHECK(!report.failed);
+    text.assign(report.chars, report.cch);
+    Report_Free(&report);
+    return text;
+}
+
+static void TestDryRunThenPurge(void)
+{
+    WSTR pattern = W("app.exe");
+    const WCHAR* patterns = pattern.c_str();
+    MATCHER* matcher = Matcher_Create(&patterns, 1);
+    REPORT_FIXTURE f;
+    TARGETS_PURGE purge;
+
+    Fixture_Init(&f);
+
+    // Dry run: every value read and every match counted, none deleted. The
+    // run itself succeeds; the missing key fails only its own target.
+    CHECK_EQ(Targets_Purge(&f.opener.base, Targets_Builtin(), TARGET_BUILTIN_COUNT, matcher, PURGE_DRY_RUN, 1, NULL,
+        &purge), ERROR_SUCCESS);
+    CheckStats(&purge.results[TARGET_MUICACHE].stats, 6, 6 * 14 * 2, 3, 0);
+    CheckStats(&purge.results[TARGET_SHC].stats, 2, 2 * (4 + 28), 1, 0);
+    CheckStats(&purge.results[TARGET_FIREWALL].stats, 0, 0, 0, 0);
+    CheckStats(&purge.totals, 8, 6 * 14 * 2 + 2 * (4 + 28), 4, 0);
+    CHECK_EQ(purge.results[TARGET_MUICACHE].status, ERROR_SUCCESS);
+    CHECK_EQ(purge.results[TARGET_FIREWALL].status, ERROR_FILE_NOT_FOUND);
+    CHECK_EQ(purge.purged, 2);
+    CHECK_EQ(purge.failed, 1);
+    CHECK_EQ(purge.missing, 0);
+    CHECK_EQ(purge.firstError, ERROR_FILE_NOT_FOUND);
+    CHECK_EQ(Key_ValueNames(f.mui).size(), 6);
+    CHECK_EQ(Key_ValueNames(f.shc).size(), 2);
+
+    ZeroTimes(&purge, TARGET_BUILTIN_COUNT);
+    CHECK(Compact(&purge) ==
+        "MuiCache status=0 enumerated=6 bytes=168 matched=3 deleted=0 failed=0 ms=0;"
+        "SHC status=0 enumerated=2 bytes=64 matched=1 deleted=0 failed=0 ms=0;"
+        "FirewallRules status=2 enumerated=0 bytes=0 matched=0 deleted=0 failed=0 ms=0;"
+        "total status=2 enumerated=8 bytes=232 matched=4 deleted=0 failed=0 ms=0");
+    CHECK(Json(&purge, TRUE) ==
+        "{\"dryRun\":true,\"milliseconds\":0,\"workers\":1,\"targets\":["
+        "{\"name\":\"MuiCache\",\"status\":0,\"enumerated\":6,\"bytes\":168,\"matched\":3,\"deleted\":0,"
+        "\"failed\":0,\"keys\":1,\"skipped\":false,\"milliseconds\":0},"
+        "{\"name\":\"SHC\",\"status\":0,\"enumerated\":2,\"bytes\":64,\"matched\":1,\"deleted\":0,"
+        "\"failed\":0,\"keys\":1,\"skipped\":false,\"milliseconds\":0},"
+        "{\"name\":\"FirewallRules\",\"status\":2,\"enumerated\":0,\"bytes\":0,\"matched\":0,\"deleted\":0,"
+        "\"failed\":0,\"keys\":0,\"skipped\":false,\"milliseconds\":0}],"
+        "\"totals\":{\"status\":2,\"enumerated\":8,\"bytes\":232,\"matched\":4,\"deleted\":0,\"failed\":0,"
+        "\"purged\":2,\"skipped\":0,\"missing\":0,\"failedTargets\":1}}\n");
+    Targets_Free(&purge);
+
+    // The real purge finds the same matches and deletes them.
+    Targets_Purge(&f.opener.base, Targets_Builtin(), TARGET_BUILTIN_COUNT, matcher, 0, 0, NULL, &purge);
+    CheckStats(&purge.results[TARGET_MUICACHE].stats, 6, 6 * 14 * 2, 3, 3);
+    CheckStats(&purge.results[TARGET_SHC].stats, 2, 2 * (4 + 28), 1, 1);
+    CheckStats(&purge.totals, 8, 6 * 14 * 2 + 2 * (4 + 28), 4, 4);
+    CHECK_EQ(Key_ValueNames(f.mui).size(), 3);
+    CHECK_EQ(Key_ValueNames(f.shc).size(), 1);
+
+    ZeroTimes(&purge, TARGET_BUILTIN_COUNT);
+    purge.workers = 3;
+    CHECK(Compact(&purge) ==
+        "MuiCache status=0 enumerated=6 bytes=168 matched=3 deleted=3 failed=0 ms=0;"
+        "SHC status=0 enumerated=2 bytes=64 matched=1 deleted=1 failed=0 ms=0;"
+        "FirewallRules status=2 enumerated=0 bytes=0 matched=0 deleted=0 failed=0 ms=0;"
+        "total status=2 enumerated=8 bytes=232 matched=4 deleted=4 failed=0 ms=0");
+    std::string json = Json(&purge, FALSE);
+    CHECK(json.compare(0, 47, "{\"dryRun\":false,\"milliseconds\":0,\"workers\":3,\"t") == 0);
+    CHECK(json.find("\"totals\":{\"status\":2,\"enumerated\":8,\"bytes\":232,\"matched\":4,\"deleted\":4,") !=
+        std::string::npos);
+    Targets_Free(&purge);
+
+    // Nothing left to match: read again, nothing counted as matched.
+    Targets_Purge(&f.opener.base, Targets_Builtin(), 2, matcher, 0, 1, NULL, &purge);
+    CHECK_EQ(purge.firstError, ERROR_SUCCESS);
+    CheckStats(&purge.totals, 4, 3 * 14 * 2 + 4 + 28, 0, 0);
+    Targets_Free(&purge);
+
+    Matcher_Destroy(matcher);
+    Fixture_Close(&f);
+}
+
+static void TestFormatting(void)
+{
+    TARGET_RESULT results[TARGET_BUILTIN_COUNT];
+    TARGETS_PURGE purge;
+
+    // Negative statuses (HRESULTs) and the largest counters print in full.
+    memset(results, 0, sizeof(results));
+    memset(&purge, 0, sizeof(purge));
+    purge.results = results;
+    results[TARGET_MUICACHE].status = (LSTATUS)E_FAIL;
+    results[TARGET_MUICACHE].stats.enumerated = 0xFFFFFFFF;
+    results[TARGET_SHC].skipped = TRUE;
+    results[TARGET_SHC].milliseconds = 1234567;
+    purge.firstError = (LSTATUS)E_FAIL;
+    purge.totals.enumerated = 0xFFFFFFFF;
+    purge.milliseconds = 10;
+    CHECK(Compact(&purge) ==
+        "MuiCache status=-2147467259 enumerated=4294967295 bytes=0 matched=0 deleted=0 failed=0 ms=0;"
+        "SHC status=0 enumerated=0 bytes=0 matched=0 deleted=0 failed=0 ms=1234567;"
+        "FirewallRules status=0 enumerated=0 bytes=0 matched=0 deleted=0 failed=0 ms=0;"
+        "total status=-2147467259 enumerated=4294967295 bytes=0 matched=0 deleted=0 failed=0 ms=10");
+    CHECK(Json(&purge, FALSE).find(",\"skipped\":true,\"milliseconds\":1234567}") != std::string::npos);
+
+    // No targets: just the totals.
+    REPORT report;
+    Report_Init(&report);
+    Report_FormatCompact(&report, Targets_Builtin(), &purge, 0);
+    CHECK(std::string(report.chars, report.cch) ==
+        "total status=-2147467259 enumerated=4294967295 bytes=0 matched=0 deleted=0 failed=0 ms=10");
+    Report_Free(&report);
+}
+
+int main()
+{
+    TestDryRunThenPurge();
+    TestFormatting();
+    return Check_Result();
+}
@@ -0,0 +1,163 @@
+// NotifyBatch coalescing through the SHELL_NOTIFY_RECORDER and a sink that
+// keeps every event: up to the item limit each path is announced as created
+// or updated, in order; past it a single ASSOCCHANGED replaces them all;
+// Flush leaves the batch empty for the next round.
+#include "check.h"
+#include "fakes.h"
+#include "shellnotify.h"
+
+#include <string>
+
+typedef struct _NOTIFY_EVENT {
+    LONG eventId;
+    WSTR path;
+    BOOL hasPath;
+} NOTIFY_EVENT;
+
+typedef struct _EVENT_LOG {
+    SHELL_NOTIFIER base;
+    std::vector<NOTIFY_EVENT> events;
+} EVENT_LOG;
+
+static void EventLog_Notify(SHELL_NOTIFIER* notifier, LONG eventId, const WCHAR* path)
+{
+    NOTIFY_EVENT event;
+    event.eventId = eventId;
+    event.hasPath = path != NULL;
+    if (path)
+        event.path = path;
+    ((EVENT_LOG*)notifier)->events.push_back(event);
+}
+
+static const SHELL_NOTIFIER_VTBL kEventLogVtbl = {
+    EventLog_Notify,
+};
+
+static WSTR PathOf(DWORD i)
+{
+    return W(("C:\\Users\\u\\Desktop\\app" + std::to_string(i) + ".lnk").c_str());
+}
+
+static void Add(SHELL_NOTIFY_BATCH* batch, DWORD count)
+{
+    for (DWORD i = 0; i < count; ++i)
+        NotifyBatch_Add(batch, PathOf(i).c_str(), i % 3 == 0);
+}
+
+static void TestRecorder(void)
+{
+    for (DWORD count = 0; count <= 20; ++count)
+    {
+        SHELL_NOTIFY_RECORDER recorder;
+        SHELL_NOTIFY_BATCH batch;
+        DWORD created = (count + 2) / 3;
+
+        NotifyRecorder_Init(&recorder);
+        NotifyBatch_Init(&batch, &recorder.base, SHELL_NOTIFY_ITEM_LIMIT);
+        Add(&batch, count);
+        CHECK_EQ(recorder.total, 0);
+        NotifyBatch_Flush(&batch);
+        if (count <= SHELL_NOTIFY_ITEM_LIMIT)
+        {
+            CHECK_EQ(recorder.total, count);
+            CHECK_EQ(recorder.created, created);
+            CHECK_EQ(recorder.updated, count - created);
+            CHECK_EQ(recorder.assocChanged, 0);
+        }
+        else
+        {
+            CHECK_EQ(recorder.total, 1);
+            CHECK_EQ(recorder.assocChanged, 1);
+            CHECK_EQ(recorder.created + recorder.updated, 0);
+        }
+    }
+}
+
+static void TestPathsInOrder(void)
+{
+    EVENT_LOG log;
+    SHELL_NOTIFY_BATCH batch;
+
+    log.base.vtbl = &kEventLogVtbl;
+    NotifyBatch_Init(&batch, &log.base, SHELL_NOTIFY_ITEM_LIMIT);
+    Add(&batch, SHELL_NOTIFY_ITEM_LIMIT);
+    NotifyBatch_Flush(&batch);
+    CHECK_EQ(log.events.size(), SHELL_NOTIFY_ITEM_LIMIT);
+    for (DWORD i = 0; i < log.events.size(); ++i)
+    {
+        CHECK_EQ(log.events[i].eventId, i % 3 == 0 ? SHELL_NOTIFY_CREATE : SHELL_NOTIFY_UPDATEITEM);
+        CHECK(log.events[i].hasPath);
+        CHECK(log.events[i].path == PathOf(i));
+    }
+
+    // One past the limit: the ASSOCCHANGED carries no path.
+    log.events.clear();
+    Add(&batch, SHELL_NOTIFY_ITEM_LIMIT + 1);
+    NotifyBatch_Flush(&batch);
+    CHECK_EQ(log.events.size(), 1);
+    CHECK_EQ(log.events[0].eventId, SHELL_NOTIFY_ASSOCCHANGED);
+    CHECK(!log.events[0].hasPath);
+}
+
+static void TestFlushResets(void)
+{
+    SHELL_NOTIFY_RECORDER recorder;
+    SHELL_NOTIFY_BATCH batch;
+
+    NotifyRecorder_Init(&recorder);
+    NotifyBatch_Init(&batch, &recorder.base, SHELL_NOTIFY_ITEM_LIMIT);
+
+    // An overflowing round doesn't carry into the next one.
+    Add(&batch, 50);
+    NotifyBatch_Flush(&batch);
+    CHECK_EQ(batch.count, 0);
+    CHECK(!batch.overflow);
+    CHECK(batch.entries == NULL);
+    CHECK_EQ(batch.used, 0);
+    Add(&batch, 2);
+    NotifyBatch_Flush(&batch);
+    CHECK_EQ(recorder.assocChanged, 1);
+    CHECK_EQ(recorder.created, 1);
+    CHECK_EQ(recorder.updated, 1);
+
+    // Nor do a round's paths.
+    Add(&batch, 5);
+    NotifyBatch_Flush(&batch);
+    CHECK_EQ(recorder.total, 1 + 2 + 5);
+
+    // An empty batch sends nothing.
+    NotifyBatch_Flush(&batch);
+    NotifyBatch_Flush(&batch);
+    CHECK_EQ(recorder.total, 1 + 2 + 5);
+}
+
+static void TestOtherLimits(void)
+{
+    SHELL_NOTIFY_RECORDER recorder;
+    SHELL_NOTIFY_BATCH batch;
+
+    // A limit of 0 always coalesces.
+    NotifyRecorder_Init(&recorder);
+    NotifyBatch_Init(&batch, &recorder.base, 0);
+    Add(&batch, 1);
+    NotifyBatch_Flush(&batch);
+    CHECK_EQ(recorder.total, 1);
+    CHECK_EQ(recorder.assocChanged, 1);
+
+    // A large limit keeps every path, growing its buffer as it goes.
+    NotifyRecorder_Init(&recorder);
+    NotifyBatch_Init(&batch, &recorder.base, 1000);
+    Add(&batch, 1000);
+    NotifyBatch_Flush(&batch);
+    CHECK_EQ(recorder.total, 1000);
+    CHECK_EQ(recorder.assocChanged, 0);
+}
+
+int main()
+{
+    TestRecorder();
+    TestPathsInOrder();
+    TestFlushResets();
+    TestOtherLimits();
+    return Check_Result();
+}
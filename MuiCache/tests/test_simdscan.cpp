@@ -0,0 +1,281 @@
+// SimdScan_Contains/FindChar at every kernel level the CPU has, against a
+// plain loop: lengths around the 8-char (SSE2) and 16-char (AVX2) vectors,
+// matches across vector boundaries, what case folding touches, and the
+// matcher modes built on top.
+#include "check.h"
+#include "fakes.h"
+#include "matcher.h"
+#include "simdscan.h"
+
+static BOOL Reference(const WCHAR* text, DWORD cch, const WCHAR* needle, DWORD cchNeedle, BOOL foldCase)
+{
+    for (DWORD start = 0; cchNeedle && start + cchNeedle <= cch; ++start)
+    {
+        DWORD i = 0;
+        while (i < cchNeedle && (foldCase ? SimdScan_FoldChar(text[start + i]) : text[start + i]) == needle[i])
+            ++i;
+        if (i == cchNeedle)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+// The needle at every offset of every text length up to three AVX2 vectors,
+// so it starts and ends in every lane and in the scalar tail; and a decoy
+// sharing the first two chars (what the kernels filter on) but not the rest.
+static void TestPlacement(DWORD level)
+{
+    static const WCHAR kNeedle[] = { 'a', 'p', 'p', '.', 'e', 'x', 'e' };
+    WCHAR text[48];
+
+    for (DWORD cchNeedle = 1; cchNeedle <= 7; ++cchNeedle)
+    {
+        for (DWORD cch = 0; cch <= 48; ++cch)
+        {
+            for (DWORD i = 0; i < cch; ++i)
+                text[i] = (WCHAR)('0' + i % 10);
+            CHECK(!SimdScan_Contains(text, cch, kNeedle, cchNeedle, FALSE));
+            for (DWORD start = 0; start + cchNeedle <= cch; ++start)
+            {
+                for (DWORD i = 0; i < cch; ++i)
+                    text[i] = (WCHAR)('0' + i % 10);
+                memcpy(text + start, kNeedle, cchNeedle * sizeof(WCHAR));
+                if (!SimdScan_Contains(text, cch, kNeedle, cchNeedle, FALSE) ||
+                    SimdScan_Contains(text, cch, kNeedle, cchNeedle, FALSE) != Reference(text, cch, kNeedle, cchNeedle, FALSE))
+                {
+                    fprintf(stderr, "level %u: needle %u at %u of %u missed\n", level, cchNeedle, start, cch);
+                    ++g_checkFailures;
+                }
+                if (cchNeedle > 2)
+                {
+                    text[start + cchNeedle - 1] = 'Q';
+                    CHECK(!SimdScan_Contains(text, cch, kNeedle, cchNeedle, FALSE));
+                    // The match past the end of |cch| must not count.
+                    CHECK(!SimdScan_Contains(text, start + cchNeedle - 1, kNeedle, cchNeedle, FALSE));
+                }
+            }
+        }
+    }
+}
+
+// Only 'A'..'Z' fold. Neighbours like '@', '[', '`' and Latin-1 letters
+// differ from their |0x20 twin by the same bit and must stay apart.
+static void TestFolding(DWORD level)
+{
+    WCHAR text[40], needle[2];
+    DWORD bad = 0;
+
+    for (DWORD i = 0; i < 40; ++i)
+        text[i] = '#';
+    for (DWORD c = 1; c <= 0xFFFF; ++c)
+    {
+        text[21] = (WCHAR)c;
+        text[22] = 'q';
+        needle[1] = 'q';
+        needle[0] = SimdScan_FoldChar((WCHAR)c);
+        if (!SimdScan_Contains(text, 40, needle, 2, TRUE))
+            ++bad;
+        needle[0] = (WCHAR)(c | 0x20);
+        if (needle[0] != SimdScan_FoldChar((WCHAR)c) && SimdScan_Contains(text, 40, needle, 2, TRUE))
+            ++bad;
+        // Without folding nothing but the char itself matches.
+        needle[0] = (WCHAR)(c ^ 0x20);
+        if (SimdScan_Contains(text, 40, needle, 2, FALSE))
+            ++bad;
+    }
+    if (bad)
+    {
+        fprintf(stderr, "level %u: %u folding mismatches\n", level, bad);
+        ++g_checkFailures;
+    }
+    CHECK_EQ(SimdScan_FoldChar('A'), 'a');
+    CHECK_EQ(SimdScan_FoldChar('Z'), 'z');
+    CHECK_EQ(SimdScan_FoldChar('@'), '@');
+    CHECK_EQ(SimdScan_FoldChar('['), '[');
+    CHECK_EQ(SimdScan_FoldChar(0x00C4), 0x00C4);
+}
+
+static void TestRandom(DWORD level)
+{
+    static const WCHAR kAlphabet[] = { 'a', 'A', 'p', 'P', '.', '\\', 'e', 'x', 0x00C4, 0x00E4, 0x8041, 'Z', 'z', '@', '`' };
+    WCHAR text[80], needle[6];
+    DWORD bad = 0;
+    GEN_RNG rng;
+
+    Gen_Seed(&rng, 12);
+    for (DWORD iteration = 0; iteration < 100000; ++iteration)
+    {
+        DWORD cch = Gen_Below(&rng, 80), cchNeedle = 1 + Gen_Below(&rng, 6);
+        BOOL foldCase = Gen_Below(&rng, 2);
+
+        for (DWORD i = 0; i < cch; ++i)
+            text[i] = kAlphabet[Gen_Below(&rng, sizeof(kAlphabet) / sizeof(WCHAR))];
+        for (DWORD i = 0; i < cchNeedle; ++i)
+        {
+            needle[i] = cch >= cchNeedle && Gen_Below(&rng, 2) ? text[i + (cch - cchNeedle) / 2]
+                : kAlphabet[Gen_Below(&rng, sizeof(kAlphabet) / sizeof(WCHAR))];
+            if (foldCase)
+                needle[i] = SimdScan_FoldChar(needle[i]);
+        }
+        if (SimdScan_Contains(text, cch, needle, cchNeedle, foldCase) != Reference(text, cch, needle, cchNeedle, foldCase))
+            ++bad;
+    }
+    if (bad)
+    {
+        fprintf(stderr, "level %u: %u random mismatches\n", level, bad);
+        ++g_checkFailures;
+    }
+}
+
+static void TestFindChar(DWORD level)
+{
+    WCHAR text[70];
+
+    for (DWORD cch = 0; cch <= 70; ++cch)
+    {
+        for (DWORD i = 0; i < cch; ++i)
+            text[i] = 'a';
+        CHECK_EQ(SimdScan_FindChar(text, cch, '\\'), cch);
+        for (DWORD at = 0; at < cch; ++at)
+        {
+            text[at] = '\\';
+            if (at + 1 < cch)
+                text[cch - 1] = '\\';
+            if (SimdScan_FindChar(text, cch, '\\') != at)
+            {
+                fprintf(stderr, "level %u: FindChar at %u of %u\n", level, at, cch);
+                ++g_checkFailures;
+            }
+            text[at] = 'a';
+            text[cch - 1] = 'a';
+        }
+    }
+}
+
+static BOOL Matches(MATCHER* matcher, const char* name)
+{
+    WSTR text = W(name);
+    return Matcher_Contains(matcher, text.c_str(), (DWORD)text.size());
+}
+
+// MATCHER_PATH_SUFFIX anchors the pattern at a '\' (or the start of the
+// name) once the property suffix is off.
+static void TestSuffixAnchor(void)
+{
+    static const struct {
+        const char* name;
+        BOOL suffix;
+        BOOL suffixIgnoreCase;
+    } kCases[] = {
+        { "C:\\x\\app.exe.FriendlyAppName", TRUE, TRUE },
+        { "C:\\x\\myapp.exe.FriendlyAppName", FALSE, FALSE },
+        { "C:\\x\\APP.exe.ApplicationCompany", FALSE, TRUE },
+        { "C:\\x\\app.exe", TRUE, TRUE },
+        { "C:\\x\\app.exe.bak", FALSE, FALSE },
+        { "app.exe.friendlyappname", TRUE, TRUE },
+        { "app.exe", TRUE, TRUE },
+        { "C:\\app.exe\\b.exe.FriendlyAppName", FALSE, FALSE },
+        { "C:\\x/app.exe", FALSE, FALSE },
+    };
+    WSTR pattern = W("app.exe"), anchored = W("\\x\\app.exe");
+    const WCHAR* patterns[] = { pattern.c_str() };
+    const WCHAR* anchoredPatterns[] = { anchored.c_str() };
+    MATCHER* substring = Matcher_Create(patterns, 1);
+    MATCHER* suffix = Matcher_CreateEx(patterns, 1, MATCHER_PATH_SUFFIX);
+    MATCHER* suffixIgnoreCase = Matcher_CreateEx(patterns, 1, MATCHER_PATH_SUFFIX | MATCHER_IGNORE_CASE);
+    MATCHER* withDir = Matcher_CreateEx(anchoredPatterns, 1, MATCHER_PATH_SUFFIX);
+
+    for (const auto& c : kCases)
+    {
+        if (Matches(suffix, c.name) != c.suffix || Matches(suffixIgnoreCase, c.name) != c.suffixIgnoreCase)
+        {
+            fprintf(stderr, "suffix match of %s\n", c.name);
+            ++g_checkFailures;
+        }
+    }
+    CHECK(Matches(substring, "C:\\x\\myapp.exe.FriendlyAppName"));
+    CHECK(Matches(withDir, "C:\\x\\app.exe.FriendlyAppName"));
+    CHECK(Matches(withDir, "C:\\y\\x\\app.exe"));
+    CHECK(!Matches(withDir, "C:\\yx\\app.exe"));
+
+    Matcher_Destroy(substring);
+    Matcher_Destroy(suffix);
+    Matcher_Destroy(suffixIgnoreCase);
+    Matcher_Destroy(withDir);
+}
+
+// Up to four patterns scan with the kernels, more walk the automaton; both
+// must agree with the plain search.
+static void TestMatcherModes(DWORD level)
+{
+    static const char* const kPatterns[] = { "App", "exe", "Foo", "BAR.", "z", "qq" };
+    static const char kAlphabet[] = "aApPeExXfFoObBrR.zZq";
+    WSTR patterns[6], folded[6];
+    const WCHAR* pointers[6];
+    MATCHER* matchers[3];
+    WCHAR text[40];
+    DWORD bad = 0;
+    GEN_RNG rng;
+
+    for (DWORD i = 0; i < 6; ++i)
+    {
+        patterns[i] = W(kPatterns[i]);
+        folded[i] = patterns[i];
+        for (WCHAR& ch : folded[i])
+            ch = SimdScan_FoldChar(ch);
+        pointers[i] = patterns[i].c_str();
+    }
+    matchers[0] = Matcher_CreateEx(pointers, 4, MATCHER_IGNORE_CASE);
+    matchers[1] = Matcher_CreateEx(pointers, 5, MATCHER_IGNORE_CASE);
+    matchers[2] = Matcher_CreateEx(pointers, 6, 0);
+
+    Gen_Seed(&rng, 3);
+    for (DWORD iteration = 0; iteration < 50000; ++iteration)
+    {
+        DWORD cch = Gen_Below(&rng, 40);
+        BOOL expected[3] = { FALSE, FALSE, FALSE };
+        for (DWORD i = 0; i < cch; ++i)
+            text[i] = kAlphabet[Gen_Below(&rng, sizeof(kAlphabet) - 1)];
+        for (DWORD k = 0; k < 6; ++k)
+        {
+            if (k < 4 && Reference(text, cch, folded[k].c_str(), (DWORD)folded[k].size(), TRUE))
+                expected[0] = TRUE;
+            if (k < 5 && Reference(text, cch, folded[k].c_str(), (DWORD)folded[k].size(), TRUE))
+                expected[1] = TRUE;
+            if (Reference(text, cch, patterns[k].c_str(), (DWORD)patterns[k].size(), FALSE))
+                expected[2] = TRUE;
+        }
+        for (DWORD m = 0; m < 3; ++m)
+        {
+            if (Matcher_Contains(matchers[m], text, cch) != expected[m])
+                ++bad;
+        }
+    }
+    if (bad)
+    {
+        fprintf(stderr, "level %u: %u matcher mismatches\n", level, bad);
+        ++g_checkFailures;
+    }
+    for (MATCHER* m : matchers)
+        Matcher_Destroy(m);
+}
+
+int main()
+{
+    DWORD best = SimdScan_Level();
+
+    printf("kernel levels 0..%u\n", best);
+    for (DWORD level = 0; level <= best; ++level)
+    {
+        SimdScan_Limit(level);
+        CHECK_EQ(SimdScan_Level(), level);
+        TestPlacement(level);
+        TestFolding(level);
+        TestRandom(level);
+        TestFindChar(level);
+        TestMatcherModes(level);
+        if (level == best)
+            TestSuffixAnchor();
+    }
+    return Check_Result();
+}
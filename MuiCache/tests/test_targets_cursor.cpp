@@ -0,0 +1,342 @@
+// Targets_PurgeUntil resumed call after call with a deadline that has
+// always passed: every call stops after one value, the cursor goes through
+// its text form in between, and the keys must end up as one uninterrupted
+// purge leaves them, whatever is deleted behind its back meanwhile.
+#include "check.h"
+#include "fakes.h"
+#include "targets.h"
+
+#include <set>
+#include <string.h>
+
+typedef struct _CURSOR_FIXTURE {
+    MEMORY_KEY_OPENER opener;
+    REGKEY* mui;
+    REGKEY* shc;
+} CURSOR_FIXTURE;
+
+static void Fixture_Init(CURSOR_FIXTURE* f)
+{
+    const PURGE_TARGET* targets = Targets_Builtin();
+
+    MemoryKeyOpener_Init(&f->opener);
+    for (DWORD i = 0; i < PURGE_ROOT_COUNT; ++i)
+        RegKey_CreateMemory(&f->opener.roots[i]);
+    RegKey_MemoryCreateSubKey(f->opener.roots[targets[TARGET_MUICACHE].root], targets[TARGET_MUICACHE].path,
+        &f->mui);
+    RegKey_MemoryCreateSubKey(f->opener.roots[targets[TARGET_SHC].root], targets[TARGET_SHC].path, &f->shc);
+}
+
+static void Fixture_Close(CURSOR_FIXTURE* f)
+{
+    f->mui->vtbl->Close(f->mui);
+    f->shc->vtbl->Close(f->shc);
+    for (DWORD i = 0; i < PURGE_ROOT_COUNT; ++i)
+        f->opener.roots[i]->vtbl->Close(f->opener.roots[i]);
+}
+
+// SHC records are matched on their multi-string data: the name again.
+static void Shc_Fill(REGKEY* key, const std::vector<WSTR>& names)
+{
+    for (const WSTR& n : names)
+    {
+        WSTR data = n;
+        data.push_back(0);
+        data.push_back(0);
+        RegKey_MemorySetValue(key, n.c_str(), REG_MULTI_SZ, (const BYTE*)data.c_str(),
+            (DWORD)(data.size() * sizeof(WCHAR)));
+    }
+}
+
+// MuiCache names, every third one for "app.exe"; SHC likewise, fewer.
+static void Fixture_Fill(CURSOR_FIXTURE* f, DWORD count)
+{
+    std::vector<WSTR> mui, shc;
+    char name[64];
+
+    for (DWORD i = 0; i < count; ++i)
+    {
+        snprintf(name, sizeof(name), i % 3 ? "C:\\Keep\\other%u.exe" : "C:\\P\\app.exe.%u", i);
+        mui.push_back(W(name));
+        if (i % 4 == 0)
+            shc.push_back(W(name));
+    }
+    Key_Fill(f->mui, mui);
+    Shc_Fill(f->shc, shc);
+}
+
+static MATCHER* CreateMatcher(const char* pattern)
+{
+    WSTR p = W(pattern);
+    const WCHAR* pointer = p.c_str();
+    return Matcher_Create(&pointer, 1);
+}
+
+static TARGETS_CURSOR RoundTrip(const TARGETS_CURSOR* cursor)
+{
+    WCHAR text[TARGETS_CURSOR_CCH];
+    TARGETS_CURSOR parsed;
+
+    TargetsCursor_Format(cursor, text);
+    CHECK(TargetsCursor_Parse(text, &parsed));
+    CHECK(!memcmp(&parsed, cursor, sizeof(TARGETS_CURSOR)));
+    return parsed;
+}
+
+// External deletes at the cursor, made between two calls.
+#define EXTERNAL_NONE     0
+#define EXTERNAL_RESUME   1 // the value the cursor resumes after
+#define EXTERNAL_EARLIER  2 // one already examined, before that
+#define EXTERNAL_LATER    3 // one not reached yet
+
+// Purges both targets a value per call; returns the number of calls, and
+// erases what it deletes externally from |keep|.
+static DWORD PurgeInSteps(CURSOR_FIXTURE* f, const MATCHER* matcher, DWORD external, std::set<WSTR>* keep,
+    DWORD* deleted)
+{
+    TARGETS_CURSOR cursor;
+    TARGETS_PURGE purge;
+    DWORD calls = 0, midKey = 0;
+    LSTATUS status;
+
+    memset(&cursor, 0, sizeof(cursor));
+    *deleted = 0;
+    do
+    {
+        status = Targets_PurgeUntil(&f->opener.base, Targets_Builtin(), TARGET_SHC + 1, matcher, 0,
+            Time_Milliseconds(), &cursor, &purge);
+        CHECK(status == WAIT_TIMEOUT || status == ERROR_SUCCESS);
+        *deleted += purge.totals.deleted;
+        Targets_Free(&purge);
+        cursor = RoundTrip(&cursor);
+        ++calls;
+
+        if (status != WAIT_TIMEOUT || cursor.target != TARGET_MUICACHE || !cursor.values.index)
+            continue;
+        ++midKey;
+        if (external == EXTERNAL_NONE || calls % 5)
+            continue;
+
+        std::vector<WSTR> names = Key_ValueNames(f->mui);
+        DWORD index = cursor.values.index;
+        if (external == EXTERNAL_RESUME)
+            index -= 1;
+        else if (external == EXTERNAL_EARLIER)
+            index = index > 1 ? index - 2 : 0;
+        if (index < names.size())
+        {
+            CHECK_EQ(f->mui->vtbl->DeleteValue(f->mui, names[index].c_str()), ERROR_SUCCESS);
+            keep->erase(names[index]);
+        }
+    } while (status == WAIT_TIMEOUT && calls < 100000);
+
+    CHECK_EQ(status, ERROR_SUCCESS);
+    CHECK(midKey > 1);
+    CHECK(!cursor.patterns && !cursor.target && !cursor.values.index && !cursor.values.lastName);
+    return calls;
+}
+
+// Interrupted after every value, the purge leaves what a one-shot purge of
+// the same keys leaves, in the same order.
+static void TestMatchesOneShot(void)
+{
+    CURSOR_FIXTURE steps, once;
+    MATCHER* matcher = CreateMatcher("app.exe");
+    TARGETS_PURGE purge;
+    std::set<WSTR> keep;
+    DWORD deleted, calls;
+
+    Fixture_Init(&steps);
+    Fixture_Init(&once);
+    Fixture_Fill(&steps, 300);
+    Fixture_Fill(&once, 300);
+
+    calls = PurgeInSteps(&steps, matcher, EXTERNAL_NONE, &keep, &deleted);
+    CHECK(calls > 300);
+    CHECK_EQ(Targets_Purge(&once.opener.base, Targets_Builtin(), TARGET_SHC + 1, matcher, PURGE_IN_PLACE, 1, NULL,
+        &purge), ERROR_SUCCESS);
+    CHECK_EQ(deleted, purge.totals.deleted);
+    CHECK_EQ(deleted, 100 + 25);
+    Targets_Free(&purge);
+    CHECK(Key_ValueNames(steps.mui) == Key_ValueNames(once.mui));
+    CHECK(Key_ValueNames(steps.shc) == Key_ValueNames(once.shc));
+
+    Fixture_Close(&steps);
+    Fixture_Close(&once);
+    Matcher_Destroy(matcher);
+}
+
+// Values deleted by someone else between calls, the one the cursor resumes
+// after included, make it neither skip a match nor stop early.
+static void TestExternalDeletes(void)
+{
+    MATCHER* matcher = CreateMatcher("app.exe");
+
+    for (DWORD external = EXTERNAL_RESUME; external <= EXTERNAL_LATER; ++external)
+    {
+        CURSOR_FIXTURE f;
+        std::set<WSTR> keep;
+        DWORD deleted;
+
+        Fixture_Init(&f);
+        Fixture_Fill(&f, 300);
+        for (const WSTR& n : Key_ValueNames(f.mui))
+        {
+            if (N(n).find("app.exe") == std::string::npos)
+                keep.insert(n);
+        }
+
+        PurgeInSteps(&f, matcher, external, &keep, &deleted);
+        std::vector<WSTR> left = Key_ValueNames(f.mui);
+        CHECK(std::set<WSTR>(left.begin(), left.end()) == keep);
+        CHECK_EQ(left.size(), keep.size());
+        CHECK(Key_ValueNames(f.shc).size() == 50);
+        Fixture_Close(&f);
+    }
+    Matcher_Destroy(matcher);
+}
+
+// A cursor from text that was cut, garbled or edited is refused and comes
+// back zeroed, so the caller starts over instead of trusting it.
+static void TestCorruptText(void)
+{
+    WCHAR text[TARGETS_CURSOR_CCH];
+    TARGETS_CURSOR cursor, parsed;
+
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.patterns = 0x1234abcd;
+    cursor.target = TARGET_SHC;
+    cursor.values.index = 57;
+    cursor.values.lastName = 0xdeadbeef;
+    TargetsCursor_Format(&cursor, text);
+    CHECK_EQ(text[TARGETS_CURSOR_CCH - 1], 0);
+    CHECK(TargetsCursor_Parse(text, &parsed));
+    CHECK(!memcmp(&parsed, &cursor, sizeof(cursor)));
+
+    // Every single flipped hex digit, the check field's own included.
+    for (DWORD i = 0; i < TARGETS_CURSOR_CCH - 1; ++i)
+    {
+        WCHAR saved = text[i];
+        text[i] = saved == '0' ? '1' : '0';
+        memset(&parsed, 0xFF, sizeof(parsed));
+        CHECK(!TargetsCursor_Parse(text, &parsed));
+        CHECK(!parsed.patterns && !parsed.target && !parsed.values.index && !parsed.values.lastName);
+        text[i] = saved;
+    }
+
+    static const char* const kBad[] = {
+        "zz", "0", "1234abcd", "1234ABCD00000001000000390000000000000000",
+    };
+    for (const char* bad : kBad)
+    {
+        memset(&parsed, 0xFF, sizeof(parsed));
+        CHECK(!TargetsCursor_Parse(W(bad).c_str(), &parsed));
+        CHECK(!parsed.patterns && !parsed.target && !parsed.values.index);
+    }
+
+    // Cut short, and with something after it.
+    WSTR cut(text, TARGETS_CURSOR_CCH - 2);
+    CHECK(!TargetsCursor_Parse(cut.c_str(), &parsed));
+    WSTR longer(text);
+    longer.push_back('0');
+    CHECK(!TargetsCursor_Parse(longer.c_str(), &parsed));
+
+    // Empty text is a fresh start.
+    memset(&parsed, 0xFF, sizeof(parsed));
+    CHECK(TargetsCursor_Parse(W("").c_str(), &parsed));
+    CHECK(!parsed.patterns && !parsed.target && !parsed.values.index);
+}
+
+// A cursor that parses but is stale: from another pattern set, or pointing
+// past the targets or past the key's end.
+static void TestStaleCursor(void)
+{
+    CURSOR_FIXTURE f;
+    MATCHER* app = CreateMatcher("app.exe");
+    MATCHER* other = CreateMatcher("other");
+    TARGETS_CURSOR cursor;
+    TARGETS_PURGE purge;
+
+    Fixture_Init(&f);
+    Fixture_Fill(&f, 30);
+
+    // Taken with "app.exe" on the SHC target; run with "other" it starts
+    // from MuiCache again.
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.patterns = Matcher_Hash(app);
+    cursor.target = TARGET_SHC;
+    cursor.values.index = 100000;
+    CHECK_EQ(Targets_PurgeUntil(&f.opener.base, Targets_Builtin(), TARGET_SHC + 1, other, PURGE_DRY_RUN,
+        Time_Milliseconds() + 100000, &cursor, &purge), ERROR_SUCCESS);
+    CHECK_EQ(purge.results[TARGET_MUICACHE].stats.matched, 20);
+    CHECK_EQ(purge.purged, 2);
+    CHECK_EQ(Key_ValueNames(f.mui).size(), 30);
+    Targets_Free(&purge);
+
+    // Past the table.
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.patterns = Matcher_Hash(app);
+    cursor.target = 7;
+    CHECK_EQ(Targets_PurgeUntil(&f.opener.base, Targets_Builtin(), TARGET_SHC + 1, app, 0,
+        Time_Milliseconds() + 100000, &cursor, &purge), ERROR_SUCCESS);
+    CHECK_EQ(purge.totals.deleted, 10 + 3);
+    Targets_Free(&purge);
+
+    // Past the end of a key that shrank, with a name no longer there: the
+    // key is walked again from the start.
+    Fixture_Fill(&f, 30);
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.patterns = Matcher_Hash(app);
+    cursor.values.index = 5000;
+    cursor.values.lastName = 0x12345678;
+    CHECK_EQ(Targets_PurgeUntil(&f.opener.base, Targets_Builtin(), TARGET_SHC + 1, app, 0,
+        Time_Milliseconds() + 100000, &cursor, &purge), ERROR_SUCCESS);
+    CHECK_EQ(purge.results[TARGET_MUICACHE].stats.deleted, 10);
+    CHECK_EQ(Key_ValueNames(f.mui).size(), 20);
+    Targets_Free(&purge);
+
+    Fixture_Close(&f);
+    Matcher_Destroy(app);
+    Matcher_Destroy(other);
+}
+
+// A dry run resumed value by value counts every match once and deletes
+// nothing.
+static void TestDryRun(void)
+{
+    CURSOR_FIXTURE f;
+    MATCHER* matcher = CreateMatcher("app.exe");
+    TARGETS_CURSOR cursor;
+    TARGETS_PURGE purge;
+    DWORD matched = 0, calls = 0;
+    LSTATUS status;
+
+    Fixture_Init(&f);
+    Fixture_Fill(&f, 90);
+    memset(&cursor, 0, sizeof(cursor));
+    do
+    {
+        status = Targets_PurgeUntil(&f.opener.base, Targets_Builtin(), TARGET_SHC + 1, matcher, PURGE_DRY_RUN,
+            Time_Milliseconds(), &cursor, &purge);
+        matched += purge.totals.matched;
+        CHECK_EQ(purge.totals.deleted, 0);
+        Targets_Free(&purge);
+        cursor = RoundTrip(&cursor);
+    } while (status == WAIT_TIMEOUT && ++calls < 100000);
+    CHECK_EQ(status, ERROR_SUCCESS);
+    CHECK_EQ(matched, 30 + 8);
+    CHECK_EQ(Key_ValueNames(f.mui).size(), 90);
+
+    Fixture_Close(&f);
+    Matcher_Destroy(matcher);
+}
+
+int main()
+{
+    TestMatchesOneShot();
+    TestExternalDeletes();
+    TestCorruptText();
+    TestStaleCursor();
+    TestDryRun();
+    return Check_Result();
+}
@@ -0,0 +1,287 @@
+// Unpin_FindShortcuts and Unpin_Run over a FAKE_DIR_LISTER tree: a plain
+// pattern stays the case-sensitive prefix TaskbarUnpin always used, a
+// wildcard one is a case-insensitive glob, UNPIN_RECURSE walks subfolders
+// and only then, and the verbs run on a bounded pool with the serial loop's
+// aggregate result. Plus Glob_Match against a plain recursive reference.
+#include "check.h"
+#include "fakes.h"
+#include "glob.h"
+#include "unpin.h"
+
+#include <algorithm>
+#include <string>
+
+static const char* const kRoot = "C:\\Users\\u\\Pinned";
+
+// Root: "App One.lnk", "app two.LNK", "Application.lnk", "Other.lnk",
+// "App.txt", "App folder" (a directory); below it "App Deep.lnk" and
+// "deeper\App Deepest.lnk"; "empty" holds nothing.
+static void Tree_Init(FAKE_DIR_LISTER* lister)
+{
+    WSTR root = W(kRoot), sub = FakeDir_Join(root, W("App folder"));
+
+    FakeDirLister_Init(lister);
+    FakeDirLister_Add(lister, root, W("App One.lnk"), FALSE);
+    FakeDirLister_Add(lister, root, W("app two.LNK"), FALSE);
+    FakeDirLister_Add(lister, root, W("Application.lnk"), FALSE);
+    FakeDirLister_Add(lister, root, W("Other.lnk"), FALSE);
+    FakeDirLister_Add(lister, root, W("App.txt"), FALSE);
+    FakeDirLister_Add(lister, root, W("App folder"), TRUE);
+    FakeDirLister_Add(lister, root, W("empty"), TRUE);
+    FakeDirLister_Add(lister, sub, W("App Deep.lnk"), FALSE);
+    FakeDirLister_Add(lister, sub, W("deeper"), TRUE);
+    FakeDirLister_Add(lister, FakeDir_Join(sub, W("deeper")), W("App Deepest.lnk"), FALSE);
+}
+
+// The found paths relative to the root, '/'-joined, sorted.
+static std::vector<std::string> Find(FAKE_DIR_LISTER* lister, const char* pattern, DWORD flags, LSTATUS* status)
+{
+    std::vector<std::string> found;
+    STR_LIST paths;
+    size_t skip = strlen(kRoot) + 1;
+
+    StrList_Init(&paths);
+    *status = Unpin_FindShortcuts(&lister->base, W(kRoot).c_str(), W(pattern).c_str(), flags, &paths);
+    for (DWORD i = 0; i < paths.count; ++i)
+    {
+        std::string path = N(WSTR(StrList_Get(&paths, i)));
+        path = path.size() > skip ? path.substr(skip) : path;
+        std::replace(path.begin(), path.end(), (char)PATH_SEPARATOR, '/');
+        found.push_back(path);
+    }
+    StrList_Free(&paths);
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+static std::vector<std::string> Names(std::initializer_list<const char*> names)
+{
+    std::vector<std::string> list(names.begin(), names.end());
+    std::sort(list.begin(), list.end());
+    return list;
+}
+
+static void TestPrefix(void)
+{
+    FAKE_DIR_LISTER lister;
+    LSTATUS status;
+
+    Tree_Init(&lister);
+    // No wildcard: a case-sensitive prefix over .lnk files, in any case of
+    // extension; "app two.LNK" doesn't start with "App".
+    CHECK(Find(&lister, "App", 0, &status) == Names({ "App One.lnk", "Application.lnk" }));
+    CHECK_EQ(status, ERROR_SUCCESS);
+    CHECK(Find(&lister, "app", 0, &status) == Names({ "app two.LNK" }));
+    CHECK(Find(&lister, "APP", 0, &status).empty());
+    CHECK(Find(&lister, "App One.lnk", 0, &status) == Names({ "App One.lnk" }));
+    // The prefix is of the whole name; a later match doesn't count.
+    CHECK(Find(&lister, "One", 0, &status).empty());
+    // The empty prefix takes every shortcut.
+    CHECK_EQ(Find(&lister, "", 0, &status).size(), 4);
+    // Only the root was listed.
+    CHECK_EQ(lister.lists, 6);
+}
+
+static void TestGlob(void)
+{
+    FAKE_DIR_LISTER lister;
+    LSTATUS status;
+
+    Tree_Init(&lister);
+    // With a wildcard the match is the whole name, ignoring case.
+    CHECK(Find(&lister, "app*", 0, &status) == Names({ "App One.lnk", "Application.lnk", "app two.LNK" }));
+    CHECK(Find(&lister, "APP ???.lnk", 0, &status) == Names({ "App One.lnk", "app two.LNK" }));
+    CHECK(Find(&lister, "[ao]*", 0, &status) == Names({ "App One.lnk", "Application.lnk", "Other.lnk",
+        "app two.LNK" }));
+    CHECK(Find(&lister, "[!a]*", 0, &status) == Names({ "Other.lnk" }));
+    // Only shortcuts are candidates, so "App*" never reaches "App.txt".
+    CHECK(Find(&lister, "App*", 0, &status) == Find(&lister, "app*.lnk", 0, &status));
+    CHECK(Find(&lister, "*.txt", 0, &status).empty());
+    CHECK(Find(&lister, "*One", 0, &status).empty());
+}
+
+static void TestRecurse(void)
+{
+    FAKE_DIR_LISTER lister;
+    LSTATUS status;
+
+    Tree_Init(&lister);
+    CHECK(Find(&lister, "App*", UNPIN_RECURSE, &status) == Names({ "App One.lnk", "Application.lnk",
+        "app two.LNK", "App folder/App Deep.lnk", "App folder/deeper/App Deepest.lnk" }));
+    CHECK_EQ(status, ERROR_SUCCESS);
+    // Root, "App folder", "empty", "deeper".
+    CHECK_EQ(lister.lists, 4);
+
+    // The prefix form recurses too, and matches on the file name only:
+    // "App folder" is no shortcut, its contents are judged on their own.
+    CHECK(Find(&lister, "App D", UNPIN_RECURSE, &status) == Names({ "App folder/App Deep.lnk",
+        "App folder/deeper/App Deepest.lnk" }));
+    CHECK(Find(&lister, "App D", 0, &status).empty());
+
+    // An unlistable subfolder is skipped; a missing root is an error.
+    lister.dirs.erase(FakeDir_Join(W(kRoot), W("empty")));
+    CHECK_EQ(Find(&lister, "*", UNPIN_RECURSE, &status).size(), 6);
+    CHECK_EQ(status, ERROR_SUCCESS);
+    lister.dirs.erase(W(kRoot));
+    CHECK(Find(&lister, "*", UNPIN_RECURSE, &status).empty());
+    CHECK(status != ERROR_SUCCESS);
+}
+
+static void TestRun(void)
+{
+    FAKE_DIR_LISTER lister;
+    FAKE_VERB_EXECUTOR executor;
+    UNPIN_RESULT result;
+
+    Tree_Init(&lister);
+    FakeVerbExecutor_Init(&executor);
+    executor.delayMicroseconds = 20000;
+    CHECK_EQ(Unpin_Run(&lister.base, &executor.base, W(kRoot).c_str(), W("*").c_str(), UNPIN_RECURSE, 3, &result),
+        ERROR_SUCCESS);
+    CHECK_EQ(result.matched, 6);
+    CHECK_EQ(result.succeeded, 6);
+    CHECK_EQ(result.result, 42);
+    CHECK_EQ(executor.calls, 6);
+    CHECK(executor.peak >= 1 && executor.peak <= 3);
+    // Every worker thread but the caller's attaches and detaches once.
+    CHECK_EQ(executor.attaches, 2);
+    CHECK_EQ(executor.detaches, 2);
+
+    // Names ending in 'k' (".lnk") fail, ".LNK" doesn't: the first success
+    // is what's reported.
+    FakeVerbExecutor_Init(&executor);
+    executor.failSuffix = 'k';
+    CHECK_EQ(Unpin_Run(&lister.base, &executor.base, W(kRoot).c_str(), W("app*").c_str(), 0, 4, &result),
+        ERROR_SUCCESS);
+    CHECK_EQ(result.matched, 3);
+    CHECK_EQ(result.succeeded, 1);
+    CHECK_EQ(result.result, 42);
+
+    // All fail: the last failure.
+    CHECK_EQ(Unpin_Run(&lister.base, &executor.base, W(kRoot).c_str(), W("App").c_str(), 0, 4, &result),
+        ERROR_SUCCESS);
+    CHECK_EQ(result.matched, 2);
+    CHECK_EQ(result.succeeded, 0);
+    CHECK_EQ(result.result, 2);
+
+    // Nothing matched: nothing run, result 0.
+    FakeVerbExecutor_Init(&executor);
+    CHECK_EQ(Unpin_Run(&lister.base, &executor.base, W(kRoot).c_str(), W("Zed").c_str(), 0, 4, &result),
+        ERROR_SUCCESS);
+    CHECK_EQ(result.matched, 0);
+    CHECK_EQ(result.result, 0);
+    CHECK_EQ(executor.calls, 0);
+}
+
+static void TestDispatchBound(void)
+{
+    FAKE_VERB_EXECUTOR executor;
+    STR_LIST paths;
+    std::vector<LONG> results(200);
+
+    StrList_Init(&paths);
+    for (DWORD i = 0; i < 200; ++i)
+        StrList_AddPath(&paths, W(kRoot).c_str(), W(("s" + std::to_string(i) + ".lnk").c_str()).c_str());
+
+    for (DWORD concurrency = 0; concurrency <= UNPIN_MAX_CONCURRENCY + 4; concurrency += 4)
+    {
+        FakeVerbExecutor_Init(&executor);
+        executor.delayMicroseconds = 1000;
+        Verb_Dispatch(&executor.base, W("taskbarunpin").c_str(), &paths, concurrency, results.data());
+        CHECK_EQ(executor.calls, 200);
+        CHECK(executor.peak <= (LONG)std::max<DWORD>(1, std::min<DWORD>(concurrency, UNPIN_MAX_CONCURRENCY)));
+        CHECK_EQ(executor.attaches, executor.detaches);
+        for (DWORD i = 0; i < 200; ++i)
+            CHECK_EQ(results[i], 42);
+    }
+    StrList_Free(&paths);
+}
+
+// Plain backtracking glob, the specification Glob_Match must agree with.
+static int Fold(int ch, BOOL ignoreCase)
+{
+    return ignoreCase && ch >= 'A' && ch <= 'Z' ? ch + 32 : ch;
+}
+
+static BOOL Reference(const char* pattern, const char* name, BOOL ignoreCase)
+{
+    if (!*pattern)
+        return !*name;
+    if (*pattern == '*')
+    {
+        for (const char* rest = name;; ++rest)
+        {
+            if (Reference(pattern + 1, rest, ignoreCase))
+                return TRUE;
+            if (!*rest)
+                return FALSE;
+        }
+    }
+    if (!*name)
+        return FALSE;
+    if (*pattern == '?')
+        return Reference(pattern + 1, name + 1, ignoreCase);
+    if (*pattern == '[')
+    {
+        const char* p = pattern + 1;
+        BOOL negate = *p == '!' || *p == '^', found = FALSE;
+        int ch = Fold(*name, ignoreCase);
+        p += negate;
+        do
+        {
+            if (!*p)
+                return *name == '[' && Reference(pattern + 1, name + 1, ignoreCase);
+            int lo = Fold(*p++, ignoreCase), hi = lo;
+            if (p[0] == '-' && p[1] && p[1] != ']')
+            {
+                hi = Fold(p[1], ignoreCase);
+                p += 2;
+            }
+            if (lo <= ch && ch <= hi)
+                found = TRUE;
+        } while (*p != ']');
+        return found != negate && Reference(p + 1, name + 1, ignoreCase);
+    }
+    return Fold(*pattern, ignoreCase) == Fold(*name, ignoreCase) && Reference(pattern + 1, name + 1, ignoreCase);
+}
+
+static void TestGlobReference(void)
+{
+    static const char kPatternChars[] = "ab[]!-*?AB^c";
+    static const char kNameChars[] = "abAB[]-!c";
+    GEN_RNG rng;
+
+    Gen_Seed(&rng, 7);
+    for (DWORD i = 0; i < 200000; ++i)
+    {
+        char pattern[10], name[10];
+        DWORD patternLength = Gen_Below(&rng, 9), nameLength = Gen_Below(&rng, 9);
+        BOOL ignoreCase = Gen_Below(&rng, 2);
+
+        for (DWORD j = 0; j < patternLength; ++j)
+            pattern[j] = kPatternChars[Gen_Below(&rng, sizeof(kPatternChars) - 1)];
+        pattern[patternLength] = 0;
+        for (DWORD j = 0; j < nameLength; ++j)
+            name[j] = kNameChars[Gen_Below(&rng, sizeof(kNameChars) - 1)];
+        name[nameLength] = 0;
+        if (!Glob_Match(W(pattern).c_str(), W(name).c_str(), ignoreCase ? GLOB_IGNORE_CASE : 0) !=
+            !Reference(pattern, name, ignoreCase))
+        {
+            fprintf(stderr, "glob \"%s\" on \"%s\" (ignore case %d)\n", pattern, name, ignoreCase);
+            CHECK(FALSE);
+        }
+    }
+    CHECK(Glob_HasWildcards(W("a[b").c_str()));
+    CHECK(!Glob_HasWildcards(W("App One").c_str()));
+}
+
+int main()
+{
+    TestPrefix();
+    TestGlob();
+    TestRecurse();
+    TestRun();
+    TestDispatchBound();
+    TestGlobReference();
+    return Check_Result();
+}
@@ -0,0 +1,230 @@
+#include "thread.h"
+
+#if defined(_WIN32)
+
+extern "C" THREAD Thread_Start(THREAD_PROC proc, void* arg)
+{
+    return (THREAD)CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)proc, arg, 0, NULL);
+}
+
+extern "C" void Thread_Join(THREAD thread)
+{
+    WaitForSingleObject((HANDLE)thread, INFINITE);
+    CloseHandle((HANDLE)thread);
+}
+
+struct SPAWN_ARGS
+{
+    THREAD_PROC proc;
+    void* arg;
+    HMODULE module;
+};
+
+static DWORD WINAPI Thread_SpawnTrampoline(void* p)
+{
+    SPAWN_ARGS args = *(SPAWN_ARGS*)p;
+    Mem_Free(p);
+    args.proc(args.arg);
+    // Our code may be unmapped the moment the reference goes: leave from
+    // kernel32, not from here.
+    FreeLibraryAndExitThread(args.module, 0);
+    return 0;
+}
+
+extern "C" BOOL Thread_Spawn(THREAD_PROC proc, void* arg)
+{
+    SPAWN_ARGS* args = (SPAWN_ARGS*)Mem_Alloc(sizeof(SPAWN_ARGS));
+    HANDLE thread;
+
+    if (!args)
+        return FALSE;
+    args->proc = proc;
+    args->arg = arg;
+    if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR)Thread_SpawnTrampoline, &args->module))
+    {
+        Mem_Free(args);
+        return FALSE;
+    }
+    thread = CreateThread(NULL, 0, Thread_SpawnTrampoline, args, 0, NULL);
+    if (!thread)
+    {
+        FreeLibrary(args->module);
+        Mem_Free(args);
+        return FALSE;
+    }
+    CloseHandle(thread);
+    return TRUE;
+}
+
+extern "C" DWORD Thread_CpuCount(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+}
+
+extern "C" DWORD Thread_CurrentId(void)
+{
+    return GetCurrentThreadId();
+}
+
+extern "C" EVENT Event_Create(void)
+{
+    return (EVENT)CreateEventW(NULL, TRUE, FALSE, NULL);
+}
+
+extern "C" void Event_Destroy(EVENT event)
+{
+    CloseHandle((HANDLE)event);
+}
+
+extern "C" void Event_Set(EVENT event)
+{
+    SetEvent((HANDLE)event);
+}
+
+extern "C" BOOL Event_Wait(EVENT event, DWORD milliseconds)
+{
+    return WaitForSingleObject((HANDLE)event, milliseconds) == WAIT_OBJECT_0;
+}
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+struct _THREAD
+{
+    pthread_t id;
+    THREAD_PROC proc;
+    void* arg;
+};
+
+static void* Thread_Trampoline(void* arg)
+{
+    THREAD thread = (THREAD)arg;
+    thread->proc(thread->arg);
+    return NULL;
+}
+
+// Nobody joins a spawned thread, so it frees its own record.
+static void* Thread_DetachedTrampoline(void* arg)
+{
+    struct _THREAD copy = *(THREAD)arg;
+    Mem_Free(arg);
+    copy.proc(copy.arg);
+    return NULL;
+}
+
+struct _EVENT
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    BOOL set;
+};
+
+extern "C" THREAD Thread_Start(THREAD_PROC proc, void* arg)
+{
+    THREAD thread = (THREAD)Mem_Alloc(sizeof(struct _THREAD));
+    if (!thread)
+        return NULL;
+    thread->proc = proc;
+    thread->arg = arg;
+    if (pthread_create(&thread->id, NULL, Thread_Trampoline, thread) != 0)
+    {
+        Mem_Free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+extern "C" void Thread_Join(THREAD thread)
+{
+    pthread_join(thread->id, NULL);
+    Mem_Free(thread);
+}
+
+extern "C" BOOL Thread_Spawn(THREAD_PROC proc, void* arg)
+{
+    THREAD thread = (THREAD)Mem_Alloc(sizeof(struct _THREAD));
+    pthread_t id;
+
+    if (!thread)
+        return FALSE;
+    thread->proc = proc;
+    thread->arg = arg;
+    // The record may already be gone once pthread_create returns.
+    if (pthread_create(&id, NULL, Thread_DetachedTrampoline, thread) != 0)
+    {
+        Mem_Free(thread);
+        return FALSE;
+    }
+    pthread_detach(id);
+    return TRUE;
+}
+
+extern "C" DWORD Thread_CpuCount(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (DWORD)n : 1;
+}
+
+extern "C" DWORD Thread_CurrentId(void)
+{
+    // Only used to tell threads apart; the low bits of the handle suffice.
+    return (DWORD)(size_t)pthread_self();
+}
+
+extern "C" EVENT Event_Create(void)
+{
+    EVENT event = (EVENT)Mem_Alloc(sizeof(struct _EVENT));
+    if (!event)
+        return NULL;
+    pthread_mutex_init(&event->mutex, NULL);
+    pthread_cond_init(&event->cond, NULL);
+    event->set = FALSE;
+    return event;
+}
+
+extern "C" void Event_Destroy(EVENT event)
+{
+    pthread_cond_destroy(&event->cond);
+    pthread_mutex_destroy(&event->mutex);
+    Mem_Free(event);
+}
+
+extern "C" void Event_Set(EVENT event)
+{
+    pthread_mutex_lock(&event->mutex);
+    event->set = TRUE;
+    pthread_cond_broadcast(&event->cond);
+    pthread_mutex_unlock(&event->mutex);
+}
+
+extern "C" BOOL Event_Wait(EVENT event, DWORD milliseconds)
+{
+    struct timespec deadline;
+    BOOL set;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (long)(milliseconds % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_nsec -= 1000000000;
+        ++deadline.tv_sec;
+    }
+
+    pthread_mutex_lock(&event->mutex);
+    while (!event->set)
+    {
+        if (milliseconds == INFINITE)
+            pthread_cond_wait(&event->cond, &event->mutex);
+        else if (pthread_cond_timedwait(&event->cond, &event->mutex, &deadline) != 0)
+            break;
+    }
+    set = event->set;
+    pthread_mutex_unlock(&event->mutex);
+    return set;
+}
+
+#endif
@@ -0,0 +1,40 @@
+// thread.h: plain worker threads for the portable cores. CreateThread on
+// Windows (the plugin has no CRT, so no _beginthreadex), pthreads elsewhere.
+#ifndef MUICACHE_THREAD_H_
+#define MUICACHE_THREAD_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef DWORD (WINAPI *THREAD_PROC)(void* arg);
+typedef struct _THREAD* THREAD;
+typedef struct _EVENT* EVENT;
+
+// Returns NULL if the thread could not be started.
+THREAD Thread_Start(THREAD_PROC proc, void* arg);
+// Waits for |thread| to exit and releases it.
+void Thread_Join(THREAD thread);
+// Starts a thread nobody joins. On Windows it holds a reference on the
+// module its code lives in and drops it with FreeLibraryAndExitThread, so
+// the DLL stays loaded until |proc| returns even if the host frees it first.
+BOOL Thread_Spawn(THREAD_PROC proc, void* arg);
+// Number of logical processors, at least 1.
+DWORD Thread_CpuCount(void);
+// An id for the calling thread, unique among running threads.
+DWORD Thread_CurrentId(void);
+
+// Manual-reset event, initially unset. Returns NULL on failure.
+EVENT Event_Create(void);
+void Event_Destroy(EVENT event);
+void Event_Set(EVENT event);
+// TRUE once |event| is set, FALSE if |milliseconds| (or INFINITE) ran out.
+BOOL Event_Wait(EVENT event, DWORD milliseconds);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_THREAD_H_
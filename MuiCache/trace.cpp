@@ -0,0 +1,235 @@
+// Span recorder behind trace.h.
+// Recording is one interlocked increment to claim a ring slot, a few plain
+// stores guarded by the slot's sequence word (0 while it is being written,
+// index + 1 once complete) and one interlocked increment of a histogram
+// bucket; there is no lock anywhere. Durations stay in raw clock ticks, and
+// only Trace_Flush converts them to microseconds, with 32-bit divisions: the
+// plugin has no CRT to provide 64-bit division helpers on x86.
+#include "trace.h"
+
+#if defined(MUICACHE_TRACE)
+
+#include "fileio.h"
+#include "report.h"
+#include "thread.h"
+
+typedef struct _TRACE_EVENT {
+    volatile LONG sequence;
+    DWORD op;
+    DWORD thread;
+    ULONGLONG start;
+    ULONGLONG duration;
+} TRACE_EVENT;
+
+static const char* const kTraceOpNames[TRACE_OP_COUNT] = {
+    "Purge",
+    "RegEnumValue",
+    "RegDeleteValue",
+    "ShellExecute",
+    "CoCreateInstance(TaskbandPin)",
+    "IPinnedList3::Modify",
+    "CoCreateInstance(ShellLink)",
+    "IPersistFile::Save",
+};
+
+// Zero-initialized, nothing runs at load time.
+static TRACE_EVENT g_traceRing[TRACE_RING_SIZE];
+static volatile LONG g_traceNext;
+static DWORD g_traceFlushed; // only touched by Trace_Flush
+static volatile LONG g_traceHistogram[TRACE_OP_COUNT][TRACE_HISTOGRAM_BUCKETS];
+
+extern "C" ULONGLONG Trace_Now(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (ULONGLONG)now.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ULONGLONG)ts.tv_sec * 1000000000u + (ULONGLONG)ts.tv_nsec;
+#endif
+}
+
+// Number of significant bits of |ticks|, capped to the last bucket.
+static DWORD Trace_Bucket(ULONGLONG ticks)
+{
+    DWORD high = (DWORD)(ticks >> 32);
+    DWORD value = high ? high : (DWORD)ticks;
+    DWORD bits = high ? 32 : 0;
+
+    while (value)
+    {
+        ++bits;
+        value >>= 1;
+    }
+    return bits < TRACE_HISTOGRAM_BUCKETS ? bits : TRACE_HISTOGRAM_BUCKETS - 1;
+}
+
+extern "C" void Trace_Record(DWORD op, ULONGLONG start)
+{
+    ULONGLONG duration = Trace_Now() - start;
+    DWORD index;
+    TRACE_EVENT* event;
+
+    if (op >= TRACE_OP_COUNT)
+        return;
+    Atomic_Increment(&g_traceHistogram[op][Trace_Bucket(duration)]);
+
+    index = (DWORD)Atomic_Increment(&g_traceNext) - 1;
+    event = &g_traceRing[index & (TRACE_RING_SIZE - 1)];
+    Atomic_Exchange(&event->sequence, 0);
+    event->op = op;
+    event->thread = Thread_CurrentId();
+    event->start = start;
+    event->duration = duration;
+    Atomic_Exchange(&event->sequence, (LONG)(index + 1));
+}
+
+// Ticks per second, brought under 2^32 by dropping |*shift| low bits.
+static DWORD Trace_Frequency(DWORD* shift)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    ULONGLONG value;
+
+    QueryPerformanceFrequency(&frequency);
+    value = (ULONGLONG)frequency.QuadPart;
+    *shift = 0;
+    while (value >> 32)
+    {
+        value >>= 1;
+        ++*shift;
+    }
+    return (DWORD)value;
+#else
+    *shift = 0;
+    return 1000000000u;
+#endif
+}
+
+// (|high|:|low|) / |divisor| for a high part already below |divisor|, so the
+// quotient fits in 32 bits; shift-and-subtract, one quotient bit per round.
+static DWORD Trace_Divide(DWORD high, DWORD low, DWORD divisor, DWORD* remainder)
+{
+    DWORD quotient = 0, carry, i;
+
+    for (i = 0; i < 32; ++i)
+    {
+        carry = high >> 31;
+        high = (high << 1) | (low >> 31);
+        low <<= 1;
+        quotient <<= 1;
+        if (carry || high >= divisor)
+        {
+            high -= divisor;
+            quotient |= 1;
+        }
+    }
+    *remainder = high;
+    return quotient;
+}
+
+// Microseconds in |ticks|, wrapping after 71 minutes like any DWORD count.
+static DWORD Trace_Microseconds(ULONGLONG ticks, DWORD frequency, DWORD shift)
+{
+    ULONGLONG scaled;
+    DWORD seconds, remainder, i;
+
+    for (i = 0; i < shift; ++i)
+        ticks >>= 1;
+    seconds = Trace_Divide((DWORD)(ticks >> 32) % frequency, (DWORD)ticks, frequency, &remainder);
+    // remainder < frequency, so the quotient is below 10^6.
+    scaled = (ULONGLONG)remainder * 1000000u;
+    return seconds * 1000000u + Trace_Divide((DWORD)(scaled >> 32), (DWORD)scaled, frequency, &remainder);
+}
+
+extern "C" LSTATUS Trace_Flush(const WCHAR* path)
+{
+    REPORT report;
+    TRACE_EVENT event;
+    ULONGLONG base = 0;
+    DWORD frequency, shift, op, bucket, count, end, first, index, sequence;
+    BOOL any = FALSE, anyBucket;
+    LSTATUS status;
+
+    frequency = Trace_Frequency(&shift);
+    end = (DWORD)Atomic_Load(&g_traceNext);
+    first = g_traceFlushed;
+    if (end - first > TRACE_RING_SIZE)
+        first = end - TRACE_RING_SIZE; // the rest was overwritten
+
+    // Timestamps are relative to the earliest span written out.
+    for (index = first; index != end; ++index)
+    {
+        const TRACE_EVENT* slot = &g_traceRing[index & (TRACE_RING_SIZE - 1)];
+        if ((DWORD)Atomic_Load(&slot->sequence) == index + 1 && (!any || slot->start < base))
+        {
+            base = slot->start;
+            any = TRUE;
+        }
+    }
+
+    Report_Init(&report);
+    Report_Append(&report, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    any = FALSE;
+    for (index = first; index != end; ++index)
+    {
+        TRACE_EVENT* slot = &g_traceRing[index & (TRACE_RING_SIZE - 1)];
+        sequence = (DWORD)Atomic_Load(&slot->sequence);
+        event.op = slot->op;
+        event.thread = slot->thread;
+        event.start = slot->start;
+        event.duration = slot->duration;
+        // A full barrier, so the copy above is done before the re-check.
+        if (sequence != index + 1 || (DWORD)Atomic_CompareExchange(&slot->sequence, 0, 0) != sequence)
+            continue;
+        if (event.start < base)
+            continue; // rewritten after the first pass
+        Report_Append(&report, any ? ",{\"name\":\"" : "{\"name\":\"");
+        Report_Append(&report, kTraceOpNames[event.op]);
+        Report_Append(&report, "\",\"cat\":\"muicache\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+        Report_AppendDword(&report, event.thread);
+        Report_Append(&report, ",\"ts\":");
+        Report_AppendDword(&report, Trace_Microseconds(event.start - base, frequency, shift));
+        Report_Append(&report, ",\"dur\":");
+        Report_AppendDword(&report, Trace_Microseconds(event.duration, frequency, shift));
+        Report_Append(&report, "}");
+        any = TRUE;
+    }
+
+    // Viewers ignore keys they don't know. Each bucket is listed by its
+    // upper bound in microseconds: [bound, spans].
+    Report_Append(&report, "],\"histograms\":{");
+    for (op = 0; op < TRACE_OP_COUNT; ++op)
+    {
+        Report_Append(&report, op ? ",\"" : "\"");
+        Report_Append(&report, kTraceOpNames[op]);
+        Report_Append(&report, "\":[");
+        anyBucket = FALSE;
+        for (bucket = 0; bucket < TRACE_HISTOGRAM_BUCKETS; ++bucket)
+        {
+            count = (DWORD)Atomic_Load(&g_traceHistogram[op][bucket]);
+            if (!count)
+                continue;
+            Report_Append(&report, anyBucket ? ",[" : "[");
+            Report_AppendDword(&report, Trace_Microseconds(
+                bucket < 32 ? (ULONGLONG)((DWORD)1 << bucket) : (ULONGLONG)((DWORD)1 << (bucket - 32)) << 32,
+                frequency, shift));
+            Report_Append(&report, ",");
+            Report_AppendDword(&report, count);
+            Report_Append(&report, "]");
+            anyBucket = TRUE;
+        }
+        Report_Append(&report, "]");
+    }
+    Report_Append(&report, "}}\n");
+
+    status = Report_Write(&report, path);
+    Report_Free(&report);
+    if (status == ERROR_SUCCESS)
+        g_traceFlushed = end;
+    return status;
+}
+
+#endif // MUICACHE_TRACE
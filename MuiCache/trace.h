@@ -0,0 +1,63 @@
+// trace.h: begin/end spans around the calls an uninstall can stall on
+// (registry enumeration, shell verbs, the taskband and IShellLink COM
+// objects, IPersistFile::Save). Finished spans go to a fixed-size lock-free
+// ring and to a per-operation log2 latency histogram; Trace_Flush writes
+// both out in Chrome trace-event format (chrome://tracing, Perfetto).
+// Everything compiles to nothing unless MUICACHE_TRACE is defined.
+#ifndef MUICACHE_TRACE_H_
+#define MUICACHE_TRACE_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+enum TRACE_OP
+{
+    TRACE_OP_PURGE = 0,         // MuiCache_Clear, all targets
+    TRACE_OP_REG_ENUM_VALUE,    // RegEnumValue
+    TRACE_OP_REG_DELETE_VALUE,  // RegDeleteValue
+    TRACE_OP_SHELL_VERB,        // ShellExecute("taskbarpin"/"taskbarunpin")
+    TRACE_OP_TASKBAND_CREATE,   // CoCreateInstance(CLSID_TaskbandPin)
+    TRACE_OP_TASKBAND_MODIFY,   // IPinnedList3::Modify
+    TRACE_OP_SHELL_LINK_CREATE, // CoCreateInstance(CLSID_ShellLink)
+    TRACE_OP_PERSIST_SAVE,      // IPersistFile::Save
+    TRACE_OP_COUNT
+};
+
+// Spans kept for Trace_Flush; older ones are overwritten. Power of two.
+#define TRACE_RING_SIZE 4096
+// Bucket b counts spans of [2^(b-1), 2^b) clock ticks; bucket 0 counts 0.
+#define TRACE_HISTOGRAM_BUCKETS 64
+
+#if defined(MUICACHE_TRACE)
+
+// Raw clock ticks: QueryPerformanceCounter on Windows, nanoseconds elsewhere.
+ULONGLONG Trace_Now(void);
+// Records a span of |op| from |start| (a Trace_Now value) to now.
+void Trace_Record(DWORD op, ULONGLONG start);
+// Writes the spans recorded since the last flush, and the histograms of
+// every span so far, to |path| as a Chrome trace-event JSON document.
+// Spans still being written by other threads are skipped. Flushes must not
+// overlap each other; recording may go on meanwhile.
+LSTATUS Trace_Flush(const WCHAR* path);
+
+#define MC_TRACE_BEGIN(span) ULONGLONG span = Trace_Now()
+#define MC_TRACE_END(span, op) Trace_Record((op), (span))
+#define MC_TRACE(op, statement) \
+    do { MC_TRACE_BEGIN(mc_trace_start_); statement; MC_TRACE_END(mc_trace_start_, op); } while (0)
+
+#else
+
+#define MC_TRACE_BEGIN(span)
+#define MC_TRACE_END(span, op)
+#define MC_TRACE(op, statement) do { statement; } while (0)
+
+#endif // MUICACHE_TRACE
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_TRACE_H_
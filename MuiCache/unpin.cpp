@@ -0,0 +1,208 @@
+#include "unpin.h"
+#include "glob.h"
+#include "thread.h"
+
+static const WCHAR kUnpinVerb[] = { 't', 'a', 's', 'k', 'b', 'a', 'r', 'u', 'n', 'p', 'i', 'n', 0 };
+
+struct UNPIN_WALK
+{
+    const WCHAR* pattern;
+    BOOL glob;
+    DWORD flags;
+    const WCHAR* dir;
+    STR_LIST* dirs;
+    STR_LIST* paths;
+    BOOL failed;
+};
+
+static BOOL Unpin_IsShortcut(const WCHAR* name, DWORD cch)
+{
+    const WCHAR* ext = name + cch - 4;
+    return cch >= 4 && ext[0] == '.' && (ext[1] | 0x20) == 'l' && (ext[2] | 0x20) == 'n' && (ext[3] | 0x20) == 'k';
+}
+
+static BOOL Unpin_StartsWith(const WCHAR* name, const WCHAR* prefix)
+{
+    for (; *prefix; ++prefix, ++name)
+    {
+        if (*name != *prefix)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL Unpin_OnEntry(void* context, const WCHAR* name, BOOL isDirectory)
+{
+    UNPIN_WALK* walk = (UNPIN_WALK*)context;
+    BOOL ok = TRUE;
+    if (isDirectory)
+    {
+        if (walk->flags & UNPIN_RECURSE)
+            ok = StrList_AddPath(walk->dirs, walk->dir, name);
+    }
+    else if (Unpin_IsShortcut(name, Str_Length(name)))
+    {
+        BOOL match = walk->glob ? Glob_Match(walk->pattern, name, GLOB_IGNORE_CASE) : Unpin_StartsWith(name, walk->pattern);
+        if (match)
+            ok = StrList_AddPath(walk->paths, walk->dir, name);
+    }
+    if (!ok)
+        walk->failed = TRUE;
+    return ok;
+}
+
+extern "C" LSTATUS Unpin_FindShortcuts(DIR_LISTER* lister, const WCHAR* dir, const WCHAR* pattern, DWORD flags, STR_LIST* paths)
+{
+    STR_LIST levels[2];
+    STR_LIST* level = &levels[0];
+    UNPIN_WALK walk;
+    LSTATUS status = ERROR_SUCCESS;
+    BOOL root = TRUE;
+    DWORD i;
+
+    StrList_Init(&levels[0]);
+    StrList_Init(&levels[1]);
+    if (!StrList_Add(level, dir, Str_Length(dir)))
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    walk.pattern = pattern;
+    walk.glob = Glob_HasWildcards(pattern);
+    walk.flags = flags;
+    walk.paths = paths;
+    walk.failed = FALSE;
+
+    // Breadth-first, one level at a time: subfolders found while listing
+    // go to the other list, so the directory being listed never moves.
+    while (level->count && status == ERROR_SUCCESS)
+    {
+        walk.dirs = level == &levels[0] ? &levels[1] : &levels[0];
+        for (i = 0; i < level->count; ++i)
+        {
+            LSTATUS listed;
+            walk.dir = StrList_Get(level, i);
+            listed = lister->vtbl->List(lister, walk.dir, Unpin_OnEntry, &walk);
+            if (walk.failed)
+            {
+                status = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+            // An unreadable subfolder is skipped; only the root has to be there.
+            if (listed != ERROR_SUCCESS && root)
+            {
+                status = listed;
+                break;
+            }
+        }
+        root = FALSE;
+        StrList_Free(level);
+        level = walk.dirs;
+    }
+    StrList_Free(&levels[0]);
+    StrList_Free(&levels[1]);
+    return status;
+}
+
+struct VERB_POOL
+{
+    VERB_EXECUTOR* executor;
+    const WCHAR* verb;
+    const STR_LIST* paths;
+    LONG* results;
+    volatile LONG next;
+};
+
+static void Verb_Drain(VERB_POOL* pool)
+{
+    for (;;)
+    {
+        DWORD index = (DWORD)(Atomic_Increment(&pool->next) - 1);
+        if (index >= pool->paths->count)
+            break;
+        pool->results[index] = pool->executor->vtbl->Execute(pool->executor, pool->verb, StrList_Get(pool->paths, index));
+    }
+}
+
+static DWORD WINAPI Verb_Worker(void* arg)
+{
+    VERB_POOL* pool = (VERB_POOL*)arg;
+    VERB_EXECUTOR* executor = pool->executor;
+    BOOL attached = executor->vtbl->ThreadAttach ? executor->vtbl->ThreadAttach(executor) : FALSE;
+    Verb_Drain(pool);
+    if (attached && executor->vtbl->ThreadDetach)
+        executor->vtbl->ThreadDetach(executor);
+    return 0;
+}
+
+extern "C" void Verb_Dispatch(VERB_EXECUTOR* executor, const WCHAR* verb, const STR_LIST* paths, DWORD maxConcurrency, LONG* results)
+{
+    THREAD threads[UNPIN_MAX_CONCURRENCY];
+    VERB_POOL pool;
+    DWORD workers = maxConcurrency, started = 0, i;
+
+    pool.executor = executor;
+    pool.verb = verb;
+    pool.paths = paths;
+    pool.results = results;
+    pool.next = 0;
+
+    if (workers > UNPIN_MAX_CONCURRENCY)
+        workers = UNPIN_MAX_CONCURRENCY;
+    if (workers > paths->count)
+        workers = paths->count;
+
+    // Items are claimed off a shared counter, so a slow verb only holds up
+    // its own worker. The calling thread is one of the workers, and picks
+    // up everything if no thread could be started.
+    for (; started + 1 < workers; ++started)
+    {
+        threads[started] = Thread_Start(Verb_Worker, &pool);
+        if (!threads[started])
+            break;
+    }
+    Verb_Drain(&pool);
+    for (i = 0; i < started; ++i)
+        Thread_Join(threads[i]);
+}
+
+extern "C" LSTATUS Unpin_Run(DIR_LISTER* lister, VERB_EXECUTOR* executor, const WCHAR* dir, const WCHAR* pattern,
+    DWORD flags, DWORD maxConcurrency, UNPIN_RESULT* result)
+{
+    STR_LIST paths;
+    LONG* results;
+    LSTATUS status;
+    DWORD i;
+
+    memset(result, 0, sizeof(UNPIN_RESULT));
+    StrList_Init(&paths);
+    status = Unpin_FindShortcuts(lister, dir, pattern, flags, &paths);
+    if (status != ERROR_SUCCESS || !paths.count)
+    {
+        StrList_Free(&paths);
+        return status;
+    }
+
+    results = (LONG*)Mem_Alloc(paths.count * sizeof(LONG));
+    if (!results)
+    {
+        StrList_Free(&paths);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    Verb_Dispatch(executor, kUnpinVerb, &paths, maxConcurrency, results);
+
+    result->matched = paths.count;
+    for (i = 0; i < paths.count; ++i)
+    {
+        if (VERB_SUCCEEDED(results[i]))
+        {
+            if (!result->succeeded++)
+                result->result = results[i];
+        }
+        else if (!result->succeeded)
+        {
+            result->result = results[i];
+        }
+    }
+    Mem_Free(results);
+    StrList_Free(&paths);
+    return ERROR_SUCCESS;
+}
@@ -0,0 +1,67 @@
+// unpin.h: wildcard taskbar unpin. Shortcuts are found through a DIR_LISTER
+// and unpinned through a VERB_EXECUTOR on a small worker pool; both are
+// vtables so the walk and the scheduling can run against fakes off Windows.
+#ifndef MUICACHE_UNPIN_H_
+#define MUICACHE_UNPIN_H_
+
+#include "platform.h"
+#include "dirlist.h"
+#include "strlist.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _VERB_EXECUTOR VERB_EXECUTOR;
+
+typedef struct _VERB_EXECUTOR_VTBL {
+    // Optional per-worker setup (e.g. COM); ThreadDetach runs only after a
+    // TRUE return. Not called for work done on the caller's thread.
+    BOOL (*ThreadAttach)(VERB_EXECUTOR* executor);
+    void (*ThreadDetach)(VERB_EXECUTOR* executor);
+    // ShellExecute-style result: greater than 32 on success.
+    LONG (*Execute)(VERB_EXECUTOR* executor, const WCHAR* verb, const WCHAR* path);
+} VERB_EXECUTOR_VTBL;
+
+struct _VERB_EXECUTOR {
+    const VERB_EXECUTOR_VTBL* vtbl;
+};
+
+#define VERB_SUCCEEDED(result) ((result) > 32)
+
+#define UNPIN_RECURSE 0x1
+
+#define UNPIN_DEFAULT_CONCURRENCY 4
+#define UNPIN_MAX_CONCURRENCY     16
+
+typedef struct _UNPIN_RESULT {
+    DWORD matched;
+    DWORD succeeded;
+    // First successful result in listing order, else the last failure, 0 if
+    // nothing matched; what the serial loop used to report.
+    LONG result;
+} UNPIN_RESULT;
+
+// Collects the .lnk files under |dir| whose names match |pattern|. A pattern
+// with wildcards is a case-insensitive glob over the whole file name; a plain
+// one is a case-sensitive prefix, as TaskbarUnpin has always done.
+LSTATUS Unpin_FindShortcuts(DIR_LISTER* lister, const WCHAR* dir, const WCHAR* pattern, DWORD flags, STR_LIST* paths);
+
+// Runs |verb| on every entry of |paths| using up to |maxConcurrency| threads
+// and stores each result in |results|.
+void Verb_Dispatch(VERB_EXECUTOR* executor, const WCHAR* verb, const STR_LIST* paths, DWORD maxConcurrency, LONG* results);
+
+// Unpin_FindShortcuts + Verb_Dispatch("taskbarunpin"), aggregated.
+LSTATUS Unpin_Run(DIR_LISTER* lister, VERB_EXECUTOR* executor, const WCHAR* dir, const WCHAR* pattern,
+    DWORD flags, DWORD maxConcurrency, UNPIN_RESULT* result);
+
+#if defined(_WIN32)
+// ShellExecute executor with an STA per worker.
+VERB_EXECUTOR* Unpin_Win32Executor(void);
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_UNPIN_H_
@@ -0,0 +1,37 @@
+// VERB_EXECUTOR over ShellExecute.
+#include "unpin.h"
+#include "trace.h"
+#include <ShellAPI.h>
+#include <objbase.h>
+
+static BOOL Win32_ThreadAttach(VERB_EXECUTOR* executor)
+{
+    // ShellExecute runs shell extensions, which want an STA.
+    return SUCCEEDED(CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE));
+}
+
+static void Win32_ThreadDetach(VERB_EXECUTOR* executor)
+{
+    CoUninitialize();
+}
+
+static LONG Win32_Execute(VERB_EXECUTOR* executor, const WCHAR* verb, const WCHAR* path)
+{
+    INT_PTR result;
+    MC_TRACE(TRACE_OP_SHELL_VERB, result = (INT_PTR)ShellExecuteW(NULL, verb, path, NULL, NULL, 0));
+    // Only the "> 32" test is meaningful, keep that across the narrowing.
+    return result > 32 ? (result > 0x7FFFFFFF ? 42 : (LONG)result) : (LONG)result;
+}
+
+static const VERB_EXECUTOR_VTBL Win32_VerbExecutorVtbl = {
+    Win32_ThreadAttach,
+    Win32_ThreadDetach,
+    Win32_Execute,
+};
+
+static VERB_EXECUTOR Win32_VerbExecutor = { &Win32_VerbExecutorVtbl };
+
+extern "C" VERB_EXECUTOR* Unpin_Win32Executor(void)
+{
+    return &Win32_VerbExecutor;
+}
@@ -0,0 +1,166 @@
+#include "wspool.h"
+#include "thread.h"
+
+// One worker's range, alone on its cache line so owners popping their own
+// work don't invalidate each other.
+struct WORK_SLOT
+{
+    volatile LONG range; // (end << 16) | next, relative to the round's base
+    BYTE padding[60];
+};
+
+struct WORK_POOL
+{
+    WORK_SLOT slots[WORK_POOL_MAX_WORKERS];
+    DWORD workers;
+    DWORD base;
+    WORK_POOL_JOB job;
+    void* context;
+    volatile LONG steals;
+};
+
+struct WORK_THREAD
+{
+    WORK_POOL* pool;
+    DWORD id;
+};
+
+static __inline LONG Work_Pack(DWORD next, DWORD end)
+{
+    return (LONG)((end << 16) | next);
+}
+
+// Takes the next index off the front of |slot|, or returns FALSE if empty.
+static BOOL Work_Pop(WORK_SLOT* slot, DWORD* index)
+{
+    for (;;)
+    {
+        LONG range = Atomic_Add(&slot->range, 0);
+        DWORD next = (DWORD)range & 0xFFFF, end = ((DWORD)range >> 16) & 0xFFFF;
+        if (next >= end)
+            return FALSE;
+        if (Atomic_CompareExchange(&slot->range, Work_Pack(next + 1, end), range) == range)
+        {
+            *index = next;
+            return TRUE;
+        }
+    }
+}
+
+// Moves the back half of |victim|'s range to |thief| and returns its first
+// index to run right away. |thief| is empty, and only its owner refills it.
+static BOOL Work_Steal(WORK_SLOT* victim, WORK_SLOT* thief, DWORD* index)
+{
+    for (;;)
+    {
+        LONG range = Atomic_Add(&victim->range, 0);
+        DWORD next = (DWORD)range & 0xFFFF, end = ((DWORD)range >> 16) & 0xFFFF;
+        DWORD split;
+        if (next >= end)
+            return FALSE;
+        split = end - (end - next + 1) / 2;
+        if (Atomic_CompareExchange(&victim->range, Work_Pack(next, split), range) == range)
+        {
+            LONG empty = Atomic_Add(&thief->range, 0);
+            Atomic_CompareExchange(&thief->range, Work_Pack(split + 1, end), empty);
+            *index = split;
+            return TRUE;
+        }
+    }
+}
+
+static void Work_Loop(WORK_POOL* pool, DWORD id)
+{
+    WORK_SLOT* own = &pool->slots[id];
+    DWORD index, i;
+    for (;;)
+    {
+        BOOL found = Work_Pop(own, &index);
+        // Out of own work: go round the others once; when every range was
+        // empty there is nothing left that isn't already being run.
+        for (i = 1; !found && i < pool->workers; ++i)
+        {
+            found = Work_Steal(&pool->slots[(id + i) % pool->workers], own, &index);
+            if (found)
+                Atomic_Increment(&pool->steals);
+        }
+        if (!found)
+            return;
+        pool->job(pool->context, pool->base + index, id);
+    }
+}
+
+static DWORD WINAPI Work_Thread(void* arg)
+{
+    WORK_THREAD* thread = (WORK_THREAD*)arg;
+    Work_Loop(thread->pool, thread->id);
+    return 0;
+}
+
+extern "C" void WorkPool_Run(DWORD count, DWORD workers, WORK_POOL_JOB job, void* context, WORK_POOL_STATS* stats)
+{
+    WORK_POOL* pool;
+    THREAD threads[WORK_POOL_MAX_WORKERS];
+    WORK_THREAD args[WORK_POOL_MAX_WORKERS];
+    DWORD started, i, round, base;
+
+    if (!workers)
+        workers = Thread_CpuCount();
+    if (workers > WORK_POOL_MAX_WORKERS)
+        workers = WORK_POOL_MAX_WORKERS;
+    if (workers > count)
+        workers = count ? count : 1;
+    if (stats)
+    {
+        stats->workers = workers;
+        stats->steals = 0;
+    }
+
+    // Too big for the stack of a CRT-less DLL (no __chkstk).
+    pool = (WORK_POOL*)Mem_Alloc(sizeof(WORK_POOL));
+    if (!pool)
+    {
+        // Still do the work, just on this thread.
+        for (i = 0; i < count; ++i)
+            job(context, i, 0);
+        if (stats)
+            stats->workers = 1;
+        return;
+    }
+
+    for (base = 0; base < count; base += round)
+    {
+        round = count - base;
+        if (round > WORK_POOL_MAX_JOBS)
+            round = WORK_POOL_MAX_JOBS;
+
+        memset(pool, 0, sizeof(WORK_POOL));
+        pool->workers = workers;
+        pool->base = base;
+        pool->job = job;
+        pool->context = context;
+        // Even split up front; stealing evens out the uneven jobs.
+        for (i = 0; i < workers; ++i)
+            pool->slots[i].range = Work_Pack(round * i / workers, round * (i + 1) / workers);
+
+        for (started = 0; started + 1 < workers; ++started)
+        {
+            args[started].pool = pool;
+            args[started].id = started + 1;
+            threads[started] = Thread_Start(Work_Thread, &args[started]);
+            if (!threads[started])
+                break;
+        }
+        // The caller is worker 0. Ranges of threads that failed to start
+        // are picked up by stealing.
+        Work_Loop(pool, 0);
+        for (i = 0; i < started; ++i)
+            Thread_Join(threads[i]);
+        if (stats)
+        {
+            stats->workers = started + 1;
+            stats->steals += (DWORD)pool->steals;
+        }
+    }
+    Mem_Free(pool);
+}
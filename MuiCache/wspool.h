@@ -0,0 +1,36 @@
+// wspool.h: runs a fixed set of independent jobs on a work-stealing pool.
+// Each worker owns a contiguous range of job indices and takes from its
+// front; an idle worker steals the back half of another worker's range.
+// Ranges are packed 16-bit (next, end) pairs updated with one 32-bit
+// compare-exchange, so there are no locks and no 64-bit atomics.
+#ifndef MUICACHE_WSPOOL_H_
+#define MUICACHE_WSPOOL_H_
+
+#include "platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define WORK_POOL_MAX_WORKERS 64
+// Jobs per round; larger counts are run as several rounds.
+#define WORK_POOL_MAX_JOBS    0xFFFF
+
+typedef void (*WORK_POOL_JOB)(void* context, DWORD index, DWORD worker);
+
+typedef struct _WORK_POOL_STATS {
+    DWORD workers; // threads used, the caller's included
+    DWORD steals;  // successful steals
+} WORK_POOL_STATS;
+
+// Calls |job| once for every index in [0, count) on up to |workers| threads
+// (0: one per logical processor) and returns when all are done. |worker| is
+// in [0, workers) and stable for a thread, e.g. to index per-worker state.
+// |stats| is optional.
+void WorkPool_Run(DWORD count, DWORD workers, WORK_POOL_JOB job, void* context, WORK_POOL_STATS* stats);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // MUICACHE_WSPOOL_H_